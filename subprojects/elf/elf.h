@@ -85,10 +85,15 @@ namespace elf
         svl::endian::big<svl::u32> vaddress;
         svl::endian::big<svl::u32> paddress;
         
-        svl::endian::big<svl::u32> size;
+        svl::endian::big<svl::u32> file_size;
+        svl::endian::big<svl::u32> mem_size;
+
+        svl::endian::big<svl::u32> flags;
         svl::endian::big<svl::u32> align;
     };
 
+    static_assert(sizeof(program_header<svl::u32>) == 32);
+
     template<>
     struct program_header<svl::u64>
     {
@@ -159,6 +164,12 @@ namespace elf
         object(svl::file d)
             : data(d)
         {}
+
+        /**
+         * @brief Construct an empty elf object
+         * 
+         */
+        object() = default;
     };
 
     /**
@@ -50,7 +50,10 @@ namespace svl::endian
     template<typename T>
     T byte_swap(T val)
     {
-        return byte_swap(*reinterpret_cast<typename std::make_unsigned<T>::type*>(&val));
+        // enums dont convert back from their underlying type implicitly
+        using unsigned_t = typename std::make_unsigned<T>::type;
+        unsigned_t out = byte_swap(*reinterpret_cast<unsigned_t*>(&val));
+        return *reinterpret_cast<T*>(&out);
     }
 
     /**
@@ -219,9 +219,10 @@ namespace svl
             nullptr
         );
 
+        // an invalid file is returned so callers can check it with valid
         if(f == INVALID_HANDLE_VALUE)
         {
-            return { new win32_file(nullptr) };
+            return {};
         }
 
         return { new win32_file(std::move(f)) };
@@ -235,6 +236,10 @@ namespace svl
             access += "r";
 
         std::FILE* f = std::fopen(path.c_str(), access.c_str());
+
+        if(!f)
+            return {};
+
         return { new posix_file(f) };
 #endif
     }
@@ -0,0 +1,121 @@
+#include "futex.h"
+#include "platform.h"
+
+#if SYS_UNIX
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#   include <climits>
+#   include <cerrno>
+#   include <ctime>
+#elif SYS_OSX
+#   include <mutex>
+#   include <chrono>
+#   include <condition_variable>
+#endif
+
+namespace svl::futex
+{
+    static_assert(sizeof(std::atomic<u32>) == sizeof(u32));
+
+#if SYS_UNIX
+    static u32* addr(std::atomic<u32>& word)
+    {
+        return reinterpret_cast<u32*>(&word);
+    }
+
+    void wait(std::atomic<u32>& word, u32 expected)
+    {
+        syscall(SYS_futex, addr(word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+
+    bool wait_for(std::atomic<u32>& word, u32 expected, u64 ns)
+    {
+        timespec timeout = { static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000) };
+
+        return syscall(SYS_futex, addr(word), FUTEX_WAIT_PRIVATE, expected, &timeout, nullptr, 0) == 0 || errno != ETIMEDOUT;
+    }
+
+    void wake_one(std::atomic<u32>& word)
+    {
+        syscall(SYS_futex, addr(word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void wake_all(std::atomic<u32>& word)
+    {
+        syscall(SYS_futex, addr(word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+#elif SYS_WINDOWS
+    void wait(std::atomic<u32>& word, u32 expected)
+    {
+        WaitOnAddress(&word, &expected, sizeof(u32), INFINITE);
+    }
+
+    bool wait_for(std::atomic<u32>& word, u32 expected, u64 ns)
+    {
+        // round up so short waits dont turn into polling
+        u64 ms = (ns + 999999) / 1000000;
+        if(ms >= INFINITE)
+            ms = INFINITE - 1;
+
+        return WaitOnAddress(&word, &expected, sizeof(u32), static_cast<DWORD>(ms)) || GetLastError() != ERROR_TIMEOUT;
+    }
+
+    void wake_one(std::atomic<u32>& word)
+    {
+        WakeByAddressSingle(&word);
+    }
+
+    void wake_all(std::atomic<u32>& word)
+    {
+        WakeByAddressAll(&word);
+    }
+#else
+    // osx has no public futex so words hash into a fixed set of condition variables
+    struct bucket
+    {
+        std::mutex mut;
+        std::condition_variable cond;
+    };
+
+    static bucket buckets[64];
+
+    static bucket& get(std::atomic<u32>& word)
+    {
+        return buckets[(reinterpret_cast<uintptr_t>(&word) >> 2) % 64];
+    }
+
+    void wait(std::atomic<u32>& word, u32 expected)
+    {
+        auto& b = get(word);
+        std::unique_lock<std::mutex> lock(b.mut);
+
+        if(word.load() == expected)
+            b.cond.wait(lock);
+    }
+
+    bool wait_for(std::atomic<u32>& word, u32 expected, u64 ns)
+    {
+        auto& b = get(word);
+        std::unique_lock<std::mutex> lock(b.mut);
+
+        if(word.load() != expected)
+            return true;
+
+        return b.cond.wait_for(lock, std::chrono::nanoseconds(ns)) == std::cv_status::no_timeout;
+    }
+
+    void wake_one(std::atomic<u32>& word)
+    {
+        // other words may share the bucket so waking one isnt enough
+        wake_all(word);
+    }
+
+    void wake_all(std::atomic<u32>& word)
+    {
+        auto& b = get(word);
+        std::lock_guard<std::mutex> guard(b.mut);
+        b.cond.notify_all();
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+
+#include <atomic>
+
+namespace svl::futex
+{
+    /**
+     * @brief block until the value of a word changes
+     *
+     * may return spuriously so callers must check the word again in a loop
+     *
+     * @param word the word to wait on
+     * @param expected returns immediately if the word doesnt hold this value
+     */
+    void wait(std::atomic<u32>& word, u32 expected);
+
+    /**
+     * @brief block until the value of a word changes or a timeout passes
+     *
+     * may return spuriously like wait
+     *
+     * @param word the word to wait on
+     * @param expected returns immediately if the word doesnt hold this value
+     * @param ns the most nanoseconds to wait for
+     * @return false if the timeout passed
+     */
+    bool wait_for(std::atomic<u32>& word, u32 expected, u64 ns);
+
+    /**
+     * @brief wake one thread waiting on a word
+     *
+     * @param word the word being waited on
+     */
+    void wake_one(std::atomic<u32>& word);
+
+    /**
+     * @brief wake every thread waiting on a word
+     *
+     * @param word the word being waited on
+     */
+    void wake_all(std::atomic<u32>& word);
+}
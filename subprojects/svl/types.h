@@ -53,6 +53,18 @@ namespace svl
 
         /// 128 bits of packed doubles
         __m128d doubles;
+
+        /// 128 bits of packed floats
+        __m128 floats;
+
+        /// individual lanes in host order
+        u8 bytes[16];
+        u16 halves[8];
+        u32 words[4];
+        u64 dwords[2];
+        f32 singles[4];
+        f64 reals[2];
+
         struct
         {
             /// the low 64 bits
@@ -8,10 +8,26 @@
 #include <vfs.h>
 
 #include <future>
+#include <chrono>
 
 #include "vm/vm.h"
+#include "vm/trace.h"
 #include "vm/ppu/module.h"
 #include "vm/ppu/thread.h"
+#include "vm/ppu/patch.h"
+#include "vm/ppu/decode.h"
+#include "vm/ppu/disasm.h"
+#include "vm/ppu/conformance.h"
+#include "vm/ppu/fpu.h"
+#include "vm/spu/recompiler.h"
+#include "vm/spu/scheduler.h"
+#include "vm/spu/image.h"
+#include "vm/spu/spurs.h"
+#include "vm/sys/timer.h"
+#include "vm/sys/fs.h"
+#include "vm/sys/memory.h"
+
+#include "debug/gdb.h"
 
 #include "elf.h"
 
@@ -39,6 +55,21 @@ namespace volts::cmd
     using namespace loader;
     using namespace crypt;
 
+    /// stops every host thread that can touch guest memory before unmapping it
+    static void shutdown_vm()
+    {
+        // wait for the spus and report how busy they were
+        spu::stop_spurs();
+        spu::stop_scheduler();
+
+        // guest timers wont be waited on any more
+        vm::stop_timers();
+        vm::stop_fs();
+
+        vm::report_memory();
+        vm::deinit();
+    }
+
     void parse(int argc, char** argv)
     {
         opts::Options opts = { "volts", "ps3 command line tools" };
@@ -50,7 +81,21 @@ namespace volts::cmd
             ("sfo", "parse an sfo file", opts::value<std::string>())
             ("pup", "parse a pup file", opts::value<std::string>())
             ("self", "parse a self file", opts::value<std::string>())
+            ("disasm", "disassemble the executable segments of an elf or self", opts::value<std::string>())
+            ("disasm-bench", "benchmark the disassembler instead of printing")
+            ("ppu-test", "run the ppu instruction conformance cases")
+            ("ppu-bench", "also measure each instruction when running the conformance cases")
+            ("fpu", "set the fpu mode [fast | accurate]", opts::value<std::string>())
+            ("spu-decoder", "set how spu code is executed [interpreter | recompiler]", opts::value<std::string>())
+            ("spu-cache", "load and save compiled spu blocks to a file in the vfs", opts::value<std::string>()->implicit_value("cache/spu.bin"))
+            ("spu-precompile", "compile the spu programs embedded in an elf or self into the spu cache", opts::value<std::string>())
+            ("spu-analyze", "print the functions, loops and channel use of the spu programs in an elf or self", opts::value<std::string>())
+            ("spu-cores", "pin the host thread of each spu to a core, a comma separated list", opts::value<std::vector<svl::u32>>())
+            ("patches", "load function patches from a file in the vfs", opts::value<std::string>())
+            ("record", "record a trace of all non deterministic inputs", opts::value<std::string>())
+            ("replay", "replay a recorded trace", opts::value<std::string>())
             ("boot", "boot the emulator", opts::value<std::string>())
+            ("gdb", "wait for gdb to connect on a port before booting", opts::value<svl::u16>()->implicit_value("2345"))
             ("gui", "run gui", opts::value<std::string>())
             ("debug", "enable debugging")
             ;
@@ -119,6 +164,36 @@ namespace volts::cmd
             spdlog::info("updated vfs root to {}", fs::absolute(path).string());
         }
 
+        // hle libraries have to be registered before patches can name them
+        spu::init_spurs();
+
+        if(res.count("patches"))
+            ppu::load_patches(res["patches"].as<std::string>());
+
+        if(res.count("fpu"))
+        {
+            ppu::fpu_mode mode;
+            if(ppu::parse_fpu_mode(res["fpu"].as<std::string>(), mode))
+                ppu::set_fpu_mode(mode);
+            else
+                spdlog::warn("invalid fpu mode {}. must be one of [fast | accurate]", res["fpu"].as<std::string>());
+        }
+
+        if(res.count("spu-decoder"))
+        {
+            spu::decoder mode;
+            if(spu::parse_decoder(res["spu-decoder"].as<std::string>(), mode))
+                spu::set_decoder(mode);
+            else
+                spdlog::warn("invalid spu decoder {}. must be one of [interpreter | recompiler]", res["spu-decoder"].as<std::string>());
+        }
+
+        if(res.count("spu-cache"))
+            spu::load_cache(vfs::get(res["spu-cache"].as<std::string>()));
+
+        if(res.count("spu-cores"))
+            spu::pin_spus(res["spu-cores"].as<std::vector<svl::u32>>());
+
         if(res.count("sfo"))
         {
             if(fs::path path = res["sfo"].as<std::string>(); fs::exists(path))
@@ -227,21 +302,169 @@ namespace volts::cmd
             }
         }
 
+        if(res.count("record"))
+            vm::trace::record(res["record"].as<std::string>());
+        else if(res.count("replay"))
+            vm::trace::replay(res["replay"].as<std::string>());
+
+        if(res.count("disasm"))
+        {
+            if(fs::path path = res["disasm"].as<std::string>(); fs::exists(path))
+            {
+                auto file = svl::open(path, svl::mode::read);
+                auto dec = self::load(file);
+                auto exec = elf::load<elf::ppu_exec>(dec.size() ? dec : file).expect("failed to parse elf");
+
+                ppu::init_table();
+
+                // collect every instruction in the executable segments
+                std::vector<svl::u32> code;
+                std::vector<svl::u32> addrs;
+
+                for(auto prog : exec.progs)
+                {
+                    if(prog.type != 1 || !(prog.flags & 1))
+                        continue;
+
+                    exec.data.seek(prog.offset);
+                    auto words = exec.data.read<svl::endian::big<svl::u32>>(prog.file_size / 4);
+
+                    for(std::size_t i = 0; i < words.size(); i++)
+                    {
+                        code.push_back(words[i]);
+                        addrs.push_back(static_cast<svl::u32>(prog.vaddress + i * 4));
+                    }
+                }
+
+                if(res.count("disasm-bench"))
+                {
+                    using clock = std::chrono::steady_clock;
+
+                    std::string out;
+                    svl::u64 count = 0;
+                    auto start = clock::now();
+
+                    // run whole passes over the code until a second has passed
+                    while(!code.empty() && clock::now() - start < std::chrono::seconds(1))
+                    {
+                        for(auto op : code)
+                        {
+                            out.clear();
+                            ppu::disasm(op, out);
+                        }
+
+                        count += code.size();
+                    }
+
+                    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+                    spdlog::info("disassembled {} instructions in {}ms ({} instructions/s)", count, ms, ms ? count * 1000 / ms : count);
+                }
+                else
+                {
+                    std::string out;
+
+                    for(std::size_t i = 0; i < code.size(); i++)
+                    {
+                        out.clear();
+                        ppu::disasm(code[i], out);
+                        spdlog::info("{:08x}: {:08x} {}", addrs[i], code[i], out);
+                    }
+                }
+            }
+            else
+            {
+                spdlog::error("no elf file found at {}", path.string());
+            }
+        }
+
+        if(res.count("spu-precompile"))
+        {
+            if(fs::path path = res["spu-precompile"].as<std::string>(); fs::exists(path))
+            {
+                auto file = svl::open(path, svl::mode::read);
+                auto dec = self::load(file);
+                auto exec = elf::load<elf::ppu_exec>(dec.size() ? dec : file).expect("failed to parse elf");
+
+                spu::precompile(exec);
+
+                if(!res.count("spu-cache"))
+                    spdlog::warn("no spu cache was given so the compiled blocks wont be saved");
+            }
+            else
+            {
+                spdlog::error("no elf file found at {}", path.string());
+            }
+        }
+
+        if(res.count("spu-analyze"))
+        {
+            if(fs::path path = res["spu-analyze"].as<std::string>(); fs::exists(path))
+            {
+                auto file = svl::open(path, svl::mode::read);
+                auto dec = self::load(file);
+                auto& src = dec.size() ? dec : file;
+
+                src.seek(0);
+                spu::report(src.read<svl::u8>(src.size()));
+            }
+            else
+            {
+                spdlog::error("no elf file found at {}", path.string());
+            }
+        }
+
+        if(res.count("ppu-test"))
+        {
+            vm::init();
+            auto failed = ppu::run_conformance(res.count("ppu-bench") != 0);
+            vm::deinit();
+
+            if(failed)
+                std::exit(1);
+        }
+
         if(res.count("boot"))
         {
             // TODO: boot elf games
-            svl::file f = svl::open(res["boot"].as<std::string>(), svl::mode::read);
+            fs::path path = res["boot"].as<std::string>();
+            svl::file f = svl::open(path, svl::mode::read);
+
+            auto lib = self::load(f);
+            auto exec = elf::load<elf::ppu_exec>(lib.size() ? lib : f).expect("failed to parse elf");
+
+            vm::init();
+
+            // the executable has fixed addresses so it goes in before modules take any space
+            auto image = ppu::place_exec(exec);
+            if(!image)
+            {
+                spdlog::critical("failed to load {}", path.string());
+                vm::deinit();
+                std::exit(1);
+            }
+
+            // the firmware and the titles own modules are loaded together so
+            // the executable can be linked against all of them at once
+            auto mods = ppu::load_prxs(ppu::boot_modules(path));
+            spdlog::info("loaded {} modules", mods.size());
+
+            ppu::link_exec(image.value());
 
-            //auto lib = self::load(f);
+            if(spu::get_decoder() == spu::decoder::recompiler)
+                spu::precompile(exec);
 
-            //f.seek(0);
+            // the entry point is a function descriptor of the address and toc
+            svl::u32 entry = exec.head.entry;
+            ppu::thread main(svl::endian::byte_swap(vm::read<svl::u32>(entry)));
+            main.gpr[2] = svl::endian::byte_swap(vm::read<svl::u32>(entry + 4));
 
-            //auto elf = elf::load<elf::ppu_exec>(lib.size() ? lib : f);
+            // the only ppu thread so far, its trace entries are named by its index
+            vm::trace::attach(vm::trace::thread_kind::ppu);
 
-            //vm::init();
+            if(res.count("gdb"))
+                gdb::serve({ &main }, res["gdb"].as<svl::u16>());
 
-            //ppu::load_prx(elf.value());
-            //ppu::thread(elf->head.entry);
+            shutdown_vm();
         }
 
         if(res.count("gui"))
@@ -257,4 +480,10 @@ int main(int argc, char** argv)
     setvbuf(stdout, nullptr, _IOFBF, 1024);
 #endif
     volts::cmd::parse(argc, argv);
+
+    // flush any trace that was being recorded
+    volts::vm::trace::stop();
+
+    // keep any spu blocks compiled this run
+    volts::spu::save_cache();
 }
@@ -0,0 +1,730 @@
+#include "gdb.h"
+
+#include <platform.h>
+
+#include "vm/vm.h"
+#include "vm/ppu/breakpoint.h"
+#include "vm/ppu/fpu.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <string>
+
+#if SYS_WINDOWS
+#   include <winsock2.h>
+#   include <ws2tcpip.h>
+#else
+#   include <sys/socket.h>
+#   include <sys/select.h>
+#   include <netinet/in.h>
+#   include <netinet/tcp.h>
+#   include <arpa/inet.h>
+#   include <unistd.h>
+#endif
+
+namespace volts::gdb
+{
+    using namespace svl;
+
+#if SYS_WINDOWS
+    using socket_t = SOCKET;
+    constexpr socket_t invalid_socket = INVALID_SOCKET;
+
+    static void close_socket(socket_t sock) { closesocket(sock); }
+#else
+    using socket_t = int;
+    constexpr socket_t invalid_socket = -1;
+
+    static void close_socket(socket_t sock) { close(sock); }
+#endif
+
+    /// how many instructions each thread runs before the next one gets a turn
+    constexpr u32 quantum = 0x1000;
+
+    /// how many rounds of every thread running run between checking for an interrupt
+    constexpr u32 poll_rounds = 16;
+
+    /// signals reported in stop replies
+    constexpr u32 sigint = 2;
+    constexpr u32 sigtrap = 5;
+
+    /// the guest address space is 32 bits wide
+    constexpr u64 memory_size = 0x100000000;
+
+    /// the largest packet gdb is told it can send or receive, the PacketSize in qSupported
+    constexpr u64 packet_size = 0x1000;
+
+    /// tells gdb which architecture to use without the user setting it
+    constexpr const char* target_xml =
+        "<?xml version=\"1.0\"?>"
+        "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+        "<target><architecture>powerpc:common64</architecture></target>";
+
+    /**
+     * @brief register numbers of powerpc:common64 without altivec
+     *
+     */
+    enum class reg : u32
+    {
+        gpr = 0,
+        fpr = 32,
+        pc = 64,
+        msr = 65,
+        cr = 66,
+        lr = 67,
+        ctr = 68,
+        xer = 69,
+        fpscr = 70,
+        count = 71,
+    };
+
+    struct connection
+    {
+        socket_t sock;
+
+        const std::vector<ppu::thread*>& threads;
+
+        /// thread used for register and memory packets
+        u32 current = 0;
+
+        /// is the client still expecting acknowledgements
+        bool ack = true;
+
+        /// buffered input from the socket
+        char buffer[0x1000];
+        u32 len = 0;
+        u32 pos = 0;
+    };
+
+    static bool read_byte(connection& conn, char& out)
+    {
+        if(conn.pos == conn.len)
+        {
+            int got = recv(conn.sock, conn.buffer, sizeof(conn.buffer), 0);
+
+            if(got <= 0)
+                return false;
+
+            conn.len = got;
+            conn.pos = 0;
+        }
+
+        out = conn.buffer[conn.pos++];
+        return true;
+    }
+
+    // check if the client sent an interrupt without blocking
+    static bool interrupted(connection& conn)
+    {
+        if(conn.pos == conn.len)
+        {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(conn.sock, &set);
+
+            timeval timeout = {};
+
+            if(select(static_cast<int>(conn.sock) + 1, &set, nullptr, nullptr, &timeout) <= 0)
+                return false;
+        }
+
+        char c;
+        return read_byte(conn, c) && c == '\x03';
+    }
+
+    static u32 hex_digit(char c)
+    {
+        if(c >= '0' && c <= '9')
+            return c - '0';
+        if(c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+
+        return 0;
+    }
+
+    // parse hex digits starting at pos, pos is left on the first non hex character
+    static u64 parse_hex(const std::string& str, std::size_t& pos)
+    {
+        u64 val = 0;
+
+        while(pos < str.size() && std::isxdigit(static_cast<unsigned char>(str[pos])))
+            val = val << 4 | hex_digit(str[pos++]);
+
+        return val;
+    }
+
+    static u64 parse_hex(const std::string& str)
+    {
+        std::size_t pos = 0;
+        return parse_hex(str, pos);
+    }
+
+    // append a value as big endian hex
+    static void append_hex(std::string& out, u64 val, u32 bytes)
+    {
+        constexpr const char* digits = "0123456789abcdef";
+
+        for(u32 i = bytes * 2; i > 0; i--)
+            out += digits[(val >> ((i - 1) * 4)) & 0xF];
+    }
+
+    // read a big endian hex value of a fixed width
+    static u64 read_hex(const std::string& str, std::size_t& pos, u32 bytes)
+    {
+        u64 val = 0;
+
+        for(u32 i = 0; i < bytes * 2 && pos < str.size(); i++)
+            val = val << 4 | hex_digit(str[pos++]);
+
+        return val;
+    }
+
+    static bool send_packet(connection& conn, const std::string& data)
+    {
+        u8 sum = 0;
+
+        for(char c : data)
+            sum += static_cast<u8>(c);
+
+        std::string packet = "$" + data + "#";
+        append_hex(packet, sum, 1);
+
+        for(;;)
+        {
+            if(send(conn.sock, packet.data(), static_cast<int>(packet.size()), 0) != static_cast<int>(packet.size()))
+                return false;
+
+            if(!conn.ack)
+                return true;
+
+            char reply;
+            if(!read_byte(conn, reply))
+                return false;
+
+            // anything other than a nack means it arrived
+            if(reply != '-')
+                return true;
+        }
+    }
+
+    static bool read_packet(connection& conn, std::string& out)
+    {
+        for(;;)
+        {
+            char c;
+
+            // skip acks and interrupts sent while the threads were already halted
+            do
+            {
+                if(!read_byte(conn, c))
+                    return false;
+            }
+            while(c != '$');
+
+            out.clear();
+            u8 sum = 0;
+
+            for(;;)
+            {
+                if(!read_byte(conn, c))
+                    return false;
+
+                if(c == '#')
+                    break;
+
+                out += c;
+                sum += static_cast<u8>(c);
+            }
+
+            char check[2];
+            if(!read_byte(conn, check[0]) || !read_byte(conn, check[1]))
+                return false;
+
+            if(!conn.ack)
+                return true;
+
+            bool valid = (hex_digit(check[0]) << 4 | hex_digit(check[1])) == sum;
+            send(conn.sock, valid ? "+" : "-", 1, 0);
+
+            if(valid)
+                return true;
+        }
+    }
+
+    // condition register bits are stored a byte per bit
+    static u32 pack_cr(const ppu::control& cr)
+    {
+        u32 val = 0;
+
+        for(u32 i = 0; i < 32; i++)
+            val |= (cr.bytes[i] & 1) << (31 - i);
+
+        return val;
+    }
+
+    static void unpack_cr(ppu::control& cr, u32 val)
+    {
+        for(u32 i = 0; i < 32; i++)
+            cr.bytes[i] = (val >> (31 - i)) & 1;
+    }
+
+    // get the value and width of a register
+    static bool get_reg(ppu::thread& ppu, u32 num, u64& val, u32& bytes)
+    {
+        bytes = 8;
+
+        if(num < (u32)reg::fpr)
+        {
+            val = ppu.gpr[num];
+            return true;
+        }
+
+        if(num < (u32)reg::pc)
+        {
+            std::memcpy(&val, &ppu.fpr[num - (u32)reg::fpr], sizeof(u64));
+            return true;
+        }
+
+        switch((reg)num)
+        {
+        case reg::pc: val = ppu.cia; return true;
+        case reg::msr: val = 0; return true;
+        case reg::cr: val = pack_cr(ppu.cr); bytes = 4; return true;
+        case reg::lr: val = ppu.link; return true;
+        case reg::ctr: val = ppu.count; return true;
+        case reg::xer: val = ppu.xer; bytes = 4; return true;
+        case reg::fpscr: val = ppu.fpscr; bytes = 4; return true;
+        default: return false;
+        }
+    }
+
+    static bool set_reg(ppu::thread& ppu, u32 num, u64 val)
+    {
+        if(num < (u32)reg::fpr)
+        {
+            ppu.gpr[num] = val;
+            return true;
+        }
+
+        if(num < (u32)reg::pc)
+        {
+            std::memcpy(&ppu.fpr[num - (u32)reg::fpr], &val, sizeof(u64));
+            return true;
+        }
+
+        switch((reg)num)
+        {
+        case reg::pc: ppu.cia = static_cast<u32>(val); return true;
+        case reg::msr: return true;
+        case reg::cr: unpack_cr(ppu.cr, static_cast<u32>(val)); return true;
+        case reg::lr: ppu.link = val; return true;
+        case reg::ctr: ppu.count = val; return true;
+        case reg::xer: ppu.xer = val; return true;
+        case reg::fpscr: ppu.fpscr = static_cast<u32>(val); return true;
+        default: return false;
+        }
+    }
+
+    static std::string stop_reply(u32 signal, u32 thread)
+    {
+        std::string out = "T";
+        append_hex(out, signal, 1);
+        out += "thread:";
+        append_hex(out, thread + 1, 4);
+        out += ';';
+        return out;
+    }
+
+    // run every thread in turn until one hits a breakpoint or the client interrupts
+    static std::string resume(connection& conn)
+    {
+        // threads sitting on a breakpoint need to run the real instruction first
+        for(auto* ppu : conn.threads)
+        {
+            ppu->halted = false;
+            ppu::step_breakpoint(*ppu);
+        }
+
+        for(u32 round = 1;; round++)
+        {
+            for(u32 i = 0; i < conn.threads.size(); i++)
+            {
+                auto* ppu = conn.threads[i];
+
+                for(u32 n = 0; n < quantum && !ppu->halted; n++)
+                    ppu->step();
+
+                if(ppu->halted)
+                {
+                    conn.current = i;
+                    return stop_reply(sigtrap, i);
+                }
+            }
+
+            if(round % poll_rounds == 0 && interrupted(conn))
+                return stop_reply(sigint, conn.current);
+        }
+    }
+
+    static std::string read_memory(const std::string& args)
+    {
+        std::size_t pos = 0;
+        u64 addr = parse_hex(args, pos);
+        pos++;
+        u64 len = parse_hex(args, pos);
+
+        // each byte is two hex characters, gdb asks again for whatever is left
+        len = std::min(len, packet_size / 2);
+
+        if(addr + len > memory_size || !vm::allocated(addr, len))
+            return "E01";
+
+        std::vector<u8> data(len);
+        std::memcpy(data.data(), vm::base(addr), len);
+        ppu::hide_breakpoints(addr, data.data(), len);
+
+        std::string out;
+        for(u8 byte : data)
+            append_hex(out, byte, 1);
+
+        return out;
+    }
+
+    static std::string write_memory(const std::string& args)
+    {
+        std::size_t pos = 0;
+        u64 addr = parse_hex(args, pos);
+        pos++;
+        u64 len = parse_hex(args, pos);
+        pos++;
+
+        if(addr + len > memory_size || args.size() - pos < len * 2 || !vm::allocated(addr, len))
+            return "E01";
+
+        ppu::lift_breakpoints(addr, len);
+
+        auto* dst = static_cast<u8*>(vm::base(addr));
+        for(u64 i = 0; i < len; i++)
+            dst[i] = static_cast<u8>(read_hex(args, pos, 1));
+
+        ppu::restore_breakpoints(addr, len);
+
+        return "OK";
+    }
+
+    static std::string read_registers(ppu::thread& ppu)
+    {
+        std::string out;
+
+        for(u32 i = 0; i < (u32)reg::count; i++)
+        {
+            u64 val;
+            u32 bytes;
+            get_reg(ppu, i, val, bytes);
+            append_hex(out, val, bytes);
+        }
+
+        return out;
+    }
+
+    static std::string write_registers(ppu::thread& ppu, const std::string& args)
+    {
+        std::size_t pos = 0;
+
+        for(u32 i = 0; i < (u32)reg::count && pos < args.size(); i++)
+        {
+            u64 val;
+            u32 bytes;
+            get_reg(ppu, i, val, bytes);
+            set_reg(ppu, i, read_hex(args, pos, bytes));
+        }
+
+        return "OK";
+    }
+
+    // Z and z packets, software and hardware breakpoints are both patched in
+    static std::string breakpoint(const std::string& args, bool insert)
+    {
+        if(args.size() < 3 || (args[0] != '0' && args[0] != '1'))
+            return "";
+
+        std::size_t pos = 2;
+        u64 addr = parse_hex(args, pos);
+
+        bool ok = insert ? ppu::add_breakpoint(addr) : ppu::remove_breakpoint(addr);
+        return ok ? "OK" : "E01";
+    }
+
+    static std::string query(connection& conn, const std::string& packet)
+    {
+        if(packet.rfind("qSupported", 0) == 0)
+            return "PacketSize=1000;qXfer:features:read+;QStartNoAckMode+";
+
+        if(packet == "QStartNoAckMode")
+        {
+            send_packet(conn, "OK");
+            conn.ack = false;
+            return {};
+        }
+
+        if(packet == "qAttached")
+            return "1";
+
+        if(packet == "qC")
+        {
+            std::string out = "QC";
+            append_hex(out, conn.current + 1, 4);
+            return out;
+        }
+
+        if(packet == "qfThreadInfo")
+        {
+            std::string out = "m";
+
+            for(u32 i = 0; i < conn.threads.size(); i++)
+            {
+                if(i)
+                    out += ',';
+
+                append_hex(out, i + 1, 4);
+            }
+
+            return out;
+        }
+
+        if(packet == "qsThreadInfo")
+            return "l";
+
+        // qXfer:features:read:target.xml:offset,length
+        if(packet.rfind("qXfer:features:read:target.xml:", 0) == 0)
+        {
+            std::size_t pos = std::strlen("qXfer:features:read:target.xml:");
+            u64 offset = parse_hex(packet, pos);
+            pos++;
+            u64 len = parse_hex(packet, pos);
+
+            std::string xml = target_xml;
+
+            if(offset >= xml.size())
+                return "l";
+
+            auto part = xml.substr(offset, len);
+            return (offset + part.size() < xml.size() ? "m" : "l") + part;
+        }
+
+        return "";
+    }
+
+    // handle a packet, returns false when the session is over
+    static bool handle(connection& conn, const std::string& packet)
+    {
+        auto& ppu = *conn.threads[conn.current];
+        std::string args = packet.size() > 1 ? packet.substr(1) : "";
+
+        std::string reply;
+
+        switch(packet.empty() ? 0 : packet[0])
+        {
+        case '?':
+            reply = stop_reply(sigtrap, conn.current);
+            break;
+        case 'g':
+            reply = read_registers(ppu);
+            break;
+        case 'G':
+            reply = write_registers(ppu, args);
+            break;
+        case 'p':
+        {
+            u64 val;
+            u32 bytes;
+
+            if(get_reg(ppu, static_cast<u32>(parse_hex(args)), val, bytes))
+                append_hex(reply, val, bytes);
+            else
+                reply = "E01";
+
+            break;
+        }
+        case 'P':
+        {
+            std::size_t pos = 0;
+            u32 num = static_cast<u32>(parse_hex(args, pos));
+            pos++;
+
+            u64 val;
+            u32 bytes;
+            get_reg(ppu, num, val, bytes);
+
+            reply = set_reg(ppu, num, read_hex(args, pos, bytes)) ? "OK" : "E01";
+            break;
+        }
+        case 'm':
+            reply = read_memory(args);
+            break;
+        case 'M':
+            reply = write_memory(args);
+            break;
+        case 'H':
+        {
+            // thread 0 means any thread and -1 means every thread, both keep the current one
+            if(args.size() > 1 && args[1] != '-')
+            {
+                u64 id = parse_hex(args.substr(1));
+
+                if(id > conn.threads.size())
+                {
+                    reply = "E01";
+                    break;
+                }
+
+                if(id)
+                    conn.current = static_cast<u32>(id - 1);
+            }
+
+            reply = "OK";
+            break;
+        }
+        case 'T':
+        {
+            u64 id = parse_hex(args);
+            reply = id && id <= conn.threads.size() ? "OK" : "E01";
+            break;
+        }
+        case 's':
+            if(!args.empty())
+                ppu.cia = static_cast<u32>(parse_hex(args));
+
+            ppu.halted = false;
+            ppu::step_breakpoint(ppu);
+            reply = stop_reply(sigtrap, conn.current);
+            break;
+        case 'c':
+            if(!args.empty())
+                ppu.cia = static_cast<u32>(parse_hex(args));
+
+            reply = resume(conn);
+            break;
+        case 'Z':
+            reply = breakpoint(args, true);
+            break;
+        case 'z':
+            reply = breakpoint(args, false);
+            break;
+        case 'q':
+        case 'Q':
+            reply = query(conn, packet);
+
+            // the reply was already sent before acks were turned off
+            if(packet == "QStartNoAckMode")
+                return true;
+
+            break;
+        case 'D':
+            send_packet(conn, "OK");
+            return false;
+        case 'k':
+            return false;
+        default:
+            // an empty reply tells gdb the packet isnt supported
+            break;
+        }
+
+        return send_packet(conn, reply);
+    }
+
+    bool serve(const std::vector<ppu::thread*>& threads, u16 port)
+    {
+        if(threads.empty())
+        {
+            spdlog::error("no threads to debug");
+            return false;
+        }
+
+#if SYS_WINDOWS
+        WSADATA wsa;
+        if(WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        {
+            spdlog::error("failed to start winsock");
+            return false;
+        }
+#endif
+
+        socket_t server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+        if(server == invalid_socket)
+        {
+            spdlog::error("failed to create debugger socket");
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 1) != 0)
+        {
+            spdlog::error("failed to listen for a debugger on port {}", port);
+            close_socket(server);
+            return false;
+        }
+
+        spdlog::info("waiting for a debugger on localhost:{}", port);
+
+        socket_t client = accept(server, nullptr, nullptr);
+        close_socket(server);
+
+        if(client == invalid_socket)
+        {
+            spdlog::error("failed to accept debugger connection");
+            return false;
+        }
+
+        // packets are tiny and latency matters more than throughput
+        int nodelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+
+        spdlog::info("debugger connected");
+
+        // guest code runs on this thread from here on so it needs the same host fpu state as ppu::thread::run
+        ppu::apply_host_fpu();
+
+        for(auto* ppu : threads)
+            ppu->halted = true;
+
+        connection conn = { client, threads };
+
+        std::string packet;
+        bool clean = false;
+
+        while(read_packet(conn, packet))
+        {
+            if(!handle(conn, packet))
+            {
+                clean = true;
+                break;
+            }
+        }
+
+        // leave guest memory as it was found
+        ppu::clear_breakpoints();
+
+        for(auto* ppu : threads)
+            ppu->halted = false;
+
+        close_socket(client);
+
+        spdlog::info("debugger disconnected");
+
+        return clean;
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <types.h>
+
+#include "vm/ppu/thread.h"
+
+#include <vector>
+
+namespace volts::gdb
+{
+    /// the default port the stub listens on
+    constexpr svl::u16 default_port = 2345;
+
+    /**
+     * @brief serve the gdb remote serial protocol on a local tcp port
+     *
+     * blocks until a debugger connects then lets it control the threads
+     * until it detaches or kills the session. the threads start halted.
+     * breakpoints are patched into guest memory so code without any
+     * breakpoints runs at full interpreter speed.
+     *
+     * connect with
+     * `gdb -ex "set architecture powerpc:common64" -ex "target remote localhost:<port>"`
+     *
+     * @param threads the ppu threads to debug
+     * @param port the port to listen on, only accepts connections from localhost
+     * @return true if a debugger connected and the session ended cleanly
+     */
+    bool serve(const std::vector<ppu::thread*>& threads, svl::u16 port = default_port);
+}
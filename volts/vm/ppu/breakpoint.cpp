@@ -0,0 +1,107 @@
+#include "breakpoint.h"
+#include "decode.h"
+
+#include <endian.h>
+
+#include <spdlog/spdlog.h>
+
+#include <map>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    // original instructions keyed by address, in host byte order.
+    // only the debugger touches this while the guest is halted
+    static std::map<u32, u32> breakpoints;
+
+    bool add_breakpoint(vm::addr addr)
+    {
+        if(addr & 3 || addr > 0xFFFFFFFC)
+            return false;
+
+        if(breakpoints.count(addr))
+            return true;
+
+        breakpoints[addr] = endian::byte_swap(vm::read<u32>(addr));
+        vm::write<u32>(addr, endian::byte_swap(breakpoint_opcode));
+
+        return true;
+    }
+
+    bool remove_breakpoint(vm::addr addr)
+    {
+        auto it = breakpoints.find(addr);
+
+        if(it == breakpoints.end())
+            return false;
+
+        vm::write<u32>(addr, endian::byte_swap(it->second));
+        breakpoints.erase(it);
+
+        return true;
+    }
+
+    void clear_breakpoints()
+    {
+        for(auto [addr, op] : breakpoints)
+            vm::write<u32>(addr, endian::byte_swap(op));
+
+        breakpoints.clear();
+    }
+
+    void hit_breakpoint(thread& ppu)
+    {
+        if(!breakpoints.count(ppu.cia))
+        {
+            spdlog::critical("invalid op {}", breakpoint_opcode);
+            return;
+        }
+
+        // the caller moves past the instruction, stay on the breakpoint so it can be resumed
+        ppu.cia -= 4;
+        ppu.halted = true;
+    }
+
+    void step_breakpoint(thread& ppu)
+    {
+        auto it = breakpoints.find(ppu.cia);
+
+        if(it == breakpoints.end())
+            return ppu.step();
+
+        u32 op = it->second;
+        ops[decode(op)](ppu, {op});
+        ppu.cia += 4;
+    }
+
+    void hide_breakpoints(vm::addr addr, u8* data, u64 len)
+    {
+        for(auto it = breakpoints.lower_bound(addr > 3 ? addr - 3 : 0); it != breakpoints.end() && it->first < addr + len; it++)
+        {
+            u32 op = endian::byte_swap(it->second);
+            auto bytes = reinterpret_cast<u8*>(&op);
+
+            for(u32 i = 0; i < 4; i++)
+            {
+                if(it->first + i >= addr && it->first + i < addr + len)
+                    data[it->first + i - addr] = bytes[i];
+            }
+        }
+    }
+
+    void lift_breakpoints(vm::addr addr, u64 len)
+    {
+        for(auto it = breakpoints.lower_bound(addr > 3 ? addr - 3 : 0); it != breakpoints.end() && it->first < addr + len; it++)
+            vm::write<u32>(it->first, endian::byte_swap(it->second));
+    }
+
+    void restore_breakpoints(vm::addr addr, u64 len)
+    {
+        for(auto it = breakpoints.lower_bound(addr > 3 ? addr - 3 : 0); it != breakpoints.end() && it->first < addr + len; it++)
+        {
+            it->second = endian::byte_swap(vm::read<u32>(it->first));
+            vm::write<u32>(it->first, endian::byte_swap(breakpoint_opcode));
+        }
+    }
+}
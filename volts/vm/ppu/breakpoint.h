@@ -0,0 +1,81 @@
+#pragma once
+
+#include <types.h>
+
+#include "thread.h"
+#include "vm.h"
+
+namespace volts::ppu
+{
+    /// instruction patched over breakpoints, primary opcode 0 is illegal on the cell
+    constexpr svl::u32 breakpoint_opcode = 0;
+
+    /**
+     * @brief set a breakpoint
+     *
+     * the instruction is replaced in guest memory so only the
+     * breakpoint itself costs anything when executed
+     *
+     * @param addr the address of the instruction
+     * @return true if the breakpoint was set
+     */
+    bool add_breakpoint(vm::addr addr);
+
+    /**
+     * @brief remove a breakpoint and restore the original instruction
+     *
+     * @param addr the address of the instruction
+     * @return true if there was a breakpoint at the address
+     */
+    bool remove_breakpoint(vm::addr addr);
+
+    /**
+     * @brief remove every breakpoint
+     */
+    void clear_breakpoints();
+
+    /**
+     * @brief called when a thread executes a breakpoint
+     *
+     * halts the thread with cia left on the breakpoint
+     *
+     * @param ppu the thread
+     */
+    void hit_breakpoint(thread& ppu);
+
+    /**
+     * @brief execute the instruction at cia, running the original instruction if it is a breakpoint
+     *
+     * @param ppu the thread to step
+     */
+    void step_breakpoint(thread& ppu);
+
+    /**
+     * @brief replace breakpoints in a copy of guest memory with the original instructions
+     *
+     * @param addr the address the data was copied from
+     * @param data the copied data
+     * @param len the length of the data
+     */
+    void hide_breakpoints(vm::addr addr, svl::u8* data, svl::u64 len);
+
+    /**
+     * @brief put the original instructions back before guest memory is written
+     *
+     * the breakpoints stay set, restore_breakpoints must be called after the write
+     *
+     * @param addr the start of the memory about to be written
+     * @param len the length of the memory about to be written
+     */
+    void lift_breakpoints(vm::addr addr, svl::u64 len);
+
+    /**
+     * @brief reapply breakpoints after guest memory was written
+     *
+     * anything written over a breakpoint becomes the new original instruction
+     *
+     * @param addr the start of the written memory
+     * @param len the length of the written memory
+     */
+    void restore_breakpoints(vm::addr addr, svl::u64 len);
+}
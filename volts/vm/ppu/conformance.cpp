@@ -0,0 +1,305 @@
+#include "conformance.h"
+
+#include "thread.h"
+#include "decode.h"
+#include "disasm.h"
+#include "vm.h"
+#include "sys/syscall.h"
+
+#include <endian.h>
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    /// size of the guest memory test data lives in
+    constexpr u32 data_size = 0x10000;
+
+    /// how many times each case is run when timing
+    constexpr u32 timing_iterations = 100000;
+
+    struct reg_value
+    {
+        u32 reg;
+        u64 val;
+    };
+
+    struct float_value
+    {
+        u32 reg;
+        f64 val;
+    };
+
+    struct vector_value
+    {
+        u32 reg;
+        u64 lo;
+        u64 hi;
+    };
+
+    struct mem_value
+    {
+        u32 addr;
+
+        /// width in bytes, 1, 2, 4 or 8
+        u32 size;
+
+        /// value as the guest sees it, stored big endian
+        u64 val;
+    };
+
+    struct conformance_case
+    {
+        /// the instruction to run
+        u32 op;
+
+        std::vector<reg_value> gpr_in;
+        std::vector<reg_value> gpr_out;
+
+        std::vector<float_value> fpr_in;
+        std::vector<float_value> fpr_out;
+
+        std::vector<vector_value> vr_in;
+        std::vector<vector_value> vr_out;
+
+        std::vector<mem_value> mem_in;
+        std::vector<mem_value> mem_out;
+
+        /// how many times the instruction should trap
+        u32 traps = 0;
+    };
+
+    // fill every 16 bit lane of a vector
+    constexpr u64 lanes(u16 val)
+    {
+        return (u64)val * 0x0001000100010001ULL;
+    }
+
+    // memory cases address the test data through data_addr, it is wherever the data was allocated
+    static std::vector<conformance_case> make_cases(u32 data_addr)
+    {
+        return {
+            // ori r3, r4, 0x10
+            { 0x60830010, { { 4, 0x100 } }, { { 3, 0x110 } } },
+            // oris r3, r4, 0x1234
+            { 0x64831234, { { 4, 1 } }, { { 3, 0x12340001 } } },
+            // xori r3, r4, 0xFFFF
+            { 0x6883FFFF, { { 4, 0x0F0F } }, { { 3, 0xF0F0 } } },
+            // xoris r3, r4, 0x8000
+            { 0x6C838000, { { 4, 0 } }, { { 3, 0x80000000 } } },
+            // andi. r3, r4, 0xFF
+            { 0x708300FF, { { 4, 0x1234 } }, { { 3, 0x34 } } },
+
+            // tdi 4, r3, 5 does not trap when r3 != 5
+            { 0x08830005, { { 3, 4 } }, { { 3, 4 } } },
+            // twi 16, r3, -1 does not trap when r3 >= -1
+            { 0x0E03FFFF, { { 3, 0 } }, { { 3, 0 } } },
+            // tdi 4, r3, 5 traps when r3 == 5
+            { 0x08830005, { { 3, 5 } }, { { 3, 5 } }, {}, {}, {}, {}, {}, {}, 1 },
+            // twi 16, r3, -1 traps when r3 < -1, only the low word is compared
+            { 0x0E03FFFF, { { 3, 0x1FFFFFFFE } }, { { 3, 0x1FFFFFFFE } }, {}, {}, {}, {}, {}, {}, 1 },
+
+            // sc with r11 = sys_process_getpid
+            { 0x44000002, { { 11, 1 } }, { { 3, 1 } } },
+
+            // lbz r3, -16(r1)
+            { 0x8861FFF0, { { 1, data_addr + 0x10 } }, { { 3, 0xAB } }, {}, {}, {}, {}, { { data_addr, 1, 0xAB } } },
+            // lbzu r3, 1(r4)
+            { 0x8C640001, { { 4, data_addr - 1 } }, { { 3, 0xAB }, { 4, data_addr } }, {}, {}, {}, {}, { { data_addr, 1, 0xAB } } },
+            // lbzx r3, r4, r5
+            { 0x7C6428AE, { { 4, data_addr }, { 5, 1 } }, { { 3, 0xCD } }, {}, {}, {}, {}, { { data_addr + 1, 1, 0xCD } } },
+            // lbzux r3, r4, r5
+            { 0x7C6428EE, { { 4, data_addr }, { 5, 1 } }, { { 3, 0xCD }, { 4, data_addr + 1 } }, {}, {}, {}, {}, { { data_addr + 1, 1, 0xCD } } },
+            // lhzu r3, 2(r4)
+            { 0xA4640002, { { 4, data_addr } }, { { 3, 0x8001 }, { 4, data_addr + 2 } }, {}, {}, {}, {}, { { data_addr + 2, 2, 0x8001 } } },
+            // lhau r3, 2(r4)
+            { 0xAC640002, { { 4, data_addr } }, { { 3, 0xFFFFFFFFFFFF8001 }, { 4, data_addr + 2 } }, {}, {}, {}, {}, { { data_addr + 2, 2, 0x8001 } } },
+            // lwzu r3, 4(r4)
+            { 0x84640004, { { 4, data_addr } }, { { 3, 0xDEADBEEF }, { 4, data_addr + 4 } }, {}, {}, {}, {}, { { data_addr + 4, 4, 0xDEADBEEF } } },
+
+            // stw r3, 8(r4)
+            { 0x90640008, { { 3, 0x11223344 }, { 4, data_addr } }, { { 4, data_addr } }, {}, {}, {}, {}, {}, { { data_addr + 8, 4, 0x11223344 } } },
+            // std r3, 16(r4)
+            { 0xF8640010, { { 3, 0x0102030405060708 }, { 4, data_addr } }, { { 4, data_addr } }, {}, {}, {}, {}, {}, { { data_addr + 16, 8, 0x0102030405060708 } } },
+            // stdu r1, -8(r1)
+            { 0xF821FFF9, { { 1, data_addr + 0x20 } }, { { 1, data_addr + 0x18 } }, {}, {}, {}, {}, {}, { { data_addr + 0x18, 8, data_addr + 0x20 } } },
+
+            // lfs f1, 4(r3)
+            { 0xC0230004, { { 3, data_addr } }, {}, {}, { { 1, 1.5 } }, {}, {}, { { data_addr + 4, 4, 0x3FC00000 } } },
+            // stfs f1, 0(r3)
+            { 0xD0230000, { { 3, data_addr } }, {}, { { 1, -2.0 } }, {}, {}, {}, {}, { { data_addr, 4, 0xC0000000 } } },
+
+            // fadd f1, f2, f3
+            { 0xFC22182A, {}, {}, { { 2, 1.5 }, { 3, 2.25 } }, { { 1, 3.75 } } },
+            // fmul f1, f2, f4
+            { 0xFC220132, {}, {}, { { 2, 3.0 }, { 4, -2.0 } }, { { 1, -6.0 } } },
+            // fdivs f1, f2, f3
+            { 0xEC221824, {}, {}, { { 2, 1.0 }, { 3, 4.0 } }, { { 1, 0.25 } } },
+
+            // vmhaddshs v0, v1, v2, v3
+            { 0x100110E0, {}, {}, {}, {},
+                { { 1, lanes(0x4000), lanes(0x4000) }, { 2, lanes(0x4000), lanes(0x4000) }, { 3, lanes(1), lanes(1) } },
+                { { 0, lanes(0x2001), lanes(0x2001) } } },
+            // vmhaddshs saturates -1 * -1
+            { 0x100110E0, {}, {}, {}, {},
+                { { 1, lanes(0x8000), lanes(0x8000) }, { 2, lanes(0x8000), lanes(0x8000) }, { 3, 0, 0 } },
+                { { 0, lanes(0x7FFF), lanes(0x7FFF) } } },
+        };
+    }
+
+    static u64 read_mem(const mem_value& mem)
+    {
+        switch(mem.size)
+        {
+        case 1: return vm::read<u8>(mem.addr);
+        case 2: return endian::byte_swap(vm::read<u16>(mem.addr));
+        case 4: return endian::byte_swap(vm::read<u32>(mem.addr));
+        default: return endian::byte_swap(vm::read<u64>(mem.addr));
+        }
+    }
+
+    static void write_mem(const mem_value& mem)
+    {
+        switch(mem.size)
+        {
+        case 1: vm::write<u8>(mem.addr, static_cast<u8>(mem.val)); break;
+        case 2: vm::write<u16>(mem.addr, endian::byte_swap(static_cast<u16>(mem.val))); break;
+        case 4: vm::write<u32>(mem.addr, endian::byte_swap(static_cast<u32>(mem.val))); break;
+        default: vm::write<u64>(mem.addr, endian::byte_swap(mem.val)); break;
+        }
+    }
+
+    static void setup(thread& ppu, const conformance_case& test)
+    {
+        for(const auto& in : test.gpr_in)
+            ppu.gpr[in.reg] = in.val;
+
+        for(const auto& in : test.fpr_in)
+            ppu.fpr[in.reg] = in.val;
+
+        for(const auto& in : test.vr_in)
+        {
+            ppu.vr[in.reg].lo = in.lo;
+            ppu.vr[in.reg].hi = in.hi;
+        }
+    }
+
+    static bool check(thread& ppu, const conformance_case& test, const std::string& name)
+    {
+        bool pass = true;
+
+        for(const auto& out : test.gpr_out)
+        {
+            if(ppu.gpr[out.reg] != out.val)
+            {
+                spdlog::error("{}: r{} = {:x}, expected {:x}", name, out.reg, ppu.gpr[out.reg], out.val);
+                pass = false;
+            }
+        }
+
+        for(const auto& out : test.fpr_out)
+        {
+            if(std::memcmp(&ppu.fpr[out.reg], &out.val, sizeof(f64)) != 0)
+            {
+                spdlog::error("{}: f{} = {}, expected {}", name, out.reg, ppu.fpr[out.reg], out.val);
+                pass = false;
+            }
+        }
+
+        for(const auto& out : test.vr_out)
+        {
+            if(ppu.vr[out.reg].lo != out.lo || ppu.vr[out.reg].hi != out.hi)
+            {
+                spdlog::error("{}: v{} = {:016x}{:016x}, expected {:016x}{:016x}", name, out.reg, ppu.vr[out.reg].hi, ppu.vr[out.reg].lo, out.hi, out.lo);
+                pass = false;
+            }
+        }
+
+        for(const auto& out : test.mem_out)
+        {
+            if(u64 val = read_mem(out); val != out.val)
+            {
+                spdlog::error("{}: [{:x}] = {:x}, expected {:x}", name, out.addr, val, out.val);
+                pass = false;
+            }
+        }
+
+        if(ppu.traps != test.traps)
+        {
+            spdlog::error("{}: trapped {} times, expected {}", name, ppu.traps, test.traps);
+            pass = false;
+        }
+
+        return pass;
+    }
+
+    u32 run_conformance(bool timing)
+    {
+        using clock = std::chrono::steady_clock;
+
+        init_table();
+        vm::init_syscalls();
+
+        vm::addr data_addr = vm::user64k->alloc(data_size);
+        if(!data_addr)
+        {
+            spdlog::error("failed to allocate conformance test data");
+            return 1;
+        }
+
+        auto cases = make_cases(static_cast<u32>(data_addr));
+
+        u32 failed = 0;
+
+        for(const auto& test : cases)
+        {
+            std::string name;
+            disasm(test.op, name);
+
+            thread ppu(0);
+            form op = { test.op };
+            auto func = ops[decode(test.op)];
+
+            for(const auto& mem : test.mem_in)
+                write_mem(mem);
+
+            setup(ppu, test);
+            func(ppu, op);
+
+            bool pass = check(ppu, test, name);
+            failed += !pass;
+
+            // every trap is logged so timing them would only time the log
+            if(!timing || test.traps)
+            {
+                spdlog::info("{} {}", pass ? "pass" : "FAIL", name);
+                continue;
+            }
+
+            // inputs are reset every iteration so updating forms dont walk off,
+            // the cost of that is included in the result
+            auto start = clock::now();
+
+            for(u32 i = 0; i < timing_iterations; i++)
+            {
+                setup(ppu, test);
+                func(ppu, op);
+            }
+
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+            spdlog::info("{} {:<32} {:.2f}ns/op", pass ? "pass" : "FAIL", name, (f64)ns / timing_iterations);
+        }
+
+        spdlog::info("{}/{} cases passed", cases.size() - failed, cases.size());
+
+        vm::user64k->dealloc(data_addr);
+
+        return failed;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::ppu
+{
+    /**
+     * @brief run every instruction against known inputs and outputs
+     *
+     * needs vm::init to have been called, test data is placed at the
+     * start of the user64k block
+     *
+     * @param timing also measure how long each instruction takes
+     * @return svl::u32 the amount of failed cases
+     */
+    svl::u32 run_conformance(bool timing);
+}
@@ -0,0 +1,153 @@
+#include "decode.h"
+
+#include "ops.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    func_t ops[0x20000];
+
+    opinfo infos[0x20000];
+
+    struct instruction
+    {
+        u32 val;
+        func_t func;
+        const char* name;
+        operands layout;
+        u32 magn = 0;
+    };
+
+    static void set(u32 idx, const instruction& e)
+    {
+        ops[idx] = e.func;
+        infos[idx] = { e.name, e.layout };
+    }
+
+    // this is just stolen from rpcs3
+    // at the point i find a better way of doing this ill use that instead
+    static void fill(u32 op, u32 num, u32 sh, std::initializer_list<instruction> instr)
+    {
+        if(sh < 11)
+        {
+            for(const auto& e : instr)
+            {
+                for(u32 i = 0; i < 1u << (e.magn + (11 - sh - num)); i++)
+                {
+                    for(u32 j = 0; j < 1u << sh; j++)
+                    {
+                        set((((((i << (num - e.magn)) | e.val) << sh) | j) << 6) | op, e);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for(const auto& e : instr)
+            {
+                for(u32 i = 0; i < 1u << 11; i++)
+                {
+                    set(i << 6 | e.val, e);
+                }
+            }
+        }
+    }
+
+    void init_table()
+    {
+        static bool table_flag = true;
+
+        if(!table_flag)
+            return;
+
+        table_flag = false;
+
+        // fill the table with stub ops to detect invalid opcodes
+        std::fill(std::begin(ops), std::end(ops), [](thread& t, form op) {
+            spdlog::critical("invalid op {}", op.raw);
+        });
+
+        std::fill(std::begin(infos), std::end(infos), opinfo{ "invalid", operands::invalid });
+
+        fill(0, 6, -1, {
+            { breakpoint_opcode, breakpoint, "breakpoint", operands::none },
+            { native_opcode, native, "native", operands::native },
+
+            { 0x02, tdi, "tdi", operands::trap },
+            { 0x03, twi, "twi", operands::trap },
+
+            { 0x11, sc, "sc", operands::none },
+
+            { 0x18, ori, "ori", operands::logical },
+            { 0x19, oris, "oris", operands::logical },
+            { 0x1A, xori, "xori", operands::logical },
+            { 0x1B, xoris, "xoris", operands::logical },
+            { 0x1C, andi, "andi.", operands::logical },
+
+            { 0x21, lwzu, "lwzu", operands::load },
+            { 0x22, lbz, "lbz", operands::load },
+            { 0x23, lbzu, "lbzu", operands::load },
+
+            { 0x24, stw, "stw", operands::store },
+
+            { 0x29, lhzu, "lhzu", operands::load },
+
+            { 0x2B, lhau, "lhau", operands::load },
+
+            { 0x30, lfs, "lfs", operands::load_float },
+
+            { 0x34, stfs, "stfs", operands::store_float }
+        });
+
+        fill(0x3E, 2, 0, {
+            { 0x0, _std, "std", operands::store_ds },
+            { 0x1, stdu, "stdu", operands::store_ds }
+        });
+
+        fill(0x1F, 10, 1, {
+            { 0x57, lbzx, "lbzx", operands::indexed },
+            { 0x77, lbzux, "lbzux", operands::indexed },
+            { 0x173, mftb, "mftb", operands::spr }
+        });
+
+        fill(0x04, 11, 0, {
+            { 0x20, vmhaddshs, "vmhaddshs", operands::vector_abc, 5 }
+        });
+
+        fill_fpu_table();
+    }
+
+    template<bool F>
+    static void fill_fpu()
+    {
+        auto pick = [](func_t fast, func_t accurate) { return F ? fast : accurate; };
+
+        fill(0x3F, 5, 1, {
+            { 0x12, pick(fp_fast<fp_op::div, false>, fp_accurate<fp_op::div, false>), "fdiv", operands::float_ab },
+            { 0x14, pick(fp_fast<fp_op::sub, false>, fp_accurate<fp_op::sub, false>), "fsub", operands::float_ab },
+            { 0x15, pick(fp_fast<fp_op::add, false>, fp_accurate<fp_op::add, false>), "fadd", operands::float_ab },
+            { 0x19, pick(fp_fast<fp_op::mul, false>, fp_accurate<fp_op::mul, false>), "fmul", operands::float_ac }
+        });
+
+        fill(0x3B, 5, 1, {
+            { 0x12, pick(fp_fast<fp_op::div, true>, fp_accurate<fp_op::div, true>), "fdivs", operands::float_ab },
+            { 0x14, pick(fp_fast<fp_op::sub, true>, fp_accurate<fp_op::sub, true>), "fsubs", operands::float_ab },
+            { 0x15, pick(fp_fast<fp_op::add, true>, fp_accurate<fp_op::add, true>), "fadds", operands::float_ab },
+            { 0x19, pick(fp_fast<fp_op::mul, true>, fp_accurate<fp_op::mul, true>), "fmuls", operands::float_ac }
+        });
+    }
+
+    void fill_fpu_table()
+    {
+        if(get_fpu_mode() == fpu_mode::fast)
+            fill_fpu<true>();
+        else
+            fill_fpu<false>();
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <types.h>
+
+#include <string>
+#include <type_traits>
+
+namespace volts::ppu
+{
+    struct thread;
+
+    /**
+     * @brief a field of an instruction
+     *
+     * uses powerpc bit numbering, bit 0 is the most significant bit
+     *
+     * @tparam I the first bit of the field
+     * @tparam N the width of the field in bits
+     * @tparam T the type of the field, signed fields are sign extended
+     */
+    template<svl::u32 I, svl::u32 N, typename T = svl::u32>
+    struct field
+    {
+        static constexpr svl::u32 shift = 32 - I - N;
+        static constexpr svl::u32 mask = (1u << N) - 1;
+
+        operator T() const
+        {
+            svl::u32 val = (raw >> shift) & mask;
+
+            if constexpr(std::is_signed<T>::value)
+                return static_cast<T>(static_cast<svl::i32>(val << (32 - N)) >> (32 - N));
+            else
+                return static_cast<T>(val);
+        }
+
+        svl::u32 raw;
+    };
+
+    union form
+    {
+        svl::u32 raw;
+
+        field<6, 5> rs;
+        field<11, 5> ra;
+        field<16, 5> rb;
+        field<6, 5> rd;
+
+        field<11, 5> va;
+        field<16, 5> vb;
+        field<21, 5> vc;
+        field<6, 5> vd;
+
+        field<6, 5> bo;
+
+        field<16, 14> ds;
+
+        field<6, 5> frs;
+        field<6, 5> frd;
+        field<11, 5> fra;
+        field<16, 5> frb;
+        field<21, 5> frc;
+
+        field<16, 16, svl::i32> simm16;
+        field<16, 16> uimm16;
+
+        /// split spr field, the two halves are swapped
+        field<11, 10> spr;
+    };
+
+    static_assert(sizeof(form) == sizeof(svl::u32));
+
+    /**
+     * @brief the operand layout of an instruction, used by the disassembler
+     *
+     */
+    enum class operands : svl::u8
+    {
+        /// opcode that isnt implemented
+        invalid,
+
+        /// no operands
+        none,
+
+        /// native replacement index
+        native,
+
+        /// to, ra, simm
+        trap,
+
+        /// ra, rs, uimm
+        logical,
+
+        /// rd, d(ra)
+        load,
+
+        /// rs, d(ra)
+        store,
+
+        /// rs, ds(ra)
+        store_ds,
+
+        /// frd, d(ra)
+        load_float,
+
+        /// frs, d(ra)
+        store_float,
+
+        /// rd, ra, rb
+        indexed,
+
+        /// frd, fra, frb
+        float_ab,
+
+        /// frd, fra, frc
+        float_ac,
+
+        /// rd, spr
+        spr,
+
+        /// vd, va, vb, vc
+        vector_abc,
+    };
+
+    /**
+     * @brief decode metadata shared by the interpreter and the disassembler
+     *
+     */
+    struct opinfo
+    {
+        /// mnemonic of the instruction
+        const char* name;
+
+        /// how to print the operands
+        operands layout;
+    };
+
+    using func_t = void(*)(thread&, form);
+
+    /// interpreter functions indexed by decode(op)
+    extern func_t ops[0x20000];
+
+    /// instruction metadata indexed by decode(op)
+    extern opinfo infos[0x20000];
+
+    /**
+     * @brief get the table index of an instruction
+     *
+     * @param op the instruction
+     * @return svl::u32 the index into ops and infos
+     */
+    inline svl::u32 decode(svl::u32 op)
+    {
+        return (op >> 26 | op << (32 - 26)) & 0x1FFFF;
+    }
+
+    /**
+     * @brief build the decode tables, safe to call more than once
+     */
+    void init_table();
+
+    /**
+     * @brief fill the floating point entries of the decode table for the current fpu mode
+     */
+    void fill_fpu_table();
+}
@@ -0,0 +1,79 @@
+#include "disasm.h"
+#include "decode.h"
+
+#include <endian.h>
+
+#include <spdlog/fmt/fmt.h>
+
+#include <iterator>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    void disasm(u32 op, std::string& out)
+    {
+        form f = { op };
+        const auto& info = infos[decode(op)];
+        auto it = std::back_inserter(out);
+
+        switch(info.layout)
+        {
+        case operands::invalid:
+            fmt::format_to(it, ".long 0x{:08x}", op);
+            break;
+        case operands::none:
+            out += info.name;
+            break;
+        case operands::native:
+            fmt::format_to(it, "{} {}", info.name, op & 0x3FFFFFF);
+            break;
+        case operands::trap:
+            fmt::format_to(it, "{} {}, r{}, {}", info.name, (u32)f.bo, (u32)f.ra, (i32)f.simm16);
+            break;
+        case operands::logical:
+            fmt::format_to(it, "{} r{}, r{}, 0x{:x}", info.name, (u32)f.ra, (u32)f.rs, (u32)f.uimm16);
+            break;
+        case operands::load:
+            fmt::format_to(it, "{} r{}, {}(r{})", info.name, (u32)f.rd, (i32)f.simm16, (u32)f.ra);
+            break;
+        case operands::store:
+            fmt::format_to(it, "{} r{}, {}(r{})", info.name, (u32)f.rs, (i32)f.simm16, (u32)f.ra);
+            break;
+        case operands::store_ds:
+            fmt::format_to(it, "{} r{}, {}(r{})", info.name, (u32)f.rs, (i32)f.simm16 & ~3, (u32)f.ra);
+            break;
+        case operands::load_float:
+            fmt::format_to(it, "{} f{}, {}(r{})", info.name, (u32)f.frd, (i32)f.simm16, (u32)f.ra);
+            break;
+        case operands::store_float:
+            fmt::format_to(it, "{} f{}, {}(r{})", info.name, (u32)f.frs, (i32)f.simm16, (u32)f.ra);
+            break;
+        case operands::indexed:
+            fmt::format_to(it, "{} r{}, r{}, r{}", info.name, (u32)f.rd, (u32)f.ra, (u32)f.rb);
+            break;
+        case operands::float_ab:
+            fmt::format_to(it, "{} f{}, f{}, f{}", info.name, (u32)f.frd, (u32)f.fra, (u32)f.frb);
+            break;
+        case operands::float_ac:
+            fmt::format_to(it, "{} f{}, f{}, f{}", info.name, (u32)f.frd, (u32)f.fra, (u32)f.frc);
+            break;
+        case operands::spr:
+            // the two halves of the spr field are swapped
+            fmt::format_to(it, "{} r{}, {}", info.name, (u32)f.rd, (f.spr >> 5) | (f.spr & 0x1F) << 5);
+            break;
+        case operands::vector_abc:
+            fmt::format_to(it, "{} v{}, v{}, v{}, v{}", info.name, (u32)f.vd, (u32)f.va, (u32)f.vb, (u32)f.vc);
+            break;
+        }
+    }
+
+    std::string disasm(vm::addr at)
+    {
+        init_table();
+
+        std::string out;
+        disasm(endian::byte_swap(vm::read<u32>(at)), out);
+        return out;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <types.h>
+
+#include "vm.h"
+
+#include <string>
+
+namespace volts::ppu
+{
+    /**
+     * @brief disassemble an instruction
+     *
+     * uses the same decode tables as the interpreter so anything
+     * the interpreter can run can be disassembled
+     *
+     * @param op the instruction in host byte order
+     * @param out the string to append the text to
+     */
+    void disasm(svl::u32 op, std::string& out);
+
+    /**
+     * @brief disassemble the instruction at an address in guest memory
+     *
+     * @param at the address of the instruction
+     * @return std::string the disassembled text
+     */
+    std::string disasm(vm::addr at);
+}
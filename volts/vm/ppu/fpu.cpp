@@ -0,0 +1,49 @@
+#include "fpu.h"
+#include "decode.h"
+
+#include <spdlog/spdlog.h>
+
+#include <xmmintrin.h>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    /// flush to zero and denormals are zero bits of mxcsr
+    constexpr u32 mxcsr_ftz_daz = 0x8040;
+
+    static fpu_mode current = fpu_mode::accurate;
+
+    void set_fpu_mode(fpu_mode mode)
+    {
+        current = mode;
+        fill_fpu_table();
+
+        spdlog::info("using {} fpu mode", mode == fpu_mode::fast ? "fast" : "accurate");
+    }
+
+    fpu_mode get_fpu_mode()
+    {
+        return current;
+    }
+
+    bool parse_fpu_mode(const std::string& name, fpu_mode& mode)
+    {
+        if(name == "fast")
+            mode = fpu_mode::fast;
+        else if(name == "accurate")
+            mode = fpu_mode::accurate;
+        else
+            return false;
+
+        return true;
+    }
+
+    void apply_host_fpu()
+    {
+        if(current == fpu_mode::fast)
+            _mm_setcsr(_mm_getcsr() | mxcsr_ftz_daz);
+        else
+            _mm_setcsr(_mm_getcsr() & ~mxcsr_ftz_daz);
+    }
+}
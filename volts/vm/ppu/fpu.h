@@ -0,0 +1,104 @@
+#pragma once
+
+#include <types.h>
+
+#include <string>
+
+namespace volts::ppu
+{
+    /**
+     * @brief how floating point instructions are emulated
+     *
+     */
+    enum class fpu_mode : svl::u8
+    {
+        /// track fpscr, keep denormals and use powerpc nan propagation
+        accurate,
+
+        /// map straight to host sse ops with denormals flushed and no exception flags
+        fast,
+    };
+
+    /**
+     * @brief fpscr bits, in powerpc order so bit 0 is the most significant bit
+     *
+     */
+    namespace fpscr
+    {
+        /// exception summary
+        constexpr svl::u32 fx = 0x80000000;
+
+        /// invalid operation summary
+        constexpr svl::u32 vx = 0x20000000;
+
+        /// overflow
+        constexpr svl::u32 ox = 0x10000000;
+
+        /// underflow
+        constexpr svl::u32 ux = 0x08000000;
+
+        /// divide by zero
+        constexpr svl::u32 zx = 0x04000000;
+
+        /// inexact
+        constexpr svl::u32 xx = 0x02000000;
+
+        /// invalid operation on a signalling nan
+        constexpr svl::u32 vxsnan = 0x01000000;
+
+        /// inf - inf
+        constexpr svl::u32 vxisi = 0x00800000;
+
+        /// inf / inf
+        constexpr svl::u32 vxidi = 0x00400000;
+
+        /// 0 / 0
+        constexpr svl::u32 vxzdz = 0x00200000;
+
+        /// inf * 0
+        constexpr svl::u32 vximz = 0x00100000;
+
+        /// the last result was inexact, not sticky
+        constexpr svl::u32 fi = 0x00020000;
+
+        /// class of the last result
+        constexpr svl::u32 fprf = 0x0001F000;
+
+        /// every invalid operation bit
+        constexpr svl::u32 vx_all = vxsnan | vxisi | vxidi | vxzdz | vximz;
+    }
+
+    /**
+     * @brief select the fpu mode, usually done per title before booting
+     *
+     * rebuilds the floating point entries of the decode table so the
+     * choice costs nothing per instruction
+     *
+     * @param mode the mode to use
+     */
+    void set_fpu_mode(fpu_mode mode);
+
+    /**
+     * @brief get the current fpu mode
+     *
+     * @return fpu_mode the mode
+     */
+    fpu_mode get_fpu_mode();
+
+    /**
+     * @brief parse an fpu mode name
+     *
+     * @param name either "fast" or "accurate"
+     * @param mode set to the parsed mode
+     * @return true if the name was valid
+     */
+    bool parse_fpu_mode(const std::string& name, fpu_mode& mode);
+
+    /**
+     * @brief configure the host fpu of the calling thread for the current mode
+     *
+     * fast mode enables flush to zero and denormals are zero.
+     * mxcsr is per host thread so every thread that steps ppu code has to call this first
+     */
+    void apply_host_fpu();
+}
@@ -1,6 +1,8 @@
 #include "module.h"
 
 #include "vm.h"
+#include "symbols.h"
+#include "patch.h"
 
 #include <xxhash.h>
 
@@ -8,9 +10,16 @@
 
 #include <spdlog/spdlog.h>
 
-#include <map>
+#include <expected.h>
 
-#include <bitrange.h>
+#include "crypt/self.h"
+
+#include <future>
+#include <thread>
+#include <array>
+#include <utility>
+#include <algorithm>
+#include <cstring>
 
 namespace volts::ppu
 {
@@ -29,121 +38,283 @@ namespace volts::ppu
 
     static_assert(sizeof(relocation_info) == 24);
 
-    struct segment
+    struct module_info
     {
-        vm::addr addr;
-        u64 size;
-        u32 type;
-        u32 flags;
-        u64 file_size;
+        u8 len;
+        pad unk1;
+
+        big<u16> version;
+        big<u16> attrib;
+        big<u16> funcs;
+        big<u16> vars;
+        big<u16> tlsvars;
+
+        u8 hash;
+        u8 tlshash;
+        pad unk2[2];
+
+        big<u32> name;
+        big<u32> nids;
+        big<u32> addrs;
+        big<u32> vnids;
+        big<u32> vstubs;
+
+        big<u32> unk3;
+        big<u32> unk4;
     };
 
-    std::map<u32, u32> load_symbols(u32 front, u32 back)
+    static_assert(sizeof(module_info) == 44);
+
+    void load_symbols(u32 front, u32 back)
     {
-        struct module_info
+        auto addr = front;
+
+        while(addr < back)
         {
-            u8 len;
-            pad unk1;
+            auto lib = vm::read<module_info>(addr);
 
-            big<u16> version;
-            big<u16> attrib;
-            big<u16> funcs;
-            big<u16> vars;
-            big<u16> tlsvars;
-            
-            u8 hash;
-            u8 tlshash;
-            pad unk2[2];
-            
-            big<vm::addr> name;
-            big<vm::addr> nids;
-            big<vm::addr> addrs;
-            big<vm::addr> vnids;
-            big<vm::addr> vstubs;
-            
-            big<u32> unk3;
-            big<u32> unk4;
-        };
+            // the unnamed library holds the module entry points, those get looked up by the loader
+            // not linked against so they go into the table under library id 0
+            u32 id = lib.name ? library_id((char*)vm::base(lib.name)) : 0;
 
-        std::map<u32, u32> symbols = {};
+            auto* nids = (big<u32>*)vm::base(lib.nids);
+            auto* addrs = (big<u32>*)vm::base(lib.addrs);
 
-        auto addr = front;
+            for(u32 i = 0, end = lib.funcs + lib.vars; i < end; i++)
+                exports.insert(id, nids[i], addrs[i]);
+
+            addr += lib.len ? lib.len : sizeof(module_info);
+        }
+    }
+
+    /**
+     * @brief a relocation with its target and value already resolved
+     * 
+     */
+    struct resolved_reloc
+    {
+        /// the value to relocate with
+        u64 data;
+
+        /// the address being relocated
+        u32 addr;
+    };
+
+    /// every supported relocation type, relocations are bucketed in this order
+    constexpr u32 reloc_types[] = { 1, 4, 5, 6, 10, 11, 38, 44, 57 };
+
+    constexpr std::size_t reloc_type_count = sizeof(reloc_types) / sizeof(u32);
 
-        //while(addr < back)
+    /// relocation sets larger than this get split across threads
+    constexpr std::size_t parallel_reloc_threshold = 0x10000;
+
+    static int reloc_index(u32 type)
+    {
+        for(std::size_t i = 0; i < reloc_type_count; i++)
+            if(reloc_types[i] == type)
+                return static_cast<int>(i);
+
+        return -1;
+    }
+
+    // apply a batch of relocations of the same type, keeping the type out
+    // of the loop lets the compiler unroll and vectorize each one
+    template<u32 T>
+    static void apply_relocs(const std::vector<resolved_reloc>& relocs)
+    {
+        for(const auto& reloc : relocs)
         {
-            spdlog::info("offset {}", addr);
-            spdlog::info("len = {}", vm::read<u8>(addr));
-            spdlog::info("version = {}", vm::read<big<u16>>(addr + 2));
+            auto addr = reloc.addr;
+            auto data = reloc.data;
 
+            if constexpr(T == 1) // ADDR32
+            {
+                vm::write<u32>(addr, byte_swap(static_cast<u32>(data)));
+            }
+            else if constexpr(T == 4) // ADDR16_LO
+            {
+                vm::write<u16>(addr, byte_swap(static_cast<u16>(data)));
+            }
+            else if constexpr(T == 5) // ADDR16_HI
+            {
+                vm::write<u16>(addr, byte_swap(static_cast<u16>(data >> 16)));
+            }
+            else if constexpr(T == 6) // ADDR16_HA
+            {
+                vm::write<u16>(addr, byte_swap(static_cast<u16>((data + 0x8000) >> 16)));
+            }
+            else if constexpr(T == 10) // REL24
+            {
+                u32 op = byte_swap(vm::read<u32>(addr));
+                op = (op & ~0x3FFFFFCU) | (static_cast<u32>(data - addr) & 0x3FFFFFC);
+                vm::write<u32>(addr, byte_swap(op));
+            }
+            else if constexpr(T == 11) // REL14
+            {
+                u32 op = byte_swap(vm::read<u32>(addr));
+                op = (op & ~0xFFFCU) | (static_cast<u32>(data - addr) & 0xFFFC);
+                vm::write<u32>(addr, byte_swap(op));
+            }
+            else if constexpr(T == 38) // ADDR64
+            {
+                vm::write<u64>(addr, byte_swap(data));
+            }
+            else if constexpr(T == 44) // REL64
+            {
+                vm::write<u64>(addr, byte_swap(data - addr));
+            }
+            else if constexpr(T == 57) // ADDR16_LO_DS
+            {
+                u16 half = byte_swap(vm::read<u16>(addr));
+                half = (half & 3) | (static_cast<u16>(data) & ~3);
+                vm::write<u16>(addr, byte_swap(half));
+            }
+        }
+    }
+
+    using reloc_buckets = std::array<std::vector<resolved_reloc>, reloc_type_count>;
+
+    template<std::size_t... I>
+    static void apply_buckets(const reloc_buckets& buckets, std::index_sequence<I...>)
+    {
+        (apply_relocs<reloc_types[I]>(buckets[I]), ...);
+    }
+
+    /// a place a variable import is referenced from, patched like a relocation once the variable is found
+    struct var_ref
+    {
+        big<u32> type;
+        big<u32> addr;
+        big<u32> addend;
+    };
+
+    static_assert(sizeof(var_ref) == 12);
+
+    void link_imports(u32 front, u32 back)
+    {
+        auto addr = front;
+        u32 missing = 0;
+
+        reloc_buckets refs;
+
+        while(addr < back)
+        {
             auto lib = vm::read<module_info>(addr);
-            spdlog::info("lib(len={},version={},attrib={},funcs={},vars={},tlsvars={},hash={},tlshash={},name={},nids={},addrs={},vnids={},vstubs={})", 
-                lib.len,
-                lib.version.get(),
-                lib.attrib.get(),
-                lib.funcs.get(),
-                lib.vars.get(),
-                lib.tlsvars.get(),
-                lib.hash,
-                lib.tlshash,
-                lib.name.get(),
-                lib.nids.get(),
-                lib.addrs.get(),
-                lib.vnids.get(),
-                lib.vstubs.get()
-            );
-
-            /*
-            auto lib = vm::read<module_info>(addr);
+            u32 id = library_id((char*)vm::base(lib.name));
 
-            spdlog::info("lib(len={},version={},attrib={},funcs={},vars={},tlsvars={},hash={},tlshash={},name={},nids={},addrs={},vnids={},vstubs={})", 
-                lib.len,
-                lib.version.get(),
-                lib.attrib.get(),
-                lib.funcs.get(),
-                lib.vars.get(),
-                lib.tlsvars.get(),
-                lib.hash,
-                lib.tlshash,
-                lib.name.get(),
-                lib.nids.get(),
-                lib.addrs.get(),
-                lib.vnids.get(),
-                lib.vstubs.get()
-            );
-
-            spdlog::info("name offset {}", lib.name.val);
-            
+            auto* nids = (big<u32>*)vm::base(lib.nids);
+            auto* stubs = (big<u32>*)vm::base(lib.addrs);
 
-            // special symbols
-            if(lib.name.get() == 0)
+            for(u32 i = 0; i < lib.funcs; i++)
             {
-                auto* nids = (big<vm::addr>*)vm::base(lib.nids);
-                auto* addrs = (big<vm::addr>*)vm::base(lib.addrs);
+                if(u32 sym = exports.find(id, nids[i]); sym)
+                {
+                    vm::write<u32>(stubs[i], byte_swap(sym));
+                }
+                else
+                {
+                    spdlog::debug("unresolved import {:x} from {}", nids[i].get(), (char*)vm::base(lib.name));
+                    missing++;
+                }
+            }
+
+            auto* vnids = (big<u32>*)vm::base(lib.vnids);
+            auto* vstubs = (big<u32>*)vm::base(lib.vstubs);
 
-                for(int i = 0, end = lib.funcs + lib.vars; i < end; i++)
+            for(u32 i = 0; i < lib.vars; i++)
+            {
+                u32 sym = exports.find(id, vnids[i]);
+
+                if(!sym)
                 {
-                    u32 nid = nids[i];
-                    u32 addr = addrs[i];
+                    spdlog::debug("unresolved variable import {:x} from {}", vnids[i].get(), (char*)vm::base(lib.name));
+                    missing++;
+                    continue;
+                }
 
-                    spdlog::info("{} = {}", nid, addr);
+                // each variable has its own list of references ending in one of type 0
+                for(auto* ref = (var_ref*)vm::base(vstubs[i]); ref->type; ref++)
+                {
+                    if(int idx = reloc_index(ref->type); idx >= 0)
+                        refs[idx].push_back(resolved_reloc{ u64(sym) + ref->addend, ref->addr });
+                    else
+                        spdlog::error("invalid variable reference type {}", ref->type.get());
                 }
-                // we add 44 because thats how large module_info is meant to be but msvc
-                // refuses to pack the thing correctly
-                addr += lib.len ? lib.len : 44;
-                continue;
             }
 
-            std::string name = (char*)vm::base(lib.name.val);
-            spdlog::info("symbol name: {}", name);
+            // thread local variables need a tls segment which nothing sets up yet
+            if(lib.tlsvars)
+            {
+                spdlog::debug("{} thread local imports from {} were not linked", lib.tlsvars.get(), (char*)vm::base(lib.name));
+                missing += lib.tlsvars;
+            }
 
-            addr += lib.len ? lib.len : 44;*/
+            addr += lib.len ? lib.len : sizeof(module_info);
         }
 
-        return symbols;
+        apply_buckets(refs, std::make_index_sequence<reloc_type_count>());
+
+        if(missing)
+            spdlog::warn("{} imports were left unresolved", missing);
+    }
+
+    static void relocate(elf::ppu_prx& mod, const std::vector<segment>& segments)
+    {
+        for(auto prog : mod.progs)
+        {
+            if(prog.type != 0x700000A4)
+                continue;
+
+            mod.data.seek(prog.offset);
+            auto relocs = mod.data.read<relocation_info>(prog.file_size / sizeof(relocation_info));
+
+            // relocations never overlap so splitting them by the page they
+            // target lets each worker write without synchronizing
+            std::size_t workers = 1;
+            if(relocs.size() >= parallel_reloc_threshold)
+                workers = std::max<std::size_t>(1, std::min<std::size_t>(std::thread::hardware_concurrency(), 8));
+
+            std::vector<reloc_buckets> buckets(workers);
+
+            for(const auto& reloc : relocs)
+            {
+                int idx = reloc_index(reloc.type);
+
+                if(idx < 0)
+                {
+                    spdlog::error("invalid relocation type {}", reloc.type.get());
+                    continue;
+                }
+
+                u32 addr = static_cast<u32>(segments.at(reloc.idx_addr).addr + reloc.offset);
+                u64 data = reloc.idx_val == 0xFF ? reloc.ptr.get() : segments.at(reloc.idx_val).addr + reloc.ptr;
+
+                buckets[(addr >> 12) % workers][idx].push_back(resolved_reloc{data, addr});
+            }
+
+            spdlog::debug("applying {} relocations on {} threads", relocs.size(), workers);
+
+            std::vector<std::future<void>> tasks;
+
+            for(std::size_t i = 1; i < workers; i++)
+            {
+                tasks.push_back(std::async(std::launch::async, [&bucket = buckets[i]] {
+                    apply_buckets(bucket, std::make_index_sequence<reloc_type_count>());
+                }));
+            }
+
+            apply_buckets(buckets[0], std::make_index_sequence<reloc_type_count>());
+
+            for(auto& task : tasks)
+                task.get();
+
+            break;
+        }
     }
 
-    // TODO: all this
-    void load_prx(elf::ppu_prx& mod)
+    // load a prx into memory and relocate it, this only touches memory owned
+    // by the module so many modules can be loaded at once
+    static svl::expected<module> load_image(elf::ppu_prx& mod)
     {
         std::unique_ptr<XXH64_state_t, decltype(&XXH64_freeState)> hasher(XXH64_createState(), XXH64_freeState);
         XXH64_reset(hasher.get(), 0);
@@ -162,7 +333,15 @@ namespace volts::ppu
             vm::addr addr = (vm::addr)vm::main->alloc(prog.mem_size);
 
             if(!addr)
-                spdlog::error("out of memory");
+            {
+                spdlog::error("out of memory loading a {:x} byte segment", prog.mem_size);
+
+                // give back what the module already took so a failed load doesnt leak guest memory
+                for(const auto& seg : segments)
+                    vm::main->dealloc(seg.addr);
+
+                return svl::none();
+            }
 
             spdlog::info("loaded program data at {}", addr);
             
@@ -176,7 +355,8 @@ namespace volts::ppu
                 prog.file_size
             });
 
-            XXH64_update(hasher.get(), &prog.vaddress, sizeof(prog.vaddress));
+            // the file contents before relocation so the hash doesnt depend on where the module landed
+            XXH64_update(hasher.get(), dat.data(), dat.size());
         }
 
         std::vector<segment> sections;
@@ -204,70 +384,16 @@ namespace volts::ppu
             }
         }
 
-        // do the relocations
-        for(auto prog : mod.progs)
+        if(segments.empty())
         {
-            if(prog.type != 0x700000A4)
-                continue;
-
-            mod.data.seek(prog.offset);
-            auto relocs = mod.data.read<relocation_info>(prog.file_size / sizeof(relocation_info));
-
-            for(auto reloc : relocs)
-            {
-                //spdlog::debug("ptr {} {}", reloc.ptr.get(), vm::read<u64>(reloc.ptr));
-                auto addr = vm::read<big<u32>>(segments.at(reloc.idx_addr).addr + reloc.offset);
-                auto data = reloc.idx_val == 0xFF ? byte_swap(vm::read<u64>(reloc.ptr)) : segments.at(reloc.idx_addr).addr + reloc.ptr;
-
-                // TODO: clean up the bitfield syntax
-
-                //spdlog::debug("relocation {} at {}", reloc.type, addr);
+            spdlog::error("prx has no loadable segments");
+            return svl::none();
+        }
 
-                if(addr > 75396 && addr < 75536)
-                {
-                    spdlog::info("reloc {} puts {} at {}", reloc.type, data, addr);
-                }
+        relocate(mod, segments);
 
-                switch(reloc.type)
-                {
-                case 1:
-                    vm::write<u32>(addr, data);
-                    break;
-                case 4:
-                    vm::write<u16>(addr, data);
-                    break;
-                case 5:
-                    vm::write<u16>(addr, data >> 16);
-                    break;
-                case 6:
-                    vm::write<u16>(addr, (data >> 16) + (data & 0x8000 ? 1 : 0));
-                    break;
-                case 10:
-                    vm::write<u32>(addr, byte_swap(bitrange<u32, 7, 30>(static_cast<u32>((data - addr) >> 2)).read()));
-                    break;
-                case 11:
-                    vm::write<u32>(addr, byte_swap(bitrange<u32, 17, 30>(static_cast<u32>((data - addr) >> 2)).read()));
-                    break;
-                case 38:
-                    vm::write<u64>(addr, data);
-                    break;
-                case 44:
-                    vm::write<u64>(addr, data - addr);
-                    break;
-                case 57:
-                    vm::write<u16>(addr, byte_swap(bitrange<u16, 1, 14>(static_cast<u16>(data >> 2)).read()));
-                    break;
-                default:
-                    spdlog::error("invalid relocation type {}", reloc.type);
-                    break;
-                }
-            }
-
-            break;
-        }
-        
         auto hash = XXH64_digest(hasher.get());
-        spdlog::info("prx hash: {}", hash);
+        spdlog::info("prx hash: {:x}", hash);
 
         struct library_info
         {
@@ -285,23 +411,287 @@ namespace volts::ppu
         };
 
         auto info = vm::read<library_info>(segments[0].addr + mod.progs[0].paddress - mod.progs[0].offset);
-        auto name = std::string(info.name);
+        auto name = std::string(info.name, strnlen(info.name, sizeof(info.name)));
 
         spdlog::info("name {}, version {}.{}", name, info.version[0], info.version[1]);
 
         spdlog::info("symbol range: {}-{}", info.symbols_front, info.symbols_back);
 
-        auto symbols = load_symbols(info.symbols_front, info.symbols_back);
+        return module{
+            name,
+            info.toc,
+            info.symbols_front,
+            info.symbols_back,
+            info.deps_front,
+            info.deps_back,
+            hash,
+            segments
+        };
+    }
+
+    static void link(const module& mod)
+    {
+        load_symbols(mod.symbols_front, mod.symbols_back);
+
+        // natives bound to library nids take back the exports the module just replaced
+        export_natives();
+
+        link_imports(mod.deps_front, mod.deps_back);
+        apply_patches(mod);
+    }
+
+    // collect the library ids in a range of module_info structures
+    static std::vector<u32> libraries(u32 front, u32 back)
+    {
+        std::vector<u32> out;
+
+        for(auto addr = front; addr < back;)
+        {
+            auto lib = vm::read<module_info>(addr);
+
+            if(lib.name)
+                out.push_back(library_id((char*)vm::base(lib.name)));
+
+            addr += lib.len ? lib.len : sizeof(module_info);
+        }
+
+        return out;
+    }
+
+    svl::expected<module> load_prx(elf::ppu_prx& mod)
+    {
+        auto out = load_image(mod);
+        if(out)
+            link(out.value());
+
+        return out;
+    }
+
+    std::vector<module> load_prxs(const std::vector<fs::path>& paths)
+    {
+        std::vector<std::future<svl::expected<module>>> tasks;
+
+        for(const auto& path : paths)
+        {
+            tasks.push_back(std::async(std::launch::async, [path]() -> svl::expected<module> {
+                auto file = svl::open(path, svl::mode::read);
+
+                if(!file.valid())
+                {
+                    spdlog::error("failed to open prx {}", path.string());
+                    return svl::none();
+                }
+
+                auto dec = crypt::self::load(file);
+
+                auto prx = elf::load<elf::ppu_prx>(dec.size() ? dec : file);
+
+                if(!prx)
+                {
+                    spdlog::error("failed to load prx {}", path.string());
+                    return svl::none();
+                }
+
+                auto mod = prx.value();
+                return load_image(mod);
+            }));
+        }
+
+        std::vector<module> loaded;
+
+        for(auto& task : tasks)
+        {
+            if(auto mod = task.get(); mod)
+                loaded.push_back(mod.value());
+        }
+
+        // work out which libraries each module exports and depends on
+        std::vector<std::vector<u32>> exported;
+        std::vector<std::vector<u32>> imported;
+
+        for(const auto& mod : loaded)
+        {
+            exported.push_back(libraries(mod.symbols_front, mod.symbols_back));
+            imported.push_back(libraries(mod.deps_front, mod.deps_back));
+        }
+
+        // link every module only after all the modules it imports from are linked.
+        // imports from libraries that none of these modules export are assumed to
+        // already be linked or to be provided by hle
+        std::vector<bool> done(loaded.size(), false);
+        std::vector<module> order;
+
+        auto ready = [&](std::size_t idx) {
+            for(auto lib : imported[idx])
+            {
+                for(std::size_t other = 0; other < loaded.size(); other++)
+                {
+                    if(other == idx || done[other])
+                        continue;
+
+                    if(std::find(exported[other].begin(), exported[other].end(), lib) != exported[other].end())
+                        return false;
+                }
+            }
+
+            return true;
+        };
+
+        while(order.size() < loaded.size())
+        {
+            bool progress = false;
+
+            for(std::size_t idx = 0; idx < loaded.size(); idx++)
+            {
+                if(done[idx] || !ready(idx))
+                    continue;
+
+                link(loaded[idx]);
+                order.push_back(loaded[idx]);
+                done[idx] = progress = true;
+            }
+
+            // cyclic imports, link whatever is left in load order
+            if(!progress)
+            {
+                spdlog::warn("cyclic module dependencies, linking remaining modules in load order");
+
+                for(std::size_t idx = 0; idx < loaded.size(); idx++)
+                {
+                    if(done[idx])
+                        continue;
+
+                    link(loaded[idx]);
+                    order.push_back(loaded[idx]);
+                    done[idx] = true;
+                }
+            }
+        }
+
+        return order;
     }
 
-    void load_exec(elf::ppu_exec& exec)
+    std::vector<fs::path> boot_modules(const fs::path& exec)
     {
+        std::vector<fs::path> out;
+
+        for(auto name : { "liblv2.sprx", "libsysmodule.sprx" })
+        {
+            auto path = vfs::get(fs::path("dev_flash/sys/external") / name);
+
+            if(fs::exists(path))
+                out.push_back(path);
+            else
+                spdlog::warn("firmware module {} is missing, has the firmware been installed", name);
+        }
+
+        auto dir = exec.parent_path();
+
+        if(dir.empty() || !fs::is_directory(dir))
+            return out;
+
+        for(auto& entry : fs::directory_iterator(dir))
+        {
+            if(entry.is_regular_file() && entry.path().extension() == ".sprx")
+                out.push_back(entry.path());
+        }
+
+        return out;
+    }
+
+    /**
+     * @brief the process prx parameters of an executable
+     *
+     * points at the executables own exports and imports
+     */
+    struct process_prx_param
+    {
+        big<u32> size;
+        big<u32> magic;
+        big<u32> version;
+        big<u32> unk0;
+
+        big<u32> libent_start;
+        big<u32> libent_end;
+
+        big<u32> libstub_start;
+        big<u32> libstub_end;
+
+        u8 ver[2];
+        pad unk1[6];
+    };
+
+    static_assert(sizeof(process_prx_param) == 40);
+
+    svl::expected<module> place_exec(elf::ppu_exec& exec)
+    {
+        std::unique_ptr<XXH64_state_t, decltype(&XXH64_freeState)> hasher(XXH64_createState(), XXH64_freeState);
+        XXH64_reset(hasher.get(), 0);
+
+        module out = {};
+        out.name = "executable";
+
         for(auto prog : exec.progs)
         {
             if(prog.type != 1 || !prog.mem_size)
                 continue;
 
-            
+            // executables are not relocatable so everything goes where it asks to be
+            vm::addr addr = vm::main->falloc(prog.vaddress, prog.mem_size);
+            if(!addr)
+            {
+                spdlog::error("executable segment at {:x} overlaps memory already in use", prog.vaddress);
+                return svl::none();
+            }
+
+            exec.data.seek(prog.offset);
+            auto dat = exec.data.read<u8>(prog.file_size);
+
+            std::memcpy(vm::base(addr), dat.data(), prog.file_size);
+            std::memset((u8*)vm::base(addr) + prog.file_size, 0, prog.mem_size - prog.file_size);
+
+            spdlog::info("loaded program data at {:x}", addr);
+
+            out.segments.push_back(segment{
+                addr,
+                prog.mem_size,
+                prog.type,
+                prog.flags,
+                prog.file_size
+            });
+
+            XXH64_update(hasher.get(), dat.data(), dat.size());
         }
+
+        out.hash = XXH64_digest(hasher.get());
+        spdlog::info("executable hash: {:x}", out.hash);
+
+        for(auto prog : exec.progs)
+        {
+            if(prog.type != 0x60000002 || prog.file_size < sizeof(process_prx_param))
+                continue;
+
+            auto param = vm::read<process_prx_param>(prog.vaddress);
+
+            if(param.magic != 0x1B434CEC)
+            {
+                spdlog::error("invalid process prx parameters");
+                break;
+            }
+
+            out.deps_front = param.libstub_start;
+            out.deps_back = param.libstub_end;
+            break;
+        }
+
+        return out;
+    }
+
+    void link_exec(const module& exec)
+    {
+        export_natives();
+
+        link_imports(exec.deps_front, exec.deps_back);
+        apply_patches(exec);
     }
 }
@@ -1,9 +1,106 @@
 #pragma once
 
 #include <elf.h>
+#include <wrapfs.h>
+
+#include "vm.h"
+
+#include <string>
+#include <vector>
 
 namespace volts::ppu
 {
-    void load_prx(elf::ppu_prx& mod);
-    void load_exec(elf::ppu_exec& exec);
-}
\ No newline at end of file
+    /**
+     * @brief a segment of a module loaded into guest memory
+     *
+     */
+    struct segment
+    {
+        vm::addr addr;
+        svl::u64 size;
+        svl::u32 type;
+        svl::u32 flags;
+        svl::u64 file_size;
+    };
+
+    /**
+     * @brief a prx module that has been loaded and relocated but not linked
+     *
+     */
+    struct module
+    {
+        /// the name of the module
+        std::string name;
+
+        /// the toc of the module
+        svl::u32 toc;
+
+        /// range of the exported libraries
+        svl::u32 symbols_front;
+        svl::u32 symbols_back;
+
+        /// range of the imported libraries
+        svl::u32 deps_front;
+        svl::u32 deps_back;
+
+        /// hash of the module, used to identify it
+        svl::u64 hash;
+
+        /// the loaded segments
+        std::vector<segment> segments;
+    };
+
+    /**
+     * @brief load a prx into memory, apply its relocations and link it
+     *
+     * @param mod the prx to load
+     * @return svl::expected<module> the loaded module, empty if its segments didnt fit in memory
+     */
+    svl::expected<module> load_prx(elf::ppu_prx& mod);
+
+    /**
+     * @brief load many prx files at once
+     *
+     * reading, decrypting, copying and relocating each module happens in parallel.
+     * linking happens afterwards on the calling thread in dependency order so
+     * every module has its imports resolved by the time it is linked
+     *
+     * @param paths the paths of the prx or sprx files to load
+     * @return std::vector<module> the loaded modules in the order they were linked
+     */
+    std::vector<module> load_prxs(const std::vector<fs::path>& paths);
+
+    /**
+     * @brief find the prx modules a title needs before its entry point runs
+     *
+     * this is liblv2 and libsysmodule from the firmware in the vfs followed by
+     * every sprx shipped next to the executable. the rest of the firmware is
+     * loaded by the guest itself through libsysmodule
+     *
+     * @param exec the path of the executable being booted
+     * @return std::vector<fs::path> the modules that exist on disk
+     */
+    std::vector<fs::path> boot_modules(const fs::path& exec);
+
+    /**
+     * @brief load the segments of an executable into memory at their addresses
+     *
+     * must happen before any prx is loaded, modules go wherever there is
+     * space so they would otherwise take the addresses the executable needs
+     *
+     * @param exec the executable to load
+     * @return svl::expected<module> the executable as a module so it can be linked
+     * and patched like one, empty if a segment overlaps memory already in use
+     */
+    svl::expected<module> place_exec(elf::ppu_exec& exec);
+
+    /**
+     * @brief link the imports of an executable placed by place_exec and apply its patches
+     *
+     * imports are linked against whatever modules have already been loaded
+     * so any prx the executable needs should be loaded first
+     *
+     * @param exec the module place_exec returned
+     */
+    void link_exec(const module& exec);
+}
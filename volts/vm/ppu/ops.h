@@ -1,90 +1,110 @@
+#pragma once
+
 #include "thread.h"
+#include "decode.h"
 #include <endian.h>
-#include <bitrange.h>
 
 #include "vm.h"
-
-#include <array>
+#include "sys/syscall.h"
+#include "patch.h"
+#include "breakpoint.h"
+#include "sys/timebase.h"
+#include "fpu.h"
 
 #include <spdlog/spdlog.h>
 
+#include <cmath>
+#include <cfenv>
+#include <cstring>
+#include <type_traits>
+
 namespace volts::ppu
 {
-    union form
-    {
-        svl::u32 raw;
-
-        svl::bitrange<svl::u32, 6, 5> rs;
-        svl::bitrange<svl::u32, 11, 5> ra;
-        svl::bitrange<svl::u32, 16, 5> rb;
-        svl::bitrange<svl::u32, 6, 5> rd;
-
-        svl::bitrange<svl::u32, 11, 5> va;
-        svl::bitrange<svl::u32, 16, 5> vb;
-        svl::bitrange<svl::u32, 21, 5> vc;
-        svl::bitrange<svl::u32, 6, 5> vd;
-
-        svl::bitrange<svl::u32, 6, 5> bo;
-
-        svl::bitrange<svl::u32, 16, 14> ds;
+    using namespace svl;
 
-        svl::bitrange<svl::u32, 6, 5> frs;
-        svl::bitrange<svl::u32, 6, 5> frd;
+    // guest memory is big endian, device registers are read and written a word at a time
+    template<typename T>
+    T load(vm::addr addr)
+    {
+        if constexpr(sizeof(T) == 4 && std::is_integral<T>::value)
+        {
+            if(vm::is_mmio(addr))
+                return static_cast<T>(vm::mmio_read(addr));
+        }
 
-        svl::bitrange<svl::i32, 16, 16> simm16;
-        svl::bitrange<svl::u32, 16, 16> uimm16;
-    };
+        if constexpr(sizeof(T) == 1)
+            return vm::read<T>(addr);
+        else
+            return endian::byte_swap(vm::read<T>(addr));
+    }
 
-    static_assert(sizeof(form) == sizeof(svl::u32));
+    template<typename T>
+    void store(vm::addr addr, T val)
+    {
+        if constexpr(sizeof(T) == 4 && std::is_integral<T>::value)
+        {
+            if(vm::is_mmio(addr))
+                return vm::mmio_write(addr, static_cast<u32>(val));
+        }
 
-    using namespace svl;
+        if constexpr(sizeof(T) == 1)
+            vm::write<T>(addr, val);
+        else
+            vm::write<T>(addr, endian::byte_swap(val));
+    }
 
-    svl::u32 decode(svl::u32 op)
+    // trap if any of the conditions selected by to hold
+    template<typename T>
+    bool trap(T a, T b, u32 to)
     {
-        return (op >> 26 | op << (32 - 26)) & 0x1FFFF; 
+        using S = std::make_signed_t<T>;
+
+        return ((to & 0x10) && (S)a < (S)b) ||
+            ((to & 0x8) && (S)a > (S)b) ||
+            ((to & 0x4) && a == b) ||
+            ((to & 0x2) && a < b) ||
+            ((to & 0x1) && a > b);
     }
 
     void tdi(thread& ppu, form op)
     {
-        u64 a = ppu.gpr[op.ra];
-        i64 s = (i64)op.simm16;
-        
-        if(
-            ((a < s) && (op.bo & 0x10)) ||
-            ((a > s) && (op.bo & 0x8)) ||
-            ((a == s) && (op.bo & 0x4)) ||
-            ((a < s) && (op.bo & 0x2)) ||
-            ((a > s) && (op.bo & 0x1))
-        )
+        if(trap<u64>(ppu.gpr[op.ra], (i64)op.simm16, op.bo))
         {
-            spdlog::error("trap");
+            ppu.traps++;
+            spdlog::error("trap at {:x}", ppu.cia);
             // todo: pause
         }
     }
 
     void twi(thread& ppu, form op)
     {
-        u32 a = ppu.gpr[op.ra];
-        i64 s = (i64)op.simm16;
-
-        if(
-            ((a < s) && (op.bo & 0x10)) ||
-            ((a > s) && (op.bo & 0x8)) ||
-            ((a == s) && (op.bo & 0x4)) ||
-            ((a < s) && (op.bo & 0x2)) ||
-            ((a > s) && (op.bo & 0x1))
-        )
+        if(trap<u32>(static_cast<u32>(ppu.gpr[op.ra]), (i32)op.simm16, op.bo))
         {
-            spdlog::error("trap");
+            ppu.traps++;
+            spdlog::error("trap at {:x}", ppu.cia);
             // todo: pause
         }
     }
 
+    void native(thread& ppu, form op)
+    {
+        call_native(ppu, op.raw & 0x3FFFFFF);
+    }
+
+    void breakpoint(thread& ppu, form op)
+    {
+        hit_breakpoint(ppu);
+    }
+
+    void sc(thread& ppu, form op)
+    {
+        vm::syscall(ppu);
+    }
+
     void stw(thread& ppu, form op)
     {
         u64 addr = op.ra ? ppu.gpr[op.ra] + op.simm16 : (i32)op.simm16;
-        u32 val = ppu.gpr[op.rs];
-        vm::write<u32>(addr, val);
+        store<u32>(addr, static_cast<u32>(ppu.gpr[op.rs]));
     }
 
     void ori(thread& ppu, form op)
@@ -110,74 +130,89 @@ namespace volts::ppu
     void lbz(thread& ppu, form op)
     {
         vm::addr addr = op.ra ? ppu.gpr[op.ra] + op.simm16 : (i32)op.simm16;
-        ppu.gpr[op.rd] = vm::read<u8>(addr);
+        ppu.gpr[op.rd] = load<u8>(addr);
     }
 
     void lbzu(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + op.simm16;
-        ppu.gpr[op.rd] = vm::read<u8>(addr);
+        ppu.gpr[op.rd] = load<u8>(addr);
         ppu.gpr[op.ra] = addr;
     }
 
     void lbzx(thread& ppu, form op)
     {
         vm::addr addr = op.ra ? ppu.gpr[op.ra] + ppu.gpr[op.rb] : ppu.gpr[op.rb];
-        ppu.gpr[op.rd] = vm::read<u8>(addr);
+        ppu.gpr[op.rd] = load<u8>(addr);
     }
 
     void lbzux(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + ppu.gpr[op.rb];
-        ppu.gpr[op.rd] = vm::read<u8>(addr);
+        ppu.gpr[op.rd] = load<u8>(addr);
         ppu.gpr[op.ra] = addr;
     }
 
+    void mftb(thread& ppu, form op)
+    {
+        u64 tb = vm::get_timebase();
+
+        // spr 269 is the upper half, 268 is the full register
+        u32 spr = (op.raw >> 16 & 0x1F) | (op.raw >> 11 & 0x1F) << 5;
+        ppu.gpr[op.rd] = spr == 269 ? tb >> 32 : tb;
+    }
+
     void _std(thread& ppu, form op)
     {
-        vm::addr addr = ppu.gpr[op.ra] + (op.simm16 & ~3);
-        vm::write<u64>(addr, ppu.gpr[op.rs]);
-        ppu.gpr[op.ra] = addr;
+        vm::addr addr = op.ra ? ppu.gpr[op.ra] + (op.simm16 & ~3) : (op.simm16 & ~3);
+        store<u64>(addr, ppu.gpr[op.rs]);
     }
 
     void stdu(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + (op.simm16 & ~3);
-        vm::write<u64>(addr, ppu.gpr[op.rs]);
+        store<u64>(addr, ppu.gpr[op.rs]);
         ppu.gpr[op.ra] = addr;
     }
     
     void lfs(thread& ppu, form op)
     {
-        // TODO: is this right
         vm::addr addr = op.ra ? ppu.gpr[op.ra] + op.simm16 : (i32)op.simm16;
-        ppu.fpr[op.frd] = vm::ref<f32>(addr);
+        u32 bits = load<u32>(addr);
+
+        f32 val;
+        std::memcpy(&val, &bits, sizeof(f32));
+        ppu.fpr[op.frd] = val;
     }
 
     void stfs(thread& ppu, form op)
     {
         vm::addr addr = op.ra ? ppu.gpr[op.ra] + op.simm16 : (i32)op.simm16;
-        vm::write<f32>(addr, ppu.fpr[op.frs]);
+        f32 val = static_cast<f32>(ppu.fpr[op.frs]);
+
+        u32 bits;
+        std::memcpy(&bits, &val, sizeof(u32));
+        store<u32>(addr, bits);
     }
 
     void lhzu(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + op.simm16;
-        ppu.gpr[op.rd] = vm::read<u16>(addr);
+        ppu.gpr[op.rd] = load<u16>(addr);
         ppu.gpr[op.ra] = addr;
     }
 
     void lwzu(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + op.simm16;
-        ppu.gpr[op.rd] = vm::read<u32>(addr);
+        ppu.gpr[op.rd] = load<u32>(addr);
         ppu.gpr[op.ra] = addr;
     }
 
     void lhau(thread& ppu, form op)
     {
         vm::addr addr = ppu.gpr[op.ra] + op.simm16;
-        ppu.gpr[op.rd] = vm::read<u16>(addr);
+        ppu.gpr[op.rd] = static_cast<i64>(static_cast<i16>(load<u16>(addr)));
         ppu.gpr[op.ra] = addr;
     }
 
@@ -200,90 +235,147 @@ namespace volts::ppu
         ppu.vr[op.vd].ints = _mm_adds_epi16(_mm_adds_epi16(_mm_xor_si128(m, s), c), _mm_srli_epi16(s, 15));
     }
 
-    using func_t = void(*)(thread&, form);
-    
-    func_t ops[0x20000];
-
-    struct instruction
+    enum class fp_op
     {
-        u32 val;
-        func_t func;
-        u32 magn = 0;
+        add,
+        sub,
+        mul,
+        div,
     };
 
-    // this is just stolen from rpcs3
-    // at the point i find a better way of doing this ill use that instead
-    void fill(u32 op, u32 num, u32 sh, std::initializer_list<instruction> instr)
-    {
-        if(sh < 11)
-        {   
-            for(const auto& e : instr)
-            {
-                for(int i = 0; i < (e.magn + (11 - sh - num)); i++)
-                {
-                    for(int j = 0; j < 1u << sh; j++)
-                    {
-                        ops[((((((i << (num - e.magn)) | e.val) << sh) | j) << 6) | op)] = e.func;
-                    }
-                }
-            }
-        }
+    template<fp_op O>
+    f64 fp_compute(f64 a, f64 b)
+    {
+        if constexpr(O == fp_op::add)
+            return a + b;
+        else if constexpr(O == fp_op::sub)
+            return a - b;
+        else if constexpr(O == fp_op::mul)
+            return a * b;
         else
+            return a / b;
+    }
+
+    // multiply takes its second operand from frc, everything else from frb
+    template<fp_op O>
+    f64 fp_second(thread& ppu, form op)
+    {
+        return O == fp_op::mul ? ppu.fpr[op.frc] : ppu.fpr[op.frb];
+    }
+
+    template<fp_op O, bool S>
+    void fp_fast(thread& ppu, form op)
+    {
+        f64 r = fp_compute<O>(ppu.fpr[op.fra], fp_second<O>(ppu, op));
+        ppu.fpr[op.frd] = S ? static_cast<f32>(r) : r;
+    }
+
+    inline u64 fp_bits(f64 val)
+    {
+        u64 out;
+        std::memcpy(&out, &val, sizeof(u64));
+        return out;
+    }
+
+    inline f64 fp_value(u64 bits)
+    {
+        f64 out;
+        std::memcpy(&out, &bits, sizeof(f64));
+        return out;
+    }
+
+    inline bool is_snan(f64 val)
+    {
+        return std::isnan(val) && !(fp_bits(val) & 0x0008000000000000ULL);
+    }
+
+    inline f64 quiet(f64 val)
+    {
+        return fp_value(fp_bits(val) | 0x0008000000000000ULL);
+    }
+
+    // result class bits of fpscr
+    inline u32 fp_class(f64 val)
+    {
+        bool neg = std::signbit(val);
+
+        switch(std::fpclassify(val))
         {
-            for(const auto& e : instr)
-            {
-                for(int i = 0; i < 1u << 11; i++)
-                {
-                    ops[i << 6 | e.val] = e.func;
-                }
-            }
+        case FP_NAN: return 0x11000;
+        case FP_INFINITE: return neg ? 0x09000 : 0x05000;
+        case FP_ZERO: return neg ? 0x12000 : 0x02000;
+        case FP_SUBNORMAL: return neg ? 0x18000 : 0x14000;
+        default: return neg ? 0x08000 : 0x04000;
         }
     }
 
-    void init_table()
+    template<fp_op O>
+    u32 fp_invalid(f64 a, f64 b)
     {
-        // fill the table with stub ops to detect invalid opcodes
-        std::fill(std::begin(ops), std::end(ops), [](thread& t, form op) {
-            spdlog::critical("invalid op {}", op.raw);
-        });
+        if(is_snan(a) || is_snan(b))
+            return fpscr::vxsnan;
+
+        if constexpr(O == fp_op::add || O == fp_op::sub)
+            return fpscr::vxisi;
+        else if constexpr(O == fp_op::mul)
+            return fpscr::vximz;
+        else
+            return std::isinf(a) ? fpscr::vxidi : fpscr::vxzdz;
+    }
+
+    template<fp_op O, bool S>
+    void fp_accurate(thread& ppu, form op)
+    {
+        // volatile so the host flags are raised by this computation and not folded away
+        volatile f64 a = ppu.fpr[op.fra];
+        volatile f64 b = fp_second<O>(ppu, op);
+
+        std::feclearexcept(FE_ALL_EXCEPT);
+
+        f64 r = fp_compute<O>(a, b);
+        if(S)
+            r = static_cast<f32>(r);
 
-        fill(0, 6, -1, {
-            { 0x02, tdi },
-            { 0x03, twi },
+        int ex = std::fetestexcept(FE_ALL_EXCEPT);
 
-            { 0x18, ori },
-            { 0x19, oris },
-            { 0x1A, xori },
-            { 0x1B, xoris },
-            { 0x1C, andi },
+        u32 flags = 0;
 
-            { 0x21, lwzu },
-            { 0x22, lbz },
-            { 0x23, lbzu },
+        if(ex & FE_INVALID)
+            flags |= fp_invalid<O>(a, b);
+        if(ex & FE_OVERFLOW)
+            flags |= fpscr::ox;
+        if(ex & FE_UNDERFLOW)
+            flags |= fpscr::ux;
+        if(ex & FE_DIVBYZERO)
+            flags |= fpscr::zx;
+        if(ex & FE_INEXACT)
+            flags |= fpscr::xx;
 
-            { 0x24, stw },
+        // powerpc propagates the first nan operand, x86 produces a negative default nan
+        if(std::isnan(a))
+            r = quiet(a);
+        else if(std::isnan(b))
+            r = quiet(b);
+        else if(std::isnan(r))
+            r = fp_value(0x7FF8000000000000ULL);
 
-            { 0x29, lhzu },
+        if(S && std::isnan(r))
+            r = static_cast<f32>(r);
 
-            { 0x2B, lhau },
+        u32 status = ppu.fpscr & ~(fpscr::fprf | fpscr::fi);
 
-            { 0x30, lfs },
+        if(flags & ~status & ~fpscr::fi)
+            status |= fpscr::fx;
 
-            { 0x34, stfs }
-        });
+        status |= flags | fp_class(r);
 
-        fill(0x3E, 2, 0, {
-            { 0x0, _std },
-            { 0x1, stdu }
-        });
+        if(ex & FE_INEXACT)
+            status |= fpscr::fi;
 
-        fill(0x1F, 10, 1, {
-            { 0x57, lbzx },
-            { 0x77, lbzux }
-        });
+        if(status & fpscr::vx_all)
+            status |= fpscr::vx;
 
-        fill(0x04, 11, 0, {
-            { 0x20, vmhaddshs, 5 }
-        });
+        ppu.fpscr = status;
+        ppu.fpr[op.frd] = r;
     }
 }
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "patch.h"
+#include "fpu.h"
+#include "symbols.h"
+
+#include <endian.h>
+#include <file.h>
+
+#include "vfs.h"
+
+#include <rapidjson/document.h>
+
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+
+namespace volts::ppu
+{
+    using namespace svl;
+    using namespace endian;
+
+    namespace json = rapidjson;
+
+    /**
+     * @brief a function signature
+     *
+     */
+    struct signature
+    {
+        /// bytes to match
+        std::vector<u8> bytes;
+
+        /// true for bytes that match anything
+        std::vector<bool> wild;
+
+        /// the replacement to patch in
+        std::string name;
+    };
+
+    /**
+     * @brief a patch at a known offset in a module
+     *
+     */
+    struct module_patch
+    {
+        /// offset from the first segment
+        u32 offset;
+
+        /// the replacement to patch in
+        std::string name;
+    };
+
+    /**
+     * @brief a native exported in place of a library function
+     *
+     */
+    struct native_export
+    {
+        /// the library exporting the function
+        std::string library;
+
+        /// the nid of the function
+        u32 nid;
+
+        /// the replacement to export
+        std::string name;
+
+        /// the function descriptor of the native once it is in guest memory
+        vm::addr desc = 0;
+    };
+
+    static std::vector<native_t> natives;
+    static std::map<std::string, u32> native_names;
+
+    static std::multimap<u64, module_patch> module_patches;
+    static std::vector<signature> signatures;
+    static std::vector<native_export> native_exports;
+
+    // r3 = destination, r4 = source, r5 = length
+    static void native_memcpy(thread& ppu)
+    {
+        std::memcpy(vm::base(ppu.gpr[3]), vm::base(ppu.gpr[4]), ppu.gpr[5]);
+    }
+
+    static void native_memmove(thread& ppu)
+    {
+        std::memmove(vm::base(ppu.gpr[3]), vm::base(ppu.gpr[4]), ppu.gpr[5]);
+    }
+
+    // r3 = destination, r4 = byte, r5 = length
+    static void native_memset(thread& ppu)
+    {
+        std::memset(vm::base(ppu.gpr[3]), static_cast<u8>(ppu.gpr[4]), ppu.gpr[5]);
+    }
+
+    static void native_memcmp(thread& ppu)
+    {
+        ppu.gpr[3] = static_cast<i64>(std::memcmp(vm::base(ppu.gpr[3]), vm::base(ppu.gpr[4]), ppu.gpr[5]));
+    }
+
+    static void native_strlen(thread& ppu)
+    {
+        ppu.gpr[3] = std::strlen(static_cast<const char*>(vm::base(ppu.gpr[3])));
+    }
+
+    // floating point arguments and results are passed in f1
+    static void native_sqrt(thread& ppu)
+    {
+        ppu.fpr[1] = std::sqrt(ppu.fpr[1]);
+    }
+
+    static void native_sqrtf(thread& ppu)
+    {
+        ppu.fpr[1] = std::sqrt(static_cast<f32>(ppu.fpr[1]));
+    }
+
+    // replaces busy wait loops, give the host core back instead of spinning
+    static void native_yield(thread& ppu)
+    {
+        std::this_thread::yield();
+    }
+
+    static void init_natives()
+    {
+        if(static bool init_flag = true; init_flag)
+        {
+            init_flag = false;
+
+            register_native("memcpy", native_memcpy);
+            register_native("memmove", native_memmove);
+            register_native("memset", native_memset);
+            register_native("memcmp", native_memcmp);
+            register_native("strlen", native_strlen);
+            register_native("sqrt", native_sqrt);
+            register_native("sqrtf", native_sqrtf);
+            register_native("yield", native_yield);
+        }
+    }
+
+    void register_native(const std::string& name, native_t func)
+    {
+        init_natives();
+
+        if(auto it = native_names.find(name); it != native_names.end())
+        {
+            natives[it->second] = func;
+            return;
+        }
+
+        native_names[name] = static_cast<u32>(natives.size());
+        natives.push_back(func);
+    }
+
+    void bind_native(const std::string& library, u32 nid, const std::string& name)
+    {
+        native_exports.push_back({ library, nid, name, 0 });
+    }
+
+    void export_natives()
+    {
+        init_natives();
+
+        // each native gets an instruction that calls it followed by a function descriptor pointing at it
+        constexpr u32 entry_size = 16;
+
+        auto unplaced = std::count_if(native_exports.begin(), native_exports.end(), [](auto& bind) { return !bind.desc; });
+
+        // natives bound since the last call are placed together, allocations are whole pages
+        vm::addr at = unplaced ? vm::main->alloc(unplaced * entry_size) : 0;
+        if(unplaced && !at)
+            spdlog::error("failed to allocate memory for {} native exports", unplaced);
+
+        for(auto& bind : native_exports)
+        {
+            if(!bind.desc && at)
+            {
+                auto it = native_names.find(bind.name);
+                if(it == native_names.end())
+                {
+                    spdlog::error("no native replacement named {}", bind.name);
+                    continue;
+                }
+
+                vm::write<u32>(at, byte_swap(native_opcode << 26 | it->second));
+                vm::write<u32>(at + 8, byte_swap(at));
+                vm::write<u32>(at + 12, 0);
+
+                bind.desc = at + 8;
+                at += entry_size;
+
+                spdlog::debug("exported {} as {:x} from {}", bind.name, bind.nid, bind.library);
+            }
+
+            if(bind.desc)
+                exports.insert(library_id(bind.library), bind.nid, bind.desc);
+        }
+    }
+
+    void call_native(thread& ppu, u32 idx)
+    {
+        if(idx >= natives.size())
+        {
+            spdlog::critical("invalid native replacement {} at {:x}", idx, ppu.cia);
+            return;
+        }
+
+        natives[idx](ppu);
+
+        // return to the caller, the interpreter steps past the current instruction
+        // so account for that here
+        ppu.cia = static_cast<u32>(ppu.link - 4);
+    }
+
+    bool patch(vm::addr addr, const std::string& name)
+    {
+        init_natives();
+
+        auto it = native_names.find(name);
+        if(it == native_names.end())
+        {
+            spdlog::error("no native replacement named {}", name);
+            return false;
+        }
+
+        vm::write<u32>(addr, byte_swap(native_opcode << 26 | it->second));
+        spdlog::debug("replaced function at {:x} with {}", addr, name);
+
+        return true;
+    }
+
+    void add_patch(u64 hash, u32 offset, const std::string& name)
+    {
+        module_patches.insert({ hash, module_patch{ offset, name } });
+    }
+
+    bool add_signature(const std::string& pattern, const std::string& name)
+    {
+        signature sig = { {}, {}, name };
+
+        for(std::size_t i = 0; i < pattern.size();)
+        {
+            if(pattern[i] == ' ')
+            {
+                i++;
+                continue;
+            }
+
+            if(i + 1 >= pattern.size())
+                return false;
+
+            auto str = pattern.substr(i, 2);
+            i += 2;
+
+            if(str == "??")
+            {
+                sig.bytes.push_back(0);
+                sig.wild.push_back(true);
+                continue;
+            }
+
+            char* end = nullptr;
+            auto val = std::strtoul(str.c_str(), &end, 16);
+
+            if(end != str.c_str() + 2)
+                return false;
+
+            sig.bytes.push_back(static_cast<u8>(val));
+            sig.wild.push_back(false);
+        }
+
+        if(sig.bytes.empty())
+            return false;
+
+        signatures.push_back(sig);
+        return true;
+    }
+
+    bool load_patches(const fs::path& path)
+    {
+        auto real = vfs::get(path);
+
+        if(!fs::exists(real))
+        {
+            spdlog::error("no patch file found at {}", real.string());
+            return false;
+        }
+
+        auto file = svl::open(real, svl::mode::read);
+        std::string text(file.size(), '\0');
+        file.read(text.data(), text.size());
+
+        json::Document doc;
+        doc.Parse(text.c_str());
+
+        if(doc.HasParseError() || !doc.IsObject() || !doc.HasMember("patches") || !doc["patches"].IsArray())
+        {
+            spdlog::error("malformed patch file {}", real.string());
+            return false;
+        }
+
+        // titles that dont need exact floating point can opt into the fast fpu
+        if(doc.HasMember("fpu") && doc["fpu"].IsString())
+        {
+            fpu_mode mode;
+            if(parse_fpu_mode(doc["fpu"].GetString(), mode))
+                set_fpu_mode(mode);
+            else
+                spdlog::warn("invalid fpu mode {}", doc["fpu"].GetString());
+        }
+
+        // each patch is either
+        // { "native": "memcpy", "hash": "<module hash in hex>", "offset": 1234 }
+        // { "native": "memcpy", "pattern": "7C 08 02 A6 ?? ?? ?? ??" }
+        for(const auto& entry : doc["patches"].GetArray())
+        {
+            if(!entry.IsObject() || !entry.HasMember("native") || !entry["native"].IsString())
+            {
+                spdlog::warn("skipping patch without a native replacement");
+                continue;
+            }
+
+            std::string name = entry["native"].GetString();
+
+            if(entry.HasMember("pattern") && entry["pattern"].IsString())
+            {
+                if(!add_signature(entry["pattern"].GetString(), name))
+                    spdlog::warn("malformed pattern for {}", name);
+            }
+            else if(entry.HasMember("hash") && entry["hash"].IsString() && entry.HasMember("offset") && entry["offset"].IsUint())
+            {
+                add_patch(std::strtoull(entry["hash"].GetString(), nullptr, 16), entry["offset"].GetUint(), name);
+            }
+            else
+            {
+                spdlog::warn("patch for {} has no target", name);
+            }
+        }
+
+        spdlog::info("loaded patches from {}", real.string());
+        return true;
+    }
+
+    static bool matches(const u8* data, const signature& sig)
+    {
+        for(std::size_t i = 0; i < sig.bytes.size(); i++)
+        {
+            if(!sig.wild[i] && data[i] != sig.bytes[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    u32 apply_patches(const module& mod)
+    {
+        u32 count = 0;
+
+        if(!mod.segments.empty())
+        {
+            auto [front, back] = module_patches.equal_range(mod.hash);
+            for(auto it = front; it != back; ++it)
+            {
+                if(it->second.offset >= mod.segments[0].size)
+                {
+                    spdlog::warn("patch offset {:x} is outside of {}", it->second.offset, mod.name);
+                    continue;
+                }
+
+                count += patch(mod.segments[0].addr + it->second.offset, it->second.name);
+            }
+        }
+
+        for(const auto& seg : mod.segments)
+        {
+            // only scan executable segments
+            if(!(seg.flags & 1))
+                continue;
+
+            auto* data = static_cast<const u8*>(vm::base(seg.addr));
+
+            for(const auto& sig : signatures)
+            {
+                // functions are always 4 byte aligned
+                for(u64 off = 0; off + sig.bytes.size() <= seg.file_size; off += 4)
+                {
+                    if(matches(data + off, sig))
+                        count += patch(seg.addr + off, sig.name);
+                }
+            }
+        }
+
+        if(count)
+            spdlog::info("replaced {} functions in {}", count, mod.name);
+
+        return count;
+    }
+}
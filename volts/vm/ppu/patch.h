@@ -0,0 +1,95 @@
+#pragma once
+
+#include <types.h>
+#include <wrapfs.h>
+
+#include "thread.h"
+#include "module.h"
+
+#include <string>
+
+namespace volts::ppu
+{
+    /// a native replacement for a guest function
+    using native_t = void(*)(thread&);
+
+    /// primary opcode patched over the entry of replaced functions, unused by the cell
+    constexpr svl::u32 native_opcode = 1;
+
+    /**
+     * @brief register a native replacement that patches can refer to by name
+     *
+     * @param name the name patches use to refer to the replacement
+     * @param func the native function
+     */
+    void register_native(const std::string& name, native_t func);
+
+    /**
+     * @brief export a native replacement under the nid of a library function
+     *
+     * imports of the function then link straight to the native without any patch naming it
+     *
+     * @param library the name of the library that exports the function
+     * @param nid the nid of the function
+     * @param name the name of the registered replacement
+     */
+    void bind_native(const std::string& library, svl::u32 nid, const std::string& name);
+
+    /**
+     * @brief place every bound native in guest memory and export it
+     *
+     * runs each time a module is linked so the natives keep replacing what modules export
+     */
+    void export_natives();
+
+    /**
+     * @brief call a native replacement then return to the caller
+     *
+     * @param ppu the calling thread
+     * @param idx the index of the replacement encoded in the patched instruction
+     */
+    void call_native(thread& ppu, svl::u32 idx);
+
+    /**
+     * @brief replace a guest function with a native one
+     *
+     * @param addr the entry point of the guest function
+     * @param name the name of the registered replacement
+     * @return true if the replacement exists and was patched in
+     */
+    bool patch(vm::addr addr, const std::string& name);
+
+    /**
+     * @brief add a patch that is applied to a module with a given hash
+     *
+     * @param hash the hash of the module
+     * @param offset offset of the function from the start of the first segment
+     * @param name the name of the registered replacement
+     */
+    void add_patch(svl::u64 hash, svl::u32 offset, const std::string& name);
+
+    /**
+     * @brief add a patch that is applied to every function matching a signature
+     *
+     * @param pattern hex bytes separated by spaces, ?? matches any byte
+     * @param name the name of the registered replacement
+     * @return false if the pattern is malformed
+     */
+    bool add_signature(const std::string& pattern, const std::string& name);
+
+    /**
+     * @brief load patches from a json file in the vfs
+     *
+     * @param path the path of the file relative to the vfs root
+     * @return true if the file was loaded
+     */
+    bool load_patches(const fs::path& path);
+
+    /**
+     * @brief apply every patch that targets a module
+     *
+     * @param mod the loaded module
+     * @return svl::u32 the amount of functions that were replaced
+     */
+    svl::u32 apply_patches(const module& mod);
+}
@@ -0,0 +1,74 @@
+#include "symbols.h"
+
+#include <xxhash.h>
+
+namespace volts::ppu
+{
+    using namespace svl;
+
+    symbol_table exports;
+
+    static u32 next_pow2(u32 val)
+    {
+        u32 out = 16;
+        while(out < val)
+            out <<= 1;
+
+        return out;
+    }
+
+    u32 library_id(const std::string& name)
+    {
+        return static_cast<u32>(XXH64(name.data(), name.size(), 0));
+    }
+
+    symbol_table::symbol_table(u32 capacity)
+        // keep the load factor under 50% so probe sequences stay short
+        : slots(next_pow2(capacity * 2), symbol{0, 0})
+    {}
+
+    u32 symbol_table::slot(u64 key) const
+    {
+        u32 mask = static_cast<u32>(slots.size() - 1);
+
+        // nids are already hashes but the library id sits in the upper half
+        // so mix both halves before masking
+        u32 idx = static_cast<u32>((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+        while(slots[idx].addr && slots[idx].key != key)
+            idx = (idx + 1) & mask;
+
+        return idx;
+    }
+
+    void symbol_table::grow()
+    {
+        std::vector<symbol> old(slots.size() * 2, symbol{0, 0});
+        old.swap(slots);
+
+        for(const auto& sym : old)
+        {
+            if(sym.addr)
+                slots[slot(sym.key)] = sym;
+        }
+    }
+
+    void symbol_table::insert(u32 lib, u32 nid, u32 addr)
+    {
+        if((count + 1) * 2 > slots.size())
+            grow();
+
+        u64 key = (u64)lib << 32 | nid;
+        auto& sym = slots[slot(key)];
+
+        if(!sym.addr)
+            count++;
+
+        sym = symbol{key, addr};
+    }
+
+    u32 symbol_table::find(u32 lib, u32 nid) const
+    {
+        return slots[slot((u64)lib << 32 | nid)].addr;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <types.h>
+
+#include <string>
+#include <vector>
+
+namespace volts::ppu
+{
+    /**
+     * @brief a slot in the symbol table
+     *
+     */
+    struct symbol
+    {
+        /// library id in the upper 32 bits, nid in the lower 32 bits
+        svl::u64 key;
+
+        /// address of the symbol, 0 if the slot is empty
+        svl::u32 addr;
+    };
+
+    /**
+     * @brief hash a library name into a library id
+     *
+     * @param name the name of the library
+     * @return svl::u32 the library id
+     */
+    svl::u32 library_id(const std::string& name);
+
+    /**
+     * @brief flat open addressing table of exported symbols
+     *
+     * every loaded module exports into a single table keyed by (library, nid)
+     * so resolving an import is a single probe sequence rather than a lookup
+     * per module
+     */
+    struct symbol_table
+    {
+        /**
+         * @brief Construct a new symbol table
+         *
+         * @param capacity the amount of symbols to reserve space for
+         */
+        symbol_table(svl::u32 capacity = 4096);
+
+        /**
+         * @brief add or replace a symbol
+         *
+         * @param lib the library id
+         * @param nid the nid of the symbol
+         * @param addr the address of the symbol, must not be 0
+         */
+        void insert(svl::u32 lib, svl::u32 nid, svl::u32 addr);
+
+        /**
+         * @brief find a symbol
+         *
+         * @param lib the library id
+         * @param nid the nid of the symbol
+         * @return svl::u32 the address of the symbol or 0 if it wasnt found
+         */
+        svl::u32 find(svl::u32 lib, svl::u32 nid) const;
+
+        /// the amount of symbols in the table
+        svl::u32 size() const { return count; }
+
+    private:
+        void grow();
+
+        /// probe for the slot a key lives in or should be inserted into
+        svl::u32 slot(svl::u64 key) const;
+
+        std::vector<symbol> slots;
+        svl::u32 count = 0;
+    };
+
+    /// all symbols exported by loaded modules
+    extern symbol_table exports;
+}
@@ -1,28 +1,41 @@
 #include "thread.h"
 
-#include "ops.h"
+#include "decode.h"
+#include "fpu.h"
+#include "vm.h"
+#include "sys/syscall.h"
 
 #include <endian.h>
 
 namespace volts::ppu
 {
+    using namespace svl;
+
     thread::thread(u64 entry)
     {
         if(static bool table_flag = true; table_flag)
         {
             init_table();
+            vm::init_syscalls();
             table_flag = false;
         }
 
         cia = entry;
-        spdlog::info("entry point: {}", cia);
+    }
 
-        for(int i = 0; i < 10; i++)
-        {
-            auto op = vm::read<u32>(cia);
-            auto d = decode(op);
-            ops[d](*this, {op});
-            cia += 4;
-        }
+    void thread::step()
+    {
+        // instructions are stored big endian
+        u32 op = endian::byte_swap(vm::read<u32>(cia));
+        ops[decode(op)](*this, {op});
+        cia += 4;
+    }
+
+    void thread::run(u64 count)
+    {
+        apply_host_fpu();
+
+        for(u64 i = 0; i < count; i++)
+            step();
     }
 }
\ No newline at end of file
@@ -16,7 +16,19 @@ namespace volts::ppu
     struct thread
     {
         thread(svl::u64 entry);
-        
+
+        /**
+         * @brief execute the instruction at cia
+         */
+        void step();
+
+        /**
+         * @brief execute a number of instructions
+         *
+         * @param count the amount of instructions to execute
+         */
+        void run(svl::u64 count);
+
         svl::u64 gpr[32] = {};
         svl::f64 fpr[32] = {};
 
@@ -28,10 +40,19 @@ namespace volts::ppu
         svl::u32 cia = 0;
 
         control cr = {};
+
+        /// floating point status and control register
+        svl::u32 fpscr = 0;
         // todo: fixed point exception
 
         svl::v128 vr[32] = {};
 
+        /// set when the thread hits a breakpoint, cleared by the debugger
+        bool halted = false;
+
+        /// how many trap instructions have fired on this thread
+        svl::u32 traps = 0;
+
         // todo: vector status
         // vr save register
     };
@@ -0,0 +1,215 @@
+#include "analyzer.h"
+#include "thread.h"
+#include "decode.h"
+
+#include <endian.h>
+
+#include <cstring>
+#include <algorithm>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    static u32 fetch(const u8* ls, u32 addr)
+    {
+        u32 op;
+        std::memcpy(&op, ls + addr, sizeof(u32));
+        return endian::byte_swap(op);
+    }
+
+    static func_t func_of(u32 op)
+    {
+        return funcs[decode(op)];
+    }
+
+    // where a direct branch goes, or nothing if the instruction isnt one
+    static bool branch_target(u32 op, u32 addr, u32& out)
+    {
+        auto func = func_of(op);
+
+        // the 16 bit immediate is a word offset
+        i32 offset = (static_cast<i32>(op << 9) >> 16) * 4;
+
+        if(func == ops::br || func == ops::brsl || func == ops::brz || func == ops::brnz || func == ops::brhz || func == ops::brhnz)
+            out = (addr + offset) & ls_mask;
+        else if(func == ops::bra || func == ops::brasl)
+            out = offset & ls_mask;
+        else
+            return false;
+
+        return true;
+    }
+
+    static bool is_call(u32 op)
+    {
+        auto func = func_of(op);
+        return func == ops::brsl || func == ops::brasl || func == ops::bisl;
+    }
+
+    // if execution can continue at the next instruction
+    static bool falls_through(func_t func)
+    {
+        return func != ops::br && func != ops::bra && func != ops::bi && func != ops::iret
+            && func != ops::stop && func != ops::stopd && func != ops::invalid;
+    }
+
+    static bool is_load(func_t func)
+    {
+        return func == ops::lqd || func == ops::lqx || func == ops::lqa || func == ops::lqr;
+    }
+
+    static bool is_store(func_t func)
+    {
+        return func == ops::stqd || func == ops::stqx || func == ops::stqa || func == ops::stqr;
+    }
+
+    static loop_kind classify(const u8* ls, u32 head, u32 tail)
+    {
+        bool load = false;
+        bool store = false;
+        bool shuffle = false;
+        bool channel = false;
+
+        for(u32 addr = head; addr <= tail; addr += 4)
+        {
+            u32 op = fetch(ls, addr);
+            auto func = func_of(op);
+            form f = { op };
+
+            if(func == ops::rdch || func == ops::rchcnt)
+            {
+                u32 ch = f.ca;
+
+                if(ch == channel::mfc_tag_stat || ch == channel::mfc_stall_stat || ch == channel::mfc_cmd || ch == channel::mfc_atomic_stat)
+                    return loop_kind::dma_wait;
+
+                channel = true;
+            }
+
+            load |= is_load(func);
+            store |= is_store(func);
+            shuffle |= func == ops::shufb;
+        }
+
+        if(channel)
+            return loop_kind::channel_wait;
+
+        if(load && store && shuffle)
+            return loop_kind::shufb_copy;
+
+        return loop_kind::plain;
+    }
+
+    // blocks reached by falling through and direct branches from the start of a function,
+    // executable segments also hold constants and jump tables that only look like code
+    static std::vector<u32> reachable(const u8* ls, u32 start, u32 end)
+    {
+        std::set<u32> seen;
+        std::vector<u32> work = { start };
+
+        while(!work.empty())
+        {
+            u32 block = work.back();
+            work.pop_back();
+
+            if(block < start || block >= end || !seen.insert(block).second)
+                continue;
+
+            for(u32 addr = block; addr < end; addr += 4)
+            {
+                u32 op = fetch(ls, addr);
+
+                if(u32 target; branch_target(op, addr, target) && !is_call(op))
+                    work.push_back(target);
+
+                if(ends_block[decode(op)])
+                {
+                    if(falls_through(func_of(op)))
+                        work.push_back(addr + 4);
+
+                    break;
+                }
+            }
+        }
+
+        return { seen.begin(), seen.end() };
+    }
+
+    analysis analyze(const u8* ls, u32 begin, u32 end, u32 entry)
+    {
+        analysis out;
+
+        begin &= ~3;
+        end = std::min(end, ls_size);
+
+        std::set<u32> calls = { entry };
+        out.blocks = { begin, entry };
+
+        for(u32 addr = begin; addr + 4 <= end; addr += 4)
+        {
+            u32 op = fetch(ls, addr);
+            auto func = func_of(op);
+            form f = { op };
+
+            out.instructions++;
+
+            if(ends_block[decode(op)])
+                out.blocks.insert((addr + 4) & ls_mask);
+
+            if(u32 target; branch_target(op, addr, target))
+            {
+                out.targets.insert(target);
+                out.blocks.insert(target);
+
+                if(is_call(op))
+                    calls.insert(target);
+                else if(target <= addr && target >= begin)
+                    out.loops.push_back({ target, addr, loop_kind::plain });
+            }
+
+            if(func == ops::rdch)
+                out.channel_reads[f.ca]++;
+            else if(func == ops::wrch)
+                out.channel_writes[f.ca]++;
+        }
+
+        for(auto& l : out.loops)
+            l.kind = classify(ls, l.head, l.tail);
+
+        // calls outside the analyzed range belong to some other piece of code
+        for(auto it = calls.begin(); it != calls.end(); ++it)
+        {
+            if(*it < begin || *it >= end)
+                continue;
+
+            auto next = std::find_if(std::next(it), calls.end(), [end](u32 addr) { return addr < end; });
+
+            function func = { *it, next == calls.end() ? end : *next, {}, true };
+
+            func.blocks = reachable(ls, func.start, func.end);
+
+            for(u32 addr = func.start; addr < func.end; addr += 4)
+                func.leaf &= !is_call(fetch(ls, addr));
+
+            out.functions.push_back(std::move(func));
+        }
+
+        return out;
+    }
+
+    const char* loop_name(loop_kind kind)
+    {
+        switch(kind)
+        {
+        case loop_kind::dma_wait:
+            return "dma wait";
+        case loop_kind::channel_wait:
+            return "channel wait";
+        case loop_kind::shufb_copy:
+            return "shufb copy";
+        default:
+            return "plain";
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <types.h>
+
+#include <set>
+#include <map>
+#include <vector>
+
+namespace volts::spu
+{
+    /// what a loop spends its time doing
+    enum class loop_kind : svl::u8
+    {
+        /// nothing recognised
+        plain,
+
+        /// polls the tag status until a dma completes
+        dma_wait,
+
+        /// polls a mailbox, signal or event channel
+        channel_wait,
+
+        /// copies quadwords with loads, shufb and stores
+        shufb_copy,
+    };
+
+    /**
+     * @brief a loop found from a backwards branch
+     */
+    struct loop
+    {
+        /// the branch target, first instruction of the loop
+        svl::u32 head;
+
+        /// the backwards branch, last instruction of the loop
+        svl::u32 tail;
+
+        loop_kind kind;
+    };
+
+    /**
+     * @brief a function found from the entry point or a call
+     */
+    struct function
+    {
+        svl::u32 start;
+
+        /// address after the last instruction
+        svl::u32 end;
+
+        /// blocks reachable from the start without indirect branches, what the recompiler compiles ahead of time
+        std::vector<svl::u32> blocks;
+
+        /// true if the function makes no calls
+        bool leaf;
+    };
+
+    /**
+     * @brief everything the analyzer found in a range of local store
+     */
+    struct analysis
+    {
+        svl::u32 instructions = 0;
+
+        /// every address execution can enter a block at
+        std::set<svl::u32> blocks;
+
+        /// targets of direct branches
+        std::set<svl::u32> targets;
+
+        std::vector<function> functions;
+        std::vector<loop> loops;
+
+        /// reads and writes of each channel
+        std::map<svl::u32, svl::u32> channel_reads;
+        std::map<svl::u32, svl::u32> channel_writes;
+    };
+
+    /**
+     * @brief find the functions, blocks and loops in a range of spu code
+     *
+     * code is assumed to be laid out linearly, functions end where the next one starts
+     *
+     * @param ls the local store holding the code
+     * @param begin the first address to analyze
+     * @param end the address after the last instruction
+     * @param entry the entry point of the program
+     * @return analysis what was found
+     */
+    analysis analyze(const svl::u8* ls, svl::u32 begin, svl::u32 end, svl::u32 entry);
+
+    /**
+     * @brief get the name of a loop kind
+     *
+     * @param kind the kind
+     * @return const char* the name
+     */
+    const char* loop_name(loop_kind kind);
+}
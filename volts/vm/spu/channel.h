@@ -0,0 +1,391 @@
+#pragma once
+
+#include <types.h>
+#include <futex.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include <emmintrin.h>
+
+namespace volts::spu
+{
+    /// spu event bits, reported by the event status channel
+    namespace event
+    {
+        /// lock line reservation lost
+        constexpr svl::u32 lr = 0x400;
+
+        /// signal notification 1 available
+        constexpr svl::u32 s1 = 0x200;
+
+        /// signal notification 2 available
+        constexpr svl::u32 s2 = 0x100;
+
+        /// outbound mailbox available
+        constexpr svl::u32 le = 0x80;
+
+        /// outbound interrupt mailbox available
+        constexpr svl::u32 me = 0x40;
+
+        /// inbound mailbox has data
+        constexpr svl::u32 mb = 0x10;
+    }
+
+    /// how many times a channel is polled before the thread sleeps
+    constexpr svl::u32 spin_count = 0x100;
+
+    /**
+     * @brief lets another thread pull an spu off a channel it is waiting on
+     *
+     * the scheduler uses this to give a blocked thread's slot to another thread
+     * and raw spus use it to stop a thread stuck reading a mailbox
+     */
+    struct preemption
+    {
+        /**
+         * @brief ask the thread to return to its run loop, waking it if its parked
+         */
+        void request()
+        {
+            requested.store(true);
+
+            // the thread may have parked just before it could see the request, so
+            // keep waking the word its parked on until it notices and unparks
+            while(auto* word = parked.load())
+            {
+                svl::futex::wake_all(*word);
+                std::this_thread::yield();
+            }
+        }
+
+        /**
+         * @brief forget a request once the thread has returned to its run loop
+         */
+        void clear()
+        {
+            requested.store(false);
+        }
+
+        /**
+         * @brief get if the thread has been asked to return to its run loop
+         */
+        bool pending() const
+        {
+            return requested.load(std::memory_order_relaxed);
+        }
+
+    private:
+        friend bool park(std::atomic<svl::u32>&, svl::u32, std::atomic<svl::u32>&, preemption*);
+
+        std::atomic<bool> requested = false;
+
+        /// the word the thread sleeps on, null while its running
+        std::atomic<std::atomic<svl::u32>*> parked = nullptr;
+    };
+
+    /**
+     * @brief wait for a word to change
+     *
+     * spins briefly first since the other side of a mailbox usually answers quickly,
+     * then sleeps on the word. sleepers is how wake knows to make a syscall at all
+     *
+     * @param word the word to wait on
+     * @param old return once the word doesnt hold this value
+     * @param sleepers count of threads sleeping on the word
+     * @param stop lets the wait be abandoned, null if it cant be
+     * @return true if the word may have changed
+     * @return false if the wait was abandoned through stop
+     */
+    inline bool park(std::atomic<svl::u32>& word, svl::u32 old, std::atomic<svl::u32>& sleepers, preemption* stop = nullptr)
+    {
+        for(svl::u32 i = 0; i < spin_count; i++)
+        {
+            if(word.load(std::memory_order_relaxed) != old)
+                return true;
+
+            if(stop && stop->pending())
+                return false;
+
+            _mm_pause();
+        }
+
+        sleepers++;
+
+        // publish the word before checking for a request so request either sees it or this sees the request
+        if(stop)
+            stop->parked.store(&word);
+
+        if(!stop || !stop->requested.load())
+            svl::futex::wait(word, old);
+
+        if(stop)
+            stop->parked.store(nullptr);
+
+        sleepers--;
+
+        return !stop || !stop->requested.load();
+    }
+
+    /**
+     * @brief wake threads sleeping on a word after it was changed
+     *
+     * @param word the word that changed
+     * @param sleepers count of threads sleeping on the word
+     */
+    inline void unpark(std::atomic<svl::u32>& word, std::atomic<svl::u32>& sleepers)
+    {
+        if(sleepers.load() != 0)
+            svl::futex::wake_all(word);
+    }
+
+    /**
+     * @brief a single producer single consumer queue of channel values
+     *
+     * @tparam N how many values the mailbox holds
+     */
+    template<svl::u32 N>
+    struct mailbox
+    {
+        /**
+         * @brief add a value if there is space
+         *
+         * @param val the value to add
+         * @return true if the value was added
+         * @return false if the mailbox was full
+         */
+        bool try_push(svl::u32 val)
+        {
+            svl::u32 t = tail.load(std::memory_order_relaxed);
+            if(t - head.load() >= N)
+                return false;
+
+            data[t % N] = val;
+            tail.store(t + 1);
+            unpark(tail, sleepers);
+
+            return true;
+        }
+
+        /**
+         * @brief take the oldest value if there is one
+         *
+         * @param out the value taken
+         * @return true if a value was taken
+         * @return false if the mailbox was empty
+         */
+        bool try_pop(svl::u32& out)
+        {
+            svl::u32 h = head.load(std::memory_order_relaxed);
+            if(tail.load() == h)
+                return false;
+
+            out = data[h % N];
+            head.store(h + 1);
+            unpark(head, sleepers);
+
+            return true;
+        }
+
+        /**
+         * @brief add a value, blocks while the mailbox is full
+         *
+         * @param val the value to add
+         * @param stop lets the wait be abandoned, null if it cant be
+         * @return false if the wait was abandoned and the value wasnt added
+         */
+        bool push(svl::u32 val, preemption* stop = nullptr)
+        {
+            while(!try_push(val))
+            {
+                svl::u32 h = head.load();
+                if(tail.load(std::memory_order_relaxed) - h >= N && !park(head, h, sleepers, stop))
+                    return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief take the oldest value, blocks while the mailbox is empty
+         *
+         * @param out the value taken
+         * @param stop lets the wait be abandoned, null if it cant be
+         * @return false if the wait was abandoned and nothing was taken
+         */
+        bool pop(svl::u32& out, preemption* stop = nullptr)
+        {
+            while(!try_pop(out))
+            {
+                svl::u32 t = tail.load();
+                if(t == head.load(std::memory_order_relaxed) && !park(tail, t, sleepers, stop))
+                    return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief get how many values are in the mailbox
+         *
+         * @return svl::u32 the number of values waiting
+         */
+        svl::u32 count() const
+        {
+            return tail.load() - head.load();
+        }
+
+    private:
+        std::array<svl::u32, N> data = {};
+
+        std::atomic<svl::u32> head = 0;
+        std::atomic<svl::u32> tail = 0;
+        std::atomic<svl::u32> sleepers = 0;
+    };
+
+    /**
+     * @brief a mailbox holding one value that either side may empty
+     *
+     * the spu fills it and the ppu normally empties it, but the kernel also
+     * takes the value when an spu sends an event so taking is a compare exchange
+     */
+    struct single_mailbox
+    {
+        /**
+         * @brief add a value if the mailbox is empty, only the spu may call this
+         *
+         * @param val the value to add
+         * @return true if the value was added
+         * @return false if the mailbox was full
+         */
+        bool try_push(svl::u32 val)
+        {
+            if(state.load() != empty)
+                return false;
+
+            data = val;
+            state.store(full);
+            unpark(state, sleepers);
+
+            return true;
+        }
+
+        /**
+         * @brief take the value if there is one, safe to call from any thread
+         *
+         * @param out the value taken
+         * @return true if a value was taken
+         * @return false if the mailbox was empty
+         */
+        bool try_pop(svl::u32& out)
+        {
+            svl::u32 expected = full;
+            if(!state.compare_exchange_strong(expected, taking))
+                return false;
+
+            out = data;
+            state.store(empty);
+            unpark(state, sleepers);
+
+            return true;
+        }
+
+        /**
+         * @brief add a value, blocks while the mailbox is full
+         *
+         * @param val the value to add
+         * @param stop lets the wait be abandoned, null if it cant be
+         * @return false if the wait was abandoned and the value wasnt added
+         */
+        bool push(svl::u32 val, preemption* stop = nullptr)
+        {
+            while(!try_push(val))
+            {
+                svl::u32 s = state.load();
+                if(s != empty && !park(state, s, sleepers, stop))
+                    return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief get how many values are in the mailbox
+         *
+         * @return svl::u32 1 while the mailbox is full or being emptied, otherwise 0
+         */
+        svl::u32 count() const
+        {
+            return state.load() != empty ? 1 : 0;
+        }
+
+    private:
+        static constexpr svl::u32 empty = 0;
+        static constexpr svl::u32 full = 1;
+        static constexpr svl::u32 taking = 2;
+
+        svl::u32 data = 0;
+
+        std::atomic<svl::u32> state = empty;
+        std::atomic<svl::u32> sleepers = 0;
+    };
+
+    /**
+     * @brief a signal notification register
+     *
+     * writes either replace the value or are or'd into it depending
+     * on how the register is configured, reads clear it
+     */
+    struct signal_register
+    {
+        /**
+         * @brief write to the register
+         *
+         * @param val the value to write
+         * @param accumulate or the value into the register rather than replacing it
+         */
+        void write(svl::u32 val, bool accumulate)
+        {
+            if(accumulate)
+                value |= val;
+            else
+                value = val;
+
+            unpark(value, sleepers);
+        }
+
+        /**
+         * @brief read and clear the register, blocks until it holds a value
+         *
+         * @param out the value
+         * @param stop lets the wait be abandoned, null if it cant be
+         * @return false if the wait was abandoned and the register wasnt read
+         */
+        bool read(svl::u32& out, preemption* stop = nullptr)
+        {
+            while(true)
+            {
+                if(out = value.exchange(0); out != 0)
+                    return true;
+
+                if(!park(value, 0, sleepers, stop))
+                    return false;
+            }
+        }
+
+        /**
+         * @brief get if there is a value waiting
+         *
+         * @return svl::u32 1 if the register holds a value, otherwise 0
+         */
+        svl::u32 count() const
+        {
+            return value.load() != 0 ? 1 : 0;
+        }
+
+    private:
+        std::atomic<svl::u32> value = 0;
+        std::atomic<svl::u32> sleepers = 0;
+    };
+}
@@ -0,0 +1,279 @@
+#include "decode.h"
+
+#include "ops.h"
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    struct instruction
+    {
+        /// the opcode
+        u32 val;
+
+        /// width of the opcode in bits
+        u32 width;
+
+        func_t func;
+        const char* name;
+    };
+
+    // every spu instruction, the opcodes are prefix free so the order doesnt matter
+    static constexpr instruction instructions[] = {
+        // rr and ri7, 11 bit opcodes
+        { 0x000, 11, ops::stop, "stop" },
+        { 0x001, 11, ops::nop, "lnop" },
+        { 0x002, 11, ops::nop, "sync" },
+        { 0x003, 11, ops::nop, "dsync" },
+        { 0x00C, 11, ops::mfspr, "mfspr" },
+        { 0x00D, 11, ops::rdch, "rdch" },
+        { 0x00F, 11, ops::rchcnt, "rchcnt" },
+        { 0x040, 11, ops::sf, "sf" },
+        { 0x041, 11, ops::_or, "or" },
+        { 0x042, 11, ops::bg, "bg" },
+        { 0x048, 11, ops::sfh, "sfh" },
+        { 0x049, 11, ops::nor, "nor" },
+        { 0x053, 11, ops::absdb, "absdb" },
+        { 0x058, 11, ops::rot, "rot" },
+        { 0x059, 11, ops::rotm, "rotm" },
+        { 0x05A, 11, ops::rotma, "rotma" },
+        { 0x05B, 11, ops::shl, "shl" },
+        { 0x05C, 11, ops::roth, "roth" },
+        { 0x05D, 11, ops::rothm, "rothm" },
+        { 0x05E, 11, ops::rotmah, "rotmah" },
+        { 0x05F, 11, ops::shlh, "shlh" },
+        { 0x078, 11, ops::roti, "roti" },
+        { 0x079, 11, ops::rotmi, "rotmi" },
+        { 0x07A, 11, ops::rotmai, "rotmai" },
+        { 0x07B, 11, ops::shli, "shli" },
+        { 0x07C, 11, ops::rothi, "rothi" },
+        { 0x07D, 11, ops::rothmi, "rothmi" },
+        { 0x07E, 11, ops::rotmahi, "rotmahi" },
+        { 0x07F, 11, ops::shlhi, "shlhi" },
+        { 0x0C0, 11, ops::a, "a" },
+        { 0x0C1, 11, ops::_and, "and" },
+        { 0x0C2, 11, ops::cg, "cg" },
+        { 0x0C8, 11, ops::ah, "ah" },
+        { 0x0C9, 11, ops::nand, "nand" },
+        { 0x0D3, 11, ops::avgb, "avgb" },
+        { 0x10C, 11, ops::mtspr, "mtspr" },
+        { 0x10D, 11, ops::wrch, "wrch" },
+        { 0x128, 11, ops::biz, "biz" },
+        { 0x129, 11, ops::binz, "binz" },
+        { 0x12A, 11, ops::bihz, "bihz" },
+        { 0x12B, 11, ops::bihnz, "bihnz" },
+        { 0x140, 11, ops::stopd, "stopd" },
+        { 0x144, 11, ops::stqx, "stqx" },
+        { 0x1A8, 11, ops::bi, "bi" },
+        { 0x1A9, 11, ops::bisl, "bisl" },
+        { 0x1AA, 11, ops::iret, "iret" },
+        { 0x1AB, 11, ops::bisled, "bisled" },
+        { 0x1AC, 11, ops::nop, "hbr" },
+        { 0x1B0, 11, ops::gb, "gb" },
+        { 0x1B1, 11, ops::gbh, "gbh" },
+        { 0x1B2, 11, ops::gbb, "gbb" },
+        { 0x1B4, 11, ops::fsm, "fsm" },
+        { 0x1B5, 11, ops::fsmh, "fsmh" },
+        { 0x1B6, 11, ops::fsmb, "fsmb" },
+        { 0x1B8, 11, ops::frest, "frest" },
+        { 0x1B9, 11, ops::frsqest, "frsqest" },
+        { 0x1C4, 11, ops::lqx, "lqx" },
+        { 0x1CC, 11, ops::rotqbybi, "rotqbybi" },
+        { 0x1CD, 11, ops::rotqmbybi, "rotqmbybi" },
+        { 0x1CF, 11, ops::shlqbybi, "shlqbybi" },
+        { 0x1D4, 11, ops::cbx, "cbx" },
+        { 0x1D5, 11, ops::chx, "chx" },
+        { 0x1D6, 11, ops::cwx, "cwx" },
+        { 0x1D7, 11, ops::cdx, "cdx" },
+        { 0x1D8, 11, ops::rotqbi, "rotqbi" },
+        { 0x1D9, 11, ops::rotqmbi, "rotqmbi" },
+        { 0x1DB, 11, ops::shlqbi, "shlqbi" },
+        { 0x1DC, 11, ops::rotqby, "rotqby" },
+        { 0x1DD, 11, ops::rotqmby, "rotqmby" },
+        { 0x1DF, 11, ops::shlqby, "shlqby" },
+        { 0x1F0, 11, ops::orx, "orx" },
+        { 0x1F4, 11, ops::cbd, "cbd" },
+        { 0x1F5, 11, ops::chd, "chd" },
+        { 0x1F6, 11, ops::cwd, "cwd" },
+        { 0x1F7, 11, ops::cdd, "cdd" },
+        { 0x1F8, 11, ops::rotqbii, "rotqbii" },
+        { 0x1F9, 11, ops::rotqmbii, "rotqmbii" },
+        { 0x1FB, 11, ops::shlqbii, "shlqbii" },
+        { 0x1FC, 11, ops::rotqbyi, "rotqbyi" },
+        { 0x1FD, 11, ops::rotqmbyi, "rotqmbyi" },
+        { 0x1FF, 11, ops::shlqbyi, "shlqbyi" },
+        { 0x201, 11, ops::nop, "nop" },
+        { 0x240, 11, ops::cgt, "cgt" },
+        { 0x241, 11, ops::_xor, "xor" },
+        { 0x248, 11, ops::cgth, "cgth" },
+        { 0x249, 11, ops::eqv, "eqv" },
+        { 0x250, 11, ops::cgtb, "cgtb" },
+        { 0x253, 11, ops::sumb, "sumb" },
+        { 0x258, 11, ops::hgt, "hgt" },
+        { 0x2A5, 11, ops::clz, "clz" },
+        { 0x2A6, 11, ops::xswd, "xswd" },
+        { 0x2AE, 11, ops::xshw, "xshw" },
+        { 0x2B4, 11, ops::cntb, "cntb" },
+        { 0x2B6, 11, ops::xsbh, "xsbh" },
+        { 0x2C0, 11, ops::clgt, "clgt" },
+        { 0x2C1, 11, ops::andc, "andc" },
+        { 0x2C2, 11, ops::fcgt, "fcgt" },
+        { 0x2C4, 11, ops::fa, "fa" },
+        { 0x2C5, 11, ops::fs, "fs" },
+        { 0x2C6, 11, ops::fm, "fm" },
+        { 0x2C8, 11, ops::clgth, "clgth" },
+        { 0x2C9, 11, ops::orc, "orc" },
+        { 0x2CA, 11, ops::fcmgt, "fcmgt" },
+        { 0x2CC, 11, ops::dfa, "dfa" },
+        { 0x2CD, 11, ops::dfs, "dfs" },
+        { 0x2CE, 11, ops::dfm, "dfm" },
+        { 0x2D0, 11, ops::clgtb, "clgtb" },
+        { 0x2D8, 11, ops::hlgt, "hlgt" },
+        { 0x340, 11, ops::addx, "addx" },
+        { 0x341, 11, ops::sfx, "sfx" },
+        { 0x342, 11, ops::cgx, "cgx" },
+        { 0x343, 11, ops::bgx, "bgx" },
+        { 0x346, 11, ops::mpyhha, "mpyhha" },
+        { 0x34E, 11, ops::mpyhhau, "mpyhhau" },
+        { 0x35C, 11, ops::dfma, "dfma" },
+        { 0x35D, 11, ops::dfms, "dfms" },
+        { 0x35E, 11, ops::dfnms, "dfnms" },
+        { 0x35F, 11, ops::dfnma, "dfnma" },
+        { 0x398, 11, ops::fscrrd, "fscrrd" },
+        { 0x3B8, 11, ops::fesd, "fesd" },
+        { 0x3B9, 11, ops::frds, "frds" },
+        { 0x3BA, 11, ops::fscrwr, "fscrwr" },
+        { 0x3C0, 11, ops::ceq, "ceq" },
+        { 0x3C2, 11, ops::fceq, "fceq" },
+        { 0x3C4, 11, ops::mpy, "mpy" },
+        { 0x3C5, 11, ops::mpyh, "mpyh" },
+        { 0x3C6, 11, ops::mpyhh, "mpyhh" },
+        { 0x3C7, 11, ops::mpys, "mpys" },
+        { 0x3C8, 11, ops::ceqh, "ceqh" },
+        { 0x3CA, 11, ops::fcmeq, "fcmeq" },
+        { 0x3CC, 11, ops::mpyu, "mpyu" },
+        { 0x3CE, 11, ops::mpyhhu, "mpyhhu" },
+        { 0x3D0, 11, ops::ceqb, "ceqb" },
+        { 0x3D4, 11, ops::fi, "fi" },
+        { 0x3D8, 11, ops::heq, "heq" },
+
+        // ri8, 10 bit opcodes
+        { 0x1D8, 10, ops::cflts, "cflts" },
+        { 0x1D9, 10, ops::cfltu, "cfltu" },
+        { 0x1DA, 10, ops::csflt, "csflt" },
+        { 0x1DB, 10, ops::cuflt, "cuflt" },
+
+        // ri16, 9 bit opcodes
+        { 0x040, 9, ops::brz, "brz" },
+        { 0x041, 9, ops::stqa, "stqa" },
+        { 0x042, 9, ops::brnz, "brnz" },
+        { 0x044, 9, ops::brhz, "brhz" },
+        { 0x046, 9, ops::brhnz, "brhnz" },
+        { 0x047, 9, ops::stqr, "stqr" },
+        { 0x060, 9, ops::bra, "bra" },
+        { 0x061, 9, ops::lqa, "lqa" },
+        { 0x062, 9, ops::brasl, "brasl" },
+        { 0x064, 9, ops::br, "br" },
+        { 0x065, 9, ops::fsmbi, "fsmbi" },
+        { 0x066, 9, ops::brsl, "brsl" },
+        { 0x067, 9, ops::lqr, "lqr" },
+        { 0x081, 9, ops::il, "il" },
+        { 0x082, 9, ops::ilhu, "ilhu" },
+        { 0x083, 9, ops::ilh, "ilh" },
+        { 0x0C1, 9, ops::iohl, "iohl" },
+
+        // ri10, 8 bit opcodes
+        { 0x04, 8, ops::ori, "ori" },
+        { 0x05, 8, ops::orhi, "orhi" },
+        { 0x06, 8, ops::orbi, "orbi" },
+        { 0x0C, 8, ops::sfi, "sfi" },
+        { 0x0D, 8, ops::sfhi, "sfhi" },
+        { 0x14, 8, ops::andi, "andi" },
+        { 0x15, 8, ops::andhi, "andhi" },
+        { 0x16, 8, ops::andbi, "andbi" },
+        { 0x1C, 8, ops::ai, "ai" },
+        { 0x1D, 8, ops::ahi, "ahi" },
+        { 0x24, 8, ops::stqd, "stqd" },
+        { 0x34, 8, ops::lqd, "lqd" },
+        { 0x44, 8, ops::xori, "xori" },
+        { 0x45, 8, ops::xorhi, "xorhi" },
+        { 0x46, 8, ops::xorbi, "xorbi" },
+        { 0x4C, 8, ops::cgti, "cgti" },
+        { 0x4D, 8, ops::cgthi, "cgthi" },
+        { 0x4E, 8, ops::cgtbi, "cgtbi" },
+        { 0x4F, 8, ops::hgti, "hgti" },
+        { 0x5C, 8, ops::clgti, "clgti" },
+        { 0x5D, 8, ops::clgthi, "clgthi" },
+        { 0x5E, 8, ops::clgtbi, "clgtbi" },
+        { 0x5F, 8, ops::hlgti, "hlgti" },
+        { 0x74, 8, ops::mpyi, "mpyi" },
+        { 0x75, 8, ops::mpyui, "mpyui" },
+        { 0x7C, 8, ops::ceqi, "ceqi" },
+        { 0x7D, 8, ops::ceqhi, "ceqhi" },
+        { 0x7E, 8, ops::ceqbi, "ceqbi" },
+        { 0x7F, 8, ops::heqi, "heqi" },
+
+        // ri18, 7 bit opcodes
+        { 0x08, 7, ops::nop, "hbra" },
+        { 0x09, 7, ops::nop, "hbrr" },
+        { 0x21, 7, ops::ila, "ila" },
+
+        // rrr, 4 bit opcodes
+        { 0x8, 4, ops::selb, "selb" },
+        { 0xB, 4, ops::shufb, "shufb" },
+        { 0xC, 4, ops::mpya, "mpya" },
+        { 0xD, 4, ops::fnms, "fnms" },
+        { 0xE, 4, ops::fma, "fma" },
+        { 0xF, 4, ops::fms, "fms" },
+    };
+
+    // fill every index an opcode covers, shorter opcodes cover more of the table
+    template<typename T, typename F>
+    static constexpr std::array<T, table_size> build(T fallback, F get)
+    {
+        std::array<T, table_size> out = {};
+
+        for(auto& e : out)
+            e = fallback;
+
+        for(const auto& e : instructions)
+        {
+            u32 shift = 11 - e.width;
+
+            for(u32 i = 0; i < (1u << shift); i++)
+                out[(e.val << shift) | i] = get(e);
+        }
+
+        return out;
+    }
+
+    extern constexpr std::array<func_t, table_size> funcs = build<func_t>(ops::invalid, [](const instruction& e) { return e.func; });
+
+    extern constexpr std::array<const char*, table_size> names = build<const char*>("invalid", [](const instruction& e) { return e.name; });
+
+    // instructions that may leave straight line code, a block of threaded code ends at any of these
+    static constexpr func_t terminators[] = {
+        ops::stop, ops::stopd,
+        ops::br, ops::bra, ops::brsl, ops::brasl,
+        ops::brz, ops::brnz, ops::brhz, ops::brhnz,
+        ops::bi, ops::bisl, ops::bisled, ops::iret,
+        ops::biz, ops::binz, ops::bihz, ops::bihnz,
+        ops::heq, ops::heqi, ops::hgt, ops::hgti, ops::hlgt, ops::hlgti
+    };
+
+    static constexpr bool is_terminator(func_t func)
+    {
+        for(auto term : terminators)
+            if(term == func)
+                return true;
+
+        return false;
+    }
+
+    // unknown instructions stop the thread so they end blocks as well
+    extern constexpr std::array<bool, table_size> ends_block = build<bool>(true, [](const instruction& e) { return is_terminator(e.func); });
+
+    // if the table isnt built at compile time this will fail to compile
+    static_assert(funcs[decode(0x40200000)] == ops::nop);
+    static_assert(ends_block[decode(0x32000000)] && !ends_block[decode(0x40200000)]);
+}
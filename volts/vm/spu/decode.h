@@ -0,0 +1,122 @@
+#pragma once
+
+#include <types.h>
+
+#include "ppu/decode.h"
+
+#include <array>
+
+namespace volts::spu
+{
+    struct thread;
+
+    using ppu::field;
+
+    /**
+     * @brief an spu instruction, every format shares the register fields
+     *
+     */
+    union form
+    {
+        svl::u32 raw;
+
+        field<25, 7> rt;
+        field<18, 7> ra;
+        field<11, 7> rb;
+
+        /// rrr form registers
+        field<25, 7> rc;
+        field<4, 7> rt4;
+
+        /// channel number
+        field<18, 7> ca;
+
+        field<11, 7> i7;
+        field<11, 7, svl::i32> si7;
+        field<10, 8> i8;
+        field<8, 10> i10;
+        field<8, 10, svl::i32> si10;
+        field<9, 16> i16;
+        field<9, 16, svl::i32> si16;
+        field<7, 18> i18;
+
+        /// signal of stop and signal
+        field<18, 14> code;
+    };
+
+    static_assert(sizeof(form) == sizeof(svl::u32));
+
+    using func_t = void(*)(thread&, form);
+
+    /// opcodes are at most 11 bits wide so the table covers every instruction
+    constexpr svl::u32 table_size = 0x800;
+
+    /// interpreter functions indexed by decode(op), built at compile time
+    extern const std::array<func_t, table_size> funcs;
+
+    /// mnemonics indexed by decode(op)
+    extern const std::array<const char*, table_size> names;
+
+    /// true for instructions that branch, stop or halt, indexed by decode(op)
+    extern const std::array<bool, table_size> ends_block;
+
+    /// the interpreter functions code analysis and the recompiler look for, compare them against funcs[decode(op)]
+    namespace ops
+    {
+        void br(thread& spu, form op);
+        void bra(thread& spu, form op);
+        void brsl(thread& spu, form op);
+        void brasl(thread& spu, form op);
+        void brz(thread& spu, form op);
+        void brnz(thread& spu, form op);
+        void brhz(thread& spu, form op);
+        void brhnz(thread& spu, form op);
+        void bisl(thread& spu, form op);
+        void bi(thread& spu, form op);
+        void iret(thread& spu, form op);
+        void stop(thread& spu, form op);
+        void stopd(thread& spu, form op);
+        void invalid(thread& spu, form op);
+
+        void lqd(thread& spu, form op);
+        void lqx(thread& spu, form op);
+        void lqa(thread& spu, form op);
+        void lqr(thread& spu, form op);
+        void stqd(thread& spu, form op);
+        void stqx(thread& spu, form op);
+        void stqa(thread& spu, form op);
+        void stqr(thread& spu, form op);
+
+        void shufb(thread& spu, form op);
+
+        void rdch(thread& spu, form op);
+        void rchcnt(thread& spu, form op);
+        void wrch(thread& spu, form op);
+
+        // the recompiler emits these inline
+        void nop(thread& spu, form op);
+        void a(thread& spu, form op);
+        void ai(thread& spu, form op);
+        void sf(thread& spu, form op);
+        void sfi(thread& spu, form op);
+        void _and(thread& spu, form op);
+        void andi(thread& spu, form op);
+        void andc(thread& spu, form op);
+        void _or(thread& spu, form op);
+        void ori(thread& spu, form op);
+        void _xor(thread& spu, form op);
+        void xori(thread& spu, form op);
+        void il(thread& spu, form op);
+    }
+
+    /**
+     * @brief get the table index of an instruction
+     *
+     * @param op the instruction
+     * @return svl::u32 the index into funcs and names
+     */
+    constexpr svl::u32 decode(svl::u32 op)
+    {
+        return op >> 21;
+    }
+}
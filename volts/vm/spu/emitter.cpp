@@ -0,0 +1,467 @@
+#include "emitter.h"
+
+#include <platform.h>
+#include <endian.h>
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <cstring>
+
+#if SYS_WINDOWS
+#   include <Windows.h>
+#else
+#   include <sys/mman.h>
+#endif
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    // x86-64 register numbers
+    namespace reg
+    {
+        constexpr u8 rax = 0;
+        constexpr u8 rcx = 1;
+        constexpr u8 rdx = 2;
+        constexpr u8 rbx = 3;
+        constexpr u8 rsi = 6;
+        constexpr u8 rdi = 7;
+        constexpr u8 r8 = 8;
+        constexpr u8 r9 = 9;
+        constexpr u8 r12 = 12;
+        constexpr u8 r13 = 13;
+        constexpr u8 r14 = 14;
+        constexpr u8 r15 = 15;
+    }
+
+    // the block keeps the thread in rbx, the registers in r12, the pc pointer in r13,
+    // the function table in r14 and the address of the current instruction in r15d.
+    // all of them are callee saved on both abis so they survive calls into the interpreter
+#if SYS_WINDOWS
+    constexpr u8 args[] = { reg::rcx, reg::rdx, reg::r8, reg::r9 };
+#else
+    constexpr u8 args[] = { reg::rdi, reg::rsi, reg::rdx, reg::rcx };
+#endif
+
+    /// backwards branches taken before a block returns so the run loop can see stops and preemption
+    constexpr u32 loop_budget = 0x400;
+
+    /// the budget lives above the 32 bytes of windows shadow space
+    constexpr u8 budget_slot = 0x20;
+    constexpr u8 frame_size = 0x30;
+
+    /// sse ops between xmm0 and xmm1, the result is left in xmm0
+    namespace sse
+    {
+        constexpr u8 paddd = 0xFE;
+        constexpr u8 psubd = 0xFA;
+        constexpr u8 pand = 0xDB;
+        constexpr u8 pandn = 0xDF;
+        constexpr u8 por = 0xEB;
+        constexpr u8 pxor = 0xEF;
+    }
+
+    enum class inline_form
+    {
+        /// not emitted inline, the interpreter function is called
+        none,
+
+        /// emits nothing
+        skip,
+
+        /// rt = ra op rb
+        rr,
+
+        /// rt = rb op ra
+        rr_swapped,
+
+        /// rt = ra op si10
+        ri10,
+
+        /// rt = si10 op ra
+        ri10_swapped,
+
+        /// rt = si16
+        load_imm
+    };
+
+    struct inline_op
+    {
+        func_t func;
+        inline_form form;
+        u8 sse;
+    };
+
+    static const inline_op inline_ops[] = {
+        { ops::nop, inline_form::skip, 0 },
+        { ops::a, inline_form::rr, sse::paddd },
+        { ops::ai, inline_form::ri10, sse::paddd },
+        { ops::sf, inline_form::rr_swapped, sse::psubd },
+        { ops::sfi, inline_form::ri10_swapped, sse::psubd },
+        { ops::_and, inline_form::rr, sse::pand },
+        { ops::andi, inline_form::ri10, sse::pand },
+        // pandn inverts its destination, so rb goes in xmm0 for ra & ~rb
+        { ops::andc, inline_form::rr_swapped, sse::pandn },
+        { ops::_or, inline_form::rr, sse::por },
+        { ops::ori, inline_form::ri10, sse::por },
+        { ops::_xor, inline_form::rr, sse::pxor },
+        { ops::xori, inline_form::ri10, sse::pxor },
+        { ops::il, inline_form::load_imm, 0 }
+    };
+
+    static const inline_op* find_inline(u32 op)
+    {
+        func_t func = funcs[decode(op)];
+
+        for(const auto& e : inline_ops)
+            if(e.func == func)
+                return &e;
+
+        return nullptr;
+    }
+
+    // relative branches that stay in the block are jumped to without leaving the host code,
+    // absolute branches and calls always return to the run loop
+    static bool local_branch(u32 op, u32 at, u32 count, u32& target)
+    {
+        func_t func = funcs[decode(op)];
+
+        if(func != ops::br && func != ops::brz && func != ops::brnz && func != ops::brhz && func != ops::brhnz)
+            return false;
+
+        i64 to = i64(at) + form{ op }.si16;
+        if(to < 0 || to >= count)
+            return false;
+
+        target = static_cast<u32>(to);
+        return true;
+    }
+
+    struct assembler
+    {
+        std::vector<u8> out;
+
+        void byte(u8 val) { out.push_back(val); }
+
+        void bytes(std::initializer_list<u8> vals) { out.insert(out.end(), vals); }
+
+        void dword(u32 val)
+        {
+            for(u32 i = 0; i < 4; i++)
+                byte(static_cast<u8>(val >> (i * 8)));
+        }
+
+        void patch(std::size_t at, u32 val)
+        {
+            for(u32 i = 0; i < 4; i++)
+                out[at + i] = static_cast<u8>(val >> (i * 8));
+        }
+
+        // emit the opcode of a jump with a 32 bit displacement and return where the displacement goes
+        std::size_t jump(std::initializer_list<u8> opcode)
+        {
+            bytes(opcode);
+            auto at = out.size();
+            dword(0);
+            return at;
+        }
+
+        // point a displacement at a position in the code
+        void link(std::size_t at, std::size_t to)
+        {
+            patch(at, static_cast<u32>(to - (at + 4)));
+        }
+
+        void push(u8 r)
+        {
+            if(r >= 8)
+                byte(0x41);
+
+            byte(0x50 | (r & 7));
+        }
+
+        void pop(u8 r)
+        {
+            if(r >= 8)
+                byte(0x41);
+
+            byte(0x58 | (r & 7));
+        }
+
+        // mov dst, src with 64 bit registers
+        void mov(u8 dst, u8 src)
+        {
+            byte(0x48 | ((src >> 3) << 2) | (dst >> 3));
+            byte(0x89);
+            byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+        }
+
+        // mov dst, imm32 with a 32 bit register
+        void mov_imm(u8 dst, u32 imm)
+        {
+            if(dst >= 8)
+                byte(0x41);
+
+            byte(0xB8 | (dst & 7));
+            dword(imm);
+        }
+
+        // op [r13], r15d, r13 as a base always needs a displacement
+        void pc_op(u8 opcode)
+        {
+            bytes({ 0x45, opcode, 0x7D, 0x00 });
+        }
+
+        // movdqu between xmm0 or xmm1 and a guest register at [r12 + idx * 16]
+        void gpr(u8 opcode, u8 xmm, u32 idx)
+        {
+            // r12 as a base needs a sib byte
+            bytes({ 0xF3, 0x41, 0x0F, opcode, static_cast<u8>(0x84 | (xmm << 3)), 0x24 });
+            dword(idx * sizeof(v128));
+        }
+
+        void load(u8 xmm, u32 idx) { gpr(0x6F, xmm, idx); }
+        void store(u8 xmm, u32 idx) { gpr(0x7F, xmm, idx); }
+
+        // fill every lane of xmm0 or xmm1 with an immediate through eax
+        void broadcast(u8 xmm, u32 imm)
+        {
+            mov_imm(reg::rax, imm);
+            bytes({ 0x66, 0x0F, 0x6E, static_cast<u8>(0xC0 | (xmm << 3)) });
+            bytes({ 0x66, 0x0F, 0x70, static_cast<u8>(0xC0 | (xmm << 3) | xmm), 0x00 });
+        }
+
+        // op xmm0, xmm1
+        void sse(u8 opcode)
+        {
+            bytes({ 0x66, 0x0F, opcode, 0xC1 });
+        }
+    };
+
+    static void emit_inline(assembler& as, const inline_op& e, form op)
+    {
+        switch(e.form)
+        {
+        case inline_form::skip:
+            return;
+        case inline_form::rr:
+            as.load(0, op.ra);
+            as.load(1, op.rb);
+            break;
+        case inline_form::rr_swapped:
+            as.load(0, op.rb);
+            as.load(1, op.ra);
+            break;
+        case inline_form::ri10:
+            as.load(0, op.ra);
+            as.broadcast(1, static_cast<u32>(op.si10));
+            break;
+        case inline_form::ri10_swapped:
+            as.broadcast(0, static_cast<u32>(op.si10));
+            as.load(1, op.ra);
+            break;
+        case inline_form::load_imm:
+            as.broadcast(0, static_cast<u32>(op.si16));
+            as.store(0, op.rt);
+            return;
+        default:
+            return;
+        }
+
+        as.sse(e.sse);
+        as.store(0, op.rt);
+    }
+
+    std::vector<u8> emit(const u32* code, u32 count)
+    {
+        assembler as;
+
+        // the base address is needed after the arguments are moved, windows passes it on the stack
+#if SYS_WINDOWS
+        as.bytes({ 0x8B, 0x44, 0x24, 0x28 });
+#else
+        as.bytes({ 0x44, 0x89, 0xC0 });
+#endif
+
+        // five pushes realign the stack to 16 bytes, the frame holds the shadow space and the loop budget
+        for(u8 r : { reg::rbx, reg::r12, reg::r13, reg::r14, reg::r15 })
+            as.push(r);
+
+        as.bytes({ 0x48, 0x83, 0xEC, frame_size });
+        as.bytes({ 0xC7, 0x44, 0x24, budget_slot });
+        as.dword(loop_budget);
+
+        as.mov(reg::rbx, args[0]);
+        as.mov(reg::r12, args[1]);
+        as.mov(reg::r13, args[2]);
+        as.mov(reg::r14, args[3]);
+
+        // mov r15d, [r13]
+        as.pc_op(0x8B);
+
+        // the table has a 4 byte entry per instruction so the byte offset of pc from the base indexes it.
+        // mov ecx, r15d; sub ecx, eax; lea rax, [rip + table]; movsxd rcx, [rax + rcx]; add rax, rcx; jmp rax
+        as.bytes({ 0x44, 0x89, 0xF9, 0x29, 0xC1 });
+        auto table_ref = as.jump({ 0x48, 0x8D, 0x05 });
+        as.bytes({ 0x48, 0x63, 0x0C, 0x08, 0x48, 0x01, 0xC8, 0xFF, 0xE0 });
+
+        // where each instruction starts with r15d holding its address
+        std::vector<std::size_t> labels(count);
+
+        // jumps out of the block once an instruction moves pc
+        std::vector<std::size_t> exits;
+
+        // jumps to instructions in the block, and the instruction each goes to
+        std::vector<std::pair<std::size_t, u32>> jumps;
+
+        for(u32 i = 0; i < count; i++)
+        {
+            u32 op = endian::byte_swap(code[i]);
+
+            if(i)
+            {
+                // add r15d, 4
+                as.bytes({ 0x41, 0x83, 0xC7, 0x04 });
+            }
+
+            labels[i] = as.out.size();
+
+            if(const inline_op* e = find_inline(op))
+            {
+                emit_inline(as, *e, { op });
+                continue;
+            }
+
+            // ops read pc for relative branches and links so it has to be stored first
+            as.pc_op(0x89);
+
+            as.mov(args[0], reg::rbx);
+            as.mov_imm(args[1], op);
+
+            // call [r14 + decode(op) * 8]
+            as.bytes({ 0x41, 0xFF, 0x96 });
+            as.dword(decode(op) * sizeof(func_t));
+
+            if(u32 target; local_branch(op, i, count, target))
+            {
+                i32 offset = (static_cast<i32>(target) - static_cast<i32>(i)) * 4;
+
+                // mov eax, [r13]; sub eax, r15d; a branch not taken leaves pc alone and carries on
+                as.bytes({ 0x41, 0x8B, 0x45, 0x00, 0x44, 0x29, 0xF8 });
+                as.bytes({ 0x74, 0x00 });
+                auto not_taken = as.out.size();
+
+                // the branch leaves pc 4 before its target, anything else is a rewind
+                as.byte(0x3D);
+                as.dword(static_cast<u32>(offset - 4));
+                exits.push_back(as.jump({ 0x0F, 0x85 }));
+
+                // sub dword [rsp + budget], 1 on the way back to the top of a loop
+                if(target <= i)
+                {
+                    as.bytes({ 0x83, 0x6C, 0x24, budget_slot, 0x01 });
+                    exits.push_back(as.jump({ 0x0F, 0x84 }));
+                }
+
+                // add r15d, offset
+                as.bytes({ 0x41, 0x81, 0xC7 });
+                as.dword(static_cast<u32>(offset));
+                jumps.push_back({ as.jump({ 0xE9 }), target });
+
+                as.out[not_taken - 1] = static_cast<u8>(as.out.size() - not_taken);
+            }
+            else if(ends_block[decode(op)])
+            {
+                // stops, halts, calls and branches leaving the block go back to the run loop.
+                // pc is either the branch target or this instruction for the run loop to step past
+                exits.push_back(as.jump({ 0xE9 }));
+            }
+            else
+            {
+                // rewound channel accesses leave pc somewhere else
+                as.pc_op(0x39);
+                exits.push_back(as.jump({ 0x0F, 0x85 }));
+            }
+        }
+
+        // falling off the end leaves pc at the last instruction like the interpreter
+        as.pc_op(0x89);
+
+        for(auto at : exits)
+            as.link(at, as.out.size());
+
+        for(auto [at, target] : jumps)
+            as.link(at, labels[target]);
+
+        as.bytes({ 0x48, 0x83, 0xC4, frame_size });
+
+        for(u8 r : { reg::r15, reg::r14, reg::r13, reg::r12, reg::rbx })
+            as.pop(r);
+
+        as.byte(0xC3);
+
+        // entries are relative to the table so the code can be placed anywhere
+        auto table = as.out.size();
+        as.link(table_ref, table);
+
+        for(auto label : labels)
+            as.dword(static_cast<u32>(static_cast<i32>(label) - static_cast<i32>(table)));
+
+        return as.out;
+    }
+
+    /// executable memory is handed out from chunks of this size and never freed
+    constexpr std::size_t chunk_size = 0x100000;
+
+    static std::mutex mut;
+    static u8* chunk = nullptr;
+    static std::size_t used = chunk_size;
+    static u64 total = 0;
+
+    static u8* alloc_exec(std::size_t size)
+    {
+#if SYS_WINDOWS
+        return static_cast<u8*>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return mem == MAP_FAILED ? nullptr : static_cast<u8*>(mem);
+#endif
+    }
+
+    native_t place(const std::vector<u8>& code)
+    {
+        if(code.empty() || code.size() > chunk_size)
+            return nullptr;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(used + code.size() > chunk_size)
+        {
+            chunk = alloc_exec(chunk_size);
+            used = 0;
+
+            if(!chunk)
+            {
+                spdlog::error("failed to allocate executable memory for spu code");
+                used = chunk_size;
+                return nullptr;
+            }
+        }
+
+        u8* at = chunk + used;
+        std::memcpy(at, code.data(), code.size());
+
+        // keep entry points aligned for the branch predictor
+        used += (code.size() + 15) & ~std::size_t(15);
+        total += code.size();
+
+        return reinterpret_cast<native_t>(at);
+    }
+
+    u64 native_size()
+    {
+        std::lock_guard<std::mutex> guard(mut);
+        return total;
+    }
+}
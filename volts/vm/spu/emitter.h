@@ -0,0 +1,59 @@
+#pragma once
+
+#include <types.h>
+
+#include "decode.h"
+
+#include <vector>
+
+namespace volts::spu
+{
+    struct thread;
+
+    /**
+     * @brief host code compiled from a block
+     *
+     * every address the code needs comes in as an argument so the same
+     * bytes can be loaded anywhere, which is what lets them be cached on disk.
+     * execution starts at the instruction pc points to
+     *
+     * @param spu the thread running the block
+     * @param gpr the registers of the thread
+     * @param pc the program counter of the thread
+     * @param table the interpreter functions, indexed by decode(op)
+     * @param base the local store address of the first instruction of the block
+     */
+    using native_t = void(*)(thread* spu, svl::v128* gpr, svl::u32* pc, const func_t* table, svl::u32 base);
+
+    /// bumped whenever the emitted code changes so older cached code is thrown away
+    constexpr svl::u32 emitter_version = 2;
+
+    /**
+     * @brief compile a block to x86-64
+     *
+     * simple integer and logical ops are emitted inline, anything else
+     * calls its interpreter function through the table. relative branches
+     * to instructions in the block jump there directly so a whole function
+     * and its loops can run without returning
+     *
+     * @param code the instructions as they appear in local store
+     * @param count the number of instructions
+     * @return std::vector<svl::u8> the host code
+     */
+    std::vector<svl::u8> emit(const svl::u32* code, svl::u32 count);
+
+    /**
+     * @brief copy host code into executable memory
+     *
+     * @param code the host code
+     * @return native_t the entry point, nullptr if no executable memory was left
+     */
+    native_t place(const std::vector<svl::u8>& code);
+
+    /**
+     * @brief get how much host code has been placed
+     *
+     * @return svl::u64 the size in bytes
+     */
+    svl::u64 native_size();
+}
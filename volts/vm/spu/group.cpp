@@ -0,0 +1,403 @@
+#include "group.h"
+#include "thread.h"
+#include "scheduler.h"
+
+#include "sys/syscall.h"
+#include "sys/object.h"
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// segment types of a guest spu image
+    namespace segment
+    {
+        constexpr i32 copy = 1;
+        constexpr i32 fill = 2;
+        constexpr i32 info = 4;
+    }
+
+    /// images whose segments are in guest memory, kernel images are loaded by lv2 itself
+    constexpr u32 image_user = 0;
+
+    /// every thread in the group stopped by itself
+    constexpr u32 join_all_threads_exit = 2;
+
+    struct guest_segment
+    {
+        big<i32> type;
+        big<u32> ls;
+        big<u32> size;
+
+        /// the guest address of copy segments, the word to fill with for fill segments
+        big<u32> addr;
+    };
+
+    struct guest_image
+    {
+        big<u32> type;
+        big<u32> entry;
+        big<u32> segs;
+        big<i32> nsegs;
+    };
+
+    struct guest_thread_args
+    {
+        big<u64> args[4];
+    };
+
+    enum class group_state
+    {
+        /// waiting for every thread to be initialized
+        initialized,
+
+        /// every thread is initialized
+        ready,
+
+        running,
+    };
+
+    struct lv2_spu_thread
+    {
+        thread spu;
+
+        /// the pc and registers the thread starts with, restored every time its group starts
+        u32 entry;
+        u64 args[4];
+    };
+
+    struct lv2_spu_group
+    {
+        std::mutex mut;
+
+        i32 prio;
+        group_state state = group_state::initialized;
+
+        /// the id of each thread by its spu number, 0 until its initialized
+        std::vector<u32> threads;
+
+        /// the scheduler group, created the first time the group starts
+        u32 sched = 0;
+    };
+
+    static vm::object_table<lv2_spu_thread> spu_threads(0x02000000);
+    static vm::object_table<lv2_spu_group> groups(0x04000100);
+
+    static u32 sys_spu_thread_group_create(vm::ptr<big<u32>> id, u32 num, i32 prio, vm::ptr<u8> attr)
+    {
+        if(!id || !attr)
+            return vm::efault;
+
+        // lv2 runs every thread of a group at once so it cant have more than there are spus
+        if(!num || num > physical_spus)
+            return vm::einval;
+
+        auto group = std::make_unique<lv2_spu_group>();
+        group->prio = prio;
+        group->threads.resize(num);
+
+        u32 out = groups.add(std::move(group));
+        if(!out)
+            return vm::eagain;
+
+        *id = endian::byte_swap(out);
+        return 0;
+    }
+
+    static u32 sys_spu_thread_group_destroy(u32 id)
+    {
+        {
+            auto group = groups.get(id);
+            if(!group)
+                return vm::esrch;
+
+            std::lock_guard<std::mutex> guard(group->mut);
+
+            if(group->state == group_state::running)
+                return vm::ebusy;
+        }
+
+        auto group = groups.remove(id);
+        if(!group)
+            return vm::esrch;
+
+        if(group->sched)
+            destroy_group(group->sched);
+
+        for(u32 thread : group->threads)
+            if(thread)
+                spu_threads.remove(thread);
+
+        return 0;
+    }
+
+    // copy the segments of an image into local store, returns false if any are out of bounds
+    static bool load_segments(thread& spu, const guest_image& image)
+    {
+        auto segs = vm::ptr<guest_segment>(image.segs.get());
+
+        for(i32 i = 0; i < image.nsegs; i++)
+        {
+            const auto& seg = segs.get()[i];
+            u64 end = u64(seg.ls.get()) + seg.size.get();
+
+            if(seg.type == segment::info)
+                continue;
+
+            if(end > ls_size)
+            {
+                spdlog::error("spu image segment at {:x} of {} bytes doesnt fit in local store", seg.ls.get(), seg.size.get());
+                return false;
+            }
+
+            u8* dst = spu.ls.get() + seg.ls;
+
+            switch(seg.type)
+            {
+            case segment::copy:
+                std::memcpy(dst, vm::base(seg.addr), seg.size);
+                break;
+            case segment::fill:
+            {
+                // the fill word is stored as the guest wrote it
+                u32 word = seg.addr.val;
+                for(u32 at = 0; at + sizeof(u32) <= seg.size; at += sizeof(u32))
+                    std::memcpy(dst + at, &word, sizeof(u32));
+                break;
+            }
+            default:
+                spdlog::warn("skipping spu image segment of type {}", seg.type.get());
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    // the pc and arguments a thread starts with, set every time its group starts
+    static void reset(lv2_spu_thread& t)
+    {
+        std::memset(t.spu.gpr, 0, sizeof(t.spu.gpr));
+
+        // registers hold their bytes reversed so the preferred doubleword is the second
+        for(u32 i = 0; i < 4; i++)
+            t.spu.gpr[3 + i].dwords[1] = t.args[i];
+
+        t.spu.pc = t.entry;
+        t.spu.stopped = false;
+        t.spu.stop_code = 0;
+        t.spu.has_event_result = false;
+    }
+
+    static u32 sys_spu_thread_initialize(vm::ptr<big<u32>> id, u32 group_id, u32 spu_num, vm::ptr<guest_image> image, vm::ptr<u8> attr, vm::ptr<guest_thread_args> args)
+    {
+        if(!id || !image || !attr || !args)
+            return vm::efault;
+
+        auto group = groups.get(group_id);
+        if(!group)
+            return vm::esrch;
+
+        if(image->type != image_user)
+        {
+            spdlog::error("spu images of type {} arent supported", image->type.get());
+            return vm::einval;
+        }
+
+        std::lock_guard<std::mutex> guard(group->mut);
+
+        if(spu_num >= group->threads.size())
+            return vm::einval;
+
+        if(group->state != group_state::initialized || group->threads[spu_num])
+            return vm::ebusy;
+
+        auto t = std::make_unique<lv2_spu_thread>();
+
+        if(!load_segments(t->spu, *image))
+            return vm::einval;
+
+        t->entry = image->entry & ls_mask & ~3;
+        for(u32 i = 0; i < 4; i++)
+            t->args[i] = args->args[i];
+
+        u32 out = spu_threads.add(std::move(t));
+        if(!out)
+            return vm::eagain;
+
+        group->threads[spu_num] = out;
+
+        if(std::all_of(group->threads.begin(), group->threads.end(), [](u32 t) { return t != 0; }))
+            group->state = group_state::ready;
+
+        *id = endian::byte_swap(out);
+        return 0;
+    }
+
+    static u32 sys_spu_thread_group_start(u32 id)
+    {
+        auto group = groups.get(id);
+        if(!group)
+            return vm::esrch;
+
+        std::lock_guard<std::mutex> guard(group->mut);
+
+        if(group->state != group_state::ready)
+            return vm::estat;
+
+        if(!group->sched)
+        {
+            // the threads belong to the group so they outlive the scheduler group
+            std::vector<thread*> threads;
+            for(u32 t : group->threads)
+                threads.push_back(&spu_threads.get(t)->spu);
+
+            group->sched = create_group(threads);
+        }
+
+        for(u32 t : group->threads)
+            reset(*spu_threads.get(t));
+
+        group->state = group_state::running;
+        start_group(group->sched);
+
+        return 0;
+    }
+
+    static u32 sys_spu_thread_group_join(u32 id, vm::ptr<big<u32>> cause, vm::ptr<big<u32>> status)
+    {
+        auto group = groups.get(id);
+        if(!group)
+            return vm::esrch;
+
+        u32 sched;
+
+        {
+            std::lock_guard<std::mutex> guard(group->mut);
+
+            if(group->state != group_state::running)
+                return vm::estat;
+
+            sched = group->sched;
+        }
+
+        // the ppu thread blocks here rather than holding the group lock
+        join_group(sched);
+
+        {
+            std::lock_guard<std::mutex> guard(group->mut);
+            group->state = group_state::ready;
+        }
+
+        if(cause)
+            *cause = endian::byte_swap(join_all_threads_exit);
+
+        if(status)
+            *status = 0;
+
+        return 0;
+    }
+
+    // local store accesses are 1, 2, 4 or 8 bytes and aligned to their size
+    static bool valid_access(u32 lsa, u32 type)
+    {
+        if(type != 1 && type != 2 && type != 4 && type != 8)
+            return false;
+
+        return lsa < ls_size && lsa % type == 0;
+    }
+
+    static u32 sys_spu_thread_write_ls(u32 id, u32 lsa, u64 value, u32 type)
+    {
+        auto t = spu_threads.get(id);
+        if(!t)
+            return vm::esrch;
+
+        if(!valid_access(lsa, type))
+            return vm::einval;
+
+        // local store is big endian like the rest of the guest
+        u8* dst = t->spu.ls.get() + lsa;
+        switch(type)
+        {
+        case 1: *dst = static_cast<u8>(value); break;
+        case 2: { u16 v = endian::byte_swap(static_cast<u16>(value)); std::memcpy(dst, &v, 2); break; }
+        case 4: { u32 v = endian::byte_swap(static_cast<u32>(value)); std::memcpy(dst, &v, 4); break; }
+        default: { u64 v = endian::byte_swap(value); std::memcpy(dst, &v, 8); break; }
+        }
+
+        return 0;
+    }
+
+    static u32 sys_spu_thread_read_ls(u32 id, u32 lsa, vm::ptr<big<u64>> value, u32 type)
+    {
+        if(!value)
+            return vm::efault;
+
+        auto t = spu_threads.get(id);
+        if(!t)
+            return vm::esrch;
+
+        if(!valid_access(lsa, type))
+            return vm::einval;
+
+        const u8* src = t->spu.ls.get() + lsa;
+        u64 out;
+
+        switch(type)
+        {
+        case 1: out = *src; break;
+        case 2: { u16 v; std::memcpy(&v, src, 2); out = endian::byte_swap(v); break; }
+        case 4: { u32 v; std::memcpy(&v, src, 4); out = endian::byte_swap(v); break; }
+        default: { u64 v; std::memcpy(&v, src, 8); out = endian::byte_swap(v); break; }
+        }
+
+        *value = endian::byte_swap(out);
+        return 0;
+    }
+
+    static u32 sys_spu_thread_write_snr(u32 id, u32 number, u32 value)
+    {
+        auto t = spu_threads.get(id);
+        if(!t)
+            return vm::esrch;
+
+        if(number > 1)
+            return vm::einval;
+
+        t->spu.write_signal(number, value);
+        return 0;
+    }
+
+    static u32 sys_spu_thread_write_spu_mb(u32 id, u32 value)
+    {
+        auto t = spu_threads.get(id);
+        if(!t)
+            return vm::esrch;
+
+        t->spu.write_in_mbox(value);
+        return 0;
+    }
+
+    void init_groups()
+    {
+        vm::bind_syscall<sys_spu_thread_group_create>(170);
+        vm::bind_syscall<sys_spu_thread_group_destroy>(171);
+        vm::bind_syscall<sys_spu_thread_initialize>(172);
+        vm::bind_syscall<sys_spu_thread_group_start>(173);
+        vm::bind_syscall<sys_spu_thread_group_join>(178);
+        vm::bind_syscall<sys_spu_thread_write_ls>(181);
+        vm::bind_syscall<sys_spu_thread_read_ls>(182);
+        vm::bind_syscall<sys_spu_thread_write_snr>(184);
+        vm::bind_syscall<sys_spu_thread_write_spu_mb>(190);
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::spu
+{
+    /**
+     * @brief bind the spu thread group syscalls
+     *
+     * groups run on the spu scheduler so they share the six spus
+     * with every other group and follow --spu-cores
+     */
+    void init_groups();
+}
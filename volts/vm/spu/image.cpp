@@ -0,0 +1,241 @@
+#include "image.h"
+#include "thread.h"
+#include "recompiler.h"
+#include "analyzer.h"
+
+#include <convert.h>
+#include <endian.h>
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <algorithm>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    namespace cvt = svl::convert;
+
+    /// loadable segment
+    constexpr u32 pt_load = 1;
+
+    /// executable segment flag
+    constexpr u32 pf_x = 1;
+
+    svl::expected<u32> load_image(thread& spu, elf::spu_exec& exec)
+    {
+        for(auto prog : exec.progs)
+        {
+            if(prog.type != pt_load || !prog.mem_size)
+                continue;
+
+            // widened so a segment near the top of the address space cant wrap back into local store
+            if(prog.vaddress >= ls_size || u64(prog.vaddress) + prog.mem_size > ls_size || prog.file_size > prog.mem_size)
+            {
+                spdlog::error("spu segment at {:x} of {} bytes doesnt fit in local store", prog.vaddress, prog.mem_size);
+                return svl::none();
+            }
+
+            // file reads dont report short reads so make sure the data is all there first
+            if(u64(prog.offset) + prog.file_size > exec.data.size())
+            {
+                spdlog::error("spu segment at {:x} needs {} bytes past the end of the executable", prog.vaddress, prog.file_size);
+                return svl::none();
+            }
+
+            exec.data.seek(prog.offset);
+            auto dat = exec.data.read<u8>(prog.file_size);
+
+            std::memcpy(spu.ls.get() + prog.vaddress, dat.data(), prog.file_size);
+            std::memset(spu.ls.get() + prog.vaddress + prog.file_size, 0, prog.mem_size - prog.file_size);
+        }
+
+        spu.pc = exec.head.entry & ls_mask & ~3;
+        return spu.pc;
+    }
+
+    static bool is_spu_image(const elf::header<u32>& head)
+    {
+        // 32 bit, big endian, spu executable
+        return head.magic == cvt::to_u32("\177ELF")
+            && head.cls == 1
+            && head.endian == 2
+            && head.machine_type == elf::machine::spu
+            && head.elf_type == elf::type::exec;
+    }
+
+    u64 image_size(const u8* data, u64 avail)
+    {
+        using program_t = elf::spu_exec::program_t;
+
+        if(avail < sizeof(elf::header<u32>))
+            return 0;
+
+        elf::header<u32> head;
+        std::memcpy(&head, data, sizeof(head));
+
+        if(!is_spu_image(head))
+            return 0;
+
+        // the image ends with whichever of its headers or segments is furthest in
+        u64 end = u64(head.prog_offset) + u64(head.prog_count) * sizeof(program_t);
+        if(end > avail)
+            return 0;
+
+        for(u32 i = 0; i < head.prog_count; i++)
+        {
+            program_t prog;
+            std::memcpy(&prog, data + head.prog_offset + i * sizeof(program_t), sizeof(prog));
+            end = std::max<u64>(end, u64(prog.offset) + prog.file_size);
+        }
+
+        if(end > avail)
+            return 0;
+
+        // section headers are often stripped, only keep them if theyre inside the image
+        u64 sects = u64(head.sect_offset) + u64(head.sect_count) * sizeof(elf::spu_exec::section_t);
+        if(sects <= avail)
+            end = std::max(end, sects);
+
+        return end;
+    }
+
+    std::vector<elf::spu_exec> find_images(const std::vector<u8>& data)
+    {
+        std::vector<elf::spu_exec> out;
+
+        // images are aligned in their segments, 4 bytes is the least anything uses
+        for(u64 off = 0; off + sizeof(elf::header<u32>) <= data.size(); off += 4)
+        {
+            if(std::memcmp(data.data() + off, "\177ELF", 4) != 0)
+                continue;
+
+            u64 end = image_size(data.data() + off, data.size() - off);
+            if(!end)
+                continue;
+
+            auto file = svl::from(std::vector<u8>(data.begin() + off, data.begin() + off + end));
+            if(auto exec = elf::load<elf::spu_exec>(file))
+                out.push_back(exec.value());
+
+            off += (end - 4) & ~3ull;
+        }
+
+        return out;
+    }
+
+    // the address after the last reachable instruction of a function, constants
+    // and jump tables after its code are never run so they arent compiled
+    static u32 function_end(const thread& spu, const function& func)
+    {
+        u32 end = func.start;
+
+        for(u32 addr : func.blocks)
+        {
+            u32 at = addr;
+            while(at + 4 < func.end)
+            {
+                u32 op;
+                std::memcpy(&op, spu.ls.get() + at, sizeof(u32));
+
+                if(ends_block[decode(endian::byte_swap(op))])
+                    break;
+
+                at += 4;
+            }
+
+            end = std::max(end, at + 4);
+        }
+
+        return end;
+    }
+
+    // compile every function the analyzer finds in the executable segments as one block each
+    static u32 compile_image(thread& spu, elf::spu_exec& exec, u32 entry)
+    {
+        u32 count = 0;
+
+        for(auto prog : exec.progs)
+        {
+            if(prog.type != pt_load || !(prog.flags & pf_x))
+                continue;
+
+            // only code reachable from a function is compiled, anything else is
+            // either data or reached through a jump table and compiled when its run
+            auto info = analyze(spu.ls.get(), prog.vaddress, prog.vaddress + prog.file_size, entry);
+
+            for(auto& func : info.functions)
+            {
+                if(compile_function(spu, func.start, function_end(spu, func)))
+                    count++;
+            }
+        }
+
+        return count;
+    }
+
+    u32 precompile(elf::ppu_exec& exec)
+    {
+        exec.data.seek(0);
+        auto images = find_images(exec.data.read<u8>(exec.data.size()));
+
+        u32 functions = 0;
+
+        for(auto& image : images)
+        {
+            thread spu;
+
+            if(auto entry = load_image(spu, image))
+                functions += compile_image(spu, image, entry.value());
+        }
+
+        spdlog::info("precompiled {} functions from {} spu images", functions, images.size());
+
+        return static_cast<u32>(images.size());
+    }
+
+    u32 report(const std::vector<u8>& data)
+    {
+        auto images = find_images(data);
+
+        for(std::size_t i = 0; i < images.size(); i++)
+        {
+            thread spu;
+
+            auto entry = load_image(spu, images[i]);
+            if(!entry)
+                continue;
+
+            spdlog::info("spu image {} entry {:05x}", i, entry.value());
+
+            for(auto prog : images[i].progs)
+            {
+                if(prog.type != pt_load || !(prog.flags & pf_x))
+                    continue;
+
+                auto info = analyze(spu.ls.get(), prog.vaddress, prog.vaddress + prog.file_size, entry.value());
+
+                spdlog::info("  segment {:05x}: {} instructions, {} blocks, {} functions, {} loops",
+                    prog.vaddress, info.instructions, info.blocks.size(), info.functions.size(), info.loops.size()
+                );
+
+                for(auto& func : info.functions)
+                    spdlog::info("  function {:05x}-{:05x}: {} blocks{}", func.start, func.end, func.blocks.size(), func.leaf ? ", leaf" : "");
+
+                for(auto& l : info.loops)
+                    spdlog::info("  loop {:05x}-{:05x}: {}", l.head, l.tail, loop_name(l.kind));
+
+                for(auto [ch, count] : info.channel_reads)
+                    spdlog::info("  channel {} read {} times", ch, count);
+
+                for(auto [ch, count] : info.channel_writes)
+                    spdlog::info("  channel {} written {} times", ch, count);
+            }
+        }
+
+        spdlog::info("found {} spu images", images.size());
+
+        return static_cast<u32>(images.size());
+    }
+}
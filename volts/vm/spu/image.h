@@ -0,0 +1,60 @@
+#pragma once
+
+#include <types.h>
+#include <expected.h>
+
+#include "elf.h"
+
+#include <vector>
+
+namespace volts::spu
+{
+    struct thread;
+
+    /**
+     * @brief copy the loadable segments of an spu executable into local store
+     *
+     * @param spu the thread to load into
+     * @param exec the executable to load
+     * @return svl::expected<svl::u32> the entry point, empty if the image doesnt fit in local store
+     */
+    svl::expected<svl::u32> load_image(thread& spu, elf::spu_exec& exec);
+
+    /**
+     * @brief get the size of an spu executable from its headers
+     *
+     * @param data the start of the executable
+     * @param avail the number of bytes that can be read from data
+     * @return svl::u64 the size of the executable, 0 if it isnt an spu executable or doesnt fit in avail
+     */
+    svl::u64 image_size(const svl::u8* data, svl::u64 avail);
+
+    /**
+     * @brief find spu executables embedded in another file
+     *
+     * ppu executables carry their spu programs as complete elf images in their data segments
+     *
+     * @param data the contents of the file to search
+     * @return std::vector<elf::spu_exec> every spu executable found
+     */
+    std::vector<elf::spu_exec> find_images(const std::vector<svl::u8>& data);
+
+    /**
+     * @brief compile every function of the spu programs embedded in a ppu executable
+     *
+     * each function goes into the recompiler cache as one block so spus dont have to
+     * compile them while the game is running, and loops inside them stay in host code
+     *
+     * @param exec the ppu executable
+     * @return svl::u32 the number of spu images found
+     */
+    svl::u32 precompile(elf::ppu_exec& exec);
+
+    /**
+     * @brief log the functions, loops and channel use of every spu program in a file
+     *
+     * @param data the contents of an spu executable or a ppu executable carrying spu programs
+     * @return svl::u32 the number of spu images found
+     */
+    svl::u32 report(const std::vector<svl::u8>& data);
+}
@@ -0,0 +1,295 @@
+#include "mfc.h"
+#include "thread.h"
+#include "reservation.h"
+
+#include "vm.h"
+
+#include <endian.h>
+#include <futex.h>
+
+#include <spdlog/spdlog.h>
+
+#include <smmintrin.h>
+#include <algorithm>
+#include <cstring>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    mfc::mfc(u8* ls)
+        : ls(ls)
+    {
+        worker = std::thread([this] { work(); });
+    }
+
+    mfc::~mfc()
+    {
+        running = false;
+        bell++;
+        futex::wake_one(bell);
+
+        // release any list stalled waiting on the spu
+        acks = ~0u;
+        futex::wake_one(acks);
+
+        worker.join();
+    }
+
+    void mfc::push(const mfc_command& cmd)
+    {
+        u32 t = tail.load(std::memory_order_relaxed);
+
+        // the queue is full, wait for the worker to take something
+        for(u32 h = head.load(); t - h >= mfc_queue_size; h = head.load())
+            futex::wait(head, h);
+
+        queue[t % mfc_queue_size] = cmd;
+        pending[cmd.tag]++;
+        tail.store(t + 1);
+
+        // the worker only sleeps once the queue is empty, otherwise it will see this command
+        if(head.load() == t)
+        {
+            bell++;
+            futex::wake_one(bell);
+        }
+    }
+
+    u32 mfc::space() const
+    {
+        return mfc_queue_size - (tail.load() - head.load());
+    }
+
+    u32 mfc::tag_status(u32 mask) const
+    {
+        u32 out = 0;
+
+        for(u32 i = 0; i < 32; i++)
+            if((mask & (1u << i)) && pending[i].load(std::memory_order_acquire) == 0)
+                out |= (1u << i);
+
+        return out;
+    }
+
+    bool mfc::tags_ready(u32 mask, tag_update mode) const
+    {
+        u32 done = tag_status(mask);
+
+        switch(mode)
+        {
+        case tag_update::any:
+            return done != 0 || mask == 0;
+        case tag_update::all:
+            return done == mask;
+        default:
+            return true;
+        }
+    }
+
+    u32 mfc::wait_tags(u32 mask, tag_update mode)
+    {
+        while(true)
+        {
+            // read the counter first so a completion between the check and the wait isnt missed
+            u32 gen = completions.load();
+
+            if(tags_ready(mask, mode))
+                return tag_status(mask);
+
+            futex::wait(completions, gen);
+        }
+    }
+
+    u32 mfc::wait_stall()
+    {
+        while(true)
+        {
+            if(u32 s = stalled.load(); s != 0)
+            {
+                stalled &= ~s;
+                return s;
+            }
+
+            futex::wait(stalled, 0);
+        }
+    }
+
+    u32 mfc::stall_status() const
+    {
+        return stalled.load();
+    }
+
+    void mfc::ack_stall(u32 tag)
+    {
+        acks |= (1u << tag);
+        futex::wake_one(acks);
+    }
+
+    void mfc::work()
+    {
+        while(true)
+        {
+            u32 ring = bell.load();
+            u32 h = head.load(std::memory_order_relaxed);
+            u32 t = tail.load();
+
+            if(h == t)
+            {
+                if(!running)
+                    return;
+
+                futex::wait(bell, ring);
+                continue;
+            }
+
+            // run everything thats queued before waking anyone so a burst of commands costs one wakeup
+            for(; h != t; h++)
+            {
+                const auto& cmd = queue[h % mfc_queue_size];
+                execute(cmd);
+
+                pending[cmd.tag].fetch_sub(1, std::memory_order_release);
+                head.store(h + 1);
+            }
+
+            futex::wake_one(head);
+
+            completions++;
+            futex::wake_all(completions);
+        }
+    }
+
+    // valid transfers are 1, 2, 4 or 8 naturally aligned bytes or a multiple of 16 aligned to 16
+    static bool valid_transfer(u32 lsa, u64 ea, u32 size)
+    {
+        if(size == 1 || size == 2 || size == 4 || size == 8)
+            return (lsa & (size - 1)) == 0 && (ea & (size - 1)) == 0;
+
+        return size <= max_dma_size && (size & 15) == 0 && (lsa & 15) == 0 && (ea & 15) == 0;
+    }
+
+    // both sides are at least 16 byte aligned when the size is a multiple of 16
+    static void copy(u8* dst, const u8* src, u32 size)
+    {
+        if(size & 15)
+        {
+            std::memcpy(dst, src, size);
+            return;
+        }
+
+        u32 i = 0;
+
+        for(; i + 64 <= size; i += 64)
+        {
+            __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+            __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i + 32));
+            __m128i d = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i + 48));
+
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i), a);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i + 16), b);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i + 32), c);
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i + 48), d);
+        }
+
+        for(; i < size; i += 16)
+            _mm_store_si128(reinterpret_cast<__m128i*>(dst + i), _mm_load_si128(reinterpret_cast<const __m128i*>(src + i)));
+    }
+
+    void mfc::transfer(u32 lsa, u64 ea, u32 size, bool get)
+    {
+        if(!valid_transfer(lsa, ea, size))
+        {
+            spdlog::error("invalid dma of {} bytes between ls {:x} and {:x}", size, lsa, ea);
+            return;
+        }
+
+        u8* mem = static_cast<u8*>(vm::base(ea));
+
+        // local store addresses wrap around
+        u32 first = std::min(size, ls_size - lsa);
+
+        if(get)
+        {
+            copy(ls + lsa, mem, first);
+            copy(ls, mem + first, size - first);
+        }
+        else
+        {
+            // puts go a line at a time so they break reservations like any other write
+            write_lines(ea, ls + lsa, first, copy);
+            write_lines(ea + first, ls, size - first, copy);
+        }
+    }
+
+    void mfc::list(const mfc_command& cmd)
+    {
+        bool get = (cmd.cmd & mfc_cmd::get) != 0;
+
+        u32 lsa = cmd.lsa;
+        u32 addr = static_cast<u32>(cmd.ea) & ls_mask & ~7;
+
+        // the upper half of the effective address is shared by every element
+        u64 eah = cmd.ea & ~0xFFFFFFFFull;
+
+        for(u32 i = 0; i < cmd.size / 8; i++)
+        {
+            u32 elem[2];
+            std::memcpy(elem, ls + ((addr + i * 8) & ls_mask), sizeof(elem));
+
+            u32 info = endian::byte_swap(elem[0]);
+            u64 ea = eah | endian::byte_swap(elem[1]);
+            u32 size = info & 0x7FFF;
+
+            // small transfers keep the same offset into the quadword as their effective address
+            if(size < 16)
+                lsa = (lsa & ~15) | (ea & 15);
+
+            transfer(lsa & ls_mask, ea, size, get);
+            lsa = (lsa + size + 15) & ~15;
+
+            // stall and notify, wait until the spu acknowledges the stall
+            if(info & 0x80000000)
+            {
+                u32 bit = 1u << cmd.tag;
+
+                stalled |= bit;
+                futex::wake_all(stalled);
+
+                for(u32 a = acks.load(); !(a & bit); a = acks.load())
+                    futex::wait(acks, a);
+
+                acks &= ~bit;
+            }
+        }
+    }
+
+    void mfc::execute(const mfc_command& cmd)
+    {
+        // commands run in order so barriers and fences are already satisfied
+        switch(cmd.cmd & ~(mfc_cmd::barrier_flag | mfc_cmd::fence_flag))
+        {
+        case mfc_cmd::put:
+            transfer(cmd.lsa, cmd.ea, cmd.size, false);
+            break;
+        case mfc_cmd::get:
+            transfer(cmd.lsa, cmd.ea, cmd.size, true);
+            break;
+        case mfc_cmd::put | mfc_cmd::list_flag:
+        case mfc_cmd::get | mfc_cmd::list_flag:
+            list(cmd);
+            break;
+        case mfc_cmd::putqlluc:
+            putlluc(static_cast<u32>(cmd.ea), ls + (cmd.lsa & ~(line_size - 1)));
+            break;
+        case mfc_cmd::barrier:
+        case mfc_cmd::eieio:
+        case mfc_cmd::sync:
+            break;
+        default:
+            spdlog::error("unimplemented mfc command {:x}", cmd.cmd);
+            break;
+        }
+    }
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <types.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+namespace volts::spu
+{
+    /// mfc command opcodes, the low bits are modifiers so these are plain constants
+    namespace mfc_cmd
+    {
+        constexpr svl::u8 put = 0x20;
+        constexpr svl::u8 get = 0x40;
+
+        constexpr svl::u8 sndsig = 0xA0;
+        constexpr svl::u8 putlluc = 0xB0;
+        constexpr svl::u8 putllc = 0xB4;
+        constexpr svl::u8 putqlluc = 0xB8;
+        constexpr svl::u8 barrier = 0xC0;
+        constexpr svl::u8 eieio = 0xC8;
+        constexpr svl::u8 sync = 0xCC;
+        constexpr svl::u8 getllar = 0xD0;
+
+        /// wait for earlier commands in all tag groups
+        constexpr svl::u8 barrier_flag = (1 << 0);
+
+        /// wait for earlier commands in the same tag group
+        constexpr svl::u8 fence_flag = (1 << 1);
+
+        /// the transfer is described by a list in local store
+        constexpr svl::u8 list_flag = (1 << 2);
+    }
+
+    /// tag status update modes written to the tag update channel
+    enum class tag_update : svl::u32
+    {
+        immediate = 0,
+        any = 1,
+        all = 2,
+    };
+
+    /**
+     * @brief a queued dma command, built from the values written to the mfc channels
+     */
+    struct mfc_command
+    {
+        /// local store address
+        svl::u32 lsa;
+
+        /// effective address, or the local store address of the list for list commands
+        svl::u64 ea;
+
+        /// size of the transfer, or the size of the list in bytes for list commands
+        svl::u32 size;
+
+        /// tag group, 0 to 31
+        svl::u8 tag;
+
+        svl::u8 cmd;
+    };
+
+    /// the hardware queue holds 16 commands
+    constexpr svl::u32 mfc_queue_size = 16;
+
+    /// largest single transfer
+    constexpr svl::u32 max_dma_size = 0x4000;
+
+    /**
+     * @brief the memory flow controller of an spu
+     *
+     * commands are queued by the spu and executed in order on a worker thread,
+     * the spu only blocks when the queue is full or when it waits on a tag group
+     */
+    struct mfc
+    {
+        /**
+         * @brief start the dma worker for a local store
+         *
+         * @param ls the local store of the spu, must outlive the mfc
+         */
+        mfc(svl::u8* ls);
+
+        /**
+         * @brief wait for the worker to finish queued commands and stop it
+         */
+        ~mfc();
+
+        mfc(const mfc&) = delete;
+        mfc& operator=(const mfc&) = delete;
+
+        /**
+         * @brief queue a command, blocks while the queue is full
+         *
+         * @param cmd the command to queue
+         */
+        void push(const mfc_command& cmd);
+
+        /**
+         * @brief get how many commands can be queued without blocking
+         *
+         * @return svl::u32 the number of free queue entries
+         */
+        svl::u32 space() const;
+
+        /**
+         * @brief get the tag groups with no commands in flight
+         *
+         * @param mask the tag groups to check
+         * @return svl::u32 the completed groups in mask
+         */
+        svl::u32 tag_status(svl::u32 mask) const;
+
+        /**
+         * @brief check if waiting on tag groups would return without blocking
+         *
+         * @param mask the tag groups to check
+         * @param mode the tag update mode
+         * @return true if the wait is satisfied
+         * @return false if the wait would block
+         */
+        bool tags_ready(svl::u32 mask, tag_update mode) const;
+
+        /**
+         * @brief wait for tag groups to complete
+         *
+         * @param mask the tag groups to wait on
+         * @param mode wait for any group in mask, all groups in mask or return immediately
+         * @return svl::u32 the completed groups in mask
+         */
+        svl::u32 wait_tags(svl::u32 mask, tag_update mode);
+
+        /**
+         * @brief wait for a list command to stop on an element with the stall and notify bit
+         *
+         * @return svl::u32 the tag groups that stalled, cleared once read
+         */
+        svl::u32 wait_stall();
+
+        /**
+         * @brief get the tag groups with a stalled list command
+         *
+         * @return svl::u32 the stalled groups
+         */
+        svl::u32 stall_status() const;
+
+        /**
+         * @brief resume a stalled list command
+         *
+         * @param tag the tag group of the list
+         */
+        void ack_stall(svl::u32 tag);
+
+        /// command arguments as they are written to the channels
+        mfc_command args = {};
+
+        /// tag groups selected by the tag mask channel
+        svl::u32 tag_mask = 0;
+
+        /// how reads of the tag status channel wait
+        tag_update update = tag_update::immediate;
+
+    private:
+        void work();
+        void execute(const mfc_command& cmd);
+        void transfer(svl::u32 lsa, svl::u64 ea, svl::u32 size, bool get);
+        void list(const mfc_command& cmd);
+
+        svl::u8* ls;
+
+        std::array<mfc_command, mfc_queue_size> queue;
+
+        /// commands pushed and popped, the spu is the only producer and the worker the only consumer
+        std::atomic<svl::u32> head = 0;
+        std::atomic<svl::u32> tail = 0;
+
+        /// commands in flight in each tag group
+        std::array<std::atomic<svl::u32>, 32> pending = {};
+
+        /// bumped when commands are queued or the worker is stopped
+        std::atomic<svl::u32> bell = 0;
+
+        /// bumped every time a batch of commands completes
+        std::atomic<svl::u32> completions = 0;
+
+        /// tag groups with a stalled list, and acknowledgements to resume them
+        std::atomic<svl::u32> stalled = 0;
+        std::atomic<svl::u32> acks = 0;
+
+        std::atomic<bool> running = true;
+
+        std::thread worker;
+    };
+}
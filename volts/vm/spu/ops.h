@@ -1,6 +1,1425 @@
 #pragma once
 
+#include "thread.h"
+#include "decode.h"
+
+#include <spdlog/spdlog.h>
+
+#include <smmintrin.h>
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#endif
+
+#include <cmath>
+#include <limits>
+
+// registers are stored with their bytes reversed compared to the spu so element 0
+// of the spu is the top of the host vector. element wise ops work unchanged,
+// the preferred slot is word 3 and a whole register reads as one 128 bit integer
 namespace volts::spu::ops
 {
-    
-}
\ No newline at end of file
+    using namespace svl;
+
+    // converts between local store order and register order
+    inline __m128i byte_reverse()
+    {
+        return _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    }
+
+    // host byte indices
+    inline __m128i byte_index()
+    {
+        return _mm_set_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    }
+
+    inline __m128i load_quad(thread& spu, u32 addr)
+    {
+        auto src = reinterpret_cast<const __m128i*>(spu.ls.get() + (addr & ls_mask & ~15));
+        return _mm_shuffle_epi8(_mm_loadu_si128(src), byte_reverse());
+    }
+
+    inline void store_quad(thread& spu, u32 addr, __m128i val)
+    {
+        auto dst = reinterpret_cast<__m128i*>(spu.ls.get() + (addr & ls_mask & ~15));
+        _mm_storeu_si128(dst, _mm_shuffle_epi8(val, byte_reverse()));
+    }
+
+    // a register with only the preferred slot set
+    inline __m128i preferred(u32 val)
+    {
+        return _mm_set_epi32(static_cast<i32>(val), 0, 0, 0);
+    }
+
+    // the interpreter loop moves past the instruction afterwards
+    inline void branch(thread& spu, u32 target)
+    {
+        spu.pc = (target & ls_mask & ~3) - 4;
+    }
+
+    inline __m128i cmpgt_u8(__m128i a, __m128i b)
+    {
+        auto sign = _mm_set1_epi8(static_cast<i8>(0x80));
+        return _mm_cmpgt_epi8(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+    }
+
+    inline __m128i cmpgt_u16(__m128i a, __m128i b)
+    {
+        auto sign = _mm_set1_epi16(static_cast<i16>(0x8000));
+        return _mm_cmpgt_epi16(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+    }
+
+    inline __m128i cmpgt_u32(__m128i a, __m128i b)
+    {
+        auto sign = _mm_set1_epi32(static_cast<i32>(0x80000000));
+        return _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+    }
+
+    inline __m128i ones()
+    {
+        return _mm_set1_epi32(-1);
+    }
+
+    // expand the low bits of a mask into whole elements, bit n selects host element n
+    inline __m128i expand_bytes(u32 mask)
+    {
+        auto bits = _mm_set_epi8(
+            static_cast<i8>(0x80), 0x40, 0x20, 0x10, 8, 4, 2, 1,
+            static_cast<i8>(0x80), 0x40, 0x20, 0x10, 8, 4, 2, 1
+        );
+        auto spread = _mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<i32>(mask)), _mm_set_epi8(1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0));
+        return _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+    }
+
+    inline __m128i expand_halves(u32 mask)
+    {
+        auto bits = _mm_set_epi16(0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1);
+        auto spread = _mm_set1_epi16(static_cast<i16>(mask));
+        return _mm_cmpeq_epi16(_mm_and_si128(spread, bits), bits);
+    }
+
+    inline __m128i expand_words(u32 mask)
+    {
+        auto bits = _mm_set_epi32(8, 4, 2, 1);
+        auto spread = _mm_set1_epi32(static_cast<i32>(mask));
+        return _mm_cmpeq_epi32(_mm_and_si128(spread, bits), bits);
+    }
+
+    // 128 bit shifts of up to 7 bits
+    inline __m128i shl_bits(__m128i val, u32 sh)
+    {
+        auto carry = _mm_srl_epi64(_mm_slli_si128(val, 8), _mm_cvtsi32_si128(64 - sh));
+        return _mm_or_si128(_mm_sll_epi64(val, _mm_cvtsi32_si128(sh)), carry);
+    }
+
+    inline __m128i shr_bits(__m128i val, u32 sh)
+    {
+        auto carry = _mm_sll_epi64(_mm_srli_si128(val, 8), _mm_cvtsi32_si128(64 - sh));
+        return _mm_or_si128(_mm_srl_epi64(val, _mm_cvtsi32_si128(sh)), carry);
+    }
+
+    inline __m128i rotl_bits(__m128i val, u32 sh)
+    {
+        auto swapped = _mm_shuffle_epi32(val, _MM_SHUFFLE(1, 0, 3, 2));
+        return _mm_or_si128(_mm_sll_epi64(val, _mm_cvtsi32_si128(sh)), _mm_srl_epi64(swapped, _mm_cvtsi32_si128(64 - sh)));
+    }
+
+    // 128 bit shifts by whole bytes
+    inline __m128i rotl_bytes(__m128i val, u32 n)
+    {
+        auto idx = _mm_and_si128(_mm_sub_epi8(byte_index(), _mm_set1_epi8(static_cast<i8>(n & 15))), _mm_set1_epi8(15));
+        return _mm_shuffle_epi8(val, idx);
+    }
+
+    inline __m128i shl_bytes(__m128i val, u32 n)
+    {
+        // indices that go negative have their top bit set which zeroes the byte
+        auto idx = _mm_sub_epi8(byte_index(), _mm_set1_epi8(static_cast<i8>(n & 31)));
+        return _mm_shuffle_epi8(val, idx);
+    }
+
+    inline __m128i shr_bytes(__m128i val, u32 n)
+    {
+        auto idx = _mm_add_epi8(byte_index(), _mm_set1_epi8(static_cast<i8>(n & 31)));
+        idx = _mm_or_si128(idx, _mm_cmpgt_epi8(idx, _mm_set1_epi8(15)));
+        return _mm_shuffle_epi8(val, idx);
+    }
+
+    inline __m128i rotl_words(__m128i val, u32 sh)
+    {
+        sh &= 31;
+        return _mm_or_si128(_mm_sll_epi32(val, _mm_cvtsi32_si128(sh)), _mm_srl_epi32(val, _mm_cvtsi32_si128(32 - sh)));
+    }
+
+    inline __m128i rotl_halves(__m128i val, u32 sh)
+    {
+        sh &= 15;
+        return _mm_or_si128(_mm_sll_epi16(val, _mm_cvtsi32_si128(sh)), _mm_srl_epi16(val, _mm_cvtsi32_si128(16 - sh)));
+    }
+
+    // signed 16 bit multiply of the low halves of each word
+    inline __m128i mul_lo_signed(__m128i a, __m128i b)
+    {
+        auto mask = _mm_set1_epi32(0xFFFF);
+        return _mm_madd_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    }
+
+    inline __m128i mul_lo_unsigned(__m128i a, __m128i b)
+    {
+        auto mask = _mm_set1_epi32(0xFFFF);
+        return _mm_mullo_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    }
+
+    inline __m128i mul_hi_signed(__m128i a, __m128i b)
+    {
+        auto mask = _mm_set1_epi32(static_cast<i32>(0xFFFF0000));
+        return _mm_madd_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    }
+
+    inline __m128i mul_hi_unsigned(__m128i a, __m128i b)
+    {
+        return _mm_mullo_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+    }
+
+    inline __m128 abs_floats(__m128 val)
+    {
+        return _mm_and_ps(val, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)));
+    }
+
+    void invalid(thread& spu, form op)
+    {
+        spdlog::critical("invalid spu op {:x} at {:x}", op.raw, spu.pc);
+        spu.stopped = true;
+    }
+
+    // control
+
+    void stop(thread& spu, form op)
+    {
+        spu.stop_code = op.code;
+        spu.stopped = true;
+    }
+
+    void stopd(thread& spu, form op)
+    {
+        spu.stop_code = 0x3FFF;
+        spu.stopped = true;
+    }
+
+    // lnop, nop, sync, dsync and the branch hints
+    void nop(thread& spu, form op)
+    {
+    }
+
+    void mfspr(thread& spu, form op)
+    {
+        // every spr reads as zero
+        spu.gpr[op.rt].ints = _mm_setzero_si128();
+    }
+
+    void mtspr(thread& spu, form op)
+    {
+    }
+
+    // a channel access preempted while waiting runs again once the thread is back on an spu
+
+    void rdch(thread& spu, form op)
+    {
+        u32 val;
+        if(spu.read_channel(op.ca, val))
+            spu.gpr[op.rt].ints = preferred(val);
+        else
+            spu.pc -= 4;
+    }
+
+    void rchcnt(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = preferred(spu.channel_count(op.ca));
+    }
+
+    void wrch(thread& spu, form op)
+    {
+        if(!spu.write_channel(op.ca, spu.gpr[op.rt].words[3]))
+            spu.pc -= 4;
+    }
+
+    // halt if
+
+    void halt(thread& spu, bool cond)
+    {
+        if(cond)
+        {
+            spdlog::error("spu halted at {:x}", spu.pc);
+            spu.stopped = true;
+        }
+    }
+
+    void heq(thread& spu, form op)
+    {
+        halt(spu, spu.gpr[op.ra].words[3] == spu.gpr[op.rb].words[3]);
+    }
+
+    void heqi(thread& spu, form op)
+    {
+        halt(spu, spu.gpr[op.ra].words[3] == static_cast<u32>(op.si10));
+    }
+
+    void hgt(thread& spu, form op)
+    {
+        halt(spu, static_cast<i32>(spu.gpr[op.ra].words[3]) > static_cast<i32>(spu.gpr[op.rb].words[3]));
+    }
+
+    void hgti(thread& spu, form op)
+    {
+        halt(spu, static_cast<i32>(spu.gpr[op.ra].words[3]) > op.si10);
+    }
+
+    void hlgt(thread& spu, form op)
+    {
+        halt(spu, spu.gpr[op.ra].words[3] > spu.gpr[op.rb].words[3]);
+    }
+
+    void hlgti(thread& spu, form op)
+    {
+        halt(spu, spu.gpr[op.ra].words[3] > static_cast<u32>(op.si10));
+    }
+
+    // branches
+
+    void br(thread& spu, form op)
+    {
+        branch(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void bra(thread& spu, form op)
+    {
+        branch(spu, op.si16 << 2);
+    }
+
+    void brsl(thread& spu, form op)
+    {
+        u32 target = spu.pc + (op.si16 << 2);
+        spu.gpr[op.rt].ints = preferred(spu.pc + 4);
+        branch(spu, target);
+    }
+
+    void brasl(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = preferred(spu.pc + 4);
+        branch(spu, op.si16 << 2);
+    }
+
+    void brz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].words[3] == 0)
+            branch(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void brnz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].words[3] != 0)
+            branch(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void brhz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].halves[6] == 0)
+            branch(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void brhnz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].halves[6] != 0)
+            branch(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void bi(thread& spu, form op)
+    {
+        branch(spu, spu.gpr[op.ra].words[3]);
+    }
+
+    void bisl(thread& spu, form op)
+    {
+        u32 target = spu.gpr[op.ra].words[3];
+        spu.gpr[op.rt].ints = preferred(spu.pc + 4);
+        branch(spu, target);
+    }
+
+    // interrupts are never pending so this only links
+    void bisled(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = preferred(spu.pc + 4);
+    }
+
+    void iret(thread& spu, form op)
+    {
+        branch(spu, spu.srr0);
+    }
+
+    void biz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].words[3] == 0)
+            branch(spu, spu.gpr[op.ra].words[3]);
+    }
+
+    void binz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].words[3] != 0)
+            branch(spu, spu.gpr[op.ra].words[3]);
+    }
+
+    void bihz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].halves[6] == 0)
+            branch(spu, spu.gpr[op.ra].words[3]);
+    }
+
+    void bihnz(thread& spu, form op)
+    {
+        if(spu.gpr[op.rt].halves[6] != 0)
+            branch(spu, spu.gpr[op.ra].words[3]);
+    }
+
+    // loads and stores
+
+    void lqd(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = load_quad(spu, spu.gpr[op.ra].words[3] + (op.si10 << 4));
+    }
+
+    void lqx(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = load_quad(spu, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3]);
+    }
+
+    void lqa(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = load_quad(spu, op.si16 << 2);
+    }
+
+    void lqr(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = load_quad(spu, spu.pc + (op.si16 << 2));
+    }
+
+    void stqd(thread& spu, form op)
+    {
+        store_quad(spu, spu.gpr[op.ra].words[3] + (op.si10 << 4), spu.gpr[op.rt].ints);
+    }
+
+    void stqx(thread& spu, form op)
+    {
+        store_quad(spu, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3], spu.gpr[op.rt].ints);
+    }
+
+    void stqa(thread& spu, form op)
+    {
+        store_quad(spu, op.si16 << 2, spu.gpr[op.rt].ints);
+    }
+
+    void stqr(thread& spu, form op)
+    {
+        store_quad(spu, spu.pc + (op.si16 << 2), spu.gpr[op.rt].ints);
+    }
+
+    // generate controls for insertion, these build shufb masks
+
+    inline __m128i insert_mask()
+    {
+        return _mm_set_epi8(0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F);
+    }
+
+    void byte_insert(thread& spu, form op, u32 addr)
+    {
+        v128 mask = { insert_mask() };
+        mask.bytes[15 - (addr & 15)] = 0x03;
+        spu.gpr[op.rt] = mask;
+    }
+
+    void half_insert(thread& spu, form op, u32 addr)
+    {
+        v128 mask = { insert_mask() };
+        mask.halves[(14 - (addr & 14)) >> 1] = 0x0203;
+        spu.gpr[op.rt] = mask;
+    }
+
+    void word_insert(thread& spu, form op, u32 addr)
+    {
+        v128 mask = { insert_mask() };
+        mask.words[(12 - (addr & 12)) >> 2] = 0x00010203;
+        spu.gpr[op.rt] = mask;
+    }
+
+    void dword_insert(thread& spu, form op, u32 addr)
+    {
+        v128 mask = { insert_mask() };
+        mask.dwords[(8 - (addr & 8)) >> 3] = 0x0001020304050607;
+        spu.gpr[op.rt] = mask;
+    }
+
+    void cbd(thread& spu, form op) { byte_insert(spu, op, spu.gpr[op.ra].words[3] + op.si7); }
+    void chd(thread& spu, form op) { half_insert(spu, op, spu.gpr[op.ra].words[3] + op.si7); }
+    void cwd(thread& spu, form op) { word_insert(spu, op, spu.gpr[op.ra].words[3] + op.si7); }
+    void cdd(thread& spu, form op) { dword_insert(spu, op, spu.gpr[op.ra].words[3] + op.si7); }
+
+    void cbx(thread& spu, form op) { byte_insert(spu, op, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3]); }
+    void chx(thread& spu, form op) { half_insert(spu, op, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3]); }
+    void cwx(thread& spu, form op) { word_insert(spu, op, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3]); }
+    void cdx(thread& spu, form op) { dword_insert(spu, op, spu.gpr[op.ra].words[3] + spu.gpr[op.rb].words[3]); }
+
+    // constant formation
+
+    void il(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_set1_epi32(op.si16);
+    }
+
+    void ilh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_set1_epi16(static_cast<i16>(op.i16));
+    }
+
+    void ilhu(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_set1_epi32(static_cast<i32>(op.i16 << 16));
+    }
+
+    void ila(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_set1_epi32(static_cast<i32>(op.i18));
+    }
+
+    void iohl(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.rt].ints, _mm_set1_epi32(static_cast<i32>(op.i16)));
+    }
+
+    void fsmbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = expand_bytes(op.i16);
+    }
+
+    // integer arithmetic
+
+    void ah(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi16(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void ahi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi16(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void a(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void ai(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi32(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void sfh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sub_epi16(spu.gpr[op.rb].ints, spu.gpr[op.ra].ints);
+    }
+
+    void sfhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sub_epi16(_mm_set1_epi16(static_cast<i16>(op.si10)), spu.gpr[op.ra].ints);
+    }
+
+    void sf(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sub_epi32(spu.gpr[op.rb].ints, spu.gpr[op.ra].ints);
+    }
+
+    void sfi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sub_epi32(_mm_set1_epi32(op.si10), spu.gpr[op.ra].ints);
+    }
+
+    void addx(thread& spu, form op)
+    {
+        auto carry = _mm_and_si128(spu.gpr[op.rt].ints, _mm_set1_epi32(1));
+        spu.gpr[op.rt].ints = _mm_add_epi32(_mm_add_epi32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), carry);
+    }
+
+    void cg(thread& spu, form op)
+    {
+        auto a = spu.gpr[op.ra].ints;
+        auto sum = _mm_add_epi32(a, spu.gpr[op.rb].ints);
+        spu.gpr[op.rt].ints = _mm_srli_epi32(cmpgt_u32(a, sum), 31);
+    }
+
+    void cgx(thread& spu, form op)
+    {
+        auto& rt = spu.gpr[op.rt];
+
+        for(u32 i = 0; i < 4; i++)
+            rt.words[i] = (static_cast<u64>(spu.gpr[op.ra].words[i]) + spu.gpr[op.rb].words[i] + (rt.words[i] & 1)) >> 32;
+    }
+
+    void sfx(thread& spu, form op)
+    {
+        auto borrow = _mm_andnot_si128(spu.gpr[op.rt].ints, _mm_set1_epi32(1));
+        spu.gpr[op.rt].ints = _mm_sub_epi32(_mm_sub_epi32(spu.gpr[op.rb].ints, spu.gpr[op.ra].ints), borrow);
+    }
+
+    void bg(thread& spu, form op)
+    {
+        // 1 when rb >= ra, there was no borrow
+        spu.gpr[op.rt].ints = _mm_andnot_si128(cmpgt_u32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), _mm_set1_epi32(1));
+    }
+
+    void bgx(thread& spu, form op)
+    {
+        auto& rt = spu.gpr[op.rt];
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 a = spu.gpr[op.ra].words[i];
+            u32 b = spu.gpr[op.rb].words[i];
+            rt.words[i] = (rt.words[i] & 1) ? b >= a : b > a;
+        }
+    }
+
+    void mpy(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_lo_signed(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void mpyu(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_lo_unsigned(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void mpyi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_lo_signed(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void mpyui(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_lo_unsigned(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void mpya(thread& spu, form op)
+    {
+        spu.gpr[op.rt4].ints = _mm_add_epi32(mul_lo_signed(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), spu.gpr[op.rc].ints);
+    }
+
+    void mpyh(thread& spu, form op)
+    {
+        auto prod = _mm_mullo_epi16(_mm_srli_epi32(spu.gpr[op.ra].ints, 16), spu.gpr[op.rb].ints);
+        spu.gpr[op.rt].ints = _mm_slli_epi32(prod, 16);
+    }
+
+    void mpys(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_srai_epi32(mul_lo_signed(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), 16);
+    }
+
+    void mpyhh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_hi_signed(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void mpyhha(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi32(spu.gpr[op.rt].ints, mul_hi_signed(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints));
+    }
+
+    void mpyhhu(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = mul_hi_unsigned(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void mpyhhau(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_add_epi32(spu.gpr[op.rt].ints, mul_hi_unsigned(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints));
+    }
+
+    void clz(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 val = ra.words[i];
+            u32 n = 0;
+
+            for(u32 bit = 0x80000000; bit && !(val & bit); bit >>= 1)
+                n++;
+
+            out.words[i] = n;
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void cntb(thread& spu, form op)
+    {
+        // count the bits of each nibble with a lookup table
+        auto table = _mm_set_epi8(4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0);
+        auto mask = _mm_set1_epi8(0x0F);
+        auto a = spu.gpr[op.ra].ints;
+
+        auto lo = _mm_shuffle_epi8(table, _mm_and_si128(a, mask));
+        auto hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(a, 4), mask));
+        spu.gpr[op.rt].ints = _mm_add_epi8(lo, hi);
+    }
+
+    void fsmb(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = expand_bytes(spu.gpr[op.ra].halves[6]);
+    }
+
+    void fsmh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = expand_halves(spu.gpr[op.ra].words[3]);
+    }
+
+    void fsm(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = expand_words(spu.gpr[op.ra].words[3]);
+    }
+
+    void gbb(thread& spu, form op)
+    {
+        u32 bits = _mm_movemask_epi8(_mm_slli_epi64(spu.gpr[op.ra].ints, 7));
+        spu.gpr[op.rt].ints = preferred(bits);
+    }
+
+    void gbh(thread& spu, form op)
+    {
+        // pack the low byte of each half then gather the low bits
+        auto packed = _mm_packus_epi16(_mm_and_si128(spu.gpr[op.ra].ints, _mm_set1_epi16(1)), _mm_setzero_si128());
+        u32 bits = _mm_movemask_epi8(_mm_slli_epi64(packed, 7));
+        spu.gpr[op.rt].ints = preferred(bits);
+    }
+
+    void gb(thread& spu, form op)
+    {
+        u32 bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_slli_epi32(spu.gpr[op.ra].ints, 31)));
+        spu.gpr[op.rt].ints = preferred(bits);
+    }
+
+    void avgb(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_avg_epu8(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void absdb(thread& spu, form op)
+    {
+        auto a = spu.gpr[op.ra].ints;
+        auto b = spu.gpr[op.rb].ints;
+        spu.gpr[op.rt].ints = _mm_sub_epi8(_mm_max_epu8(a, b), _mm_min_epu8(a, b));
+    }
+
+    void sumb(thread& spu, form op)
+    {
+        // sum the bytes of each word, rb goes in the upper half and ra in the lower
+        auto ones = _mm_set1_epi8(1);
+        auto a = _mm_madd_epi16(_mm_maddubs_epi16(spu.gpr[op.ra].ints, ones), _mm_set1_epi16(1));
+        auto b = _mm_madd_epi16(_mm_maddubs_epi16(spu.gpr[op.rb].ints, ones), _mm_set1_epi16(1));
+        spu.gpr[op.rt].ints = _mm_or_si128(_mm_slli_epi32(b, 16), a);
+    }
+
+    void xsbh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_srai_epi16(_mm_slli_epi16(spu.gpr[op.ra].ints, 8), 8);
+    }
+
+    void xshw(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_srai_epi32(_mm_slli_epi32(spu.gpr[op.ra].ints, 16), 16);
+    }
+
+    void xswd(thread& spu, form op)
+    {
+        auto a = spu.gpr[op.ra].ints;
+        auto sign = _mm_srai_epi32(a, 31);
+
+        // keep the low word of each dword and fill the high word with its sign
+        spu.gpr[op.rt].ints = _mm_blend_epi16(a, _mm_shuffle_epi32(sign, _MM_SHUFFLE(2, 2, 0, 0)), 0xCC);
+    }
+
+    // logical
+
+    void _and(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_and_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void andc(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_andnot_si128(spu.gpr[op.rb].ints, spu.gpr[op.ra].ints);
+    }
+
+    void andbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_and_si128(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void andhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_and_si128(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void andi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_and_si128(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void _or(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void orc(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.ra].ints, _mm_xor_si128(spu.gpr[op.rb].ints, ones()));
+    }
+
+    void orbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void orhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void ori(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_or_si128(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void orx(thread& spu, form op)
+    {
+        auto a = spu.gpr[op.ra].ints;
+        a = _mm_or_si128(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 3, 2)));
+        a = _mm_or_si128(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+        spu.gpr[op.rt].ints = _mm_and_si128(a, _mm_set_epi32(-1, 0, 0, 0));
+    }
+
+    void _xor(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void xorbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void xorhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void xori(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void nand(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(_mm_and_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), ones());
+    }
+
+    void nor(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(_mm_or_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), ones());
+    }
+
+    void eqv(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_xor_si128(_mm_xor_si128(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints), ones());
+    }
+
+    void selb(thread& spu, form op)
+    {
+        auto c = spu.gpr[op.rc].ints;
+        spu.gpr[op.rt4].ints = _mm_or_si128(_mm_and_si128(c, spu.gpr[op.rb].ints), _mm_andnot_si128(c, spu.gpr[op.ra].ints));
+    }
+
+    void shufb(thread& spu, form op)
+    {
+        auto a = spu.gpr[op.ra].ints;
+        auto b = spu.gpr[op.rb].ints;
+        auto c = spu.gpr[op.rc].ints;
+
+        // 31 - index, the low 4 bits are the host byte and bit 4 is set when selecting from ra
+        auto idx = _mm_andnot_si128(c, _mm_set1_epi8(0x1F));
+        auto from_a = _mm_cmpeq_epi8(_mm_and_si128(idx, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+        auto res = _mm_blendv_epi8(_mm_shuffle_epi8(b, idx), _mm_shuffle_epi8(a, idx), from_a);
+
+        // 10xxxxxx gives 0x00, 110xxxxx gives 0xFF and 111xxxxx gives 0x80
+        auto top = _mm_cmplt_epi8(c, _mm_setzero_si128());
+        auto ff = _mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(static_cast<i8>(0xC0))), _mm_set1_epi8(static_cast<i8>(0xC0)));
+        auto e0 = _mm_cmpeq_epi8(_mm_and_si128(c, _mm_set1_epi8(static_cast<i8>(0xE0))), _mm_set1_epi8(static_cast<i8>(0xE0)));
+        auto special = _mm_or_si128(_mm_andnot_si128(e0, ff), _mm_and_si128(e0, _mm_set1_epi8(static_cast<i8>(0x80))));
+
+        spu.gpr[op.rt4].ints = _mm_blendv_epi8(res, special, top);
+    }
+
+    // shifts and rotates of elements
+
+    void shlh(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 8; i++)
+        {
+            u32 sh = rb.halves[i] & 0x1F;
+            out.halves[i] = sh > 15 ? 0 : ra.halves[i] << sh;
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void shlhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sll_epi16(spu.gpr[op.ra].ints, _mm_cvtsi32_si128(op.i7 & 0x1F));
+    }
+
+    void shl(thread& spu, form op)
+    {
+#if defined(__AVX2__)
+        auto sh = _mm_and_si128(spu.gpr[op.rb].ints, _mm_set1_epi32(0x3F));
+        spu.gpr[op.rt].ints = _mm_sllv_epi32(spu.gpr[op.ra].ints, sh);
+#else
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 sh = rb.words[i] & 0x3F;
+            out.words[i] = sh > 31 ? 0 : ra.words[i] << sh;
+        }
+
+        spu.gpr[op.rt] = out;
+#endif
+    }
+
+    void shli(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sll_epi32(spu.gpr[op.ra].ints, _mm_cvtsi32_si128(op.i7 & 0x3F));
+    }
+
+    void roth(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 8; i++)
+        {
+            u32 sh = rb.halves[i] & 0xF;
+            out.halves[i] = static_cast<u16>((ra.halves[i] << sh) | (ra.halves[i] >> (16 - sh)));
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void rothi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_halves(spu.gpr[op.ra].ints, op.i7);
+    }
+
+    void rot(thread& spu, form op)
+    {
+#if defined(__AVX2__)
+        auto sh = _mm_and_si128(spu.gpr[op.rb].ints, _mm_set1_epi32(0x1F));
+        auto a = spu.gpr[op.ra].ints;
+        spu.gpr[op.rt].ints = _mm_or_si128(_mm_sllv_epi32(a, sh), _mm_srlv_epi32(a, _mm_sub_epi32(_mm_set1_epi32(32), sh)));
+#else
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 sh = rb.words[i] & 0x1F;
+            out.words[i] = sh ? (ra.words[i] << sh) | (ra.words[i] >> (32 - sh)) : ra.words[i];
+        }
+
+        spu.gpr[op.rt] = out;
+#endif
+    }
+
+    void roti(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_words(spu.gpr[op.ra].ints, op.i7);
+    }
+
+    // the rotate and mask forms shift right by the negated count
+
+    void rothm(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 8; i++)
+        {
+            u32 sh = (0 - rb.halves[i]) & 0x1F;
+            out.halves[i] = sh > 15 ? 0 : ra.halves[i] >> sh;
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void rothmi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_srl_epi16(spu.gpr[op.ra].ints, _mm_cvtsi32_si128((0 - op.i7) & 0x1F));
+    }
+
+    void rotm(thread& spu, form op)
+    {
+#if defined(__AVX2__)
+        auto sh = _mm_and_si128(_mm_sub_epi32(_mm_setzero_si128(), spu.gpr[op.rb].ints), _mm_set1_epi32(0x3F));
+        spu.gpr[op.rt].ints = _mm_srlv_epi32(spu.gpr[op.ra].ints, sh);
+#else
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 sh = (0 - rb.words[i]) & 0x3F;
+            out.words[i] = sh > 31 ? 0 : ra.words[i] >> sh;
+        }
+
+        spu.gpr[op.rt] = out;
+#endif
+    }
+
+    void rotmi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_srl_epi32(spu.gpr[op.ra].ints, _mm_cvtsi32_si128((0 - op.i7) & 0x3F));
+    }
+
+    void rotmah(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 8; i++)
+        {
+            u32 sh = (0 - rb.halves[i]) & 0x1F;
+            out.halves[i] = static_cast<u16>(static_cast<i16>(ra.halves[i]) >> (sh > 15 ? 15 : sh));
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void rotmahi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sra_epi16(spu.gpr[op.ra].ints, _mm_cvtsi32_si128((0 - op.i7) & 0x1F));
+    }
+
+    void rotma(thread& spu, form op)
+    {
+#if defined(__AVX2__)
+        auto sh = _mm_and_si128(_mm_sub_epi32(_mm_setzero_si128(), spu.gpr[op.rb].ints), _mm_set1_epi32(0x3F));
+        spu.gpr[op.rt].ints = _mm_srav_epi32(spu.gpr[op.ra].ints, sh);
+#else
+        auto& ra = spu.gpr[op.ra];
+        auto& rb = spu.gpr[op.rb];
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            u32 sh = (0 - rb.words[i]) & 0x3F;
+            out.words[i] = static_cast<u32>(static_cast<i32>(ra.words[i]) >> (sh > 31 ? 31 : sh));
+        }
+
+        spu.gpr[op.rt] = out;
+#endif
+    }
+
+    void rotmai(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_sra_epi32(spu.gpr[op.ra].ints, _mm_cvtsi32_si128((0 - op.i7) & 0x3F));
+    }
+
+    // shifts and rotates of the whole quadword
+
+    void shlqbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shl_bits(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3] & 7);
+    }
+
+    void shlqbii(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shl_bits(spu.gpr[op.ra].ints, op.i7 & 7);
+    }
+
+    void shlqby(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shl_bytes(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3]);
+    }
+
+    void shlqbyi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shl_bytes(spu.gpr[op.ra].ints, op.i7);
+    }
+
+    void shlqbybi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shl_bytes(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3] >> 3);
+    }
+
+    void rotqbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_bits(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3] & 7);
+    }
+
+    void rotqbii(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_bits(spu.gpr[op.ra].ints, op.i7 & 7);
+    }
+
+    void rotqby(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_bytes(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3]);
+    }
+
+    void rotqbyi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_bytes(spu.gpr[op.ra].ints, op.i7);
+    }
+
+    void rotqbybi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = rotl_bytes(spu.gpr[op.ra].ints, spu.gpr[op.rb].words[3] >> 3);
+    }
+
+    void rotqmbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shr_bits(spu.gpr[op.ra].ints, (0 - spu.gpr[op.rb].words[3]) & 7);
+    }
+
+    void rotqmbii(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shr_bits(spu.gpr[op.ra].ints, (0 - op.i7) & 7);
+    }
+
+    void rotqmby(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shr_bytes(spu.gpr[op.ra].ints, 0 - spu.gpr[op.rb].words[3]);
+    }
+
+    void rotqmbyi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shr_bytes(spu.gpr[op.ra].ints, 0 - op.i7);
+    }
+
+    void rotqmbybi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = shr_bytes(spu.gpr[op.ra].ints, 0 - (spu.gpr[op.rb].words[3] >> 3));
+    }
+
+    // compares
+
+    void ceqb(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi8(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void ceqbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi8(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void ceqh(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi16(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void ceqhi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi16(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void ceq(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void ceqi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpeq_epi32(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void cgtb(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi8(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void cgtbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi8(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void cgth(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi16(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void cgthi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi16(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void cgt(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void cgti(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = _mm_cmpgt_epi32(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    void clgtb(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u8(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void clgtbi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u8(spu.gpr[op.ra].ints, _mm_set1_epi8(static_cast<i8>(op.i10)));
+    }
+
+    void clgth(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u16(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void clgthi(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u16(spu.gpr[op.ra].ints, _mm_set1_epi16(static_cast<i16>(op.si10)));
+    }
+
+    void clgt(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u32(spu.gpr[op.ra].ints, spu.gpr[op.rb].ints);
+    }
+
+    void clgti(thread& spu, form op)
+    {
+        spu.gpr[op.rt].ints = cmpgt_u32(spu.gpr[op.ra].ints, _mm_set1_epi32(op.si10));
+    }
+
+    // single precision, the spu has no denormals, nans or infinities but
+    // treating them as ieee values is close enough for games
+
+    void fa(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_add_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+    }
+
+    void fs(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_sub_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+    }
+
+    void fm(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_mul_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+    }
+
+    void fma(thread& spu, form op)
+    {
+        auto prod = _mm_mul_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+        spu.gpr[op.rt4].floats = _mm_add_ps(prod, spu.gpr[op.rc].floats);
+    }
+
+    void fms(thread& spu, form op)
+    {
+        auto prod = _mm_mul_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+        spu.gpr[op.rt4].floats = _mm_sub_ps(prod, spu.gpr[op.rc].floats);
+    }
+
+    void fnms(thread& spu, form op)
+    {
+        auto prod = _mm_mul_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+        spu.gpr[op.rt4].floats = _mm_sub_ps(spu.gpr[op.rc].floats, prod);
+    }
+
+    // the estimate is already as precise as the host gives so interpolation just passes it through
+    void frest(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_rcp_ps(spu.gpr[op.ra].floats);
+    }
+
+    void frsqest(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_rsqrt_ps(abs_floats(spu.gpr[op.ra].floats));
+    }
+
+    void fi(thread& spu, form op)
+    {
+        spu.gpr[op.rt] = spu.gpr[op.rb];
+    }
+
+    void fceq(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_cmpeq_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+    }
+
+    void fcmeq(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_cmpeq_ps(abs_floats(spu.gpr[op.ra].floats), abs_floats(spu.gpr[op.rb].floats));
+    }
+
+    void fcgt(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_cmpgt_ps(spu.gpr[op.ra].floats, spu.gpr[op.rb].floats);
+    }
+
+    void fcmgt(thread& spu, form op)
+    {
+        spu.gpr[op.rt].floats = _mm_cmpgt_ps(abs_floats(spu.gpr[op.ra].floats), abs_floats(spu.gpr[op.rb].floats));
+    }
+
+    // conversions scale by a power of 2 given by the immediate
+
+    void cflts(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        f64 scale = std::ldexp(1.0, 173 - static_cast<i32>(op.i8));
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            f64 val = ra.singles[i] * scale;
+
+            if(std::isnan(val))
+                out.words[i] = 0;
+            else if(val >= 2147483648.0)
+                out.words[i] = 0x7FFFFFFF;
+            else if(val < -2147483648.0)
+                out.words[i] = 0x80000000;
+            else
+                out.words[i] = static_cast<u32>(static_cast<i32>(val));
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void cfltu(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        f64 scale = std::ldexp(1.0, 173 - static_cast<i32>(op.i8));
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+        {
+            f64 val = ra.singles[i] * scale;
+
+            if(std::isnan(val) || val <= 0.0)
+                out.words[i] = 0;
+            else if(val >= 4294967296.0)
+                out.words[i] = 0xFFFFFFFF;
+            else
+                out.words[i] = static_cast<u32>(val);
+        }
+
+        spu.gpr[op.rt] = out;
+    }
+
+    void csflt(thread& spu, form op)
+    {
+        auto scale = _mm_set1_ps(std::ldexp(1.0f, static_cast<i32>(op.i8) - 155));
+        spu.gpr[op.rt].floats = _mm_mul_ps(_mm_cvtepi32_ps(spu.gpr[op.ra].ints), scale);
+    }
+
+    void cuflt(thread& spu, form op)
+    {
+        auto& ra = spu.gpr[op.ra];
+        f32 scale = std::ldexp(1.0f, static_cast<i32>(op.i8) - 155);
+        v128 out;
+
+        for(u32 i = 0; i < 4; i++)
+            out.singles[i] = static_cast<f32>(ra.words[i]) * scale;
+
+        spu.gpr[op.rt] = out;
+    }
+
+    // double precision, elements 0 and 2 hold the singles
+
+    void fesd(thread& spu, form op)
+    {
+        auto singles = _mm_shuffle_ps(spu.gpr[op.ra].floats, spu.gpr[op.ra].floats, _MM_SHUFFLE(0, 0, 3, 1));
+        spu.gpr[op.rt].doubles = _mm_cvtps_pd(singles);
+    }
+
+    void frds(thread& spu, form op)
+    {
+        auto singles = _mm_castps_si128(_mm_cvtpd_ps(spu.gpr[op.ra].doubles));
+        spu.gpr[op.rt].ints = _mm_shuffle_epi32(singles, _MM_SHUFFLE(1, 2, 0, 2));
+    }
+
+    void dfa(thread& spu, form op)
+    {
+        spu.gpr[op.rt].doubles = _mm_add_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+    }
+
+    void dfs(thread& spu, form op)
+    {
+        spu.gpr[op.rt].doubles = _mm_sub_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+    }
+
+    void dfm(thread& spu, form op)
+    {
+        spu.gpr[op.rt].doubles = _mm_mul_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+    }
+
+    void dfma(thread& spu, form op)
+    {
+        auto prod = _mm_mul_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+        spu.gpr[op.rt].doubles = _mm_add_pd(prod, spu.gpr[op.rt].doubles);
+    }
+
+    void dfms(thread& spu, form op)
+    {
+        auto prod = _mm_mul_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+        spu.gpr[op.rt].doubles = _mm_sub_pd(prod, spu.gpr[op.rt].doubles);
+    }
+
+    void dfnms(thread& spu, form op)
+    {
+        auto prod = _mm_mul_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+        spu.gpr[op.rt].doubles = _mm_sub_pd(spu.gpr[op.rt].doubles, prod);
+    }
+
+    void dfnma(thread& spu, form op)
+    {
+        auto prod = _mm_mul_pd(spu.gpr[op.ra].doubles, spu.gpr[op.rb].doubles);
+        auto sum = _mm_add_pd(prod, spu.gpr[op.rt].doubles);
+        spu.gpr[op.rt].doubles = _mm_xor_pd(sum, _mm_set1_pd(-0.0));
+    }
+
+    void fscrrd(thread& spu, form op)
+    {
+        spu.gpr[op.rt] = spu.fpscr;
+    }
+
+    void fscrwr(thread& spu, form op)
+    {
+        spu.fpscr = spu.gpr[op.ra];
+    }
+}
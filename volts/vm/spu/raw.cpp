@@ -0,0 +1,265 @@
+#include "raw.h"
+#include "thread.h"
+#include "mfc.h"
+
+#include "sys/syscall.h"
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <cstring>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    /**
+     * @brief a raw spu, run directly by the ppu through its registers
+     */
+    struct raw_spu
+    {
+        raw_spu(u8* memory)
+            : spu(memory)
+        {
+        }
+
+        thread spu;
+
+        /// runs the spu between writes to the run control register
+        std::thread runner;
+
+        std::atomic<u32> status = 0;
+
+        /// proxy commands get their own queue so the spu stays the only producer of its own
+        std::unique_ptr<mfc> proxy;
+        mfc_command args = {};
+        u32 query_mask = 0;
+
+        /// serialises starting and stopping the spu
+        std::mutex mut;
+    };
+
+    // slots are only written under the lock, register accesses read them directly
+    static std::mutex mut;
+    static std::unique_ptr<raw_spu> raw_spus[max_raw_spus];
+
+    thread* get_raw_spu(u32 id)
+    {
+        if(id >= max_raw_spus || !raw_spus[id])
+            return nullptr;
+
+        return &raw_spus[id]->spu;
+    }
+
+    static void start(raw_spu& raw)
+    {
+        std::lock_guard<std::mutex> guard(raw.mut);
+
+        if(raw.status & raw_status::running)
+            return;
+
+        if(raw.runner.joinable())
+            raw.runner.join();
+
+        raw.spu.preempt.clear();
+        raw.status = raw_status::running;
+
+        raw.runner = std::thread([&raw] {
+            raw.spu.run();
+
+            // a stop instruction leaves its signal in the upper half, a stop request leaves nothing
+            raw.status = raw.spu.stopped ? (raw.spu.stop_code << 16) | raw_status::stopped_by_stop : 0;
+        });
+    }
+
+    static void stop(raw_spu& raw)
+    {
+        std::lock_guard<std::mutex> guard(raw.mut);
+
+        // also pulls the spu out of a mailbox or signal read that would otherwise never return
+        raw.spu.preempt.request();
+
+        if(raw.runner.joinable())
+            raw.runner.join();
+    }
+
+    static mfc& proxy(raw_spu& raw)
+    {
+        if(!raw.proxy)
+            raw.proxy = std::make_unique<mfc>(raw.spu.ls.get());
+
+        return *raw.proxy;
+    }
+
+    static raw_spu* owner(vm::addr at, u32& offset)
+    {
+        u32 rel = static_cast<u32>(at - raw_spu_base);
+        offset = rel % raw_spu_stride - raw_spu_prob;
+
+        return raw_spus[rel / raw_spu_stride].get();
+    }
+
+    static u32 read_register(vm::addr at)
+    {
+        u32 offset;
+        raw_spu* raw = owner(at, offset);
+
+        if(!raw)
+            return 0;
+
+        thread& spu = raw->spu;
+
+        switch(offset)
+        {
+        case prob::mfc_cmd_status:
+            // commands are always accepted, the queue blocks instead of rejecting them
+            return 0;
+        case prob::mfc_queue_status:
+        {
+            u32 space = proxy(*raw).space();
+            return space | (space == mfc_queue_size ? 0x80000000 : 0);
+        }
+        case prob::query_mask:
+            return raw->query_mask;
+        case prob::tag_status:
+            return proxy(*raw).tag_status(raw->query_mask);
+        case prob::out_mbox:
+        {
+            u32 val = 0;
+            spu.read_out_mbox(val);
+            return val;
+        }
+        case prob::mbox_status:
+            return spu.out_mbox.count()
+                | ((4 - spu.in_mbox.count()) << 8)
+                | (spu.out_intr_mbox.count() << 16);
+        case prob::status:
+            return raw->status.load();
+        case prob::npc:
+            return spu.pc;
+        default:
+            spdlog::warn("unhandled raw spu register read {:x}", offset);
+            return 0;
+        }
+    }
+
+    static void write_register(vm::addr at, u32 val)
+    {
+        u32 offset;
+        raw_spu* raw = owner(at, offset);
+
+        if(!raw)
+            return;
+
+        thread& spu = raw->spu;
+
+        switch(offset)
+        {
+        case prob::mfc_lsa:
+            raw->args.lsa = val & ls_mask;
+            break;
+        case prob::mfc_eah:
+            raw->args.ea = (static_cast<u64>(val) << 32) | (raw->args.ea & 0xFFFFFFFF);
+            break;
+        case prob::mfc_eal:
+            raw->args.ea = (raw->args.ea & ~0xFFFFFFFFull) | val;
+            break;
+        case prob::mfc_size_tag:
+            raw->args.size = val >> 16;
+            raw->args.tag = val & 0x1F;
+            break;
+        case prob::mfc_cmd_status:
+            raw->args.cmd = val & 0xFF;
+            proxy(*raw).push(raw->args);
+            break;
+        case prob::query_type:
+            // tag status reads never block so the query type doesnt change anything
+            break;
+        case prob::query_mask:
+            raw->query_mask = val;
+            break;
+        case prob::in_mbox:
+            // the hardware overwrites the last entry when the mailbox is full
+            if(!spu.in_mbox.try_push(val))
+                spdlog::debug("raw spu inbound mailbox full, dropped {:x}", val);
+            break;
+        case prob::run_control:
+            if(val & 1)
+                start(*raw);
+            else
+                stop(*raw);
+            break;
+        case prob::npc:
+            spu.pc = val & ls_mask & ~3;
+            break;
+        case prob::sig_notify1:
+            spu.write_signal(0, val);
+            break;
+        case prob::sig_notify2:
+            spu.write_signal(1, val);
+            break;
+        default:
+            spdlog::warn("unhandled raw spu register write {:x} = {:x}", offset, val);
+            break;
+        }
+    }
+
+    u32 sys_raw_spu_create(vm::ptr<endian::big<u32>> id, u32 attr)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        for(u32 i = 0; i < max_raw_spus; i++)
+        {
+            if(raw_spus[i])
+                continue;
+
+            // a slot whose local store is still being released by destroy is skipped
+            vm::addr addr = vm::spu->falloc(raw_spu_addr(i), ls_size);
+            if(!addr)
+                continue;
+
+            u8* memory = static_cast<u8*>(vm::base(addr));
+            std::memset(memory, 0, ls_size);
+
+            raw_spus[i] = std::make_unique<raw_spu>(memory);
+
+            // local store stays plain memory so the ppu reads and writes it at full speed
+            if(!vm::map_mmio(addr + raw_spu_prob, raw_spu_stride - raw_spu_prob, read_register, write_register))
+            {
+                raw_spus[i].reset();
+                vm::spu->dealloc(addr);
+                return vm::eagain;
+            }
+
+            *id = endian::byte_swap(i);
+            return 0;
+        }
+
+        return vm::eagain;
+    }
+
+    u32 sys_raw_spu_destroy(u32 id)
+    {
+        std::unique_ptr<raw_spu> raw;
+
+        {
+            std::lock_guard<std::mutex> guard(mut);
+
+            if(id >= max_raw_spus || !raw_spus[id])
+                return vm::esrch;
+
+            vm::unmap_mmio(raw_spu_addr(id) + raw_spu_prob);
+            raw = std::move(raw_spus[id]);
+        }
+
+        stop(*raw);
+
+        // the thread borrows the local store so it has to go before the memory does
+        raw.reset();
+        vm::spu->dealloc(raw_spu_addr(id));
+
+        return 0;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <types.h>
+#include <endian.h>
+
+#include "vm.h"
+
+namespace volts::spu
+{
+    struct thread;
+
+    /// most raw spus that can exist at once
+    constexpr svl::u32 max_raw_spus = 5;
+
+    /// raw spu n is mapped at raw_spu_base + n * raw_spu_stride, local store first
+    constexpr vm::addr raw_spu_base = 0xE0000000;
+    constexpr svl::u32 raw_spu_stride = 0x100000;
+
+    /// offset of the problem state registers from the start of a raw spu
+    constexpr svl::u32 raw_spu_prob = 0x40000;
+
+    /// problem state register offsets from raw_spu_prob
+    namespace prob
+    {
+        constexpr svl::u32 mfc_lsa = 0x3004;
+        constexpr svl::u32 mfc_eah = 0x3008;
+        constexpr svl::u32 mfc_eal = 0x300C;
+        constexpr svl::u32 mfc_size_tag = 0x3010;
+        constexpr svl::u32 mfc_cmd_status = 0x3014;
+        constexpr svl::u32 mfc_queue_status = 0x3104;
+        constexpr svl::u32 query_type = 0x3204;
+        constexpr svl::u32 query_mask = 0x321C;
+        constexpr svl::u32 tag_status = 0x322C;
+        constexpr svl::u32 out_mbox = 0x4004;
+        constexpr svl::u32 in_mbox = 0x400C;
+        constexpr svl::u32 mbox_status = 0x4014;
+        constexpr svl::u32 run_control = 0x401C;
+        constexpr svl::u32 status = 0x4024;
+        constexpr svl::u32 npc = 0x4034;
+        constexpr svl::u32 sig_notify1 = 0x1400C;
+        constexpr svl::u32 sig_notify2 = 0x1C00C;
+    }
+
+    /// bits of the status register
+    namespace raw_status
+    {
+        constexpr svl::u32 running = (1 << 0);
+        constexpr svl::u32 stopped_by_stop = (1 << 1);
+    }
+
+    /**
+     * @brief get the address a raw spu is mapped at
+     *
+     * @param id the raw spu
+     * @return vm::addr the start of its local store
+     */
+    constexpr vm::addr raw_spu_addr(svl::u32 id)
+    {
+        return raw_spu_base + id * raw_spu_stride;
+    }
+
+    /**
+     * @brief get the thread of a raw spu
+     *
+     * @param id the raw spu
+     * @return thread* the thread, nullptr if the raw spu doesnt exist
+     */
+    thread* get_raw_spu(svl::u32 id);
+
+    /**
+     * @brief create a raw spu, its local store becomes guest memory and its registers are mapped after it
+     *
+     * @param id where to write the id of the raw spu
+     * @param attr unused
+     * @return svl::u32 0 or an lv2 error
+     */
+    svl::u32 sys_raw_spu_create(vm::ptr<svl::endian::big<svl::u32>> id, svl::u32 attr);
+
+    /**
+     * @brief stop a raw spu and unmap it
+     *
+     * @param id the raw spu
+     * @return svl::u32 0 or an lv2 error
+     */
+    svl::u32 sys_raw_spu_destroy(svl::u32 id);
+}
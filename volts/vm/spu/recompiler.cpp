@@ -0,0 +1,341 @@
+#include "recompiler.h"
+#include "thread.h"
+
+#include <file.h>
+#include <convert.h>
+#include <endian.h>
+
+#include <xxhash.h>
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    namespace cvt = svl::convert;
+
+    /**
+     * @brief header at the start of the cache file
+     *
+     * followed by count entries, each entry is the number of instructions, the
+     * instructions as they appear in local store, the size of the host code and the host code
+     */
+    struct cache_header
+    {
+        u32 magic;
+        u32 version;
+
+        /// host code is only valid with the emitter and decode table that produced it
+        u64 build;
+
+        u32 count;
+        u32 pad;
+    };
+
+    constexpr u32 cache_version = 2;
+
+    /// no block compiles to more host code than this per instruction
+    constexpr u32 max_native_per_op = 96;
+
+    static std::atomic<decoder> active = decoder::interpreter;
+
+    static std::mutex mut;
+
+    // blocks are never freed so threads can keep pointers to them without locking,
+    // blocks with the same hash but different code share a bucket
+    static std::unordered_map<u64, std::vector<std::unique_ptr<block>>> blocks;
+    static u64 total = 0;
+
+    // compiled functions keyed by the hash of the straight line run they start with,
+    // which is all compile can work out from the address execution reached
+    static std::unordered_map<u64, std::vector<const block*>> functions;
+
+    // where the cache is saved and if anything was added since it was loaded
+    static fs::path cache_path;
+    static bool dirty = false;
+
+    void set_decoder(decoder mode)
+    {
+        active = mode;
+    }
+
+    decoder get_decoder()
+    {
+        return active;
+    }
+
+    bool parse_decoder(std::string_view name, decoder& out)
+    {
+        if(name == "interpreter")
+            out = decoder::interpreter;
+        else if(name == "recompiler")
+            out = decoder::recompiler;
+        else
+            return false;
+
+        return true;
+    }
+
+    static bool matches(const block& b, const u8* code)
+    {
+        return std::memcmp(b.code.data(), code, b.code.size() * sizeof(u32)) == 0;
+    }
+
+    // number of instructions up to and including the first that ends a block
+    static u32 block_length(const u8* code, u32 limit)
+    {
+        u32 count = 0;
+        while(count < limit)
+        {
+            u32 op;
+            std::memcpy(&op, code + count * sizeof(u32), sizeof(u32));
+            count++;
+
+            if(ends_block[decode(endian::byte_swap(op))])
+                break;
+        }
+
+        return count;
+    }
+
+    // host code calls the interpreter through the table so it depends on its layout as well
+    static u64 build_hash()
+    {
+        XXH64_state_t* state = XXH64_createState();
+        XXH64_reset(state, emitter_version);
+
+        for(const char* name : names)
+            XXH64_update(state, name, std::strlen(name) + 1);
+
+        u64 hash = XXH64_digest(state);
+        XXH64_freeState(state);
+
+        return hash;
+    }
+
+    // must be called with mut held, cached host code is used instead of emitting it again
+    static const block* insert(const u8* code, u32 count, std::vector<u8> native = {})
+    {
+        u64 hash = XXH64(code, count * sizeof(u32), 0);
+        auto& bucket = blocks[hash];
+
+        for(const auto& b : bucket)
+            if(b->code.size() == count && matches(*b, code))
+                return b.get();
+
+        auto b = std::make_unique<block>();
+        b->hash = hash;
+        b->code.resize(count);
+        std::memcpy(b->code.data(), code, count * sizeof(u32));
+
+        b->ops.reserve(count);
+        for(u32 word : b->code)
+        {
+            u32 op = endian::byte_swap(word);
+            b->ops.push_back({ funcs[decode(op)], { op } });
+        }
+
+        b->native = native.empty() ? emit(b->code.data(), count) : std::move(native);
+        b->entry = place(b->native);
+
+        // anything longer than its first straight line run is a function
+        if(u32 head = block_length(code, std::min(count, max_block_size)); head < count)
+            functions[XXH64(code, head * sizeof(u32), 0)].push_back(b.get());
+
+        bucket.push_back(std::move(b));
+        total++;
+        dirty = true;
+
+        return bucket.back().get();
+    }
+
+    const block* compile(const thread& spu, u32 addr)
+    {
+        const u8* code = spu.ls.get() + addr;
+
+        // find the end of the block, it cant run past the end of local store
+        u32 count = block_length(code, std::min(max_block_size, (ls_size - addr) / u32(sizeof(u32))));
+        u64 hash = XXH64(code, count * sizeof(u32), 0);
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        // a function starting here is used over the block
+        if(auto it = functions.find(hash); it != functions.end())
+        {
+            for(const block* func : it->second)
+            {
+                if(addr + func->code.size() * sizeof(u32) <= ls_size && matches(*func, code))
+                    return func;
+            }
+        }
+
+        return insert(code, count);
+    }
+
+    const block* compile_function(const thread& spu, u32 start, u32 end)
+    {
+        if(end <= start || start >= ls_size)
+            return nullptr;
+
+        u32 count = std::min({ (end - start) / u32(sizeof(u32)), max_function_size, (ls_size - start) / u32(sizeof(u32)) });
+
+        std::lock_guard<std::mutex> guard(mut);
+        return insert(spu.ls.get() + start, count);
+    }
+
+    static void run_block(thread& spu, const block& b, u32 base)
+    {
+        u32 addr = spu.pc;
+
+        // ops read pc for relative branches and links so keep it up to date
+        for(u32 i = (addr - base) / sizeof(u32); i < b.ops.size(); i++)
+        {
+            const auto& inst = b.ops[i];
+
+            spu.pc = addr;
+            inst.func(spu, inst.op);
+
+            // a branch was taken or a channel access was preempted and rewound pc to run again later
+            if(spu.pc != addr || ends_block[decode(inst.op.raw)])
+                break;
+
+            addr += sizeof(u32);
+        }
+
+        spu.pc = (spu.pc + 4) & (ls_mask & ~3);
+    }
+
+    void execute(thread& spu)
+    {
+        if(!spu.blocks)
+            spu.blocks.reset(new block_entry[ls_size / sizeof(u32)]());
+
+        spu.stopped = false;
+
+        while(!spu.stopped && !spu.preempt.pending())
+        {
+            // the lookup table is per thread, code may have been overwritten since it was filled
+            block_entry entry = spu.blocks[spu.pc / sizeof(u32)];
+            if(!entry.code || !matches(*entry.code, spu.ls.get() + entry.base))
+            {
+                entry = { compile(spu, spu.pc), spu.pc };
+
+                // branches out of the block and returns to it come back in partway through
+                for(u32 i = 0; i < entry.code->code.size(); i++)
+                    spu.blocks[spu.pc / sizeof(u32) + i] = entry;
+            }
+
+            if(entry.code->entry)
+            {
+                entry.code->entry(&spu, spu.gpr, &spu.pc, funcs.data(), entry.base);
+                spu.pc = (spu.pc + 4) & (ls_mask & ~3);
+            }
+            else
+            {
+                run_block(spu, *entry.code, entry.base);
+            }
+        }
+    }
+
+    bool load_cache(const fs::path& path)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        cache_path = path;
+
+        if(!fs::exists(path))
+            return false;
+
+        auto file = svl::open(path, svl::mode::read);
+
+        if(!file.valid() || file.size() < sizeof(cache_header))
+            return false;
+
+        auto head = file.read<cache_header>();
+        if(head.magic != cvt::to_u32("VSPU") || head.version != cache_version || head.build != build_hash())
+        {
+            spdlog::warn("ignoring spu cache {} from a different version", path.string());
+            return false;
+        }
+
+        u64 before = total;
+
+        for(u32 i = 0; i < head.count; i++)
+        {
+            if(file.tell() + sizeof(u32) > file.size())
+                break;
+
+            auto count = file.read<u32>();
+            if(count == 0 || count > max_function_size || file.tell() + count * sizeof(u32) + sizeof(u32) > file.size())
+            {
+                spdlog::error("corrupt spu cache entry {}", i);
+                break;
+            }
+
+            auto code = file.read<u32>(count);
+
+            auto size = file.read<u32>();
+            if(size == 0 || size > (count + 1) * max_native_per_op || file.tell() + size > file.size())
+            {
+                spdlog::error("corrupt spu cache entry {}", i);
+                break;
+            }
+
+            insert(reinterpret_cast<const u8*>(code.data()), count, file.read<u8>(size));
+        }
+
+        // nothing new to write back yet
+        dirty = false;
+
+        spdlog::info("loaded {} spu blocks from {}", total - before, path.string());
+        return true;
+    }
+
+    void save_cache()
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(!dirty || cache_path.empty())
+            return;
+
+        if(cache_path.has_parent_path())
+            fs::create_directories(cache_path.parent_path());
+
+        auto file = svl::open(cache_path, svl::mode::write);
+        if(!file.valid())
+        {
+            spdlog::error("failed to open spu cache {}", cache_path.string());
+            return;
+        }
+
+        file.write(cache_header{ cvt::to_u32("VSPU"), cache_version, build_hash(), static_cast<u32>(total), 0 });
+
+        for(const auto& [hash, bucket] : blocks)
+        {
+            for(const auto& b : bucket)
+            {
+                file.write(static_cast<u32>(b->code.size()));
+                file.write(b->code.data(), b->code.size() * sizeof(u32));
+                file.write(static_cast<u32>(b->native.size()));
+                file.write(b->native.data(), b->native.size());
+            }
+        }
+
+        dirty = false;
+        spdlog::info("saved {} spu blocks with {} bytes of host code to {}", total, native_size(), cache_path.string());
+    }
+
+    u64 cache_size()
+    {
+        std::lock_guard<std::mutex> guard(mut);
+        return total;
+    }
+}
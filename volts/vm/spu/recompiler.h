@@ -0,0 +1,142 @@
+#pragma once
+
+#include <types.h>
+#include <wrapfs.h>
+
+#include "decode.h"
+#include "emitter.h"
+
+#include <vector>
+#include <string_view>
+
+namespace volts::spu
+{
+    struct thread;
+
+    enum class decoder : svl::u8
+    {
+        /// decode and execute one instruction at a time
+        interpreter,
+
+        /// compile blocks to host code and keep them in the code cache
+        recompiler,
+    };
+
+    /**
+     * @brief a decoded instruction ready to execute
+     */
+    struct compiled_op
+    {
+        func_t func;
+        form op;
+    };
+
+    /**
+     * @brief a run of spu code compiled together
+     *
+     * either a straight line run ending at a branch, stop or halt, or a whole
+     * function whose local branches stay in the host code. blocks dont store their
+     * address so the same code loaded at a different place in local store or
+     * by another spu shares a block
+     */
+    struct block
+    {
+        /// xxhash of the code as it appears in local store
+        svl::u64 hash;
+
+        /// the code as it appears in local store, used to check the block is still valid
+        std::vector<svl::u32> code;
+
+        /// the decoded instructions, run when there is no host code
+        std::vector<compiled_op> ops;
+
+        /// the host code as emitted, kept to be written to the cache file
+        std::vector<svl::u8> native;
+
+        /// entry point of the host code in executable memory
+        native_t entry = nullptr;
+    };
+
+    /// blocks are split after this many instructions
+    constexpr svl::u32 max_block_size = 0x100;
+
+    /// functions are compiled up to this many instructions, the rest runs as separate blocks
+    constexpr svl::u32 max_function_size = 0x400;
+
+    /**
+     * @brief set how spu threads execute code
+     *
+     * @param mode the decoder to use
+     */
+    void set_decoder(decoder mode);
+
+    /**
+     * @brief get how spu threads execute code
+     *
+     * @return decoder the current decoder
+     */
+    decoder get_decoder();
+
+    /**
+     * @brief parse the name of a decoder
+     *
+     * @param name the name, either interpreter or recompiler
+     * @param out the parsed decoder
+     * @return true if the name was valid
+     * @return false if the name was invalid
+     */
+    bool parse_decoder(std::string_view name, decoder& out);
+
+    /**
+     * @brief find the block starting at an address, compiling it if its not cached
+     *
+     * @param spu the thread whose local store holds the code
+     * @param addr the local store address of the block
+     * @return const block* the block, valid until the program exits
+     */
+    const block* compile(const thread& spu, svl::u32 addr);
+
+    /**
+     * @brief compile a function as one block
+     *
+     * the block is used whenever execution reaches the start of the same code, and
+     * from then on for every address inside it
+     *
+     * @param spu the thread whose local store holds the code
+     * @param start the local store address of the function
+     * @param end the address after its last instruction
+     * @return const block* the block, valid until the program exits
+     */
+    const block* compile_function(const thread& spu, svl::u32 start, svl::u32 end);
+
+    /**
+     * @brief run an spu thread with the recompiler until it stops
+     *
+     * @param spu the thread to run
+     */
+    void execute(thread& spu);
+
+    /**
+     * @brief load previously compiled blocks from a file
+     *
+     * the file is also where save_cache writes new blocks to, host code
+     * from a different build of the emitter is thrown away
+     *
+     * @param path path to the cache file
+     * @return true if the cache was loaded
+     * @return false if the cache didnt exist or was invalid
+     */
+    bool load_cache(const fs::path& path);
+
+    /**
+     * @brief write every compiled block and its host code to the cache file if any were added
+     */
+    void save_cache();
+
+    /**
+     * @brief get the number of compiled blocks
+     *
+     * @return svl::u64 the number of blocks in the cache
+     */
+    svl::u64 cache_size();
+}
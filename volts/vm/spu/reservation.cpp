@@ -0,0 +1,339 @@
+#include "reservation.h"
+#include "thread.h"
+
+#include "vm.h"
+
+#include <platform.h>
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include <immintrin.h>
+
+#if CL_MSVC
+#   include <intrin.h>
+#endif
+
+// the rest of the build only assumes sse4.1 so avx code opts in per function
+#if CL_MSVC
+#   define AVX_FUNCTION
+#else
+#   define AVX_FUNCTION __attribute__((target("avx")))
+#endif
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    /**
+     * each line hashes to a stamp in a side table, stamps work like sequence locks.
+     * bit 0 is set while a writer holds the line and bit 1 while any spu has it reserved,
+     * the rest counts writes. lines that share a stamp only cause spurious failures
+     */
+    constexpr u64 locked = 1;
+    constexpr u64 watched = 2;
+    constexpr u64 stamp_step = 4;
+
+    constexpr u32 stamp_count = 0x10000;
+
+    static std::atomic<u64> stamps[stamp_count];
+
+    /**
+     * @brief an spu that may hold a reservation
+     *
+     * writers check these to deliver lost reservation events, users counts
+     * writers looking at the slot so it can be released safely
+     */
+    struct holder
+    {
+        std::atomic<thread*> spu = nullptr;
+        std::atomic<u32> users = 0;
+    };
+
+    constexpr u32 max_holders = 64;
+
+    static holder holders[max_holders];
+
+    static std::atomic<u64>& stamp_of(u32 ea)
+    {
+        return stamps[(ea / line_size) % stamp_count];
+    }
+
+    static void backoff(u32 spins)
+    {
+        if(spins < 0x40)
+            _mm_pause();
+        else
+            std::this_thread::yield();
+    }
+
+    AVX_FUNCTION static void copy_line_avx(u8* dst, const u8* src)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+    }
+
+    static void copy_line_sse(u8* dst, const u8* src)
+    {
+        __m128i v[8];
+
+        for(u32 i = 0; i < 8; i++)
+            v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16));
+
+        for(u32 i = 0; i < 8; i++)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), v[i]);
+    }
+
+    static bool has_avx()
+    {
+#if CL_MSVC
+        // the cpu has to support avx and the os has to save the ymm registers
+        int info[4];
+        __cpuid(info, 1);
+
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+        return __builtin_cpu_supports("avx");
+#endif
+    }
+
+    // whole lines are copied in one go so a reader never sees half of a write
+    static void(*const copy_line)(u8*, const u8*) = has_avx() ? copy_line_avx : copy_line_sse;
+
+    static bool equal_line(const u8* a, const u8* b)
+    {
+        __m128i diff = _mm_setzero_si128();
+
+        for(u32 i = 0; i < line_size; i += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+            diff = _mm_or_si128(diff, _mm_xor_si128(x, y));
+        }
+
+        return _mm_testz_si128(diff, diff);
+    }
+
+    static u64 lock_line(std::atomic<u64>& stamp)
+    {
+        for(u32 spins = 0;; spins++)
+        {
+            u64 old = stamp.load(std::memory_order_relaxed);
+            if(!(old & locked) && stamp.compare_exchange_weak(old, old | locked, std::memory_order_acquire))
+                return old;
+
+            backoff(spins);
+        }
+    }
+
+    /**
+     * @brief tell every spu reserving the line that it lost its reservation
+     *
+     * @return true if another line sharing the stamp is still reserved so the stamp has to stay watched
+     */
+    static bool notify(const std::atomic<u64>& stamp, u32 line, u64 time)
+    {
+        bool shared = false;
+
+        // pairs with the fence in getllar so either this sees its pending line or it sees this write
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for(auto& h : holders)
+        {
+            if(!h.spu.load(std::memory_order_relaxed))
+                continue;
+
+            h.users++;
+
+            if(thread* spu = h.spu.load())
+            {
+                u32 raddr = spu->raddr.load();
+                u32 pending = spu->rpending.load();
+
+                if(raddr == line && spu->rtime.load() < time)
+                    spu->raise(event::lr);
+                else if(raddr != no_reservation && raddr != line && &stamp_of(raddr) == &stamp)
+                    shared = true;
+
+                // a getllar that hasnt published yet would otherwise reserve a line nothing watches
+                if(pending != no_reservation && &stamp_of(pending) == &stamp)
+                    shared = true;
+            }
+
+            h.users--;
+        }
+
+        return shared;
+    }
+
+    static void unlock_line(std::atomic<u64>& stamp, u64 old, u32 line)
+    {
+        // writing a line breaks every reservation on it, the stamp is only
+        // left watched if a different line that hashes to it is reserved
+        u64 next = (old & ~(locked | watched)) + stamp_step;
+
+        if((old & watched) && notify(stamp, line, next))
+            next |= watched;
+
+        stamp.store(next, std::memory_order_release);
+    }
+
+    static void add_holder(thread& spu)
+    {
+        for(u32 i = 0; i < max_holders; i++)
+        {
+            thread* expected = nullptr;
+            if(holders[i].spu.compare_exchange_strong(expected, &spu))
+            {
+                spu.holder = i;
+                return;
+            }
+        }
+
+        spdlog::warn("too many spus using reservations, lost reservation events wont be delivered");
+        spu.holder = max_holders;
+    }
+
+    void getllar(thread& spu, u32 ea, u8* out)
+    {
+        ea &= ~(line_size - 1);
+
+        if(spu.holder == ~0u)
+            add_holder(spu);
+
+        auto& stamp = stamp_of(ea);
+        const u8* line = static_cast<const u8*>(vm::base(ea));
+
+        // writers that unlock the line from here on leave it watched
+        spu.rpending = ea;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for(u32 spins = 0;; spins++)
+        {
+            u64 before = stamp.load(std::memory_order_acquire);
+
+            if(before & locked)
+            {
+                backoff(spins);
+                continue;
+            }
+
+            // mark the line so writers know to look for reservations, skip the write if its already marked
+            if(!(before & watched))
+            {
+                if(!stamp.compare_exchange_weak(before, before | watched))
+                    continue;
+
+                before |= watched;
+            }
+
+            copy_line(spu.rdata, line);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // nothing wrote the line while it was copied
+            if(stamp.load(std::memory_order_relaxed) == before)
+            {
+                spu.rtime = before;
+                spu.raddr = ea;
+                break;
+            }
+
+            backoff(spins);
+        }
+
+        spu.rpending = no_reservation;
+
+        std::memcpy(out, spu.rdata, line_size);
+    }
+
+    bool putllc(thread& spu, u32 ea, const u8* data)
+    {
+        ea &= ~(line_size - 1);
+
+        u32 reserved = spu.raddr.exchange(no_reservation);
+        if(reserved != ea)
+            return false;
+
+        auto& stamp = stamp_of(ea);
+        u64 time = spu.rtime.load();
+
+        // take the lock only if nothing has written the line since getllar
+        if(!stamp.compare_exchange_strong(time, time | locked, std::memory_order_acquire))
+            return false;
+
+        u8* line = static_cast<u8*>(vm::base(ea));
+
+        // plain ppu stores dont go through the stamps so check the data as well
+        if(!equal_line(line, spu.rdata))
+        {
+            stamp.store(time, std::memory_order_release);
+            return false;
+        }
+
+        copy_line(line, data);
+        unlock_line(stamp, time, ea);
+
+        return true;
+    }
+
+    void putlluc(u32 ea, const u8* data)
+    {
+        ea &= ~(line_size - 1);
+
+        auto& stamp = stamp_of(ea);
+        u64 old = lock_line(stamp);
+
+        copy_line(static_cast<u8*>(vm::base(ea)), data);
+        unlock_line(stamp, old, ea);
+    }
+
+    void write_lines(u64 ea, const u8* src, u32 size, void(*copy)(u8*, const u8*, u32))
+    {
+        while(size)
+        {
+            u32 line = static_cast<u32>(ea) & ~(line_size - 1);
+            u32 part = std::min<u32>(size, line + line_size - static_cast<u32>(ea));
+
+            auto& stamp = stamp_of(line);
+            u64 old = lock_line(stamp);
+
+            copy(static_cast<u8*>(vm::base(ea)), src, part);
+            unlock_line(stamp, old, line);
+
+            ea += part;
+            src += part;
+            size -= part;
+        }
+    }
+
+    void release_reservation(thread& spu)
+    {
+        spu.raddr = no_reservation;
+
+        if(spu.holder >= max_holders)
+            return;
+
+        auto& h = holders[spu.holder];
+        h.spu = nullptr;
+
+        // wait for writers that already found this thread
+        while(h.users.load())
+            _mm_pause();
+
+        spu.holder = ~0u;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::spu
+{
+    struct thread;
+
+    /// size and alignment of the lines the atomic unit works on
+    constexpr svl::u32 line_size = 128;
+
+    /// value of thread::raddr when a thread has no reservation, never a line address
+    constexpr svl::u32 no_reservation = ~0u;
+
+    /// atomic status channel values
+    namespace atomic_stat
+    {
+        constexpr svl::u32 putllc_failure = 1;
+        constexpr svl::u32 putlluc_success = 2;
+        constexpr svl::u32 getllar_success = 4;
+    }
+
+    /**
+     * @brief read a line from main memory and reserve it
+     *
+     * @param spu the thread taking the reservation
+     * @param ea address of the line
+     * @param out where to copy the line
+     */
+    void getllar(thread& spu, svl::u32 ea, svl::u8* out);
+
+    /**
+     * @brief write a line if nothing has written to it since getllar
+     *
+     * the reservation is released either way
+     *
+     * @param spu the thread holding the reservation
+     * @param ea address of the line
+     * @param data the line to write
+     * @return true if the line was written
+     * @return false if the reservation was lost
+     */
+    bool putllc(thread& spu, svl::u32 ea, const svl::u8* data);
+
+    /**
+     * @brief write a line unconditionally, breaking any reservations on it
+     *
+     * @param ea address of the line
+     * @param data the line to write
+     */
+    void putlluc(svl::u32 ea, const svl::u8* data);
+
+    /**
+     * @brief copy into main memory one line at a time, breaking any reservations on them
+     *
+     * used by dma puts so a lock free queue updated with a plain put still wakes its waiters
+     *
+     * @param ea where to write
+     * @param src the data to write
+     * @param size the number of bytes to write
+     * @param copy how to copy the bytes within a line
+     */
+    void write_lines(svl::u64 ea, const svl::u8* src, svl::u32 size, void(*copy)(svl::u8*, const svl::u8*, svl::u32));
+
+    /**
+     * @brief stop a thread from being told its reservation was lost, called before it is destroyed
+     *
+     * @param spu the thread
+     */
+    void release_reservation(thread& spu);
+}
@@ -0,0 +1,353 @@
+#include "scheduler.h"
+#include "thread.h"
+
+#include "trace.h"
+
+#include <platform.h>
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+
+#if SYS_UNIX
+#   include <pthread.h>
+#endif
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    using clock = std::chrono::steady_clock;
+
+    /// how long a thread runs before its swapped out for a waiting thread
+    constexpr auto quantum = std::chrono::milliseconds(1);
+
+    struct group
+    {
+        std::vector<thread*> threads;
+
+        /// runs the threads instead of thread::run, may be null
+        kernel body = nullptr;
+
+        /// threads that havent stopped yet
+        u32 running = 0;
+    };
+
+    /**
+     * @brief a host thread standing in for one physical spu
+     */
+    struct slot
+    {
+        std::thread host;
+
+        /// the thread being run, null while idle
+        thread* current = nullptr;
+
+        /// when current was swapped in
+        clock::time_point since;
+
+        std::atomic<u64> busy_ns = 0;
+        std::atomic<u64> switches = 0;
+    };
+
+    /**
+     * @brief a thread waiting for a slot
+     */
+    struct runnable
+    {
+        thread* spu;
+        u32 group;
+
+        /// the group and index in the group, names the thread in traces
+        u32 name;
+    };
+
+    static std::mutex mut;
+
+    // workers wait on work, joiners on finished and the ticker on tick
+    static std::condition_variable work;
+    static std::condition_variable finished;
+    static std::condition_variable tick;
+
+    static std::deque<runnable> queue;
+    static std::unordered_map<u32, group> groups;
+    static u32 next_id = 1;
+
+    static slot slots[physical_spus];
+    static std::thread ticker;
+    static std::vector<u32> cores;
+
+    static bool started = false;
+    static bool stopping = false;
+    static clock::time_point start_time;
+
+    static u64 elapsed_ns(clock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - since).count();
+    }
+
+    static void pin(std::thread& host, u32 core)
+    {
+#if SYS_WINDOWS
+        if(SetThreadAffinityMask(host.native_handle(), 1ull << core) == 0)
+            spdlog::warn("failed to pin spu thread to core {}", core);
+#elif SYS_UNIX
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+
+        if(pthread_setaffinity_np(host.native_handle(), sizeof(set), &set) != 0)
+            spdlog::warn("failed to pin spu thread to core {}", core);
+#else
+        spdlog::warn("pinning threads to cores isnt supported on this platform");
+#endif
+    }
+
+    // must be called with mut held
+    static std::deque<runnable>::iterator find_runnable(u32 name)
+    {
+        return std::find_if(queue.begin(), queue.end(), [name](auto& r) { return r.name == name; });
+    }
+
+    static void worker(u32 index)
+    {
+        auto& self = slots[index];
+        u32 host = vm::trace::thread_kind::host | index;
+
+        vm::trace::attach(host);
+
+        std::unique_lock<std::mutex> lock(mut);
+
+        while(true)
+        {
+            runnable next;
+
+            if(vm::trace::replaying())
+            {
+                // the trace says which thread this slot ran next, it may not be queued yet
+                lock.unlock();
+                u32 name = static_cast<u32>(vm::trace::input(vm::trace::input_type::schedule, 0));
+                lock.lock();
+
+                // the trace ended so this slot goes back to scheduling live
+                if(!vm::trace::replaying())
+                    continue;
+
+                work.wait(lock, [name] { return stopping || find_runnable(name) != queue.end(); });
+
+                if(stopping)
+                    return;
+
+                auto it = find_runnable(name);
+                next = *it;
+                queue.erase(it);
+            }
+            else
+            {
+                work.wait(lock, [] { return stopping || !queue.empty(); });
+
+                if(stopping)
+                    return;
+
+                next = queue.front();
+                queue.pop_front();
+
+                vm::trace::input(vm::trace::input_type::schedule, next.name);
+            }
+
+            self.current = next.spu;
+            self.since = clock::now();
+            next.spu->preempt.clear();
+
+            kernel body = groups[next.group].body;
+
+            lock.unlock();
+            vm::trace::attach(next.name);
+
+            if(body)
+                body(*next.spu);
+            else
+                next.spu->run();
+
+            vm::trace::attach(host);
+            self.busy_ns += elapsed_ns(self.since);
+            lock.lock();
+
+            self.current = nullptr;
+
+            if(next.spu->stopped)
+            {
+                if(--groups[next.group].running == 0)
+                    finished.notify_all();
+            }
+            else
+            {
+                // swapped out, each thread owns its local store and registers so theres nothing to copy
+                self.switches++;
+
+                if(!stopping)
+                {
+                    queue.push_back(next);
+                    work.notify_all();
+                }
+            }
+        }
+    }
+
+    // only swaps threads out while others are waiting for a slot
+    static void preempter()
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        while(!tick.wait_for(lock, quantum, [] { return stopping; }))
+        {
+            if(queue.empty())
+                continue;
+
+            for(auto& s : slots)
+                if(s.current && clock::now() - s.since >= quantum)
+                    s.current->preempt.request();
+        }
+    }
+
+    // must be called with mut held
+    static void start_scheduler()
+    {
+        started = true;
+        stopping = false;
+        start_time = clock::now();
+
+        for(u32 i = 0; i < physical_spus; i++)
+        {
+            slots[i].busy_ns = 0;
+            slots[i].switches = 0;
+            slots[i].host = std::thread(worker, i);
+
+            if(i < cores.size())
+                pin(slots[i].host, cores[i]);
+        }
+
+        ticker = std::thread(preempter);
+    }
+
+    void pin_spus(const std::vector<u32>& list)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(started)
+            spdlog::warn("spu threads are already running, pinning will apply next time the scheduler starts");
+
+        cores = list;
+    }
+
+    u32 create_group(const std::vector<thread*>& threads, kernel body)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(!started)
+            start_scheduler();
+
+        u32 id = next_id++;
+        groups[id].threads = threads;
+        groups[id].body = body;
+
+        return id;
+    }
+
+    void start_group(u32 id)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto& g = groups[id];
+        g.running = static_cast<u32>(g.threads.size());
+
+        for(u32 i = 0; i < g.threads.size(); i++)
+            queue.push_back({ g.threads[i], id, vm::trace::thread_kind::spu | (id << 8) | i });
+
+        if(g.threads.size() > physical_spus)
+            spdlog::info("spu group {} has {} threads, they will share {} spus", id, g.threads.size(), physical_spus);
+
+        work.notify_all();
+    }
+
+    void join_group(u32 id)
+    {
+        std::unique_lock<std::mutex> lock(mut);
+        finished.wait(lock, [id] { return stopping || groups[id].running == 0; });
+    }
+
+    void destroy_group(u32 id)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(auto it = groups.find(id); it != groups.end())
+        {
+            if(it->second.running)
+                spdlog::error("destroying spu group {} while {} threads are running", id, it->second.running);
+
+            groups.erase(it);
+        }
+    }
+
+    utilization get_utilization(u32 slot)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(!started)
+            return {};
+
+        auto& s = slots[slot];
+        u64 busy = s.busy_ns;
+
+        // include the time the current thread has been running
+        if(s.current)
+            busy += elapsed_ns(s.since);
+
+        return { busy, elapsed_ns(start_time), s.switches };
+    }
+
+    void stop_scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mut);
+
+            if(!started)
+                return;
+
+            stopping = true;
+
+            // threads blocked on a channel are woken and return to their run loop
+            for(auto& s : slots)
+                if(s.current)
+                    s.current->preempt.request();
+
+            work.notify_all();
+            finished.notify_all();
+            tick.notify_all();
+        }
+
+        for(auto& s : slots)
+            s.host.join();
+
+        ticker.join();
+
+        for(u32 i = 0; i < physical_spus; i++)
+        {
+            auto use = get_utilization(i);
+            spdlog::info("spu {} was busy {:.1f}% of the time and switched threads {} times",
+                i, use.total_ns ? (use.busy_ns * 100.0) / use.total_ns : 0.0, use.switches);
+        }
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        queue.clear();
+        groups.clear();
+        started = false;
+    }
+}
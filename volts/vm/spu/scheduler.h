@@ -0,0 +1,94 @@
+#pragma once
+
+#include <types.h>
+
+#include <vector>
+
+namespace volts::spu
+{
+    struct thread;
+
+    /// number of spus games can use, the seventh is reserved by the os and the eighth is disabled
+    constexpr svl::u32 physical_spus = 6;
+
+    /**
+     * @brief how much work an spu slot has done since the scheduler started
+     */
+    struct utilization
+    {
+        /// time spent running spu code
+        svl::u64 busy_ns;
+
+        /// time since the scheduler started
+        svl::u64 total_ns;
+
+        /// number of times a thread was swapped out before it stopped
+        svl::u64 switches;
+    };
+
+    /**
+     * @brief pin the host thread of each spu slot to a core
+     *
+     * must be called before the first group is created, an empty list leaves placement to the os
+     *
+     * @param cores the core of each slot, slots past the end of the list are not pinned
+     */
+    void pin_spus(const std::vector<svl::u32>& cores);
+
+    /**
+     * @brief host code that runs a thread in place of thread::run
+     *
+     * stands in for a kernel that lives on the spu and feeds it work, it must follow
+     * the same rules as thread::run. return with the thread stopped once its done and
+     * with it not stopped when its preempted, it is then run again later
+     */
+    using kernel = void(*)(thread& spu);
+
+    /**
+     * @brief create a thread group, starting the scheduler if it isnt running
+     *
+     * groups may have more threads than there are spus, the extra
+     * threads share slots and are swapped in and out
+     *
+     * @param threads the threads in the group, must outlive the group
+     * @param body runs the threads instead of thread::run, null to run them directly
+     * @return svl::u32 the id of the group
+     */
+    svl::u32 create_group(const std::vector<thread*>& threads, kernel body = nullptr);
+
+    /**
+     * @brief start running every thread in a group
+     *
+     * @param id the group to start
+     */
+    void start_group(svl::u32 id);
+
+    /**
+     * @brief wait for every thread in a group to stop
+     *
+     * @param id the group to wait on
+     */
+    void join_group(svl::u32 id);
+
+    /**
+     * @brief destroy a group that has stopped
+     *
+     * @param id the group to destroy
+     */
+    void destroy_group(svl::u32 id);
+
+    /**
+     * @brief get how busy an spu slot has been
+     *
+     * @param slot the slot, less than physical_spus
+     * @return utilization the counters of the slot
+     */
+    utilization get_utilization(svl::u32 slot);
+
+    /**
+     * @brief stop the scheduler and log how busy each spu was
+     *
+     * threads still running are swapped out and left where they stopped
+     */
+    void stop_scheduler();
+}
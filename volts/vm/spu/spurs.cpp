@@ -0,0 +1,1228 @@
+#include "spurs.h"
+#include "thread.h"
+#include "image.h"
+#include "scheduler.h"
+
+#include "vm.h"
+#include "trace.h"
+#include "sys/syscall.h"
+#include "ppu/patch.h"
+
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+namespace volts::spu
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// spurs core errors, task and job errors are the same codes offset into their own range
+    namespace error
+    {
+        constexpr u32 again = 0x80410701;
+        constexpr u32 inval = 0x80410702;
+        constexpr u32 srch = 0x80410705;
+        constexpr u32 stat = 0x8041070F;
+        constexpr u32 align = 0x80410710;
+        constexpr u32 null_pointer = 0x80410711;
+
+        constexpr u32 task = 0x200;
+        constexpr u32 job = 0x300;
+    }
+
+    /// spurs, tasksets and job chains must be aligned to this in guest memory
+    constexpr u32 object_align = 128;
+
+    constexpr u32 max_tasks = 128;
+
+    /// how deep job chain calls can nest
+    constexpr u32 max_calls = 8;
+
+    /**
+     * @brief the header every job descriptor starts with
+     *
+     * the dma list follows it, one entry per input with the size
+     * in the upper word and the low half of the address in the lower
+     */
+    struct job_header
+    {
+        big<u64> binary;
+
+        /// in 16 byte units
+        big<u16> binary_size;
+
+        /// in bytes, 8 per entry
+        big<u16> dma_list_size;
+
+        big<u32> input_high;
+        big<u32> use_inout;
+        big<u32> input_size;
+        big<u32> output_size;
+
+        /// in 16 byte units
+        big<u16> stack_size;
+        big<u16> scratch_size;
+
+        big<u32> cache_high;
+        big<u32> cache_list_size;
+
+        pad padding[8];
+    };
+
+    static_assert(sizeof(job_header) == 48);
+
+    /// a job list command points at one of these
+    struct job_list
+    {
+        big<u32> count;
+        big<u32> stride;
+        big<u64> jobs;
+    };
+
+    static_assert(sizeof(job_list) == 16);
+
+    /// job chain command opcodes, the low 3 bits of a command
+    namespace job_op
+    {
+        constexpr u32 job = 0;
+        constexpr u32 reset_pc = 1;
+        constexpr u32 sync = 2;
+        constexpr u32 next = 3;
+        constexpr u32 call = 4;
+        constexpr u32 flush = 5;
+        constexpr u32 list = 6;
+        constexpr u32 extended = 7;
+
+        /// extended opcodes in the next 4 bits
+        constexpr u32 abort = 0;
+        constexpr u32 ret = 14;
+        constexpr u32 end = 15;
+    }
+
+    struct task
+    {
+        u32 id;
+        u32 elf;
+        v128 arg;
+    };
+
+    /// attributes must be aligned to this in guest memory
+    constexpr u32 attribute_align = 8;
+
+    /// the longest name prefix an instance can be given
+    constexpr u32 max_name_prefix = 15;
+
+    /**
+     * @brief what the hle keeps in a CellSpursAttribute
+     *
+     * the structure is opaque to the guest, it only ever hands it back to the library
+     */
+    struct spurs_attribute
+    {
+        big<u32> revision;
+        big<u32> sdk_version;
+        big<u32> spus;
+        big<i32> spu_priority;
+        big<i32> ppu_priority;
+        u8 exit_if_no_work;
+        char name_prefix[max_name_prefix + 1];
+        pad padding[3];
+        big<i32> group_type;
+        big<u32> container;
+    };
+
+    static_assert(sizeof(spurs_attribute) == 48);
+
+    /// what the hle keeps in a CellSpursTaskAttribute, the argument is copied so it can go out of scope
+    struct task_attribute
+    {
+        big<u32> elf;
+        big<u32> context;
+        big<u32> context_size;
+        big<u32> pattern;
+        u8 arg[16];
+    };
+
+    static_assert(sizeof(task_attribute) == 32);
+
+    enum class workload_kind { taskset, job_chain };
+
+    enum class chain_state { idle, running, ending, finished };
+
+    /**
+     * @brief a taskset or job chain, the guest structure only identifies it
+     */
+    struct workload
+    {
+        workload_kind kind;
+
+        /// address of the guest structure
+        u32 addr;
+
+        /// lower runs first
+        u8 priority;
+
+        /// most spus that may run it at once
+        u32 max_contention;
+
+        /// spus running it right now
+        u32 running = 0;
+
+        // tasksets
+
+        u64 args = 0;
+        std::deque<task> ready;
+        std::map<u32, i32> exited;
+        u32 next_id = 0;
+        bool shutdown = false;
+
+        // job chains
+
+        u32 commands = 0;
+        u32 descriptor_size = 0;
+        u32 pc = 0;
+        std::vector<u32> calls;
+
+        /// remaining jobs of the job list being walked
+        u32 list_ea = 0;
+        u32 list_count = 0;
+        u32 list_stride = 0;
+
+        /// the job the next spu picks up, found ahead of time so scheduling knows if there is work
+        u32 next_job = 0;
+
+        chain_state state = chain_state::idle;
+        u64 jobs_run = 0;
+
+        /// ppu threads waiting on it, it is only freed once they have all left
+        u32 joiners = 0;
+
+        /// joined and waiting for its joiners to leave, lookups no longer find it
+        bool removed = false;
+    };
+
+    /**
+     * @brief one piece of work handed to a worker
+     */
+    struct work
+    {
+        workload* owner;
+        task job_task;
+        u32 job;
+    };
+
+    struct instance;
+
+    /**
+     * @brief an spu of an instance, run by the spu scheduler like any other spu thread
+     */
+    struct worker : thread
+    {
+        instance* inst;
+
+        /// the work being run, only valid while busy
+        work item = {};
+        bool busy = false;
+
+        /// the pick a replay says comes next, read from the trace before that work is ready
+        u64 recorded = 0;
+        bool has_recorded = false;
+    };
+
+    struct instance
+    {
+        u32 addr;
+        u32 spus;
+        bool stopping = false;
+
+        std::vector<std::unique_ptr<workload>> workloads;
+        std::vector<std::unique_ptr<worker>> workers;
+
+        /// the scheduler group the workers run in
+        u32 sched = 0;
+    };
+
+    // scheduling state is small and touched briefly so a single lock covers every instance
+    static std::mutex mut;
+    static std::condition_variable changed;
+
+    // bumped whenever there may be new work, idle workers park on it so the scheduler can preempt them
+    static std::atomic<u32> generation = 0;
+    static std::atomic<u32> sleepers = 0;
+
+    static std::map<u32, std::unique_ptr<instance>> instances;
+
+    // wake idle workers and waiting ppu threads, must be called with mut held
+    static void notify()
+    {
+        generation++;
+        unpark(generation, sleepers);
+        changed.notify_all();
+    }
+
+    static instance* find_instance(u32 addr)
+    {
+        auto it = instances.find(addr);
+        return it == instances.end() ? nullptr : it->second.get();
+    }
+
+    static workload* find_workload(u32 addr, workload_kind kind)
+    {
+        for(auto& [_, inst] : instances)
+            for(auto& w : inst->workloads)
+                if(w->addr == addr && w->kind == kind && !w->removed)
+                    return w.get();
+
+        return nullptr;
+    }
+
+    static void remove_workload(workload* w)
+    {
+        for(auto& [_, inst] : instances)
+        {
+            auto& all = inst->workloads;
+            all.erase(std::remove_if(all.begin(), all.end(), [w](auto& it) { return it.get() == w; }), all.end());
+        }
+    }
+
+    // leave a workload after waiting on it, the last joiner out frees it once its been joined
+    static void release(workload* w)
+    {
+        if(--w->joiners)
+            return;
+
+        if(w->removed)
+            remove_workload(w);
+
+        // finalize waits for the last joiner to leave
+        changed.notify_all();
+    }
+
+    // a chain ends once the jobs it already handed out are done
+    static void end_chain(workload& chain)
+    {
+        chain.next_job = 0;
+        chain.list_count = 0;
+        chain.state = chain.running ? chain_state::ending : chain_state::finished;
+
+        notify();
+    }
+
+    // walk the command list until a job is found or the chain has to wait
+    static void advance(workload& chain)
+    {
+        while(!chain.next_job && chain.state == chain_state::running)
+        {
+            if(chain.list_count)
+            {
+                chain.next_job = chain.list_ea;
+                chain.list_ea += chain.list_stride;
+                chain.list_count--;
+                return;
+            }
+
+            u64 cmd = vm::ref<big<u64>>(chain.pc);
+            u32 ea = static_cast<u32>(cmd) & ~7u;
+
+            switch(cmd & 7)
+            {
+            case job_op::job:
+                chain.next_job = ea;
+                chain.pc += 8;
+                break;
+            case job_op::sync:
+                // every job before the sync has to finish before anything after it starts
+                if(chain.running)
+                    return;
+
+                chain.pc += 8;
+                break;
+            case job_op::next:
+                chain.pc = ea;
+                break;
+            case job_op::call:
+                if(chain.calls.size() == max_calls)
+                {
+                    spdlog::error("job chain {:x} nested calls too deep at {:x}", chain.addr, chain.pc);
+                    end_chain(chain);
+                    return;
+                }
+
+                chain.calls.push_back(chain.pc + 8);
+                chain.pc = ea;
+                break;
+            case job_op::list:
+            {
+                auto& list = vm::ref<job_list>(ea);
+                chain.list_ea = static_cast<u32>(list.jobs.get());
+                chain.list_count = list.count;
+                chain.list_stride = list.stride;
+                chain.pc += 8;
+                break;
+            }
+            case job_op::extended:
+                switch((cmd >> 3) & 15)
+                {
+                case job_op::ret:
+                    if(!chain.calls.empty())
+                    {
+                        chain.pc = chain.calls.back();
+                        chain.calls.pop_back();
+                        break;
+                    }
+
+                    // returning from the top of the chain ends it
+                    [[fallthrough]];
+                case job_op::end:
+                case job_op::abort:
+                    end_chain(chain);
+                    return;
+                default:
+                    // guards and labels only matter to the ppu waiting on them
+                    spdlog::debug("skipping job chain command {:x} at {:x}", cmd, chain.pc);
+                    chain.pc += 8;
+                    break;
+                }
+                break;
+            default:
+                // nop, reset pc and flush have nothing to do on the host
+                chain.pc += 8;
+                break;
+            }
+        }
+    }
+
+    static bool has_work(workload& w)
+    {
+        if(w.running >= w.max_contention)
+            return false;
+
+        if(w.kind == workload_kind::taskset)
+            return !w.ready.empty();
+
+        advance(w);
+        return w.next_job != 0;
+    }
+
+    // the scheduling decision the spurs kernel would make, the highest priority
+    // workload with work runs and ties go to whichever has the fewest spus
+    static bool pick(instance& inst, work& out)
+    {
+        workload* best = nullptr;
+
+        for(auto& w : inst.workloads)
+        {
+            if(!has_work(*w))
+                continue;
+
+            if(!best || w->priority < best->priority || (w->priority == best->priority && w->running < best->running))
+                best = w.get();
+        }
+
+        if(!best)
+            return false;
+
+        out.owner = best;
+        best->running++;
+
+        if(best->kind == workload_kind::taskset)
+        {
+            out.job_task = best->ready.front();
+            best->ready.pop_front();
+        }
+        else
+        {
+            out.job = best->next_job;
+            best->next_job = 0;
+            best->jobs_run++;
+        }
+
+        return true;
+    }
+
+    // a pick as the index of the workload and the task id or job address it handed out
+    static u64 pick_name(instance& inst, const work& item)
+    {
+        auto it = std::find_if(inst.workloads.begin(), inst.workloads.end(), [&](auto& w) { return w.get() == item.owner; });
+        u64 index = std::distance(inst.workloads.begin(), it);
+
+        return (index << 32) | (item.owner->kind == workload_kind::taskset ? item.job_task.id : item.job);
+    }
+
+    // make the pick a recorded run made once the workload has that work ready
+    static bool pick_recorded(instance& inst, u64 name, work& out)
+    {
+        // the trace ended so picks are live again
+        if(!vm::trace::replaying())
+            return pick(inst, out);
+
+        u32 index = static_cast<u32>(name >> 32);
+        u32 which = static_cast<u32>(name);
+
+        if(index >= inst.workloads.size() || !has_work(*inst.workloads[index]))
+            return false;
+
+        auto& w = *inst.workloads[index];
+
+        if(w.kind == workload_kind::taskset)
+        {
+            auto it = std::find_if(w.ready.begin(), w.ready.end(), [which](auto& t) { return t.id == which; });
+            if(it == w.ready.end())
+                return false;
+
+            out.job_task = *it;
+            w.ready.erase(it);
+        }
+        else
+        {
+            if(w.next_job != which)
+                return false;
+
+            out.job = w.next_job;
+            w.next_job = 0;
+            w.jobs_run++;
+        }
+
+        out.owner = &w;
+        w.running++;
+
+        return true;
+    }
+
+    static void reset(thread& spu, u32 entry)
+    {
+        std::memset(spu.gpr, 0, sizeof(spu.gpr));
+
+        // return from main into a stop instruction
+        u32 exit = endian::byte_swap(spurs_exit_signal);
+        std::memcpy(spu.ls.get() + spurs_ls::exit, &exit, sizeof(u32));
+
+        // registers hold their bytes reversed so word 3 is the preferred slot
+        spu.gpr[0].words[3] = spurs_ls::exit;
+        spu.gpr[1].words[3] = spurs_ls::stack;
+
+        spu.pc = entry;
+        spu.stopped = false;
+        spu.stop_code = 0;
+    }
+
+    static bool start_task(thread& spu, workload& taskset, const task& t)
+    {
+        // only the headers are read until the real size is known
+        u64 size = image_size(static_cast<const u8*>(vm::base(t.elf)), 0x100000000ull - t.elf);
+        if(!size)
+        {
+            spdlog::error("task {} of taskset {:x} has no spu executable at {:x}", t.id, taskset.addr, t.elf);
+            return false;
+        }
+
+        auto begin = static_cast<const u8*>(vm::base(t.elf));
+        auto file = svl::from(std::vector<u8>(begin, begin + size));
+
+        auto exec = elf::load<elf::spu_exec>(file);
+        if(!exec)
+            return false;
+
+        auto image = exec.value();
+        auto entry = load_image(spu, image);
+        if(!entry)
+            return false;
+
+        reset(spu, entry.value());
+
+        // cellSpursTaskMain(qword argTask, uint64_t argTaskset)
+        spu.gpr[3] = t.arg;
+        spu.gpr[4].dwords[1] = taskset.args;
+
+        return true;
+    }
+
+    static u32 align16(u32 val)
+    {
+        return (val + 15) & ~15;
+    }
+
+    static bool start_job(thread& spu, workload& chain, u32 ea)
+    {
+        u8* ls = spu.ls.get();
+        auto& head = vm::ref<job_header>(ea);
+
+        std::memcpy(ls + spurs_ls::descriptor, &head, std::min(chain.descriptor_size, spurs_ls::binary - spurs_ls::descriptor));
+
+        u32 binary_size = head.binary_size.get() * 16;
+        u32 io = (spurs_ls::binary + binary_size + 127) & ~127;
+
+        // gather the inputs into the io buffer
+        auto list = reinterpret_cast<const big<u64>*>(&head + 1);
+        u32 offset = 0;
+
+        for(u32 i = 0; i < head.dma_list_size / 8; i++)
+        {
+            u64 entry = list[i];
+            u32 part = static_cast<u32>(entry >> 32) & 0x7FFF;
+
+            if(io + offset + part > spurs_ls::stack)
+                break;
+
+            std::memcpy(ls + io + offset, vm::base(static_cast<u32>(entry)), part);
+            offset = align16(offset + part);
+        }
+
+        u32 io_size = std::max<u32>(offset, align16(head.input_size));
+        u32 out = io + (head.use_inout ? 0 : io_size);
+        u32 scratch = align16(out + head.output_size);
+        u32 end = scratch + head.scratch_size.get() * 16 + head.stack_size.get() * 16;
+
+        if(end > spurs_ls::stack || head.dma_list_size > chain.descriptor_size)
+        {
+            spdlog::error("job {:x} of job chain {:x} doesnt fit in local store", ea, chain.addr);
+            return false;
+        }
+
+        std::memcpy(ls + spurs_ls::binary, vm::base(head.binary.get()), binary_size);
+
+        auto& ctx = *reinterpret_cast<job_context*>(ls + spurs_ls::context);
+        ctx.io_buffer = endian::byte_swap(io);
+        ctx.io_size = endian::byte_swap(io_size);
+        ctx.output_buffer = endian::byte_swap(out);
+        ctx.scratch_buffer = endian::byte_swap(scratch);
+        ctx.descriptor = endian::byte_swap(u64(ea));
+        ctx.dma_tag = 0;
+
+        reset(spu, spurs_ls::binary);
+
+        // cellSpursJobMain2(CellSpursJobContext2* context, CellSpursJob256* job)
+        spu.gpr[3].words[3] = spurs_ls::context;
+        spu.gpr[4].words[3] = spurs_ls::descriptor;
+
+        return true;
+    }
+
+    // load the picked work into local store, returns false if it cant run
+    static bool start(worker& self)
+    {
+        auto& item = self.item;
+
+        if(item.owner->kind == workload_kind::taskset)
+            return start_task(self, *item.owner, item.job_task);
+
+        return start_job(self, *item.owner, item.job);
+    }
+
+    static void finish(work& item, i32 code)
+    {
+        workload& w = *item.owner;
+        w.running--;
+
+        if(w.kind == workload_kind::taskset)
+            w.exited[item.job_task.id] = code;
+        else if(w.state == chain_state::ending && !w.running)
+            w.state = chain_state::finished;
+    }
+
+    static void complete(worker& self, bool ran)
+    {
+        auto& item = self.item;
+        i32 code = -1;
+
+        if(item.owner->kind == workload_kind::taskset)
+        {
+            if(ran)
+                code = static_cast<i32>(self.gpr[3].words[3]);
+        }
+        else if(ran && self.stop_code != spurs_exit_signal)
+        {
+            spdlog::warn("job {:x} of job chain {:x} stopped with {:x} at {:x}", item.job, item.owner->addr, self.stop_code, self.pc);
+        }
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        finish(item, code);
+        self.busy = false;
+
+        notify();
+    }
+
+    // wait for work, returns false if the worker was preempted or its instance is stopping
+    static bool next_work(worker& self)
+    {
+        instance& inst = *self.inst;
+
+        std::unique_lock<std::mutex> lock(mut);
+
+        while(!inst.stopping)
+        {
+            if(vm::trace::replaying() && !self.has_recorded)
+            {
+                lock.unlock();
+                self.recorded = vm::trace::input(vm::trace::input_type::schedule, 0);
+                self.has_recorded = true;
+                lock.lock();
+
+                continue;
+            }
+
+            if(self.has_recorded ? pick_recorded(inst, self.recorded, self.item) : pick(inst, self.item))
+            {
+                if(!self.has_recorded)
+                    vm::trace::input(vm::trace::input_type::schedule, pick_name(inst, self.item));
+
+                self.has_recorded = false;
+                return true;
+            }
+
+            u32 old = generation.load();
+            lock.unlock();
+
+            if(!park(generation, old, sleepers, &self.preempt))
+                return false;
+
+            lock.lock();
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief stands in for the spurs kernel, feeds a worker work until its instance stops
+     *
+     * returns whenever the scheduler preempts the worker and carries on with the
+     * same work when its run again, local store is reused between pieces of work
+     */
+    static void run_kernel(thread& spu)
+    {
+        auto& self = static_cast<worker&>(spu);
+
+        while(true)
+        {
+            if(!self.busy)
+            {
+                if(!next_work(self))
+                {
+                    // either the scheduler wants the slot back or there will be no more work
+                    std::lock_guard<std::mutex> guard(mut);
+                    self.stopped = self.inst->stopping;
+                    return;
+                }
+
+                self.busy = true;
+
+                if(!start(self))
+                {
+                    complete(self, false);
+                    continue;
+                }
+            }
+
+            self.run();
+
+            // swapped out partway through, the scheduler runs it again later
+            if(!self.stopped)
+                return;
+
+            complete(self, true);
+        }
+    }
+
+    static u8 lowest(vm::ptr<u8> priorities, u32 count)
+    {
+        if(!priorities)
+            return 0;
+
+        return *std::min_element(priorities.get(), priorities.get() + count);
+    }
+
+    static u32 spurs_initialize(vm::ptr<u8> spurs, u32 spus, i32 spu_priority, i32 ppu_priority, bool exit_if_no_work)
+    {
+        if(!spurs)
+            return error::null_pointer;
+
+        if(spurs.addr() % object_align)
+            return error::align;
+
+        if(!spus || spus > physical_spus)
+            return error::inval;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(find_instance(spurs.addr()))
+            return error::stat;
+
+        auto inst = std::make_unique<instance>();
+        inst->addr = spurs.addr();
+        inst->spus = spus;
+
+        std::vector<thread*> threads;
+        for(u32 i = 0; i < spus; i++)
+        {
+            auto w = std::make_unique<worker>();
+            w->inst = inst.get();
+            threads.push_back(w.get());
+            inst->workers.push_back(std::move(w));
+        }
+
+        // the workers share the spus with every other thread group
+        inst->sched = create_group(threads, run_kernel);
+        start_group(inst->sched);
+
+        instances[spurs.addr()] = std::move(inst);
+
+        spdlog::info("spurs {:x} initialized with {} spus", spurs.addr(), spus);
+
+        return 0;
+    }
+
+    static u32 attribute_initialize(vm::ptr<spurs_attribute> attr, u32 revision, u32 sdk_version, u32 spus, i32 spu_priority, i32 ppu_priority, bool exit_if_no_work)
+    {
+        if(!attr)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        std::memset(attr.get(), 0, sizeof(spurs_attribute));
+
+        attr->revision = endian::byte_swap(revision);
+        attr->sdk_version = endian::byte_swap(sdk_version);
+        attr->spus = endian::byte_swap(spus);
+        attr->spu_priority = endian::byte_swap(spu_priority);
+        attr->ppu_priority = endian::byte_swap(ppu_priority);
+        attr->exit_if_no_work = exit_if_no_work;
+
+        return 0;
+    }
+
+    static u32 attribute_set_name_prefix(vm::ptr<spurs_attribute> attr, vm::ptr<char> prefix, u32 size)
+    {
+        if(!attr || !prefix)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        if(size > max_name_prefix)
+            return error::inval;
+
+        std::memset(attr->name_prefix, 0, sizeof(attr->name_prefix));
+        std::memcpy(attr->name_prefix, prefix.get(), size);
+
+        return 0;
+    }
+
+    static u32 attribute_set_group_type(vm::ptr<spurs_attribute> attr, i32 type)
+    {
+        if(!attr)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        // the workers always share the spus with other groups so the type is only kept
+        attr->group_type = endian::byte_swap(type);
+
+        return 0;
+    }
+
+    static u32 attribute_set_container(vm::ptr<spurs_attribute> attr, u32 container)
+    {
+        if(!attr)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        attr->container = endian::byte_swap(container);
+
+        return 0;
+    }
+
+    static u32 attribute_enable_spu_printf(vm::ptr<spurs_attribute> attr)
+    {
+        if(!attr)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        // nothing is printed from the spus so there is nothing to enable
+        return 0;
+    }
+
+    static u32 initialize_with_attribute(vm::ptr<u8> spurs, vm::ptr<spurs_attribute> attr)
+    {
+        if(!attr)
+            return error::null_pointer;
+
+        if(attr.addr() % attribute_align)
+            return error::align;
+
+        if(attr->name_prefix[0])
+            spdlog::debug("spurs {:x} is named {}", spurs.addr(), attr->name_prefix);
+
+        return spurs_initialize(spurs, attr->spus, attr->spu_priority, attr->ppu_priority, attr->exit_if_no_work);
+    }
+
+    static void stop_instance(std::unique_ptr<instance> inst)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mut);
+            inst->stopping = true;
+
+            // work that hasnt started never will, so joiners wake once the running work is done
+            for(auto& w : inst->workloads)
+            {
+                if(w->kind == workload_kind::taskset)
+                {
+                    w->shutdown = true;
+                    w->ready.clear();
+                }
+                else if(w->state == chain_state::running)
+                {
+                    end_chain(*w);
+                }
+            }
+
+            notify();
+        }
+
+        // workers finish what they were running before they stop
+        join_group(inst->sched);
+        destroy_group(inst->sched);
+
+        // the instance is already out of the map so no new joiners can find its workloads,
+        // the ones already waiting hold pointers into it until they leave
+        std::unique_lock<std::mutex> lock(mut);
+        changed.wait(lock, [&] {
+            return std::all_of(inst->workloads.begin(), inst->workloads.end(), [](auto& w) { return w->joiners == 0; });
+        });
+    }
+
+    static u32 spurs_finalize(vm::ptr<u8> spurs)
+    {
+        std::unique_ptr<instance> inst;
+
+        {
+            std::lock_guard<std::mutex> guard(mut);
+
+            auto it = instances.find(spurs.addr());
+            if(it == instances.end())
+                return error::stat;
+
+            inst = std::move(it->second);
+            instances.erase(it);
+        }
+
+        stop_instance(std::move(inst));
+
+        return 0;
+    }
+
+    static u32 create_taskset(vm::ptr<u8> spurs, vm::ptr<u8> taskset, u64 args, vm::ptr<u8> priorities, u32 max_contention)
+    {
+        if(!spurs || !taskset)
+            return error::null_pointer + error::task;
+
+        if(taskset.addr() % object_align)
+            return error::align + error::task;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        instance* inst = find_instance(spurs.addr());
+        if(!inst)
+            return error::stat + error::task;
+
+        auto w = std::make_unique<workload>();
+        w->kind = workload_kind::taskset;
+        w->addr = taskset.addr();
+        w->priority = lowest(priorities, inst->spus);
+        w->max_contention = std::clamp<u32>(max_contention, 1, inst->spus);
+        w->args = args;
+
+        inst->workloads.push_back(std::move(w));
+
+        return 0;
+    }
+
+    static u32 create_task(vm::ptr<u8> taskset, vm::ptr<big<u32>> id, u32 elf, u32 context, u32 size, u32 pattern, vm::ptr<u8> arg)
+    {
+        if(!taskset || !id || !elf)
+            return error::null_pointer + error::task;
+
+        if(elf % 16)
+            return error::align + error::task;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        workload* w = find_workload(taskset.addr(), workload_kind::taskset);
+        if(!w || w->shutdown)
+            return error::stat + error::task;
+
+        if(w->next_id == max_tasks)
+            return error::again + error::task;
+
+        task t = { w->next_id++, elf, {} };
+
+        for(u32 i = 0; arg && i < 16; i++)
+            t.arg.bytes[15 - i] = arg.get()[i];
+
+        // tasks run to completion so the context save area is never used
+        if(context)
+            spdlog::debug("task {} of taskset {:x} has a context save area that wont be used", t.id, w->addr);
+
+        w->ready.push_back(t);
+        *id = endian::byte_swap(t.id);
+
+        notify();
+
+        return 0;
+    }
+
+    static u32 task_attribute_initialize(vm::ptr<task_attribute> attr, u32 revision, u32 size, u32 elf, u32 context, u32 context_size, u32 pattern, vm::ptr<u8> arg)
+    {
+        if(!attr || !elf)
+            return error::null_pointer + error::task;
+
+        if(attr.addr() % attribute_align)
+            return error::align + error::task;
+
+        if(elf % 16)
+            return error::align + error::task;
+
+        std::memset(attr.get(), 0, sizeof(task_attribute));
+
+        attr->elf = endian::byte_swap(elf);
+        attr->context = endian::byte_swap(context);
+        attr->context_size = endian::byte_swap(context_size);
+        attr->pattern = endian::byte_swap(pattern);
+
+        if(arg)
+            std::memcpy(attr->arg, arg.get(), sizeof(attr->arg));
+
+        return 0;
+    }
+
+    static u32 create_task_with_attribute(vm::ptr<u8> taskset, vm::ptr<big<u32>> id, vm::ptr<task_attribute> attr)
+    {
+        if(!attr)
+            return error::null_pointer + error::task;
+
+        vm::ptr<u8> arg(attr.addr() + offsetof(task_attribute, arg));
+
+        return create_task(taskset, id, attr->elf, attr->context, attr->context_size, attr->pattern, arg);
+    }
+
+    static u32 join_task(vm::ptr<u8> taskset, u32 id, vm::ptr<big<i32>> exit_code)
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        workload* w = find_workload(taskset.addr(), workload_kind::taskset);
+        if(!w)
+            return error::stat + error::task;
+
+        if(id >= w->next_id)
+            return error::srch + error::task;
+
+        w->joiners++;
+
+        // a shut down taskset drops tasks that hadnt started, they never exit
+        changed.wait(lock, [&] { return w->exited.count(id) || (w->shutdown && !w->running); });
+
+        auto it = w->exited.find(id);
+        bool exited = it != w->exited.end();
+
+        if(exited && exit_code)
+            *exit_code = endian::byte_swap(it->second);
+
+        release(w);
+
+        return exited ? 0 : error::srch + error::task;
+    }
+
+    static u32 shutdown_taskset(vm::ptr<u8> taskset)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        workload* w = find_workload(taskset.addr(), workload_kind::taskset);
+        if(!w)
+            return error::stat + error::task;
+
+        // tasks that havent started never will, running ones finish normally
+        w->shutdown = true;
+        w->ready.clear();
+
+        notify();
+
+        return 0;
+    }
+
+    static u32 join_taskset(vm::ptr<u8> taskset)
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        workload* w = find_workload(taskset.addr(), workload_kind::taskset);
+        if(!w)
+            return error::stat + error::task;
+
+        w->joiners++;
+
+        changed.wait(lock, [&] { return w->ready.empty() && !w->running; });
+
+        // other threads may still be joining its tasks
+        w->removed = true;
+        release(w);
+
+        return 0;
+    }
+
+    static u32 create_job_chain(vm::ptr<u8> spurs, vm::ptr<u8> chain, vm::ptr<big<u64>> commands, u32 descriptor_size, u32 max_grabbed, vm::ptr<u8> priorities, u32 max_contention)
+    {
+        if(!spurs || !chain || !commands)
+            return error::null_pointer + error::job;
+
+        if(chain.addr() % object_align || commands.addr() % 8)
+            return error::align + error::job;
+
+        // descriptors range from 64 to 896 bytes in steps of 128
+        if(descriptor_size < sizeof(job_header) || descriptor_size > spurs_ls::binary - spurs_ls::descriptor)
+            return error::inval + error::job;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        instance* inst = find_instance(spurs.addr());
+        if(!inst)
+            return error::stat + error::job;
+
+        auto w = std::make_unique<workload>();
+        w->kind = workload_kind::job_chain;
+        w->addr = chain.addr();
+        w->priority = lowest(priorities, inst->spus);
+        w->max_contention = std::clamp<u32>(std::min(max_contention, max_grabbed ? max_grabbed : inst->spus), 1, inst->spus);
+        w->commands = commands.addr();
+        w->descriptor_size = descriptor_size;
+
+        inst->workloads.push_back(std::move(w));
+
+        return 0;
+    }
+
+    static u32 run_job_chain(vm::ptr<u8> chain)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        workload* w = find_workload(chain.addr(), workload_kind::job_chain);
+        if(!w)
+            return error::stat + error::job;
+
+        if(w->state == chain_state::running || w->state == chain_state::ending)
+            return error::stat + error::job;
+
+        w->pc = w->commands;
+        w->calls.clear();
+        w->list_count = 0;
+        w->state = chain_state::running;
+
+        notify();
+
+        return 0;
+    }
+
+    static u32 shutdown_job_chain(vm::ptr<u8> chain)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        workload* w = find_workload(chain.addr(), workload_kind::job_chain);
+        if(!w)
+            return error::stat + error::job;
+
+        if(w->state == chain_state::running)
+            end_chain(*w);
+
+        return 0;
+    }
+
+    static u32 join_job_chain(vm::ptr<u8> chain)
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        workload* w = find_workload(chain.addr(), workload_kind::job_chain);
+        if(!w)
+            return error::stat + error::job;
+
+        w->joiners++;
+
+        changed.wait(lock, [&] { return w->state == chain_state::idle || w->state == chain_state::finished; });
+
+        spdlog::debug("job chain {:x} ran {} jobs", w->addr, w->jobs_run);
+
+        w->removed = true;
+        release(w);
+
+        return 0;
+    }
+
+    /// a native and the nid libsre exports the function it replaces under
+    struct spurs_export
+    {
+        const char* name;
+        u32 nid;
+        ppu::native_t func;
+    };
+
+    static const spurs_export spurs_exports[] = {
+        { "cellSpursInitialize", 0xACFC8DBC, vm::syscall_wrapper<spurs_initialize> },
+        { "cellSpursInitializeWithAttribute", 0xAA6269A8, vm::syscall_wrapper<initialize_with_attribute> },
+        { "cellSpursInitializeWithAttribute2", 0x30AA96C4, vm::syscall_wrapper<initialize_with_attribute> },
+        { "_cellSpursAttributeInitialize", 0x95180230, vm::syscall_wrapper<attribute_initialize> },
+        { "cellSpursAttributeSetNamePrefix", 0x07529113, vm::syscall_wrapper<attribute_set_name_prefix> },
+        { "cellSpursAttributeEnableSpuPrintfIfAvailable", 0x1051D134, vm::syscall_wrapper<attribute_enable_spu_printf> },
+        { "cellSpursAttributeSetSpuThreadGroupType", 0xA839A4D9, vm::syscall_wrapper<attribute_set_group_type> },
+        { "cellSpursAttributeSetMemoryContainerForSpuThread", 0x82275C1C, vm::syscall_wrapper<attribute_set_container> },
+        { "cellSpursFinalize", 0xCA4C4600, vm::syscall_wrapper<spurs_finalize> },
+        { "cellSpursCreateTaskset", 0x52CC6C82, vm::syscall_wrapper<create_taskset> },
+        { "cellSpursCreateTask", 0xBEB600AC, vm::syscall_wrapper<create_task> },
+        { "_cellSpursTaskAttributeInitialize", 0xB8474EFF, vm::syscall_wrapper<task_attribute_initialize> },
+        { "cellSpursCreateTaskWithAttribute", 0x1D46FEDF, vm::syscall_wrapper<create_task_with_attribute> },
+        { "cellSpursJoinTask2", 0xA7A94892, vm::syscall_wrapper<join_task> },
+        { "cellSpursShutdownTaskset", 0xA789E631, vm::syscall_wrapper<shutdown_taskset> },
+        { "cellSpursJoinTaskset", 0x9F72ADD3, vm::syscall_wrapper<join_taskset> },
+        { "cellSpursCreateJobChain", 0x60EB2DEC, vm::syscall_wrapper<create_job_chain> },
+        { "cellSpursRunJobChain", 0xF31731BB, vm::syscall_wrapper<run_job_chain> },
+        { "cellSpursShutdownJobChain", 0x738E40E6, vm::syscall_wrapper<shutdown_job_chain> },
+        { "cellSpursJoinJobChain", 0xA7C066DE, vm::syscall_wrapper<join_job_chain> }
+    };
+
+    void init_spurs()
+    {
+        // titles import these from libsre, binding the nids links those imports to the natives.
+        // patches can still name them to replace copies linked into the title itself
+        for(const auto& e : spurs_exports)
+        {
+            ppu::register_native(e.name, e.func);
+            ppu::bind_native("cellSpurs", e.nid, e.name);
+        }
+    }
+
+    void stop_spurs()
+    {
+        std::map<u32, std::unique_ptr<instance>> left;
+
+        {
+            std::lock_guard<std::mutex> guard(mut);
+            left.swap(instances);
+        }
+
+        for(auto& [_, inst] : left)
+            stop_instance(std::move(inst));
+    }
+}
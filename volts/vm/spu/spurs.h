@@ -0,0 +1,70 @@
+#pragma once
+
+#include <types.h>
+#include <endian.h>
+
+namespace volts::spu
+{
+    /// signal of the stop instruction jobs and tasks return to when their main function returns
+    constexpr svl::u32 spurs_exit_signal = 0x2100;
+
+    /**
+     * where the hle kernel places things in local store, the real kernel lives in
+     * the bottom of local store so jobs are linked above it anyway
+     */
+    namespace spurs_ls
+    {
+        /// job context passed to jobs in r3
+        constexpr svl::u32 context = 0x100;
+
+        /// copy of the job descriptor passed to jobs in r4, descriptors are at most 896 bytes
+        constexpr svl::u32 descriptor = 0x200;
+
+        /// job binaries are loaded here and their buffers follow them
+        constexpr svl::u32 binary = 0x1000;
+
+        /// holds the exit stop instruction, the link register points here
+        constexpr svl::u32 exit = 0x3FFF0;
+
+        /// initial stack pointer, the stack grows down from here
+        constexpr svl::u32 stack = 0x3FFE0;
+    }
+
+    /**
+     * @brief the job context the hle kernel writes to spurs_ls::context
+     *
+     * buffer addresses are in local store
+     */
+    struct job_context
+    {
+        /// input gathered by the dma list of the job, in list order with each element 16 byte aligned
+        svl::endian::big<svl::u32> io_buffer;
+        svl::endian::big<svl::u32> io_size;
+
+        svl::endian::big<svl::u32> output_buffer;
+        svl::endian::big<svl::u32> scratch_buffer;
+
+        /// address of the job descriptor in main memory
+        svl::endian::big<svl::u64> descriptor;
+
+        /// the dma tag the kernel used, free for the job to reuse
+        svl::endian::big<svl::u32> dma_tag;
+
+        svl::pad padding[4];
+    };
+
+    static_assert(sizeof(job_context) == 32);
+
+    /**
+     * @brief register the spurs functions as native replacements
+     *
+     * they are bound to the nids libsre exports them under so titles importing them link
+     * to the natives, workloads then run on the spu scheduler with a host kernel feeding them work
+     */
+    void init_spurs();
+
+    /**
+     * @brief stop the workers of every spurs instance the guest didnt finalize
+     */
+    void stop_spurs();
+}
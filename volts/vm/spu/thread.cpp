@@ -1,9 +1,344 @@
 #include "thread.h"
+#include "decode.h"
+#include "recompiler.h"
+#include "mfc.h"
+#include "image.h"
+
+#include "sys/event.h"
+
+#include <endian.h>
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
 
 namespace volts::spu
 {
+    using namespace svl;
+
+    thread::thread()
+        : ls(new u8[ls_size]())
+    {
+    }
+
     thread::thread(svl::file stream)
+        : thread()
+    {
+        auto exec = elf::load<elf::spu_exec>(stream);
+
+        if(!exec || exec.value().head.machine_type != elf::machine::spu)
+        {
+            spdlog::error("failed to parse spu executable");
+            return;
+        }
+
+        auto image = exec.value();
+        if(auto entry = load_image(*this, image))
+            spdlog::info("loaded spu executable with entry point {:x}", entry.value());
+    }
+
+    thread::thread(u8* memory)
+        : ls(memory, ls_deleter{ false })
+    {
+    }
+
+    thread::~thread()
+    {
+        release_reservation(*this);
+    }
+
+    void thread::step()
+    {
+        // instructions are stored big endian
+        u32 op;
+        std::memcpy(&op, ls.get() + pc, sizeof(u32));
+        op = endian::byte_swap(op);
+
+        funcs[decode(op)](*this, {op});
+        pc = (pc + 4) & (ls_mask & ~3);
+    }
+
+    void thread::run()
+    {
+        if(get_decoder() == decoder::recompiler)
+            return execute(*this);
+
+        stopped = false;
+
+        while(!stopped && !preempt.pending())
+            step();
+    }
+
+    // the dma worker is only started once an spu uses it
+    static mfc& get_mfc(thread& spu)
+    {
+        if(!spu.dma)
+            spu.dma = std::make_unique<mfc>(spu.ls.get());
+
+        return *spu.dma;
+    }
+
+    // the atomic unit runs its commands immediately, everything else goes through the queue
+    static void atomic_command(thread& spu, const mfc_command& args)
+    {
+        u8* data = spu.ls.get() + (args.lsa & ls_mask & ~(line_size - 1));
+        u32 ea = static_cast<u32>(args.ea);
+
+        switch(args.cmd)
+        {
+        case mfc_cmd::getllar:
+            getllar(spu, ea, data);
+            spu.atomic_status = atomic_stat::getllar_success;
+            break;
+        case mfc_cmd::putllc:
+            spu.atomic_status = putllc(spu, ea, data) ? 0 : atomic_stat::putllc_failure;
+            break;
+        case mfc_cmd::putlluc:
+            putlluc(ea, data);
+            spu.atomic_status = atomic_stat::putlluc_success;
+            break;
+        default:
+            spu.dma->push(args);
+            return;
+        }
+
+        spu.atomic_ready = true;
+    }
+
+    bool thread::read_channel(u32 ch, u32& out)
+    {
+        switch(ch)
+        {
+        case channel::read_tag_mask:
+            out = get_mfc(*this).tag_mask;
+            return true;
+        case channel::mfc_tag_stat:
+        {
+            // dma always finishes on its own so this doesnt need to give up the spu
+            auto& dma = get_mfc(*this);
+            out = dma.wait_tags(dma.tag_mask, dma.update);
+            return true;
+        }
+        case channel::mfc_stall_stat:
+            out = get_mfc(*this).wait_stall();
+            return true;
+        case channel::mfc_atomic_stat:
+            if(!atomic_ready)
+                spdlog::warn("atomic status read without an atomic command");
+
+            atomic_ready = false;
+            out = atomic_status;
+            return true;
+        case channel::in_mbox:
+            // the kernel answers an event through here, the ppu never sees the answer
+            if(has_event_result)
+            {
+                has_event_result = false;
+                out = event_result;
+                return true;
+            }
+
+            return in_mbox.pop(out, &preempt);
+        case channel::sig_notify1:
+            return signals[0].read(out, &preempt);
+        case channel::sig_notify2:
+            return signals[1].read(out, &preempt);
+        case channel::event_stat:
+            while(true)
+            {
+                u32 e = events.load();
+                if(e & event_mask)
+                {
+                    out = e & event_mask;
+                    return true;
+                }
+
+                if(!park(events, e, event_sleepers, &preempt))
+                    return false;
+            }
+        case channel::read_event_mask:
+            out = event_mask;
+            return true;
+        case channel::read_srr0:
+            out = srr0;
+            return true;
+        default:
+            spdlog::warn("read from unimplemented spu channel {}", ch);
+            out = 0;
+            return true;
+        }
+    }
+
+    bool thread::send_event(u32 val)
+    {
+        // the top byte picks the port, below 64 sends and waits for an answer and below 128 throws
+        u32 code = val >> 24;
+        u32 queue = code < 128 ? ports[code & 63].load() : 0;
+
+        if(!queue)
+            return out_intr_mbox.push(val, &preempt);
+
+        // the other data word was written to the outbound mailbox first, the kernel consumes it
+        u32 ignored;
+        out_mbox.try_pop(ignored);
+
+        u32 err = vm::send_event(queue, { vm::spu_event_key, 0, (static_cast<u64>(code & 63) << 32) | (val & 0xFFFFFF), event_data });
+
+        if(code < 64)
+        {
+            event_result = err;
+            has_event_result = true;
+        }
+
+        return true;
+    }
+
+    bool thread::write_channel(u32 ch, u32 val)
+    {
+        switch(ch)
+        {
+        case channel::out_mbox:
+            event_data = val;
+            return out_mbox.push(val, &preempt);
+        case channel::out_intr_mbox:
+            return send_event(val);
+        case channel::event_mask:
+            event_mask = val;
+            return true;
+        case channel::event_ack:
+            events &= ~val;
+            return true;
+        case channel::write_srr0:
+            srr0 = val & ls_mask;
+            return true;
+        default:
+            break;
+        }
+
+        auto& args = get_mfc(*this).args;
+
+        switch(ch)
+        {
+        case channel::mfc_lsa:
+            args.lsa = val & ls_mask;
+            break;
+        case channel::mfc_eah:
+            args.ea = (static_cast<u64>(val) << 32) | (args.ea & 0xFFFFFFFF);
+            break;
+        case channel::mfc_eal:
+            args.ea = (args.ea & ~0xFFFFFFFFull) | val;
+            break;
+        case channel::mfc_size:
+            args.size = val & 0xFFFF;
+            break;
+        case channel::mfc_tag:
+            args.tag = val & 0x1F;
+            break;
+        case channel::mfc_cmd:
+            args.cmd = val & 0xFF;
+            atomic_command(*this, args);
+            break;
+        case channel::mfc_tag_mask:
+            dma->tag_mask = val;
+            break;
+        case channel::mfc_tag_update:
+            if(val > static_cast<u32>(tag_update::all))
+                spdlog::error("invalid tag update mode {}", val);
+            else
+                dma->update = static_cast<tag_update>(val);
+            break;
+        case channel::mfc_stall_ack:
+            dma->ack_stall(val & 0x1F);
+            break;
+        default:
+            spdlog::warn("write of {:x} to unimplemented spu channel {}", val, ch);
+            break;
+        }
+
+        return true;
+    }
+
+    u32 thread::channel_count(u32 ch)
+    {
+        switch(ch)
+        {
+        case channel::mfc_lsa:
+        case channel::mfc_eah:
+        case channel::mfc_eal:
+        case channel::mfc_size:
+        case channel::mfc_tag:
+        case channel::mfc_tag_mask:
+        case channel::mfc_tag_update:
+        case channel::mfc_stall_ack:
+        case channel::read_tag_mask:
+            return 1;
+        case channel::mfc_cmd:
+            return get_mfc(*this).space();
+        case channel::mfc_tag_stat:
+        {
+            auto& dma = get_mfc(*this);
+            return dma.tags_ready(dma.tag_mask, dma.update) ? 1 : 0;
+        }
+        case channel::mfc_stall_stat:
+            return get_mfc(*this).stall_status() != 0 ? 1 : 0;
+        case channel::mfc_atomic_stat:
+            return atomic_ready ? 1 : 0;
+        case channel::in_mbox:
+            return in_mbox.count() + (has_event_result ? 1 : 0);
+        case channel::out_mbox:
+            return 1 - out_mbox.count();
+        case channel::out_intr_mbox:
+            return 1 - out_intr_mbox.count();
+        case channel::sig_notify1:
+            return signals[0].count();
+        case channel::sig_notify2:
+            return signals[1].count();
+        case channel::event_stat:
+            return (events.load() & event_mask) != 0 ? 1 : 0;
+        case channel::event_mask:
+        case channel::event_ack:
+        case channel::read_event_mask:
+        case channel::write_srr0:
+        case channel::read_srr0:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+    void thread::write_in_mbox(u32 val)
+    {
+        in_mbox.push(val);
+        raise(event::mb);
+    }
+
+    bool thread::read_out_mbox(u32& out)
+    {
+        if(!out_mbox.try_pop(out))
+            return false;
+
+        raise(event::le);
+        return true;
+    }
+
+    bool thread::read_out_intr_mbox(u32& out)
+    {
+        if(!out_intr_mbox.try_pop(out))
+            return false;
+
+        raise(event::me);
+        return true;
+    }
+
+    void thread::write_signal(u32 index, u32 val)
+    {
+        signals[index].write(val, signal_accumulate[index]);
+        raise(index == 0 ? event::s1 : event::s2);
+    }
+
+    void thread::raise(u32 bits)
     {
-        
+        events |= bits;
+        unpark(events, event_sleepers);
     }
-}
\ No newline at end of file
+}
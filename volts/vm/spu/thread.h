@@ -3,14 +3,265 @@
 #include <types.h>
 #include <file.h>
 
+#include "channel.h"
+#include "reservation.h"
+
+#include <memory>
+
 namespace volts::spu
 {
+    /// size of the local store of each spu
+    constexpr svl::u32 ls_size = 0x40000;
+
+    /// mask of valid local store addresses
+    constexpr svl::u32 ls_mask = ls_size - 1;
+
+    /// channel numbers used by rdch, wrch and rchcnt
+    namespace channel
+    {
+        constexpr svl::u32 event_stat = 0;
+        constexpr svl::u32 event_mask = 1;
+        constexpr svl::u32 event_ack = 2;
+        constexpr svl::u32 sig_notify1 = 3;
+        constexpr svl::u32 sig_notify2 = 4;
+        constexpr svl::u32 write_dec = 7;
+        constexpr svl::u32 read_dec = 8;
+        constexpr svl::u32 read_event_mask = 11;
+        constexpr svl::u32 read_tag_mask = 12;
+        constexpr svl::u32 mach_stat = 13;
+        constexpr svl::u32 write_srr0 = 14;
+        constexpr svl::u32 read_srr0 = 15;
+        constexpr svl::u32 mfc_lsa = 16;
+        constexpr svl::u32 mfc_eah = 17;
+        constexpr svl::u32 mfc_eal = 18;
+        constexpr svl::u32 mfc_size = 19;
+        constexpr svl::u32 mfc_tag = 20;
+        constexpr svl::u32 mfc_cmd = 21;
+        constexpr svl::u32 mfc_tag_mask = 22;
+        constexpr svl::u32 mfc_tag_update = 23;
+        constexpr svl::u32 mfc_tag_stat = 24;
+        constexpr svl::u32 mfc_stall_stat = 25;
+        constexpr svl::u32 mfc_stall_ack = 26;
+        constexpr svl::u32 mfc_atomic_stat = 27;
+        constexpr svl::u32 out_mbox = 28;
+        constexpr svl::u32 in_mbox = 29;
+        constexpr svl::u32 out_intr_mbox = 30;
+    }
+
+    struct block;
+    struct mfc;
+
+    /**
+     * @brief where the recompiler enters compiled code for an instruction address
+     */
+    struct block_entry
+    {
+        const block* code = nullptr;
+
+        /// the local store address the block was compiled from
+        svl::u32 base = 0;
+    };
+
+    /// frees local store unless it lives in guest memory
+    struct ls_deleter
+    {
+        bool owned = true;
+
+        void operator()(svl::u8* ptr) const
+        {
+            if(owned)
+                delete[] ptr;
+        }
+    };
+
     struct thread
     {
-        svl::v128 gpr[128] = {};
+        thread();
 
+        /**
+         * @brief create a thread and load an spu executable into its local store
+         *
+         * @param stream the executable, pc is set to its entry point
+         */
         thread(svl::file stream);
 
-        // todo: float point status and control register
+        /**
+         * @brief create a thread whose local store is a region of guest memory
+         *
+         * raw spus use this so the ppu reads and writes local store directly
+         *
+         * @param memory ls_size bytes that outlive the thread
+         */
+        explicit thread(svl::u8* memory);
+
+        ~thread();
+
+        /**
+         * @brief execute the instruction at pc
+         */
+        void step();
+
+        /**
+         * @brief execute instructions with the active decoder until the spu stops or is preempted
+         */
+        void run();
+
+        /**
+         * @brief read a value from a channel
+         *
+         * blocking reads give up when the thread is preempted so
+         * the instruction can be run again once its back on an spu
+         *
+         * @param ch the channel number
+         * @param out the value read
+         * @return true if the value was read
+         * @return false if the thread was preempted while waiting
+         */
+        bool read_channel(svl::u32 ch, svl::u32& out);
+
+        /**
+         * @brief write a value to a channel
+         *
+         * @param ch the channel number
+         * @param val the value to write
+         * @return true if the value was written
+         * @return false if the thread was preempted while waiting for space
+         */
+        bool write_channel(svl::u32 ch, svl::u32 val);
+
+        /**
+         * @brief write to the outbound interrupt mailbox, sending an event if the port is connected
+         *
+         * @param val the port in the top byte and data below it
+         * @return false if the thread was preempted while waiting for the interrupt mailbox
+         */
+        bool send_event(svl::u32 val);
+
+        /**
+         * @brief get how many reads or writes a channel can take without blocking
+         *
+         * @param ch the channel number
+         * @return svl::u32 the channel count
+         */
+        svl::u32 channel_count(svl::u32 ch);
+
+        /**
+         * @brief send a value to the spu, blocks while the inbound mailbox is full
+         *
+         * @param val the value to send
+         */
+        void write_in_mbox(svl::u32 val);
+
+        /**
+         * @brief take a value the spu sent if there is one
+         *
+         * @param out the value taken
+         * @return true if there was a value
+         * @return false if the outbound mailbox was empty
+         */
+        bool read_out_mbox(svl::u32& out);
+
+        /**
+         * @brief take a value the spu sent through the interrupt mailbox if there is one
+         *
+         * @param out the value taken
+         * @return true if there was a value
+         * @return false if the outbound interrupt mailbox was empty
+         */
+        bool read_out_intr_mbox(svl::u32& out);
+
+        /**
+         * @brief write to a signal notification register
+         *
+         * @param index the register, 0 or 1
+         * @param val the value to write
+         */
+        void write_signal(svl::u32 index, svl::u32 val);
+
+        /**
+         * @brief raise events and wake the spu if its waiting on them
+         *
+         * @param bits the event bits to raise
+         */
+        void raise(svl::u32 bits);
+
+        /// registers are stored with their bytes reversed so element 0 is the top of the host vector
+        svl::v128 gpr[128] = {};
+
+        /// local store, big endian like main memory
+        std::unique_ptr<svl::u8[], ls_deleter> ls;
+
+        /// address of the current instruction in local store
+        svl::u32 pc = 0;
+
+        /// interrupt return address
+        svl::u32 srr0 = 0;
+
+        /// floating point status and control register
+        svl::v128 fpscr = {};
+
+        /// set by stop and halt instructions
+        bool stopped = false;
+
+        /// set by the scheduler to make run return early so another thread can use the spu, also pulls the thread off a channel its waiting on
+        preemption preempt;
+
+        /// signal of the last stop and signal instruction
+        svl::u32 stop_code = 0;
+
+        /// compiled block covering each instruction address, filled by the recompiler
+        std::unique_ptr<block_entry[]> blocks;
+
+        /// ppu to spu mailbox
+        mailbox<4> in_mbox;
+
+        /// spu to ppu mailboxes
+        single_mailbox out_mbox;
+        mailbox<1> out_intr_mbox;
+
+        /// the last value the spu wrote to the outbound mailbox, an event sent after it carries it
+        svl::u32 event_data = 0;
+
+        /// result of the last event sent with a reply, the next inbound mailbox read returns it first
+        svl::u32 event_result = 0;
+        bool has_event_result = false;
+
+        /// event queue each spu port sends to, 0 when the port isnt connected and the ppu reads the interrupt mailbox instead
+        std::atomic<svl::u32> ports[64] = {};
+
+        /// signal notification registers 1 and 2
+        signal_register signals[2];
+
+        /// true if a signal notification register ors writes together rather than replacing its value
+        bool signal_accumulate[2] = {};
+
+        /// raised events, cleared by the event acknowledge channel
+        std::atomic<svl::u32> events = 0;
+        std::atomic<svl::u32> event_sleepers = 0;
+
+        /// events the spu waits on when reading the event status channel
+        svl::u32 event_mask = 0;
+
+        /// line reserved by getllar, written last so writers see a matching rtime
+        std::atomic<svl::u32> raddr = no_reservation;
+
+        /// stamp of the reserved line when it was read
+        std::atomic<svl::u64> rtime = 0;
+
+        /// line a getllar is reading before it publishes raddr, writers keep its stamp watched meanwhile
+        std::atomic<svl::u32> rpending = no_reservation;
+
+        /// contents of the reserved line when it was read
+        alignas(16) svl::u8 rdata[line_size] = {};
+
+        /// slot this thread uses to receive lost reservation events
+        svl::u32 holder = ~0u;
+
+        /// result of the last atomic command, read from the atomic status channel
+        svl::u32 atomic_status = 0;
+        bool atomic_ready = false;
+
+        /// dma engine, started by the first mfc channel access and stopped before local store is freed
+        std::unique_ptr<mfc> dma;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,383 @@
+#include "event.h"
+#include "syscall.h"
+#include "object.h"
+#include "sync.h"
+
+#include <futex.h>
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// most events a queue can hold
+    constexpr i32 max_queue_size = 127;
+
+    /// destroy a queue even if threads are waiting on it
+    constexpr i32 destroy_force = 1;
+
+    /// ports that send to a queue in the same process
+    constexpr i32 port_local = 1;
+
+    struct guest_event
+    {
+        big<u64> source;
+        big<u64> data1;
+        big<u64> data2;
+        big<u64> data3;
+    };
+
+    /**
+     * @brief a bounded ring of events
+     *
+     * each slot has a sequence number saying whose turn it is so producers
+     * claim slots with a single compare exchange and never wait on each other.
+     * lv2 lets several threads receive from one queue so taking an event is
+     * claimed the same way
+     */
+    struct lv2_event_queue
+    {
+        lv2_event_queue(u32 size)
+            : size(size)
+            , slots(new slot[size])
+        {
+            for(u32 i = 0; i < size; i++)
+                slots[i].seq = i;
+        }
+
+        bool push(const event& ev)
+        {
+            u64 pos = tail.load(std::memory_order_relaxed);
+
+            while(true)
+            {
+                slot& s = slots[pos % size];
+                i64 diff = static_cast<i64>(s.seq.load(std::memory_order_acquire) - pos);
+
+                if(diff == 0)
+                {
+                    if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        s.ev = ev;
+                        s.seq.store(pos + 1, std::memory_order_release);
+                        break;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    // the slot still holds an event from the last time around
+                    return false;
+                }
+                else
+                {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            signal++;
+
+            if(sleepers)
+                futex::wake_one(signal);
+
+            return true;
+        }
+
+        bool pop(event& ev)
+        {
+            u64 pos = head.load(std::memory_order_relaxed);
+
+            while(true)
+            {
+                slot& s = slots[pos % size];
+                i64 diff = static_cast<i64>(s.seq.load(std::memory_order_acquire) - (pos + 1));
+
+                if(diff == 0)
+                {
+                    if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        ev = s.ev;
+                        s.seq.store(pos + size, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if(diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        struct slot
+        {
+            std::atomic<u64> seq;
+            event ev;
+        };
+
+        u32 size;
+        std::unique_ptr<slot[]> slots;
+
+        std::atomic<u64> head = 0;
+        std::atomic<u64> tail = 0;
+
+        /// bumped by every send, receivers sleep on it while the queue is empty
+        std::atomic<u32> signal = 0;
+        std::atomic<u32> sleepers = 0;
+
+        /// threads inside a receive
+        std::atomic<u32> waiters = 0;
+
+        /// set when the queue is destroyed with threads still waiting on it
+        std::atomic<bool> closed = false;
+    };
+
+    struct lv2_event_port
+    {
+        u64 name;
+
+        /// the connected queue, 0 when it isnt connected
+        std::atomic<u32> queue = 0;
+    };
+
+    constexpr u32 port_base = 0x0E000001;
+    constexpr u32 max_ports = 256;
+
+    static object_table<lv2_event_queue> queues(0x8D000001);
+    static object_table<lv2_event_port, max_ports> ports(port_base);
+
+    u32 send_event(u32 queue, const event& ev)
+    {
+        auto q = queues.get(queue);
+        if(!q || q->closed)
+            return esrch;
+
+        return q->push(ev) ? 0 : ebusy;
+    }
+
+    bool has_queue(u32 queue)
+    {
+        auto q = queues.get(queue);
+        return q && !q->closed;
+    }
+
+    static u32 sys_event_queue_create(vm::ptr<big<u32>> id, vm::ptr<u8> attr, u64 key, i32 size)
+    {
+        if(!id || !attr)
+            return efault;
+
+        if(size <= 0 || size > max_queue_size)
+            return einval;
+
+        u32 num = queues.add(std::make_unique<lv2_event_queue>(size));
+        if(!num)
+            return eagain;
+
+        *id = endian::byte_swap(num);
+        return 0;
+    }
+
+    static u32 sys_event_queue_destroy(u32 id, i32 mode)
+    {
+        {
+            auto q = queues.get(id);
+            if(!q)
+                return esrch;
+
+            if(q->waiters && mode != destroy_force)
+                return ebusy;
+
+            // receivers see the queue is closed and leave before it is freed
+            q->closed = true;
+            q->signal++;
+            futex::wake_all(q->signal);
+        }
+
+        // ports connected to it would otherwise send to whatever queue gets its id next
+        for(u32 port = port_base; port < port_base + max_ports; port++)
+        {
+            u32 expected = id;
+            if(auto p = ports.get(port))
+                p->queue.compare_exchange_strong(expected, 0);
+        }
+
+        queues.remove(id);
+        return 0;
+    }
+
+    static u32 sys_event_queue_receive(ppu::thread& ppu, u32 id, vm::ptr<guest_event> dummy, u64 timeout)
+    {
+        auto q = queues.get(id);
+        if(!q)
+            return esrch;
+
+        deadline d(timeout);
+        event ev;
+
+        q->waiters++;
+
+        while(true)
+        {
+            u32 seen = q->signal.load();
+
+            if(q->closed)
+            {
+                q->waiters--;
+                return ecanceled;
+            }
+
+            if(q->pop(ev))
+                break;
+
+            q->sleepers++;
+            bool slept = d.sleep(q->signal, seen);
+            q->sleepers--;
+
+            if(!slept)
+            {
+                q->waiters--;
+                return etimedout;
+            }
+        }
+
+        q->waiters--;
+
+        // ppu queues hand the event back in registers rather than memory
+        ppu.gpr[4] = ev.source;
+        ppu.gpr[5] = ev.data1;
+        ppu.gpr[6] = ev.data2;
+        ppu.gpr[7] = ev.data3;
+
+        return 0;
+    }
+
+    static u32 sys_event_queue_tryreceive(u32 id, vm::ptr<guest_event> events, i32 size, vm::ptr<big<u32>> number)
+    {
+        if(!events || !number)
+            return efault;
+
+        auto q = queues.get(id);
+        if(!q)
+            return esrch;
+
+        u32 count = 0;
+        event ev;
+
+        while(count < static_cast<u32>(std::max(size, 0)) && q->pop(ev))
+        {
+            guest_event& out = events.get()[count++];
+            out.source = endian::byte_swap(ev.source);
+            out.data1 = endian::byte_swap(ev.data1);
+            out.data2 = endian::byte_swap(ev.data2);
+            out.data3 = endian::byte_swap(ev.data3);
+        }
+
+        trace::output(events.addr(), count * sizeof(guest_event));
+
+        *number = endian::byte_swap(count);
+        return 0;
+    }
+
+    static u32 sys_event_queue_drain(u32 id)
+    {
+        auto q = queues.get(id);
+        if(!q)
+            return esrch;
+
+        for(event ev; q->pop(ev);)
+            ;
+
+        return 0;
+    }
+
+    static u32 sys_event_port_create(vm::ptr<big<u32>> id, i32 type, u64 name)
+    {
+        if(!id)
+            return efault;
+
+        // ipc ports need other processes
+        if(type != port_local)
+            return einval;
+
+        auto port = std::make_unique<lv2_event_port>();
+        port->name = name;
+
+        u32 num = ports.add(std::move(port));
+        if(!num)
+            return eagain;
+
+        *id = endian::byte_swap(num);
+        return 0;
+    }
+
+    static u32 sys_event_port_destroy(u32 id)
+    {
+        {
+            auto p = ports.get(id);
+            if(!p)
+                return esrch;
+
+            if(p->queue)
+                return eisconn;
+        }
+
+        ports.remove(id);
+        return 0;
+    }
+
+    static u32 sys_event_port_connect_local(u32 id, u32 queue)
+    {
+        auto p = ports.get(id);
+        if(!p)
+            return esrch;
+
+        if(!queues.get(queue))
+            return esrch;
+
+        u32 expected = 0;
+        return p->queue.compare_exchange_strong(expected, queue) ? 0 : eisconn;
+    }
+
+    static u32 sys_event_port_disconnect(u32 id)
+    {
+        auto p = ports.get(id);
+        if(!p)
+            return esrch;
+
+        return p->queue.exchange(0) ? 0 : enotconn;
+    }
+
+    static u32 sys_event_port_send(u32 id, u64 data1, u64 data2, u64 data3)
+    {
+        auto p = ports.get(id);
+        if(!p)
+            return esrch;
+
+        u32 queue = p->queue;
+        if(!queue)
+            return enotconn;
+
+        // unnamed ports are identified by the process and port
+        u64 source = p->name ? p->name : (1ull << 32) | id;
+
+        return send_event(queue, { source, data1, data2, data3 });
+    }
+
+    void init_events()
+    {
+        bind_syscall<sys_event_queue_create>(128);
+        bind_syscall<sys_event_queue_destroy>(129);
+        bind_syscall<sys_event_queue_receive>(130);
+        bind_syscall<sys_event_queue_tryreceive>(131);
+        bind_syscall<sys_event_queue_drain>(133);
+
+        bind_syscall<sys_event_port_create>(134);
+        bind_syscall<sys_event_port_destroy>(135);
+        bind_syscall<sys_event_port_connect_local>(136);
+        bind_syscall<sys_event_port_disconnect>(137);
+        bind_syscall<sys_event_port_send>(138);
+    }
+}
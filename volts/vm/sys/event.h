@@ -0,0 +1,42 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::vm
+{
+    /// source of events sent by spu threads through their ports
+    constexpr svl::u64 spu_event_key = 0xFFFFFFFF53505501;
+
+    struct event
+    {
+        svl::u64 source;
+        svl::u64 data1;
+        svl::u64 data2;
+        svl::u64 data3;
+    };
+
+    /**
+     * @brief send an event to a queue
+     *
+     * never takes a lock so spu and rsx threads can send without
+     * waiting on anything the ppu is doing
+     *
+     * @param queue the id of the queue
+     * @param ev the event to send
+     * @return svl::u32 0, esrch if the queue doesnt exist or ebusy if it is full
+     */
+    svl::u32 send_event(svl::u32 queue, const event& ev);
+
+    /**
+     * @brief check if an event queue exists and hasnt been destroyed
+     *
+     * @param queue the id of the queue
+     * @return true if events can be sent to it
+     */
+    bool has_queue(svl::u32 queue);
+
+    /**
+     * @brief bind the event queue and event port syscalls
+     */
+    void init_events();
+}
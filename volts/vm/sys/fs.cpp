@@ -0,0 +1,1071 @@
+#include "fs.h"
+#include "syscall.h"
+#include "object.h"
+
+#include "vfs.h"
+
+#include <platform.h>
+#include <futex.h>
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+
+#if SYS_WINDOWS
+#   include <Windows.h>
+#   include <io.h>
+#   include <fcntl.h>
+#else
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#if SYS_UNIX
+#   include <sys/mman.h>
+#   include <asm/unistd.h>
+#   include <linux/io_uring.h>
+#endif
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// longest guest path including the terminator
+    constexpr u32 max_path = 1024;
+
+    /// reads and writes are split into pieces of this size so big transfers use every io thread
+    constexpr u64 io_chunk = 1024 * 1024;
+
+    /// open flags
+    namespace open_flags
+    {
+        constexpr i32 rdonly = 0;
+        constexpr i32 wronly = 1;
+        constexpr i32 rdwr = 2;
+        constexpr i32 accmode = 3;
+        constexpr i32 creat = 0x40;
+        constexpr i32 excl = 0x80;
+        constexpr i32 trunc = 0x200;
+        constexpr i32 append = 0x400;
+    }
+
+    /// dirent types
+    namespace dirent_type
+    {
+        constexpr u8 directory = 1;
+        constexpr u8 regular = 2;
+    }
+
+    struct fs_dirent
+    {
+        u8 type;
+        u8 namelen;
+        char name[256];
+    };
+
+    static_assert(sizeof(fs_dirent) == 258);
+
+    // host files, only opening and transferring differ between platforms
+#if SYS_WINDOWS
+    static int host_open(const fs::path& path, int flags)
+    {
+        return _wopen(path.c_str(), flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+    }
+
+    static void host_close(int fd)
+    {
+        _close(fd);
+    }
+
+    static i64 host_transfer(int fd, u8* data, u64 size, u64 offset, bool write)
+    {
+        OVERLAPPED at = {};
+        at.Offset = static_cast<DWORD>(offset);
+        at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+        DWORD done = 0;
+
+        BOOL ok = write
+            ? WriteFile(handle, data, static_cast<DWORD>(size), &done, &at)
+            : ReadFile(handle, data, static_cast<DWORD>(size), &done, &at);
+
+        if(!ok)
+            return GetLastError() == ERROR_HANDLE_EOF ? 0 : -EIO;
+
+        return done;
+    }
+
+    static int host_sync(int fd)
+    {
+        return _commit(fd) ? errno : 0;
+    }
+#else
+    static int host_open(const fs::path& path, int flags)
+    {
+        return ::open(path.c_str(), flags | O_CLOEXEC, 0666);
+    }
+
+    static void host_close(int fd)
+    {
+        ::close(fd);
+    }
+
+    static i64 host_transfer(int fd, u8* data, u64 size, u64 offset, bool write)
+    {
+        i64 done = write
+            ? ::pwrite(fd, data, size, offset)
+            : ::pread(fd, data, size, offset);
+
+        return done < 0 ? -errno : done;
+    }
+
+    static int host_sync(int fd)
+    {
+        return ::fsync(fd) ? errno : 0;
+    }
+#endif
+
+    static u32 host_error(int err)
+    {
+        switch(err)
+        {
+        case 0:
+            return 0;
+        case ENOENT:
+        case ENOTDIR:
+            return enoent;
+        case EEXIST:
+            return eexist;
+        case EISDIR:
+            return eisdir;
+        case EACCES:
+        case EPERM:
+            return eperm;
+        case ENOTEMPTY:
+            return ebusy;
+        case ENOSPC:
+            return enospc;
+        case EMFILE:
+        case ENFILE:
+            return enfile;
+        default:
+            return eio;
+        }
+    }
+
+    static u32 host_error(const std::error_code& err)
+    {
+        return err ? host_error(err.value()) : 0;
+    }
+
+    /**
+     * @brief every piece of one read or write, the caller sleeps on pending
+     */
+    struct io_batch
+    {
+        std::atomic<u32> pending = 0;
+
+        /// bytes each piece transferred, every io thread only writes its own entry
+        std::vector<u64> done;
+
+        /// the first host error any piece hit
+        std::atomic<int> error = 0;
+    };
+
+    /**
+     * @brief a piece of a transfer for an io thread to do
+     */
+    struct io_op
+    {
+        int fd;
+        u8* data;
+        u64 size;
+        u64 offset;
+        bool write;
+
+        io_batch* batch;
+        u32 index;
+    };
+
+    struct io_pool
+    {
+        std::mutex mut;
+        std::condition_variable cv;
+        std::deque<io_op> queue;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+    };
+
+    static io_pool pool;
+
+    static void run_op(const io_op& op)
+    {
+        u64 done = 0;
+        int error = 0;
+
+        // the host can transfer less than asked for, only a read at the end of the file stops early
+        while(done < op.size)
+        {
+            i64 n = host_transfer(op.fd, op.data + done, op.size - done, op.offset + done, op.write);
+
+            if(n < 0)
+            {
+                if(n == -EINTR)
+                    continue;
+
+                error = static_cast<int>(-n);
+                break;
+            }
+
+            if(n == 0)
+                break;
+
+            done += n;
+        }
+
+        io_batch& batch = *op.batch;
+        batch.done[op.index] = done;
+
+        int none = 0;
+        if(error)
+            batch.error.compare_exchange_strong(none, error);
+
+        // wake under the lock so the batch stays alive until the caller can take it
+        std::lock_guard<std::mutex> guard(pool.mut);
+        if(--batch.pending == 0)
+            futex::wake_one(batch.pending);
+    }
+
+    static void io_worker()
+    {
+        std::unique_lock<std::mutex> lock(pool.mut);
+
+        while(true)
+        {
+            pool.cv.wait(lock, [] { return pool.stopping || !pool.queue.empty(); });
+
+            if(pool.queue.empty())
+                return;
+
+            io_op op = pool.queue.front();
+            pool.queue.pop_front();
+
+            lock.unlock();
+            run_op(op);
+            lock.lock();
+        }
+    }
+
+    /**
+     * @brief count the bytes transferred without a gap from the start
+     *
+     * pieces finish out of order, a failed or short piece ends what the guest can be told about
+     *
+     * @param done bytes each piece transferred
+     * @param size size of the whole transfer
+     * @return u64 bytes up to the first piece that didnt finish
+     */
+    static u64 contiguous(const std::vector<u64>& done, u64 size)
+    {
+        u64 total = 0;
+
+        for(u32 i = 0; i < done.size(); i++)
+        {
+            total += done[i];
+
+            if(done[i] < std::min(io_chunk, size - i * io_chunk))
+                break;
+        }
+
+        return total;
+    }
+
+#if SYS_UNIX
+    /// most pieces one thread keeps in flight on its ring
+    constexpr u32 ring_entries = 64;
+
+    /**
+     * @brief an io_uring owned by one calling thread
+     *
+     * set up with the raw syscalls so there is no dependency on liburing,
+     * the kernel does the transfers and the caller sleeps in io_uring_enter
+     */
+    struct io_ring
+    {
+        ~io_ring()
+        {
+            if(sqes)
+                munmap(sqes, sqes_size);
+
+            if(cq_ptr && cq_ptr != sq_ptr)
+                munmap(cq_ptr, cq_size);
+
+            if(sq_ptr)
+                munmap(sq_ptr, sq_size);
+
+            if(fd >= 0)
+                ::close(fd);
+        }
+
+        bool init()
+        {
+            io_uring_params params = {};
+            fd = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &params));
+
+            if(fd < 0)
+                return false;
+
+            // plain read and write ops arrived in the same kernel as fast poll
+            if(!(params.features & IORING_FEAT_FAST_POLL))
+                return false;
+
+            sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+            cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+            bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+            if(single)
+                sq_size = cq_size = std::max(sq_size, cq_size);
+
+            sq_ptr = map(sq_size, IORING_OFF_SQ_RING);
+            cq_ptr = single ? sq_ptr : map(cq_size, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+
+            if(!sq_ptr || !cq_ptr || !sqes)
+                return false;
+
+            auto* sq = static_cast<u8*>(sq_ptr);
+            sq_tail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+            sq_mask = *reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+            sq_array = reinterpret_cast<u32*>(sq + params.sq_off.array);
+
+            auto* cq = static_cast<u8*>(cq_ptr);
+            cq_head = reinterpret_cast<u32*>(cq + params.cq_off.head);
+            cq_tail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+            cq_mask = *reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            return true;
+        }
+
+        void* map(std::size_t size, u64 offset)
+        {
+            void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+
+        /// queue a read or write, only this thread touches the submission ring
+        void push(int file, u8* data, u64 size, u64 offset, bool write, u64 tag)
+        {
+            u32 tail = *sq_tail;
+            u32 idx = tail & sq_mask;
+
+            io_uring_sqe& sqe = sqes[idx];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe.fd = file;
+            sqe.addr = reinterpret_cast<u64>(data);
+            sqe.len = static_cast<u32>(size);
+            sqe.off = offset;
+            sqe.user_data = tag;
+
+            sq_array[idx] = idx;
+            __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        }
+
+        /// submit queued pieces and sleep until at least one piece completes
+        int enter(u32 count)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, fd, count, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+        }
+
+        int fd = -1;
+
+        void* sq_ptr = nullptr;
+        void* cq_ptr = nullptr;
+        io_uring_sqe* sqes = nullptr;
+
+        std::size_t sq_size = 0;
+        std::size_t cq_size = 0;
+        std::size_t sqes_size = 0;
+
+        u32* sq_tail = nullptr;
+        u32* sq_array = nullptr;
+        u32 sq_mask = 0;
+
+        u32* cq_head = nullptr;
+        u32* cq_tail = nullptr;
+        u32 cq_mask = 0;
+        io_uring_cqe* cqes = nullptr;
+    };
+
+    /**
+     * @brief the ring of the calling thread, null when the host cant provide one
+     */
+    static io_ring* thread_ring()
+    {
+        thread_local std::unique_ptr<io_ring> ring;
+        thread_local bool tried = false;
+
+        if(!tried)
+        {
+            tried = true;
+
+            auto fresh = std::make_unique<io_ring>();
+            if(fresh->init())
+            {
+                ring = std::move(fresh);
+            }
+            else if(static std::atomic<bool> warned = false; !warned.exchange(true))
+            {
+                spdlog::info("io_uring is unavailable, file io will use the io threads");
+            }
+        }
+
+        return ring.get();
+    }
+
+    /**
+     * @brief transfer between a host file and guest memory through the ring of the calling thread
+     *
+     * pieces are resubmitted until they complete, a read only stops early at the end of the file
+     *
+     * @return int 0 or the first host error
+     */
+    static int ring_transfer(io_ring& ring, int fd, u8* data, u64 size, u64 offset, bool write, u64& done)
+    {
+        struct piece
+        {
+            u64 at;
+            u64 left;
+        };
+
+        std::vector<piece> pieces;
+        for(u64 at = 0; at < size; at += io_chunk)
+            pieces.push_back({ at, std::min(io_chunk, size - at) });
+
+        std::vector<u32> queued;
+        for(u32 i = 0; i < pieces.size(); i++)
+            queued.push_back(i);
+
+        int error = 0;
+        u32 inflight = 0;
+
+        // queued in the ring but not yet taken by the kernel
+        u32 unsubmitted = 0;
+
+        while(!queued.empty() || inflight)
+        {
+            // an error stops new pieces going out, the ones in flight still have to come back
+            while(!error && !queued.empty() && inflight < ring_entries)
+            {
+                auto& p = pieces[queued.back()];
+                ring.push(fd, data + p.at, p.left, offset + p.at, write, queued.back());
+                queued.pop_back();
+
+                inflight++;
+                unsubmitted++;
+            }
+
+            if(!inflight)
+                break;
+
+            // returns how many were submitted, a signal can interrupt the wait after that
+            int res = ring.enter(unsubmitted);
+
+            if(res >= 0)
+            {
+                unsubmitted -= std::min<u32>(res, unsubmitted);
+            }
+            else if(errno != EINTR)
+            {
+                error = errno;
+                break;
+            }
+
+            u32 head = *ring.cq_head;
+            u32 tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+            for(; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = ring.cqes[head & ring.cq_mask];
+                auto idx = static_cast<u32>(cqe.user_data);
+                auto& p = pieces[idx];
+
+                inflight--;
+
+                if(cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    queued.push_back(idx);
+                }
+                else if(cqe.res < 0)
+                {
+                    if(!error)
+                        error = -cqe.res;
+                }
+                else if(cqe.res > 0)
+                {
+                    p.at += cqe.res;
+                    p.left -= cqe.res;
+
+                    // the host can transfer less than asked for
+                    if(p.left)
+                        queued.push_back(idx);
+                }
+            }
+
+            __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        std::vector<u64> moved;
+        for(u32 i = 0; i < pieces.size(); i++)
+            moved.push_back(pieces[i].at - i * io_chunk);
+
+        done = contiguous(moved, size);
+
+        return error;
+    }
+#endif
+
+    /**
+     * @brief transfer between a host file and guest memory
+     *
+     * the ring of the calling thread is used when the host has io_uring, otherwise the io threads do it
+     *
+     * @param done set to the bytes transferred without a gap from the start
+     * @return u32 0 or an lv2 error
+     */
+    static u32 transfer(int fd, u8* data, u64 size, u64 offset, bool write, u64& done)
+    {
+        done = 0;
+
+        if(!size)
+            return 0;
+
+#if SYS_UNIX
+        if(io_ring* ring = thread_ring())
+            return host_error(ring_transfer(*ring, fd, data, size, offset, write, done));
+#endif
+
+        io_batch batch;
+        u32 count = static_cast<u32>((size + io_chunk - 1) / io_chunk);
+        batch.pending = count;
+        batch.done.resize(count);
+
+        {
+            std::lock_guard<std::mutex> guard(pool.mut);
+
+            if(pool.stopping)
+                return eio;
+
+            if(pool.workers.empty())
+            {
+                u32 threads = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+
+                for(u32 i = 0; i < threads; i++)
+                    pool.workers.emplace_back(io_worker);
+            }
+
+            for(u32 i = 0; i < count; i++)
+            {
+                u64 at = i * io_chunk;
+                pool.queue.push_back({ fd, data + at, std::min(io_chunk, size - at), offset + at, write, &batch, i });
+            }
+        }
+
+        if(count == 1)
+            pool.cv.notify_one();
+        else
+            pool.cv.notify_all();
+
+        while(u32 left = batch.pending.load())
+            futex::wait(batch.pending, left);
+
+        // the last io thread may still be waking the batch
+        std::lock_guard<std::mutex> guard(pool.mut);
+
+        done = contiguous(batch.done, size);
+        return host_error(batch.error);
+    }
+
+    /**
+     * @brief an open file or directory
+     */
+    struct lv2_fs_object
+    {
+        ~lv2_fs_object()
+        {
+            if(fd >= 0)
+                host_close(fd);
+        }
+
+        /// host file, -1 for directories
+        int fd = -1;
+
+        fs::path path;
+        i32 flags = 0;
+
+        /// calls on one descriptor run one at a time like on lv2
+        std::mutex mut;
+        u64 pos = 0;
+
+        /// directory entries read when it was opened
+        std::vector<std::pair<std::string, bool>> entries;
+        u32 next = 0;
+    };
+
+    static object_table<lv2_fs_object> files(3);
+
+    // guest paths are absolute, the device becomes the first directory under the vfs root
+    static u32 host_path(vm::ptr<char> path, fs::path& out)
+    {
+        if(!path)
+            return efault;
+
+        const char* str = path.get();
+        u64 len = strnlen(str, max_path);
+
+        if(len == 0 || len == max_path || str[0] != '/')
+            return einval;
+
+        fs::path rel(std::string(str + 1, len - 1));
+
+        // keep the guest inside the vfs root
+        for(auto& part : rel)
+        {
+            if(part == "..")
+                return enoent;
+        }
+
+        out = vfs::get(rel);
+        return 0;
+    }
+
+    static bool in_guest(vm::addr at, u64 size)
+    {
+        return at + size <= (1ull << 32);
+    }
+
+    static i64 unix_time(fs::file_time_type time)
+    {
+        auto sys = std::chrono::system_clock::now() + (time - fs::file_time_type::clock::now());
+        return std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch()).count();
+    }
+
+    static u32 write_stat(const fs::path& path, vm::ptr<u8> sb)
+    {
+        std::error_code err;
+        auto status = fs::status(path, err);
+
+        if(err)
+            return host_error(err);
+
+        bool dir = fs::is_directory(status);
+        u64 size = dir ? 0 : fs::file_size(path, err);
+        i64 time = unix_time(fs::last_write_time(path, err));
+
+        // CellFsStat is packed to 4 bytes so its 64 bit fields arent aligned
+        u8* out = sb.get();
+        auto put32 = [out](u32 at, u32 val) { val = endian::byte_swap(val); std::memcpy(out + at, &val, 4); };
+        auto put64 = [out](u32 at, u64 val) { val = endian::byte_swap(val); std::memcpy(out + at, &val, 8); };
+
+        put32(0, dir ? 040777 : 0100666);
+        put32(4, 0);
+        put32(8, 0);
+        put64(12, time);
+        put64(20, time);
+        put64(28, time);
+        put64(36, size);
+        put64(44, 4096);
+
+        trace::output(sb.addr(), 52);
+
+        return 0;
+    }
+
+    static u32 sys_fs_open(vm::ptr<char> path, i32 flags, vm::ptr<big<u32>> fd, i32 mode, vm::ptr<u8> arg, u64 size)
+    {
+        if(!fd)
+            return efault;
+
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        if(fs::is_directory(real, ec))
+            return eisdir;
+
+        int host = 0;
+        switch(flags & open_flags::accmode)
+        {
+        case open_flags::rdonly: host = O_RDONLY; break;
+        case open_flags::wronly: host = O_WRONLY; break;
+        case open_flags::rdwr: host = O_RDWR; break;
+        default: return einval;
+        }
+
+        if(flags & open_flags::creat)
+            host |= O_CREAT;
+        if(flags & open_flags::excl)
+            host |= O_EXCL;
+        if(flags & open_flags::trunc)
+            host |= O_TRUNC;
+
+        int file = host_open(real, host);
+        if(file < 0)
+            return host_error(errno);
+
+        auto obj = std::make_unique<lv2_fs_object>();
+        obj->fd = file;
+        obj->path = real;
+        obj->flags = flags;
+
+        u32 id = files.add(std::move(obj));
+        if(!id)
+            return enfile;
+
+        spdlog::debug("opened {} as {}", path.get(), id);
+
+        *fd = endian::byte_swap(id);
+        return 0;
+    }
+
+    static u32 sys_fs_read(u32 fd, vm::ptr<u8> buf, u64 nbytes, vm::ptr<big<u64>> nread)
+    {
+        if(!buf || !in_guest(buf.addr(), nbytes))
+            return efault;
+
+        auto f = files.get(fd);
+        if(!f || f->fd < 0 || (f->flags & open_flags::accmode) == open_flags::wronly)
+            return ebadf;
+
+        std::lock_guard<std::mutex> guard(f->mut);
+
+        u64 done;
+        u32 err = transfer(f->fd, buf.get(), nbytes, f->pos, false, done);
+        f->pos += done;
+
+        trace::output(buf.addr(), static_cast<u32>(done));
+
+        if(nread)
+            *nread = endian::byte_swap(done);
+
+        return err;
+    }
+
+    static u32 sys_fs_write(u32 fd, vm::ptr<u8> buf, u64 nbytes, vm::ptr<big<u64>> nwrite)
+    {
+        if(!buf || !in_guest(buf.addr(), nbytes))
+            return efault;
+
+        auto f = files.get(fd);
+        if(!f || f->fd < 0 || (f->flags & open_flags::accmode) == open_flags::rdonly)
+            return ebadf;
+
+        std::lock_guard<std::mutex> guard(f->mut);
+
+        // the host file isnt opened for appending since every transfer has its own offset
+        if(f->flags & open_flags::append)
+        {
+            std::error_code ec;
+            f->pos = fs::file_size(f->path, ec);
+        }
+
+        u64 done;
+        u32 err = transfer(f->fd, buf.get(), nbytes, f->pos, true, done);
+        f->pos += done;
+
+        if(nwrite)
+            *nwrite = endian::byte_swap(done);
+
+        return err;
+    }
+
+    static u32 sys_fs_close(u32 fd)
+    {
+        {
+            auto f = files.get(fd);
+            if(!f || f->fd < 0)
+                return ebadf;
+        }
+
+        files.remove(fd);
+        return 0;
+    }
+
+    static u32 sys_fs_opendir(vm::ptr<char> path, vm::ptr<big<u32>> fd)
+    {
+        if(!fd)
+            return efault;
+
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        auto it = fs::directory_iterator(real, ec);
+        if(ec)
+            return host_error(ec);
+
+        auto obj = std::make_unique<lv2_fs_object>();
+        obj->path = real;
+        obj->entries.emplace_back(".", true);
+        obj->entries.emplace_back("..", true);
+
+        for(; it != fs::directory_iterator(); it.increment(ec))
+            obj->entries.emplace_back(it->path().filename().string(), it->is_directory(ec));
+
+        u32 id = files.add(std::move(obj));
+        if(!id)
+            return enfile;
+
+        *fd = endian::byte_swap(id);
+        return 0;
+    }
+
+    static u32 sys_fs_readdir(u32 fd, vm::ptr<fs_dirent> dir, vm::ptr<big<u64>> nread)
+    {
+        if(!dir || !nread)
+            return efault;
+
+        auto f = files.get(fd);
+        if(!f || f->fd >= 0)
+            return ebadf;
+
+        std::lock_guard<std::mutex> guard(f->mut);
+
+        // an empty read marks the end of the directory
+        if(f->next == f->entries.size())
+        {
+            *nread = 0;
+            return 0;
+        }
+
+        auto& [name, is_dir] = f->entries[f->next++];
+        u8 len = static_cast<u8>(std::min<u64>(name.size(), sizeof(fs_dirent::name) - 1));
+
+        dir->type = is_dir ? dirent_type::directory : dirent_type::regular;
+        dir->namelen = len;
+        std::memcpy(dir->name, name.data(), len);
+        dir->name[len] = '\0';
+
+        *nread = endian::byte_swap(static_cast<u64>(sizeof(fs_dirent)));
+        return 0;
+    }
+
+    static u32 sys_fs_closedir(u32 fd)
+    {
+        {
+            auto f = files.get(fd);
+            if(!f || f->fd >= 0)
+                return ebadf;
+        }
+
+        files.remove(fd);
+        return 0;
+    }
+
+    static u32 sys_fs_stat(vm::ptr<char> path, vm::ptr<u8> sb)
+    {
+        if(!sb)
+            return efault;
+
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        return write_stat(real, sb);
+    }
+
+    static u32 sys_fs_fstat(u32 fd, vm::ptr<u8> sb)
+    {
+        if(!sb)
+            return efault;
+
+        auto f = files.get(fd);
+        if(!f)
+            return ebadf;
+
+        return write_stat(f->path, sb);
+    }
+
+    static u32 sys_fs_mkdir(vm::ptr<char> path, i32 mode)
+    {
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        if(!fs::create_directory(real, ec))
+            return ec ? host_error(ec) : eexist;
+
+        return 0;
+    }
+
+    static u32 sys_fs_rename(vm::ptr<char> from, vm::ptr<char> to)
+    {
+        fs::path src, dst;
+        if(u32 err = host_path(from, src))
+            return err;
+
+        if(u32 err = host_path(to, dst))
+            return err;
+
+        std::error_code ec;
+        fs::rename(src, dst, ec);
+        return host_error(ec);
+    }
+
+    static u32 sys_fs_rmdir(vm::ptr<char> path)
+    {
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        if(!fs::is_directory(real, ec))
+            return enoent;
+
+        fs::remove(real, ec);
+        return host_error(ec);
+    }
+
+    static u32 sys_fs_unlink(vm::ptr<char> path)
+    {
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        if(fs::is_directory(real, ec))
+            return eisdir;
+
+        if(!fs::remove(real, ec))
+            return ec ? host_error(ec) : enoent;
+
+        return 0;
+    }
+
+    static u32 sys_fs_lseek(u32 fd, i64 offset, i32 whence, vm::ptr<big<u64>> pos)
+    {
+        if(!pos)
+            return efault;
+
+        auto f = files.get(fd);
+        if(!f || f->fd < 0)
+            return ebadf;
+
+        std::lock_guard<std::mutex> guard(f->mut);
+
+        i64 from;
+        switch(whence)
+        {
+        case 0:
+            from = 0;
+            break;
+        case 1:
+            from = f->pos;
+            break;
+        case 2:
+        {
+            std::error_code ec;
+            from = fs::file_size(f->path, ec);
+            if(ec)
+                return host_error(ec);
+            break;
+        }
+        default:
+            return einval;
+        }
+
+        if(from + offset < 0)
+            return einval;
+
+        f->pos = from + offset;
+        *pos = endian::byte_swap(f->pos);
+
+        return 0;
+    }
+
+    static u32 sys_fs_fsync(u32 fd)
+    {
+        auto f = files.get(fd);
+        if(!f || f->fd < 0)
+            return ebadf;
+
+        return host_error(host_sync(f->fd));
+    }
+
+    static u32 sys_fs_truncate(vm::ptr<char> path, u64 size)
+    {
+        fs::path real;
+        if(u32 err = host_path(path, real))
+            return err;
+
+        std::error_code ec;
+        fs::resize_file(real, size, ec);
+        return host_error(ec);
+    }
+
+    static u32 sys_fs_ftruncate(u32 fd, u64 size)
+    {
+        auto f = files.get(fd);
+        if(!f || f->fd < 0 || (f->flags & open_flags::accmode) == open_flags::rdonly)
+            return ebadf;
+
+        std::error_code ec;
+        fs::resize_file(f->path, size, ec);
+        return host_error(ec);
+    }
+
+    void init_fs()
+    {
+        bind_host_syscall<sys_fs_open>(801);
+        bind_host_syscall<sys_fs_read>(802);
+        bind_host_syscall<sys_fs_write>(803);
+        bind_host_syscall<sys_fs_close>(804);
+        bind_host_syscall<sys_fs_opendir>(805);
+        bind_host_syscall<sys_fs_readdir>(806);
+        bind_host_syscall<sys_fs_closedir>(807);
+        bind_host_syscall<sys_fs_stat>(808);
+        bind_host_syscall<sys_fs_fstat>(809);
+        bind_host_syscall<sys_fs_mkdir>(811);
+        bind_host_syscall<sys_fs_rename>(812);
+        bind_host_syscall<sys_fs_rmdir>(813);
+        bind_host_syscall<sys_fs_unlink>(814);
+        bind_host_syscall<sys_fs_lseek>(818);
+        bind_host_syscall<sys_fs_fsync>(820);
+        bind_host_syscall<sys_fs_truncate>(831);
+        bind_host_syscall<sys_fs_ftruncate>(832);
+    }
+
+    void stop_fs()
+    {
+        std::vector<std::thread> workers;
+
+        {
+            std::lock_guard<std::mutex> guard(pool.mut);
+            pool.stopping = true;
+            workers.swap(pool.workers);
+        }
+
+        pool.cv.notify_all();
+
+        for(auto& worker : workers)
+            worker.join();
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace volts::vm
+{
+    /**
+     * @brief bind the lv2 filesystem syscalls
+     *
+     * guest paths are resolved under the vfs root so /dev_hdd0/game
+     * becomes dev_hdd0/game inside it. reads and writes go straight to
+     * and from guest memory through an io_uring per calling thread, hosts
+     * without one hand them to a pool of io threads instead. either way
+     * the calling thread sleeps until they finish
+     */
+    void init_fs();
+
+    /**
+     * @brief stop the io threads, waits for transfers in flight
+     */
+    void stop_fs();
+}
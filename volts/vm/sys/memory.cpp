@@ -0,0 +1,583 @@
+#include "memory.h"
+#include "syscall.h"
+#include "object.h"
+
+#include <spdlog/spdlog.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <cstring>
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// memory a title can allocate, the default container starts with all of it
+    constexpr u64 user_memory_size = 0xD500000;
+
+    /// containers are carved out in whole megabytes
+    constexpr u64 container_align = 0x100000;
+
+    /// mmapper areas are reserved in segments of this size
+    constexpr u64 segment_size = 0x10000000;
+
+    /// page size flags
+    namespace page_flags
+    {
+        constexpr u64 size_64k = 0x200;
+        constexpr u64 size_1m = 0x400;
+        constexpr u64 mask = 0xF00;
+    }
+
+    /// every page can be read and written by anything
+    constexpr u64 prot_read_write = 0x40000;
+    constexpr u64 access_right_any = 0xF;
+
+    struct memory_info
+    {
+        big<u32> total;
+        big<u32> available;
+    };
+
+    struct page_attribute
+    {
+        big<u64> attribute;
+        big<u64> access_right;
+        big<u32> page_size;
+        big<u32> pad;
+    };
+
+    struct lv2_container
+    {
+        lv2_container(u64 size)
+            : size(size)
+        {
+        }
+
+        u64 size;
+        std::atomic<u64> used = 0;
+    };
+
+    struct lv2_shared_memory
+    {
+        u64 size;
+        u32 page_size;
+
+        /// the container it is charged to, 0 for the default one
+        u32 container;
+
+        /// where it is mapped, 0 when it isnt
+        u32 addr = 0;
+
+        /// contents kept while it isnt mapped anywhere
+        std::vector<u8> saved;
+    };
+
+    struct allocation
+    {
+        u64 size;
+        u32 container;
+    };
+
+    struct mapping
+    {
+        u32 id;
+        u64 size;
+    };
+
+    static lv2_container root(user_memory_size);
+    static object_table<lv2_container> containers(0x3F000001);
+    static object_table<lv2_shared_memory> shared(0x08000001);
+
+    // every allocation, area and mapping changes under this lock, none of them are hot
+    static std::mutex mut;
+    static std::map<u32, allocation> allocations;
+    static std::map<u32, u64> areas;
+    static std::map<u32, mapping> mappings;
+
+    // containers are only destroyed with the lock held so the pointer stays good while it is
+    static lv2_container* find_container(u32 id)
+    {
+        if(id == 0)
+            return &root;
+
+        auto c = containers.get(id);
+        return c ? &*c : nullptr;
+    }
+
+    static bool charge(lv2_container& c, u64 size)
+    {
+        u64 used = c.used.load();
+
+        do
+        {
+            if(used + size > c.size)
+                return false;
+        }
+        while(!c.used.compare_exchange_weak(used, used + size));
+
+        return true;
+    }
+
+    static u64 page_size(u64 flags)
+    {
+        switch(flags & page_flags::mask)
+        {
+        case 0:
+        case page_flags::size_1m:
+            return 0x100000;
+        case page_flags::size_64k:
+            return 0x10000;
+        default:
+            return 0;
+        }
+    }
+
+    static u32 allocate(u64 size, u32 cid, u64 flags, vm::ptr<big<u32>> out)
+    {
+        if(!out)
+            return efault;
+
+        u64 page = page_size(flags);
+        if(!page)
+            return einval;
+
+        if(!size || size % page)
+            return ealign;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        lv2_container* c = find_container(cid);
+        if(!c)
+            return esrch;
+
+        if(!charge(*c, size))
+            return enomem;
+
+        // pages are backed by the host as they are touched
+        block* from = page == 0x100000 ? user1m : user64k;
+        vm::addr at = from->alloc(size, page);
+
+        if(!at)
+        {
+            c->used -= size;
+            return enomem;
+        }
+
+        allocations[at] = { size, cid };
+        spdlog::debug("allocated {:x} bytes of guest memory at {:x}", size, at);
+
+        *out = endian::byte_swap(static_cast<u32>(at));
+        return 0;
+    }
+
+    static u32 sys_memory_allocate(u64 size, u64 flags, vm::ptr<big<u32>> alloc_addr)
+    {
+        return allocate(size, 0, flags, alloc_addr);
+    }
+
+    static u32 sys_memory_allocate_from_container(u64 size, u32 cid, u64 flags, vm::ptr<big<u32>> alloc_addr)
+    {
+        return cid ? allocate(size, cid, flags, alloc_addr) : esrch;
+    }
+
+    static u32 sys_memory_free(u32 addr)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto it = allocations.find(addr);
+        if(it == allocations.end())
+            return einval;
+
+        auto [size, cid] = it->second;
+        allocations.erase(it);
+
+        (user1m->contains(addr) ? user1m : user64k)->dealloc(addr);
+
+        find_container(cid)->used -= size;
+        return 0;
+    }
+
+    static u32 sys_memory_get_page_attribute(u32 addr, vm::ptr<page_attribute> attr)
+    {
+        if(!attr)
+            return efault;
+
+        u32 page = 0;
+
+        {
+            std::lock_guard<std::mutex> guard(mut);
+
+            for(auto& [at, map] : mappings)
+            {
+                if(addr >= at && addr < at + map.size)
+                {
+                    if(auto shm = shared.get(map.id))
+                        page = shm->page_size;
+                }
+            }
+        }
+
+        for(block* b : { main, user64k, user1m, video, stack, spu })
+        {
+            if(!page && b && b->contains(addr))
+                page = b->page_size;
+        }
+
+        if(!page)
+            return einval;
+
+        attr->attribute = endian::byte_swap(prot_read_write);
+        attr->access_right = endian::byte_swap(access_right_any);
+        attr->page_size = endian::byte_swap(page);
+        attr->pad = 0;
+
+        return 0;
+    }
+
+    static u32 write_info(const lv2_container& c, vm::ptr<memory_info> info)
+    {
+        info->total = endian::byte_swap(static_cast<u32>(c.size));
+        info->available = endian::byte_swap(static_cast<u32>(c.size - c.used));
+        return 0;
+    }
+
+    static u32 sys_memory_get_user_memory_size(vm::ptr<memory_info> info)
+    {
+        if(!info)
+            return efault;
+
+        return write_info(root, info);
+    }
+
+    static u32 sys_memory_container_create(vm::ptr<big<u32>> cid, u64 size)
+    {
+        if(!cid)
+            return efault;
+
+        if(!size || size % container_align)
+            return ealign;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        // a container takes its whole budget from the default one up front
+        if(!charge(root, size))
+            return enomem;
+
+        u32 id = containers.add(std::make_unique<lv2_container>(size));
+
+        if(!id)
+        {
+            root.used -= size;
+            return eagain;
+        }
+
+        *cid = endian::byte_swap(id);
+        return 0;
+    }
+
+    static u32 sys_memory_container_destroy(u32 cid)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        u64 size;
+
+        {
+            auto c = containers.get(cid);
+            if(!c)
+                return esrch;
+
+            if(c->used)
+                return ebusy;
+
+            size = c->size;
+        }
+
+        containers.remove(cid);
+        root.used -= size;
+
+        return 0;
+    }
+
+    static u32 sys_memory_container_get_size(vm::ptr<memory_info> info, u32 cid)
+    {
+        if(!info)
+            return efault;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto c = containers.get(cid);
+        return c ? write_info(*c, info) : esrch;
+    }
+
+    // mmapper
+
+    static u32 sys_mmapper_allocate_address(u64 size, u64 flags, u64 alignment, vm::ptr<big<u32>> alloc_addr)
+    {
+        if(!alloc_addr)
+            return efault;
+
+        if(!size || size % segment_size)
+            return ealign;
+
+        if(!alignment)
+            alignment = segment_size;
+
+        if(alignment & (alignment - 1) || alignment < segment_size)
+            return einval;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        // only the address range is reserved, memory comes from mapping shared memory into it
+        vm::addr at = mapped->alloc(size, alignment);
+        if(!at)
+            return enomem;
+
+        areas[at] = size;
+
+        *alloc_addr = endian::byte_swap(static_cast<u32>(at));
+        return 0;
+    }
+
+    static u32 sys_mmapper_free_address(u32 addr)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto it = areas.find(addr);
+        if(it == areas.end())
+            return einval;
+
+        auto inside = mappings.lower_bound(addr);
+        if(inside != mappings.end() && inside->first < addr + it->second)
+            return ebusy;
+
+        mapped->dealloc(addr);
+        areas.erase(it);
+
+        return 0;
+    }
+
+    static u32 create_shared(u64 size, u32 cid, u64 flags, vm::ptr<big<u32>> mem_id)
+    {
+        if(!mem_id)
+            return efault;
+
+        u64 page = page_size(flags);
+        if(!page)
+            return einval;
+
+        if(!size || size % page)
+            return ealign;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        lv2_container* c = find_container(cid);
+        if(!c)
+            return esrch;
+
+        if(!charge(*c, size))
+            return enomem;
+
+        auto shm = std::make_unique<lv2_shared_memory>();
+        shm->size = size;
+        shm->page_size = page;
+        shm->container = cid;
+
+        u32 id = shared.add(std::move(shm));
+
+        if(!id)
+        {
+            c->used -= size;
+            return eagain;
+        }
+
+        *mem_id = endian::byte_swap(id);
+        return 0;
+    }
+
+    static u32 sys_mmapper_allocate_shared_memory(u64 ipc_key, u64 size, u64 flags, vm::ptr<big<u32>> mem_id)
+    {
+        return create_shared(size, 0, flags, mem_id);
+    }
+
+    static u32 sys_mmapper_allocate_memory_from_container(u64 size, u32 cid, u64 flags, vm::ptr<big<u32>> mem_id)
+    {
+        return cid ? create_shared(size, cid, flags, mem_id) : esrch;
+    }
+
+    static u32 sys_mmapper_free_shared_memory(u32 mem_id)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        u64 size;
+        u32 cid;
+
+        {
+            auto shm = shared.get(mem_id);
+            if(!shm)
+                return esrch;
+
+            if(shm->addr)
+                return ebusy;
+
+            size = shm->size;
+            cid = shm->container;
+        }
+
+        shared.remove(mem_id);
+        find_container(cid)->used -= size;
+
+        return 0;
+    }
+
+    // the lock must be held
+    static u32 map_at(u32 addr, u32 mem_id, lv2_shared_memory& shm)
+    {
+        auto area = areas.upper_bound(addr);
+        if(area == areas.begin())
+            return einval;
+
+        --area;
+
+        if(addr + shm.size > area->first + area->second)
+            return einval;
+
+        for(auto& [at, map] : mappings)
+        {
+            if(at < addr + shm.size && addr < at + map.size)
+                return ebusy;
+        }
+
+        // the area was decommitted when it was reserved or last unmapped so it already reads as zero
+        if(!shm.saved.empty())
+        {
+            std::memcpy(vm::base(addr), shm.saved.data(), shm.size);
+            shm.saved = {};
+        }
+
+        shm.addr = addr;
+        mappings[addr] = { mem_id, shm.size };
+
+        return 0;
+    }
+
+    static u32 sys_mmapper_map_shared_memory(u32 addr, u32 mem_id, u64 flags)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto shm = shared.get(mem_id);
+        if(!shm)
+            return esrch;
+
+        if(shm->addr)
+            return ebusy;
+
+        if(addr % shm->page_size)
+            return ealign;
+
+        return map_at(addr, mem_id, *shm);
+    }
+
+    static u32 sys_mmapper_search_and_map(u32 start_addr, u32 mem_id, u64 flags, vm::ptr<big<u32>> alloc_addr)
+    {
+        if(!alloc_addr)
+            return efault;
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto shm = shared.get(mem_id);
+        if(!shm)
+            return esrch;
+
+        if(shm->addr)
+            return ebusy;
+
+        auto area = areas.find(start_addr);
+        if(area == areas.end())
+            return einval;
+
+        for(u64 at = start_addr; at + shm->size <= start_addr + area->second; at += shm->page_size)
+        {
+            if(map_at(at, mem_id, *shm) == 0)
+            {
+                *alloc_addr = endian::byte_swap(static_cast<u32>(at));
+                return 0;
+            }
+        }
+
+        return enomem;
+    }
+
+    static u32 sys_mmapper_unmap_shared_memory(u32 addr, vm::ptr<big<u32>> mem_id)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto it = mappings.find(addr);
+        if(it == mappings.end())
+            return einval;
+
+        u32 id = it->second.id;
+        mappings.erase(it);
+
+        if(auto shm = shared.get(id))
+        {
+            // keep the contents for wherever it is mapped next and give the pages back
+            auto* data = static_cast<u8*>(vm::base(addr));
+            shm->saved.assign(data, data + shm->size);
+            shm->addr = 0;
+
+            decommit(addr, shm->size);
+        }
+
+        if(mem_id)
+            *mem_id = endian::byte_swap(id);
+
+        return 0;
+    }
+
+    void init_memory()
+    {
+        bind_syscall<sys_mmapper_free_shared_memory>(329);
+        bind_syscall<sys_mmapper_allocate_address>(330);
+        bind_syscall<sys_mmapper_free_address>(331);
+        bind_syscall<sys_mmapper_allocate_shared_memory>(332);
+        bind_syscall<sys_mmapper_map_shared_memory>(334);
+        bind_syscall<sys_mmapper_unmap_shared_memory>(335);
+        bind_syscall<sys_mmapper_search_and_map>(337);
+
+        bind_syscall<sys_memory_container_create>(341);
+        bind_syscall<sys_memory_container_destroy>(342);
+        bind_syscall<sys_memory_container_get_size>(343);
+
+        bind_syscall<sys_memory_allocate>(348);
+        bind_syscall<sys_memory_free>(349);
+        bind_syscall<sys_memory_allocate_from_container>(350);
+        bind_syscall<sys_memory_get_page_attribute>(351);
+        bind_syscall<sys_memory_get_user_memory_size>(352);
+
+        bind_syscall<sys_mmapper_allocate_memory_from_container>(362);
+    }
+
+    void report_memory()
+    {
+        if(!main)
+            return;
+
+        spdlog::info("title memory {:x} of {:x} bytes in use", root.used.load(), root.size);
+
+        const std::pair<const char*, block*> blocks[] = {
+            { "main", main },
+            { "user64k", user64k },
+            { "user1m", user1m },
+            { "mapped", mapped },
+            { "stack", stack }
+        };
+
+        for(auto [name, b] : blocks)
+            if(b)
+                spdlog::info("{} block {:x} of {:x} bytes allocated", name, b->used.load(), b->width);
+    }
+}
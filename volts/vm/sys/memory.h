@@ -0,0 +1,18 @@
+#pragma once
+
+namespace volts::vm
+{
+    /**
+     * @brief bind the sys_memory and sys_mmapper syscalls
+     *
+     * every allocation is charged to a memory container, the default
+     * container holds the memory a title is given and the containers
+     * it creates are carved out of it
+     */
+    void init_memory();
+
+    /**
+     * @brief log how much of each guest memory block and the title budget is in use
+     */
+    void report_memory();
+}
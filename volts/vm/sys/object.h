@@ -0,0 +1,153 @@
+#pragma once
+
+#include <types.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace volts::vm
+{
+    /**
+     * @brief kernel objects of one type, looked up by the id the guest was given
+     *
+     * lookups only touch atomics so they never contend with each other. users
+     * counts lookups still holding an object so it can be freed safely
+     *
+     * @tparam T the type of object
+     * @tparam N the most objects that can exist at once
+     */
+    template<typename T, svl::u32 N = 1024>
+    struct object_table
+    {
+        /**
+         * @param base the first id, lv2 ids of each type have their own top byte
+         */
+        object_table(svl::u32 base)
+            : base(base)
+        {
+        }
+
+        object_table(const object_table&) = delete;
+        object_table& operator=(const object_table&) = delete;
+
+        ~object_table()
+        {
+            for(auto& s : slots)
+                delete s.obj.load();
+        }
+
+        struct slot
+        {
+            std::atomic<T*> obj = nullptr;
+            std::atomic<svl::u32> users = 0;
+        };
+
+        /**
+         * @brief keeps an object alive while it is used
+         */
+        struct ref
+        {
+            ref(slot* s, T* obj)
+                : s(s)
+                , obj(obj)
+            {
+            }
+
+            ref(ref&& other)
+                : s(other.s)
+                , obj(other.obj)
+            {
+                other.s = nullptr;
+                other.obj = nullptr;
+            }
+
+            ref(const ref&) = delete;
+            ref& operator=(const ref&) = delete;
+
+            ~ref()
+            {
+                if(s)
+                    s->users--;
+            }
+
+            explicit operator bool() const { return obj != nullptr; }
+
+            T* operator->() const { return obj; }
+            T& operator*() const { return *obj; }
+
+        private:
+            slot* s;
+            T* obj;
+        };
+
+        /**
+         * @brief add an object
+         *
+         * @param obj the object to add
+         * @return svl::u32 the id of the object, 0 if the table is full
+         */
+        svl::u32 add(std::unique_ptr<T> obj)
+        {
+            for(svl::u32 i = 0; i < N; i++)
+            {
+                // a slot being removed still has users and cant be reused yet
+                T* expected = nullptr;
+                if(slots[i].users.load() == 0 && slots[i].obj.compare_exchange_strong(expected, obj.get()))
+                {
+                    obj.release();
+                    return base + i;
+                }
+            }
+
+            return 0;
+        }
+
+        /**
+         * @brief find an object
+         *
+         * @param id the id of the object
+         * @return ref the object, empty if there is no object with the id
+         */
+        ref get(svl::u32 id)
+        {
+            if(id - base >= N)
+                return ref(nullptr, nullptr);
+
+            slot& s = slots[id - base];
+            s.users++;
+
+            if(T* obj = s.obj.load())
+                return ref(&s, obj);
+
+            s.users--;
+            return ref(nullptr, nullptr);
+        }
+
+        /**
+         * @brief remove an object once nothing is using it
+         *
+         * @param id the id of the object
+         * @return std::unique_ptr<T> the object, empty if there was no object with the id
+         */
+        std::unique_ptr<T> remove(svl::u32 id)
+        {
+            if(id - base >= N)
+                return nullptr;
+
+            slot& s = slots[id - base];
+
+            std::unique_ptr<T> obj(s.obj.exchange(nullptr));
+
+            // lookups that found the object just before it was removed
+            while(obj && s.users.load())
+                std::this_thread::yield();
+
+            return obj;
+        }
+
+    private:
+        svl::u32 base;
+        slot slots[N];
+    };
+}
@@ -0,0 +1,994 @@
+#include "sync.h"
+#include "syscall.h"
+#include "object.h"
+#include "timer.h"
+
+#include <futex.h>
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// how often an expired deadline wakes its word until the sleeper notices
+    constexpr u64 expire_retry_usec = 16;
+
+    void deadline::expire(void* arg)
+    {
+        auto& self = *static_cast<deadline*>(arg);
+        self.expired = true;
+
+        // the thread may not be asleep yet so the timer keeps firing until the deadline goes away
+        if(auto* word = self.waiting.load())
+            futex::wake_all(*word);
+    }
+
+    deadline::~deadline()
+    {
+        // once this returns the callback isnt running and wont run again
+        if(timer)
+            cancel_timer(timer);
+    }
+
+    bool deadline::sleep(std::atomic<u32>& word, u32 expected)
+    {
+        if(forever)
+        {
+            futex::wait(word, expected);
+            return true;
+        }
+
+        if(expired)
+            return false;
+
+        waiting = &word;
+
+        if(!timer)
+        {
+            auto left = at - std::chrono::steady_clock::now();
+            if(left.count() <= 0)
+                return false;
+
+            u64 usec = std::chrono::duration_cast<std::chrono::microseconds>(left).count();
+            timer = add_timer(usec, expire_retry_usec, expire, this);
+
+            // the wheel is full so fall back to a host timeout
+            if(!timer)
+            {
+                futex::wait_for(word, expected, std::chrono::duration_cast<std::chrono::nanoseconds>(left).count());
+                return true;
+            }
+        }
+
+        // a timeout shows up on the next call
+        if(!expired)
+            futex::wait(word, expected);
+
+        return true;
+    }
+
+    /// sync attribute values
+    constexpr u32 sync_recursive = 0x10;
+    constexpr u32 sync_waiter_single = 0x10000;
+
+    /// event flag wait modes
+    namespace flag_mode
+    {
+        constexpr u32 wait_and = 0x01;
+        constexpr u32 wait_or = 0x02;
+        constexpr u32 clear = 0x10;
+        constexpr u32 clear_all = 0x20;
+    }
+
+    struct mutex_attr
+    {
+        big<u32> protocol;
+        big<u32> recursive;
+        big<u32> pshared;
+        big<u32> adaptive;
+        big<u64> ipc_key;
+        big<i32> flags;
+        big<u32> pad;
+        char name[8];
+    };
+
+    struct event_flag_attr
+    {
+        big<u32> protocol;
+        big<u32> pshared;
+        big<u64> ipc_key;
+        big<i32> flags;
+        big<i32> type;
+        char name[8];
+    };
+
+    struct lv2_mutex
+    {
+        /// 0 when unlocked, 1 when locked and 2 when locked with sleepers
+        std::atomic<u32> state = 0;
+
+        std::atomic<ppu::thread*> owner = nullptr;
+
+        /// times the owner has locked it, only touched by the owner
+        u32 depth = 0;
+
+        bool recursive = false;
+
+        std::atomic<u32> waiters = 0;
+
+        /// conds created on this mutex
+        std::atomic<u32> conds = 0;
+    };
+
+    struct lv2_cond
+    {
+        u32 mutex;
+
+        /// signals not yet taken by a waiter, never more than there are waiters
+        std::atomic<u32> tokens = 0;
+        std::atomic<u32> waiters = 0;
+    };
+
+    struct lv2_semaphore
+    {
+        std::atomic<u32> value = 0;
+        u32 max = 0;
+        std::atomic<u32> waiters = 0;
+    };
+
+    /// rwlock state bit held by a writer, the rest counts readers
+    constexpr u32 write_locked = 0x80000000;
+
+    struct lv2_rwlock
+    {
+        std::atomic<u32> state = 0;
+        std::atomic<ppu::thread*> writer = nullptr;
+        std::atomic<u32> waiters = 0;
+    };
+
+    struct lv2_event_flag
+    {
+        std::atomic<u64> pattern = 0;
+
+        /// bumped by every set, the pattern is 64 bits so waiters sleep on this instead
+        std::atomic<u32> seq = 0;
+        std::atomic<u32> waiters = 0;
+
+        bool single = false;
+    };
+
+    /**
+     * @brief the kernel half of an lwmutex
+     *
+     * the guest library does the atomics on its own lwmutex and only
+     * calls into the kernel to sleep, so this just passes a wakeup along
+     */
+    struct lv2_lwmutex
+    {
+        std::atomic<u32> signaled = 0;
+        std::atomic<u32> waiters = 0;
+    };
+
+    // every type has its own ids like lv2
+    static object_table<lv2_mutex> mutexes(0x85000000);
+    static object_table<lv2_cond> conds(0x86000000);
+    static object_table<lv2_rwlock> rwlocks(0x88000000);
+    static object_table<lv2_lwmutex> lwmutexes(0x95000000);
+    static object_table<lv2_semaphore> semaphores(0x96000000);
+    static object_table<lv2_event_flag> event_flags(0x98000000);
+
+    template<typename T>
+    static u32 create(object_table<T>& table, vm::ptr<big<u32>> id, std::unique_ptr<T> obj)
+    {
+        u32 num = table.add(std::move(obj));
+        if(!num)
+            return eagain;
+
+        *id = endian::byte_swap(num);
+        return 0;
+    }
+
+    // objects with threads sleeping on them cant be destroyed
+    template<typename T>
+    static u32 destroy(object_table<T>& table, u32 id)
+    {
+        {
+            auto obj = table.get(id);
+            if(!obj)
+                return esrch;
+
+            if(obj->waiters)
+                return ebusy;
+        }
+
+        table.remove(id);
+        return 0;
+    }
+
+    // mutex
+
+    static bool lock(lv2_mutex& m, ppu::thread& ppu, deadline& d)
+    {
+        u32 c = 0;
+        if(!m.state.compare_exchange_strong(c, 1))
+        {
+            m.waiters++;
+
+            // mark the mutex contended so the unlock knows to wake someone
+            if(c != 2)
+                c = m.state.exchange(2);
+
+            while(c != 0)
+            {
+                if(!d.sleep(m.state, 2))
+                {
+                    m.waiters--;
+                    return false;
+                }
+
+                c = m.state.exchange(2);
+            }
+
+            m.waiters--;
+        }
+
+        m.owner = &ppu;
+        m.depth = 1;
+
+        return true;
+    }
+
+    static void unlock(lv2_mutex& m)
+    {
+        m.owner = nullptr;
+        m.depth = 0;
+
+        if(m.state.exchange(0) == 2)
+            futex::wake_one(m.state);
+    }
+
+    static u32 sys_mutex_create(vm::ptr<big<u32>> id, vm::ptr<mutex_attr> attr)
+    {
+        if(!id || !attr)
+            return efault;
+
+        auto m = std::make_unique<lv2_mutex>();
+        m->recursive = attr->recursive == sync_recursive;
+
+        return create(mutexes, id, std::move(m));
+    }
+
+    static u32 sys_mutex_destroy(u32 id)
+    {
+        {
+            auto m = mutexes.get(id);
+            if(!m)
+                return esrch;
+
+            if(m->state || m->conds)
+                return ebusy;
+        }
+
+        return destroy(mutexes, id);
+    }
+
+    static u32 sys_mutex_lock(ppu::thread& ppu, u32 id, u64 timeout)
+    {
+        auto m = mutexes.get(id);
+        if(!m)
+            return esrch;
+
+        if(m->owner == &ppu)
+        {
+            if(!m->recursive)
+                return edeadlk;
+
+            m->depth++;
+            return 0;
+        }
+
+        deadline d(timeout);
+        return lock(*m, ppu, d) ? 0 : etimedout;
+    }
+
+    static u32 sys_mutex_trylock(ppu::thread& ppu, u32 id)
+    {
+        auto m = mutexes.get(id);
+        if(!m)
+            return esrch;
+
+        if(m->owner == &ppu)
+        {
+            if(!m->recursive)
+                return edeadlk;
+
+            m->depth++;
+            return 0;
+        }
+
+        u32 c = 0;
+        if(!m->state.compare_exchange_strong(c, 1))
+            return ebusy;
+
+        m->owner = &ppu;
+        m->depth = 1;
+
+        return 0;
+    }
+
+    static u32 sys_mutex_unlock(ppu::thread& ppu, u32 id)
+    {
+        auto m = mutexes.get(id);
+        if(!m)
+            return esrch;
+
+        if(m->owner != &ppu)
+            return eperm;
+
+        if(--m->depth == 0)
+            unlock(*m);
+
+        return 0;
+    }
+
+    // cond
+
+    static u32 sys_cond_create(vm::ptr<big<u32>> id, u32 mutex_id, vm::ptr<u8> attr)
+    {
+        if(!id || !attr)
+            return efault;
+
+        auto m = mutexes.get(mutex_id);
+        if(!m)
+            return esrch;
+
+        auto c = std::make_unique<lv2_cond>();
+        c->mutex = mutex_id;
+
+        if(u32 err = create(conds, id, std::move(c)))
+            return err;
+
+        m->conds++;
+        return 0;
+    }
+
+    static u32 sys_cond_destroy(u32 id)
+    {
+        u32 mutex_id;
+
+        {
+            auto c = conds.get(id);
+            if(!c)
+                return esrch;
+
+            mutex_id = c->mutex;
+        }
+
+        if(u32 err = destroy(conds, id))
+            return err;
+
+        if(auto m = mutexes.get(mutex_id))
+            m->conds--;
+
+        return 0;
+    }
+
+    static u32 sys_cond_wait(ppu::thread& ppu, u32 id, u64 timeout)
+    {
+        auto c = conds.get(id);
+        if(!c)
+            return esrch;
+
+        auto m = mutexes.get(c->mutex);
+        if(!m)
+            return esrch;
+
+        if(m->owner != &ppu)
+            return eperm;
+
+        deadline d(timeout);
+        u32 result = 0;
+
+        c->waiters++;
+
+        // the mutex is released completely and relocked to the same depth afterwards
+        u32 depth = m->depth;
+        unlock(*m);
+
+        while(true)
+        {
+            u32 t = c->tokens.load();
+
+            if(t && c->tokens.compare_exchange_weak(t, t - 1))
+                break;
+
+            if(!t && !d.sleep(c->tokens, 0))
+            {
+                result = etimedout;
+                break;
+            }
+        }
+
+        c->waiters--;
+
+        // a signal meant for a thread that timed out shouldnt wake a later waiter
+        for(u32 t = c->tokens.load(); t > c->waiters.load() && !c->tokens.compare_exchange_weak(t, t - 1);)
+            ;
+
+        deadline forever(0);
+        lock(*m, ppu, forever);
+        m->depth = depth;
+
+        return result;
+    }
+
+    static u32 signal(lv2_cond& c, bool all)
+    {
+        u32 t = c.tokens.load();
+
+        while(true)
+        {
+            u32 w = c.waiters.load();
+
+            // nobody is left to take another signal
+            if(t >= w)
+                return 0;
+
+            if(c.tokens.compare_exchange_weak(t, all ? w : t + 1))
+                break;
+        }
+
+        if(all)
+            futex::wake_all(c.tokens);
+        else
+            futex::wake_one(c.tokens);
+
+        return 0;
+    }
+
+    static u32 sys_cond_signal(u32 id)
+    {
+        auto c = conds.get(id);
+        return c ? signal(*c, false) : esrch;
+    }
+
+    static u32 sys_cond_signal_all(u32 id)
+    {
+        auto c = conds.get(id);
+        return c ? signal(*c, true) : esrch;
+    }
+
+    static u32 sys_cond_signal_to(u32 id, u32 thread_id)
+    {
+        // ppu threads dont have ids yet so any waiter is woken
+        auto c = conds.get(id);
+        return c ? signal(*c, false) : esrch;
+    }
+
+    // semaphore
+
+    static u32 sys_semaphore_create(vm::ptr<big<u32>> id, vm::ptr<u8> attr, i32 initial, i32 max)
+    {
+        if(!id || !attr)
+            return efault;
+
+        if(max <= 0 || initial < 0 || initial > max)
+            return einval;
+
+        auto s = std::make_unique<lv2_semaphore>();
+        s->value = initial;
+        s->max = max;
+
+        return create(semaphores, id, std::move(s));
+    }
+
+    static u32 sys_semaphore_destroy(u32 id)
+    {
+        return destroy(semaphores, id);
+    }
+
+    static u32 sys_semaphore_wait(u32 id, u64 timeout)
+    {
+        auto s = semaphores.get(id);
+        if(!s)
+            return esrch;
+
+        deadline d(timeout);
+
+        while(true)
+        {
+            u32 v = s->value.load();
+
+            if(v)
+            {
+                if(s->value.compare_exchange_weak(v, v - 1))
+                    return 0;
+
+                continue;
+            }
+
+            s->waiters++;
+            bool slept = d.sleep(s->value, 0);
+            s->waiters--;
+
+            if(!slept)
+                return etimedout;
+        }
+    }
+
+    static u32 sys_semaphore_trywait(u32 id)
+    {
+        auto s = semaphores.get(id);
+        if(!s)
+            return esrch;
+
+        for(u32 v = s->value.load(); v;)
+        {
+            if(s->value.compare_exchange_weak(v, v - 1))
+                return 0;
+        }
+
+        return ebusy;
+    }
+
+    static u32 sys_semaphore_post(u32 id, i32 count)
+    {
+        auto s = semaphores.get(id);
+        if(!s)
+            return esrch;
+
+        if(count < 0)
+            return einval;
+
+        u32 v = s->value.load();
+
+        do
+        {
+            if(v + count > s->max)
+                return ebusy;
+        }
+        while(!s->value.compare_exchange_weak(v, v + count));
+
+        if(s->waiters)
+        {
+            if(count == 1)
+                futex::wake_one(s->value);
+            else
+                futex::wake_all(s->value);
+        }
+
+        return 0;
+    }
+
+    static u32 sys_semaphore_get_value(u32 id, vm::ptr<big<i32>> out)
+    {
+        if(!out)
+            return efault;
+
+        auto s = semaphores.get(id);
+        if(!s)
+            return esrch;
+
+        *out = endian::byte_swap(static_cast<i32>(s->value.load()));
+        return 0;
+    }
+
+    // rwlock
+
+    static u32 sys_rwlock_create(vm::ptr<big<u32>> id, vm::ptr<u8> attr)
+    {
+        if(!id || !attr)
+            return efault;
+
+        return create(rwlocks, id, std::make_unique<lv2_rwlock>());
+    }
+
+    static u32 sys_rwlock_destroy(u32 id)
+    {
+        {
+            auto rw = rwlocks.get(id);
+            if(!rw)
+                return esrch;
+
+            if(rw->state)
+                return ebusy;
+        }
+
+        return destroy(rwlocks, id);
+    }
+
+    // readers only wait on a writer, waiting writers dont hold back new readers
+    static bool try_rlock(lv2_rwlock& rw, u32& s)
+    {
+        s = rw.state.load();
+
+        while(!(s & write_locked))
+        {
+            if(rw.state.compare_exchange_weak(s, s + 1))
+                return true;
+        }
+
+        return false;
+    }
+
+    static bool try_wlock(lv2_rwlock& rw, ppu::thread& ppu, u32& s)
+    {
+        s = 0;
+        if(!rw.state.compare_exchange_strong(s, write_locked))
+            return false;
+
+        rw.writer = &ppu;
+        return true;
+    }
+
+    static u32 sys_rwlock_rlock(ppu::thread& ppu, u32 id, u64 timeout)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        if(rw->writer == &ppu)
+            return edeadlk;
+
+        deadline d(timeout);
+
+        for(u32 s; !try_rlock(*rw, s);)
+        {
+            rw->waiters++;
+            bool slept = d.sleep(rw->state, s);
+            rw->waiters--;
+
+            if(!slept)
+                return etimedout;
+        }
+
+        return 0;
+    }
+
+    static u32 sys_rwlock_tryrlock(u32 id)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        u32 s;
+        return try_rlock(*rw, s) ? 0 : ebusy;
+    }
+
+    static u32 sys_rwlock_runlock(u32 id)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        u32 s = rw->state.load();
+
+        do
+        {
+            if(s & write_locked || !s)
+                return eperm;
+        }
+        while(!rw->state.compare_exchange_weak(s, s - 1));
+
+        if(s == 1 && rw->waiters)
+            futex::wake_all(rw->state);
+
+        return 0;
+    }
+
+    static u32 sys_rwlock_wlock(ppu::thread& ppu, u32 id, u64 timeout)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        if(rw->writer == &ppu)
+            return edeadlk;
+
+        deadline d(timeout);
+
+        for(u32 s; !try_wlock(*rw, ppu, s);)
+        {
+            rw->waiters++;
+            bool slept = d.sleep(rw->state, s);
+            rw->waiters--;
+
+            if(!slept)
+                return etimedout;
+        }
+
+        return 0;
+    }
+
+    static u32 sys_rwlock_trywlock(ppu::thread& ppu, u32 id)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        if(rw->writer == &ppu)
+            return edeadlk;
+
+        u32 s;
+        return try_wlock(*rw, ppu, s) ? 0 : ebusy;
+    }
+
+    static u32 sys_rwlock_wunlock(ppu::thread& ppu, u32 id)
+    {
+        auto rw = rwlocks.get(id);
+        if(!rw)
+            return esrch;
+
+        if(rw->writer != &ppu)
+            return eperm;
+
+        rw->writer = nullptr;
+        rw->state = 0;
+
+        if(rw->waiters)
+            futex::wake_all(rw->state);
+
+        return 0;
+    }
+
+    // event flag
+
+    static u32 sys_event_flag_create(vm::ptr<big<u32>> id, vm::ptr<event_flag_attr> attr, u64 init)
+    {
+        if(!id || !attr)
+            return efault;
+
+        auto ev = std::make_unique<lv2_event_flag>();
+        ev->pattern = init;
+        ev->single = attr->type == static_cast<i32>(sync_waiter_single);
+
+        return create(event_flags, id, std::move(ev));
+    }
+
+    static u32 sys_event_flag_destroy(u32 id)
+    {
+        return destroy(event_flags, id);
+    }
+
+    static bool valid_mode(u32 mode)
+    {
+        u32 wait = mode & 0xF;
+        u32 clear = mode & ~0xFu;
+
+        return (wait == flag_mode::wait_and || wait == flag_mode::wait_or)
+            && (clear == 0 || clear == flag_mode::clear || clear == flag_mode::clear_all);
+    }
+
+    // take the bits if the pattern satisfies the wait, result is the pattern before clearing
+    static bool take(lv2_event_flag& ev, u64 bits, u32 mode, u64& result)
+    {
+        u64 p = ev.pattern.load();
+
+        while(true)
+        {
+            bool ok = (mode & flag_mode::wait_and) ? (p & bits) == bits : (p & bits) != 0;
+            if(!ok)
+                return false;
+
+            u64 next = p;
+            if(mode & flag_mode::clear_all)
+                next = 0;
+            else if(mode & flag_mode::clear)
+                next = p & ~bits;
+
+            if(ev.pattern.compare_exchange_weak(p, next))
+            {
+                result = p;
+                return true;
+            }
+        }
+    }
+
+    static u32 sys_event_flag_wait(u32 id, u64 bits, u32 mode, vm::ptr<big<u64>> result, u64 timeout)
+    {
+        if(!bits || !valid_mode(mode))
+            return einval;
+
+        auto ev = event_flags.get(id);
+        if(!ev)
+            return esrch;
+
+        if(ev->single && ev->waiters)
+            return eperm;
+
+        deadline d(timeout);
+        u64 out = 0;
+
+        while(true)
+        {
+            u32 seq = ev->seq.load();
+
+            if(take(*ev, bits, mode, out))
+                break;
+
+            ev->waiters++;
+            bool slept = d.sleep(ev->seq, seq);
+            ev->waiters--;
+
+            if(!slept)
+            {
+                if(result)
+                    *result = endian::byte_swap(ev->pattern.load());
+
+                return etimedout;
+            }
+        }
+
+        if(result)
+            *result = endian::byte_swap(out);
+
+        return 0;
+    }
+
+    static u32 sys_event_flag_trywait(u32 id, u64 bits, u32 mode, vm::ptr<big<u64>> result)
+    {
+        if(!bits || !valid_mode(mode))
+            return einval;
+
+        auto ev = event_flags.get(id);
+        if(!ev)
+            return esrch;
+
+        u64 out = 0;
+        if(!take(*ev, bits, mode, out))
+            return ebusy;
+
+        if(result)
+            *result = endian::byte_swap(out);
+
+        return 0;
+    }
+
+    static u32 sys_event_flag_set(u32 id, u64 bits)
+    {
+        auto ev = event_flags.get(id);
+        if(!ev)
+            return esrch;
+
+        ev->pattern |= bits;
+        ev->seq++;
+
+        if(ev->waiters)
+            futex::wake_all(ev->seq);
+
+        return 0;
+    }
+
+    static u32 sys_event_flag_clear(u32 id, u64 bits)
+    {
+        auto ev = event_flags.get(id);
+        if(!ev)
+            return esrch;
+
+        // bits are the ones to keep
+        ev->pattern &= bits;
+        return 0;
+    }
+
+    static u32 sys_event_flag_get(u32 id, vm::ptr<big<u64>> flags)
+    {
+        if(!flags)
+            return efault;
+
+        auto ev = event_flags.get(id);
+        if(!ev)
+            return esrch;
+
+        *flags = endian::byte_swap(ev->pattern.load());
+        return 0;
+    }
+
+    // lwmutex
+
+    static u32 sys_lwmutex_create(vm::ptr<big<u32>> id, u32 protocol, vm::ptr<u8> control, i32 has_name, u64 name)
+    {
+        if(!id)
+            return efault;
+
+        return create(lwmutexes, id, std::make_unique<lv2_lwmutex>());
+    }
+
+    static u32 sys_lwmutex_destroy(u32 id)
+    {
+        return destroy(lwmutexes, id);
+    }
+
+    static u32 sys_lwmutex_lock(u32 id, u64 timeout)
+    {
+        auto lw = lwmutexes.get(id);
+        if(!lw)
+            return esrch;
+
+        deadline d(timeout);
+
+        while(!lw->signaled.exchange(0))
+        {
+            lw->waiters++;
+            bool slept = d.sleep(lw->signaled, 0);
+            lw->waiters--;
+
+            if(!slept)
+                return etimedout;
+        }
+
+        return 0;
+    }
+
+    static u32 sys_lwmutex_trylock(u32 id)
+    {
+        auto lw = lwmutexes.get(id);
+        if(!lw)
+            return esrch;
+
+        return lw->signaled.exchange(0) ? 0 : ebusy;
+    }
+
+    static u32 sys_lwmutex_unlock(u32 id)
+    {
+        auto lw = lwmutexes.get(id);
+        if(!lw)
+            return esrch;
+
+        // an unlock with nobody sleeping lets the next lock through straight away
+        lw->signaled = 1;
+
+        if(lw->waiters)
+            futex::wake_one(lw->signaled);
+
+        return 0;
+    }
+
+    void init_sync()
+    {
+        bind_syscall<sys_event_flag_create>(82);
+        bind_syscall<sys_event_flag_destroy>(83);
+        bind_syscall<sys_event_flag_wait>(85);
+        bind_syscall<sys_event_flag_trywait>(86);
+        bind_syscall<sys_event_flag_set>(87);
+
+        bind_syscall<sys_semaphore_create>(90);
+        bind_syscall<sys_semaphore_destroy>(91);
+        bind_syscall<sys_semaphore_wait>(92);
+        bind_syscall<sys_semaphore_trywait>(93);
+        bind_syscall<sys_semaphore_post>(94);
+
+        bind_syscall<sys_lwmutex_create>(95);
+        bind_syscall<sys_lwmutex_destroy>(96);
+        bind_syscall<sys_lwmutex_lock>(97);
+        bind_syscall<sys_lwmutex_unlock>(98);
+        bind_syscall<sys_lwmutex_trylock>(99);
+
+        bind_syscall<sys_mutex_create>(100);
+        bind_syscall<sys_mutex_destroy>(101);
+        bind_syscall<sys_mutex_lock>(102);
+        bind_syscall<sys_mutex_trylock>(103);
+        bind_syscall<sys_mutex_unlock>(104);
+
+        bind_syscall<sys_cond_create>(105);
+        bind_syscall<sys_cond_destroy>(106);
+        bind_syscall<sys_cond_wait>(107);
+        bind_syscall<sys_cond_signal>(108);
+        bind_syscall<sys_cond_signal_all>(109);
+        bind_syscall<sys_cond_signal_to>(110);
+
+        bind_syscall<sys_semaphore_get_value>(114);
+        bind_syscall<sys_event_flag_clear>(118);
+
+        bind_syscall<sys_rwlock_create>(120);
+        bind_syscall<sys_rwlock_destroy>(121);
+        bind_syscall<sys_rwlock_rlock>(122);
+        bind_syscall<sys_rwlock_tryrlock>(123);
+        bind_syscall<sys_rwlock_runlock>(124);
+        bind_syscall<sys_rwlock_wlock>(125);
+        bind_syscall<sys_rwlock_trywlock>(126);
+        bind_syscall<sys_rwlock_wunlock>(127);
+
+        bind_syscall<sys_event_flag_get>(139);
+    }
+}
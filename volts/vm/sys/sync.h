@@ -0,0 +1,61 @@
+#pragma once
+
+#include <types.h>
+#include <futex.h>
+
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+namespace volts::vm
+{
+    /**
+     * @brief when a wait gives up, lv2 timeouts are in microseconds and 0 waits forever
+     *
+     * the first sleep arms a timer on the timer wheel that wakes the word
+     * being waited on, so timed waits dont each need a host timer
+     */
+    struct deadline
+    {
+        deadline(svl::u64 usec)
+            : forever(usec == 0)
+            , at(std::chrono::steady_clock::now() + std::chrono::microseconds(std::min<svl::u64>(usec, 1ull << 40)))
+        {
+        }
+
+        deadline(const deadline&) = delete;
+        deadline& operator=(const deadline&) = delete;
+
+        ~deadline();
+
+        /**
+         * @brief sleep on a word until it changes
+         *
+         * @return false if the deadline passed before sleeping
+         */
+        bool sleep(std::atomic<svl::u32>& word, svl::u32 expected);
+
+        bool forever;
+        std::chrono::steady_clock::time_point at;
+
+    private:
+        static void expire(void* arg);
+
+        /// the wheel timer, 0 until the first sleep
+        svl::u32 timer = 0;
+
+        /// set by the timer once the deadline has passed
+        std::atomic<bool> expired = false;
+
+        /// the word the thread is sleeping on, the timer wakes it
+        std::atomic<std::atomic<svl::u32>*> waiting = nullptr;
+    };
+
+    /**
+     * @brief bind the lv2 mutex, cond, semaphore, rwlock, event flag and lwmutex syscalls
+     *
+     * every primitive is an atomic word, uncontended calls never sleep
+     * and contended ones sleep on the word with a host futex
+     */
+    void init_sync();
+}
@@ -0,0 +1,148 @@
+#include "syscall.h"
+#include "timebase.h"
+#include "sync.h"
+#include "fs.h"
+#include "memory.h"
+#include "event.h"
+#include "timer.h"
+#include "trace.h"
+
+#include "spu/raw.h"
+#include "spu/group.h"
+
+#include <atomic>
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    // one extra counter for syscall numbers outside the table
+    static std::array<std::atomic<u32>, std::tuple_size<syscall_table_t>::value + 1> missing = {};
+
+    static void unimplemented(ppu::thread& t)
+    {
+        u64 num = t.gpr[11];
+        auto idx = std::min<u64>(num, missing.size() - 1);
+
+        // only log the first call so games that spin on a missing syscall dont flood the log
+        if(missing[idx].fetch_add(1, std::memory_order_relaxed) == 0)
+            spdlog::warn("unimplemented syscall {} called from {:x}", num, t.cia);
+
+        t.gpr[3] = enosys;
+    }
+
+    static syscall_table_t make_table()
+    {
+        syscall_table_t table;
+        table.fill(unimplemented);
+        return table;
+    }
+
+    syscall_table_t syscall_table = make_table();
+
+    std::array<syscall_outputs_t, std::tuple_size<syscall_table_t>::value> syscall_outputs = {};
+    std::array<bool, std::tuple_size<syscall_table_t>::value> host_syscalls = {};
+
+    syscall_table_t* get_syscall_table()
+    {
+        return &syscall_table;
+    }
+
+    static void dispatch(ppu::thread& t, u64 num)
+    {
+        if(num < syscall_table.size())
+            syscall_table[num](t);
+        else
+            unimplemented(t);
+    }
+
+    // r3 to r10 are logged with every syscall so syscalls returning more than r3 replay
+    static constexpr u32 result_regs = 8;
+
+    static void traced_syscall(ppu::thread& t, u64 num)
+    {
+        u64 logged = trace::input(trace::input_type::enter, num);
+        if(logged != num)
+            spdlog::warn("replay entered syscall {} but the trace entered {}", num, logged);
+
+        if(trace::replaying())
+        {
+            // host syscalls only touch the host so their results come from the trace.
+            // the rest keep lv2 objects in step then are overwritten with what the guest saw
+            bool host = num < host_syscalls.size() && host_syscalls[num];
+            if(!host)
+                dispatch(t, num);
+
+            if(!trace::replay_syscall(&t.gpr[3]) && host)
+                dispatch(t, num);
+
+            return;
+        }
+
+        u64 args[result_regs];
+        std::copy_n(&t.gpr[3], result_regs, args);
+
+        dispatch(t, num);
+
+        if(!trace::recording())
+            return;
+
+        if(num < syscall_outputs.size() && syscall_outputs[num])
+            syscall_outputs[num](args);
+
+        trace::record_syscall(&t.gpr[3]);
+    }
+
+    void syscall(ppu::thread& t)
+    {
+        u64 num = t.gpr[11];
+
+        if(trace::active.load(std::memory_order_relaxed) != trace::mode::off)
+            traced_syscall(t, num);
+        else
+            dispatch(t, num);
+    }
+
+    u32 unimplemented_calls(u32 num)
+    {
+        return missing[std::min<u64>(num, missing.size() - 1)].load(std::memory_order_relaxed);
+    }
+
+    static u32 sys_process_getpid()
+    {
+        // there is only ever one guest process
+        return 1;
+    }
+
+    static u64 sys_time_get_system_time()
+    {
+        return get_system_time();
+    }
+
+    static u64 sys_time_get_timebase_frequency()
+    {
+        return timebase_frequency;
+    }
+
+    void init_syscalls()
+    {
+        bind_syscall<sys_process_getpid>(1);
+        bind_syscall<sys_timer_usleep>(141);
+        bind_syscall<sys_timer_sleep>(142);
+        bind_syscall<sys_time_get_system_time>(145);
+        bind_host_syscall<sys_time_get_timebase_frequency>(147);
+        bind_syscall<spu::sys_raw_spu_create>(160);
+        bind_syscall<spu::sys_raw_spu_destroy>(161);
+
+        init_sync();
+        init_fs();
+        init_memory();
+        init_events();
+        init_timers();
+
+        spu::init_groups();
+    }
+}
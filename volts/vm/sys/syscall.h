@@ -1,10 +1,299 @@
 #pragma once
 
+#include <types.h>
+
+#include "vm.h"
+#include "trace.h"
+#include "ppu/thread.h"
+
 #include <array>
+#include <utility>
+#include <type_traits>
 
 namespace volts::vm
 {
-    using syscall_table_t = std::array<void*, 1024>;
+    /// a bound syscall, reads its arguments from the calling thread and writes its result back
+    using syscall_t = void(*)(ppu::thread&);
+
+    using syscall_table_t = std::array<syscall_t, 1024>;
     extern syscall_table_t syscall_table;
     syscall_table_t* get_syscall_table();
-}
\ No newline at end of file
+
+    /// notes the guest memory a syscall wrote through its pointer arguments, given r3 to r10 from before it ran
+    using syscall_outputs_t = void(*)(const svl::u64* args);
+    extern std::array<syscall_outputs_t, std::tuple_size<syscall_table_t>::value> syscall_outputs;
+
+    /// syscalls that act on the host rather than on lv2 objects, replays take their results from the trace without running them
+    extern std::array<bool, std::tuple_size<syscall_table_t>::value> host_syscalls;
+
+    /// returned to the guest when calling a syscall that isnt implemented
+    constexpr svl::u32 enosys = 0x80010003;
+
+    /// out of a limited resource
+    constexpr svl::u32 eagain = 0x80010001;
+
+    /// an argument is invalid
+    constexpr svl::u32 einval = 0x80010002;
+
+    /// out of memory or over a memory budget
+    constexpr svl::u32 enomem = 0x80010004;
+
+    /// the object doesnt exist
+    constexpr svl::u32 esrch = 0x80010005;
+
+    /// the path doesnt exist
+    constexpr svl::u32 enoent = 0x80010006;
+
+    /// waiting would deadlock the calling thread
+    constexpr svl::u32 edeadlk = 0x80010008;
+
+    /// the caller doesnt own the object
+    constexpr svl::u32 eperm = 0x80010009;
+
+    /// the object is in use or the operation would block
+    constexpr svl::u32 ebusy = 0x8001000A;
+
+    /// the timeout passed before the wait was satisfied
+    constexpr svl::u32 etimedout = 0x8001000B;
+
+    /// a pointer argument is null
+    constexpr svl::u32 efault = 0x8001000D;
+
+    /// the object is in the wrong state for the operation
+    constexpr svl::u32 estat = 0x8001000F;
+
+    /// a size or address isnt aligned to the page size
+    constexpr svl::u32 ealign = 0x80010010;
+
+    /// a file operation was given a directory
+    constexpr svl::u32 eisdir = 0x80010012;
+
+    /// the wait was cancelled because the object was destroyed
+    constexpr svl::u32 ecanceled = 0x80010013;
+
+    /// the path already exists
+    constexpr svl::u32 eexist = 0x80010014;
+
+    /// the port is already connected
+    constexpr svl::u32 eisconn = 0x80010015;
+
+    /// the port isnt connected
+    constexpr svl::u32 enotconn = 0x80010016;
+
+    /// too many files are open
+    constexpr svl::u32 enfile = 0x80010022;
+
+    /// the device is full
+    constexpr svl::u32 enospc = 0x80010023;
+
+    /// the file descriptor isnt open or doesnt allow the operation
+    constexpr svl::u32 ebadf = 0x8001002A;
+
+    /// the host failed to read or write
+    constexpr svl::u32 eio = 0x8001002B;
+
+    namespace detail
+    {
+        /**
+         * @brief convert a register into a syscall argument
+         *
+         * @tparam T the type of the argument
+         */
+        template<typename T>
+        struct syscall_arg
+        {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "syscall arguments must be integers, enums or vm::ptr");
+
+            static T get(svl::u64 reg) { return static_cast<T>(reg); }
+        };
+
+        template<typename T>
+        struct syscall_arg<vm::ptr<T>>
+        {
+            static vm::ptr<T> get(svl::u64 reg) { return vm::ptr<T>(static_cast<svl::u32>(reg)); }
+        };
+
+        /**
+         * @brief convert a syscall result into a register
+         *
+         * signed results are sign extended to 64 bits like the guest would
+         *
+         * @tparam T the type of the result
+         */
+        template<typename T>
+        struct syscall_ret
+        {
+            static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "syscall results must be integers, enums or vm::ptr");
+
+            static svl::u64 set(T val)
+            {
+                using cast_t = std::conditional_t<std::is_signed<T>::value, svl::i64, svl::u64>;
+                return static_cast<svl::u64>(static_cast<cast_t>(val));
+            }
+        };
+
+        template<typename T>
+        struct syscall_ret<vm::ptr<T>>
+        {
+            static svl::u64 set(vm::ptr<T> val) { return val.addr(); }
+        };
+
+        /**
+         * @brief note the memory behind a pointer argument as a syscall output
+         *
+         * only the pointed to type is noted, syscalls that write buffers
+         * note the rest themselves with trace::output
+         *
+         * @tparam T the type of the argument
+         */
+        template<typename T>
+        struct syscall_output
+        {
+            static void note(svl::u64) {}
+        };
+
+        template<typename T>
+        struct syscall_output<vm::ptr<T>>
+        {
+            static void note(svl::u64 reg)
+            {
+                if constexpr(!std::is_void<T>::value)
+                {
+                    if(auto addr = static_cast<svl::u32>(reg))
+                        trace::output(addr, sizeof(T));
+                }
+            }
+        };
+
+        template<typename T>
+        struct syscall_bind;
+
+        template<typename R, typename... TArgs>
+        struct syscall_bind<R(*)(TArgs...)>
+        {
+            static_assert(sizeof...(TArgs) <= 8, "syscalls can only take 8 register arguments");
+
+            static constexpr std::size_t arity = sizeof...(TArgs);
+
+            template<R(*F)(TArgs...), std::size_t... I>
+            static void call(ppu::thread& t, std::index_sequence<I...>)
+            {
+                // arguments are passed in r3 to r10
+                if constexpr(std::is_void<R>::value)
+                    F(syscall_arg<TArgs>::get(t.gpr[3 + I])...);
+                else
+                    t.gpr[3] = syscall_ret<R>::set(F(syscall_arg<TArgs>::get(t.gpr[3 + I])...));
+            }
+
+            template<std::size_t... I>
+            static void note(const svl::u64* args, std::index_sequence<I...>)
+            {
+                (syscall_output<TArgs>::note(args[I]), ...);
+            }
+        };
+
+        // syscalls that need to know who called them take the thread first, it doesnt use a register
+        template<typename R, typename... TArgs>
+        struct syscall_bind<R(*)(ppu::thread&, TArgs...)>
+        {
+            static_assert(sizeof...(TArgs) <= 8, "syscalls can only take 8 register arguments");
+
+            static constexpr std::size_t arity = sizeof...(TArgs);
+
+            template<R(*F)(ppu::thread&, TArgs...), std::size_t... I>
+            static void call(ppu::thread& t, std::index_sequence<I...>)
+            {
+                if constexpr(std::is_void<R>::value)
+                    F(t, syscall_arg<TArgs>::get(t.gpr[3 + I])...);
+                else
+                    t.gpr[3] = syscall_ret<R>::set(F(t, syscall_arg<TArgs>::get(t.gpr[3 + I])...));
+            }
+
+            template<std::size_t... I>
+            static void note(const svl::u64* args, std::index_sequence<I...>)
+            {
+                (syscall_output<TArgs>::note(args[I]), ...);
+            }
+        };
+    }
+
+    /**
+     * @brief wrap a native function in the syscall calling convention
+     *
+     * all marshalling is resolved at compile time so calling the
+     * wrapper costs one indirect call from the table
+     *
+     * @tparam F the native function to wrap
+     * @param t the calling thread
+     */
+    template<auto F>
+    void syscall_wrapper(ppu::thread& t)
+    {
+        using bind_t = detail::syscall_bind<decltype(F)>;
+        bind_t::template call<F>(t, std::make_index_sequence<bind_t::arity>());
+    }
+
+    /**
+     * @brief note every pointer argument of a syscall as an output while recording
+     *
+     * @tparam F the native function the syscall is bound to
+     * @param args r3 to r10 from before the syscall ran
+     */
+    template<auto F>
+    void syscall_noter(const svl::u64* args)
+    {
+        using bind_t = detail::syscall_bind<decltype(F)>;
+        bind_t::note(args, std::make_index_sequence<bind_t::arity>());
+    }
+
+    /**
+     * @brief bind a native function to a syscall number
+     *
+     * @tparam F the native function to bind
+     * @param num the syscall number to bind to
+     */
+    template<auto F>
+    void bind_syscall(svl::u32 num)
+    {
+        syscall_table.at(num) = syscall_wrapper<F>;
+        syscall_outputs.at(num) = syscall_noter<F>;
+    }
+
+    /**
+     * @brief bind a native function that acts on the host to a syscall number
+     *
+     * the function is skipped when replaying a trace so it must
+     * note every output it writes that pointer arguments dont cover
+     *
+     * @tparam F the native function to bind
+     * @param num the syscall number to bind to
+     */
+    template<auto F>
+    void bind_host_syscall(svl::u32 num)
+    {
+        bind_syscall<F>(num);
+        host_syscalls.at(num) = true;
+    }
+
+    /**
+     * @brief execute the syscall requested by a thread
+     *
+     * the syscall number is read from r11
+     *
+     * @param t the calling thread
+     */
+    void syscall(ppu::thread& t);
+
+    /**
+     * @brief get how many times an unimplemented syscall was called
+     *
+     * @param num the syscall number
+     * @return svl::u32 the amount of times it was called
+     */
+    svl::u32 unimplemented_calls(svl::u32 num);
+
+    /**
+     * @brief bind all implemented syscalls into the table
+     */
+    void init_syscalls();
+}
@@ -0,0 +1,29 @@
+#include "timebase.h"
+
+#include "trace.h"
+
+#include <chrono>
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    static const auto start = std::chrono::steady_clock::now();
+
+    u64 get_timebase()
+    {
+        auto now = std::chrono::steady_clock::now() - start;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+
+        // split the conversion so it doesnt overflow for long sessions
+        u64 ticks = (ns / 1000000000) * timebase_frequency + (ns % 1000000000) * timebase_frequency / 1000000000;
+
+        return trace::input(trace::input_type::timebase, ticks);
+    }
+
+    u64 get_system_time()
+    {
+        u64 ticks = get_timebase();
+        return (ticks / timebase_frequency) * 1000000 + (ticks % timebase_frequency) * 1000000 / timebase_frequency;
+    }
+}
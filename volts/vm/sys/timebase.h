@@ -0,0 +1,23 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::vm
+{
+    /// frequency of the cell timebase register in hz
+    constexpr svl::u64 timebase_frequency = 79800000;
+
+    /**
+     * @brief read the timebase register
+     *
+     * @return svl::u64 ticks of timebase_frequency since the emulator started
+     */
+    svl::u64 get_timebase();
+
+    /**
+     * @brief read the system time lv2 timers are measured in
+     *
+     * @return svl::u64 microseconds since the emulator started, derived from the timebase
+     */
+    svl::u64 get_system_time();
+}
@@ -0,0 +1,728 @@
+#include "timer.h"
+#include "timebase.h"
+#include "syscall.h"
+#include "object.h"
+#include "event.h"
+
+#include <platform.h>
+#include <futex.h>
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#if SYS_UNIX
+#   include <sys/timerfd.h>
+#   include <unistd.h>
+#else
+#   include <condition_variable>
+#endif
+
+#if CL_MSVC
+#   include <intrin.h>
+#endif
+
+namespace volts::vm
+{
+    using namespace svl;
+
+    using endian::big;
+
+    /// microseconds per tick of the wheel
+    constexpr u64 tick_usec = 16;
+
+    /// every slot of a level covers a whole rotation of the level below it
+    constexpr u32 level_bits = 6;
+    constexpr u32 level_slots = 1 << level_bits;
+    constexpr u32 levels = 6;
+
+    /// timers further away than this go in the top level and are put back each time it comes around
+    constexpr u64 max_ticks = (1ull << (level_bits * levels)) - 1;
+
+    /// ids are an index into the timers with a generation above it
+    constexpr u32 max_timers = 0xFFFF;
+
+    constexpr u32 nil = std::numeric_limits<u32>::max();
+    constexpr u64 never = std::numeric_limits<u64>::max();
+
+    struct timer_entry
+    {
+        /// tick the timer fires on
+        u64 expires;
+
+        /// ticks between firings, 0 for one shot timers
+        u64 period;
+
+        timer_callback_t callback;
+        void* arg;
+
+        /// links in a slot or the free list
+        u32 prev;
+        u32 next;
+
+        u16 gen = 0;
+
+        /// where the timer is linked, level is levels when it is free
+        u8 level = levels;
+        u8 slot = 0;
+    };
+
+    struct wheel
+    {
+        wheel()
+        {
+            for(auto& level : heads)
+                std::fill(std::begin(level), std::end(level), nil);
+        }
+
+        std::vector<timer_entry> timers;
+        u32 free = nil;
+
+        u32 heads[levels][level_slots];
+
+        /// a bit for each slot with timers in it
+        u64 occupied[levels] = {};
+
+        /// the next tick to process
+        u64 current = 0;
+
+        /// tick the host timer will next go off on
+        u64 armed = never;
+
+        bool running = false;
+        bool stopping = false;
+        std::thread worker;
+
+#if SYS_UNIX
+        int fd = -1;
+#else
+        std::condition_variable cv;
+#endif
+    };
+
+    // callbacks run with the lock held so a cancel can never race one
+    static std::mutex mut;
+    static wheel w;
+
+    static const auto start = std::chrono::steady_clock::now();
+
+    static u64 now_tick()
+    {
+        auto now = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration_cast<std::chrono::microseconds>(now).count() / tick_usec;
+    }
+
+    static std::chrono::steady_clock::time_point tick_time(u64 tick)
+    {
+        return start + std::chrono::microseconds(tick * tick_usec);
+    }
+
+    // round up so a timer never fires early
+    static u64 to_ticks(u64 usec)
+    {
+        return std::min(usec / tick_usec + (usec % tick_usec != 0), max_ticks);
+    }
+
+    static void link(u32 idx)
+    {
+        auto& t = w.timers[idx];
+
+        u64 when = std::max(t.expires, w.current);
+        u64 delta = std::min(when - w.current, max_ticks);
+        when = w.current + delta;
+
+        u32 level = 0;
+        while(level < levels - 1 && delta >> (level_bits * (level + 1)))
+            level++;
+
+        u32 slot = (when >> (level_bits * level)) & (level_slots - 1);
+
+        t.level = level;
+        t.slot = slot;
+        t.prev = nil;
+        t.next = w.heads[level][slot];
+
+        if(t.next != nil)
+            w.timers[t.next].prev = idx;
+
+        w.heads[level][slot] = idx;
+        w.occupied[level] |= 1ull << slot;
+    }
+
+    static void unlink(u32 idx)
+    {
+        auto& t = w.timers[idx];
+
+        if(t.prev != nil)
+            w.timers[t.prev].next = t.next;
+        else
+            w.heads[t.level][t.slot] = t.next;
+
+        if(t.next != nil)
+            w.timers[t.next].prev = t.prev;
+
+        if(w.heads[t.level][t.slot] == nil)
+            w.occupied[t.level] &= ~(1ull << t.slot);
+    }
+
+    static void release(u32 idx)
+    {
+        auto& t = w.timers[idx];
+
+        t.level = levels;
+        t.gen++;
+        t.next = w.free;
+        w.free = idx;
+    }
+
+    // take every timer out of a slot
+    static u32 detach(u32 level, u32 slot)
+    {
+        u32 head = w.heads[level][slot];
+        w.heads[level][slot] = nil;
+        w.occupied[level] &= ~(1ull << slot);
+        return head;
+    }
+
+    static u32 first_slot(u64 occupied)
+    {
+#if CL_MSVC
+        unsigned long idx;
+        _BitScanForward64(&idx, occupied);
+        return idx;
+#else
+        return __builtin_ctzll(occupied);
+#endif
+    }
+
+    /**
+     * @brief the next tick that has a slot to expire or cascade
+     */
+    static u64 next_tick()
+    {
+        u64 best = never;
+
+        for(u32 l = 0; l < levels; l++)
+        {
+            if(!w.occupied[l])
+                continue;
+
+            u32 shift = level_bits * l;
+            u64 pos = w.current >> shift;
+            u32 idx = pos & (level_slots - 1);
+
+            // the current slot of an upper level was already cascaded unless its first tick hasnt been processed
+            bool pending = l == 0 || (w.current & ((1ull << shift) - 1)) == 0;
+            u32 from = pending ? idx : idx + 1;
+
+            u64 ahead = from < level_slots ? w.occupied[l] & (~0ull << from) : 0;
+            u64 base = pos & ~u64(level_slots - 1);
+
+            u64 slot = ahead
+                ? base + first_slot(ahead)
+                : base + level_slots + first_slot(w.occupied[l]);
+
+            best = std::min(best, slot << shift);
+        }
+
+        return best;
+    }
+
+    static void cascade(u32 level)
+    {
+        u32 slot = (w.current >> (level_bits * level)) & (level_slots - 1);
+
+        for(u32 idx = detach(level, slot); idx != nil;)
+        {
+            u32 next = w.timers[idx].next;
+            link(idx);
+            idx = next;
+        }
+    }
+
+    static void expire()
+    {
+        for(u32 idx = detach(0, w.current & (level_slots - 1)); idx != nil;)
+        {
+            auto& t = w.timers[idx];
+            u32 next = t.next;
+
+            if(t.expires > w.current)
+            {
+                // only timers clamped to the top level come around early
+                link(idx);
+            }
+            else
+            {
+                t.callback(t.arg);
+
+                if(t.period)
+                {
+                    // a late thread skips the periods it missed rather than firing them all at once
+                    while(t.expires <= w.current)
+                        t.expires += t.period;
+
+                    link(idx);
+                }
+                else
+                {
+                    release(idx);
+                }
+            }
+
+            idx = next;
+        }
+    }
+
+    static void process(u64 target)
+    {
+        while(true)
+        {
+            u64 next = next_tick();
+
+            // nothing is due so skip straight past the empty slots
+            if(next > target)
+            {
+                w.current = std::max(w.current, target + 1);
+                return;
+            }
+
+            w.current = next;
+
+            // upper levels first so their timers can fall all the way down
+            for(u32 l = levels - 1; l > 0; l--)
+            {
+                if((w.current & ((1ull << (level_bits * l)) - 1)) == 0)
+                    cascade(l);
+            }
+
+            expire();
+
+            w.current++;
+        }
+    }
+
+    static void arm(u64 tick)
+    {
+        w.armed = tick;
+
+#if SYS_UNIX
+        // steady_clock is CLOCK_MONOTONIC so its time points can be used as absolute timerfd times
+        itimerspec spec = {};
+
+        if(tick != never)
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tick_time(tick).time_since_epoch()).count();
+            spec.it_value.tv_sec = ns / 1000000000;
+            spec.it_value.tv_nsec = std::max<i64>(ns % 1000000000, 1);
+        }
+
+        timerfd_settime(w.fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#else
+        w.cv.notify_one();
+#endif
+    }
+
+    static void run()
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        while(!w.stopping)
+        {
+            process(now_tick());
+            arm(next_tick());
+
+#if SYS_UNIX
+            lock.unlock();
+
+            u64 expirations;
+            if(::read(w.fd, &expirations, sizeof(u64)) < 0 && errno != EINTR)
+                spdlog::error("timer wheel failed to wait {}", errno);
+
+            lock.lock();
+#else
+            if(w.armed == never)
+                w.cv.wait(lock);
+            else
+                w.cv.wait_until(lock, tick_time(w.armed));
+#endif
+        }
+    }
+
+    static bool start_worker()
+    {
+        if(w.running)
+            return true;
+
+        if(w.stopping)
+            return false;
+
+#if SYS_UNIX
+        w.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if(w.fd < 0)
+        {
+            spdlog::error("failed to create timer wheel timerfd {}", errno);
+            return false;
+        }
+#endif
+
+        w.current = now_tick();
+        w.running = true;
+        w.worker = std::thread(run);
+
+        return true;
+    }
+
+    u32 add_timer(u64 usec, u64 period, timer_callback_t callback, void* arg)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(!start_worker())
+            return 0;
+
+        u32 idx = w.free;
+
+        if(idx != nil)
+        {
+            w.free = w.timers[idx].next;
+        }
+        else
+        {
+            if(w.timers.size() >= max_timers)
+                return 0;
+
+            idx = w.timers.size();
+            w.timers.emplace_back();
+        }
+
+        auto& t = w.timers[idx];
+        t.expires = now_tick() + to_ticks(usec);
+        t.period = period ? std::max<u64>(to_ticks(period), 1) : 0;
+        t.callback = callback;
+        t.arg = arg;
+
+        link(idx);
+
+        // the worker only needs waking if this fires before whatever it is waiting for
+        if(t.expires < w.armed)
+            arm(t.expires);
+
+        return (static_cast<u32>(t.gen) << 16) | (idx + 1);
+    }
+
+    bool cancel_timer(u32 id)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        u32 idx = (id & 0xFFFF) - 1;
+
+        if(idx >= w.timers.size())
+            return false;
+
+        auto& t = w.timers[idx];
+
+        if(t.level == levels || t.gen != id >> 16)
+            return false;
+
+        unlink(idx);
+        release(idx);
+
+        return true;
+    }
+
+    void sleep_for(u64 usec)
+    {
+        std::atomic<u32> done = 0;
+
+        u32 id = add_timer(usec, 0, [](void* arg) {
+            auto& word = *static_cast<std::atomic<u32>*>(arg);
+            word = 1;
+            futex::wake_one(word);
+        }, &done);
+
+        if(!id)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(usec));
+            return;
+        }
+
+        while(!done)
+            futex::wait(done, 0);
+
+        // the callback might still be waking the word, it finishes before the lock is released
+        std::lock_guard<std::mutex> guard(mut);
+    }
+
+    void stop_timers()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mut);
+
+            if(!w.running)
+                return;
+
+            w.stopping = true;
+
+            // a tick in the past goes off straight away
+            arm(0);
+        }
+
+        w.worker.join();
+
+#if SYS_UNIX
+        ::close(w.fd);
+#endif
+    }
+
+    /// lv2 refuses periodic timers faster than this many microseconds
+    constexpr u64 min_period = 100;
+
+    namespace timer_state
+    {
+        constexpr u32 stopped = 0;
+        constexpr u32 running = 1;
+    }
+
+    struct timer_information
+    {
+        /// system time of the next expiry
+        big<u64> next;
+        big<u64> period;
+        big<u32> state;
+        pad padding[4];
+    };
+
+    static_assert(sizeof(timer_information) == 24);
+
+    /**
+     * @brief a guest timer, sends an event to its queue each time it expires
+     *
+     * the queue, event and period only change while the timer is stopped
+     * so the wheel callback reads them without taking the lock
+     */
+    struct lv2_timer
+    {
+        std::mutex mut;
+
+        /// the wheel timer, 0 while stopped
+        u32 entry = 0;
+
+        /// system time of the next expiry
+        std::atomic<u64> next = 0;
+        u64 period = 0;
+
+        /// set once a one shot timer has fired
+        std::atomic<bool> done = false;
+
+        /// the connected queue, 0 when it isnt connected
+        u32 queue = 0;
+        u64 name = 0;
+        u64 data1 = 0;
+        u64 data2 = 0;
+    };
+
+    static object_table<lv2_timer> lv2_timers(0x11000000);
+
+    // runs on the wheel thread so it must not take the timer lock
+    static void fire(void* arg)
+    {
+        auto& t = *static_cast<lv2_timer*>(arg);
+        u64 at = t.next;
+
+        // the event carries the time the timer was meant to expire
+        if(u32 err = send_event(t.queue, { t.name, t.data1, t.data2, at }))
+            spdlog::warn("timer event to queue {:x} dropped {:x}", t.queue, err);
+
+        if(t.period)
+            t.next = at + t.period;
+        else
+            t.done = true;
+    }
+
+    // must be called with the timer lock held
+    static bool running(const lv2_timer& t)
+    {
+        return t.entry && !t.done;
+    }
+
+    // must be called with the timer lock held
+    static void stop(lv2_timer& t)
+    {
+        // the callback isnt running once this returns
+        if(t.entry)
+            cancel_timer(t.entry);
+
+        t.entry = 0;
+    }
+
+    static u32 sys_timer_create(vm::ptr<big<u32>> id)
+    {
+        if(!id)
+            return efault;
+
+        u32 out = lv2_timers.add(std::make_unique<lv2_timer>());
+        if(!out)
+            return eagain;
+
+        *id = endian::byte_swap(out);
+        return 0;
+    }
+
+    static u32 sys_timer_destroy(u32 id)
+    {
+        {
+            auto t = lv2_timers.get(id);
+            if(!t)
+                return esrch;
+
+            // a connected timer may still be running
+            std::lock_guard<std::mutex> guard(t->mut);
+            if(t->queue)
+                return eisconn;
+        }
+
+        lv2_timers.remove(id);
+        return 0;
+    }
+
+    static u32 sys_timer_get_information(u32 id, vm::ptr<timer_information> info)
+    {
+        if(!info)
+            return efault;
+
+        auto t = lv2_timers.get(id);
+        if(!t)
+            return esrch;
+
+        std::lock_guard<std::mutex> guard(t->mut);
+
+        info->next = endian::byte_swap(t->next.load());
+        info->period = endian::byte_swap(t->period);
+        info->state = endian::byte_swap(running(*t) ? timer_state::running : timer_state::stopped);
+
+        return 0;
+    }
+
+    static u32 _sys_timer_start(u32 id, u64 base_time, u64 period)
+    {
+        if(period && period < min_period)
+            return einval;
+
+        auto t = lv2_timers.get(id);
+        if(!t)
+            return esrch;
+
+        std::lock_guard<std::mutex> guard(t->mut);
+
+        if(running(*t))
+            return ebusy;
+
+        if(!t->queue)
+            return enotconn;
+
+        u64 now = get_system_time();
+
+        // no base time means the first expiry is a period from now
+        if(!base_time)
+        {
+            if(!period)
+                return einval;
+
+            base_time = now + period;
+        }
+
+        // a one shot timer that already fired is still on the books until its restarted
+        stop(*t);
+
+        t->next = base_time;
+        t->period = period;
+        t->done = false;
+
+        t->entry = add_timer(base_time > now ? base_time - now : 0, period, fire, &*t);
+        if(!t->entry)
+            return eagain;
+
+        return 0;
+    }
+
+    static u32 sys_timer_stop(u32 id)
+    {
+        auto t = lv2_timers.get(id);
+        if(!t)
+            return esrch;
+
+        std::lock_guard<std::mutex> guard(t->mut);
+        stop(*t);
+
+        return 0;
+    }
+
+    static u32 sys_timer_connect_event_queue(u32 id, u32 queue, u64 name, u64 data1, u64 data2)
+    {
+        auto t = lv2_timers.get(id);
+        if(!t)
+            return esrch;
+
+        if(!has_queue(queue))
+            return esrch;
+
+        std::lock_guard<std::mutex> guard(t->mut);
+
+        if(t->queue)
+            return eisconn;
+
+        // unnamed timers are identified by the process and timer like unnamed ports
+        t->queue = queue;
+        t->name = name ? name : (1ull << 32) | id;
+        t->data1 = data1;
+        t->data2 = data2;
+
+        return 0;
+    }
+
+    static u32 sys_timer_disconnect_event_queue(u32 id)
+    {
+        auto t = lv2_timers.get(id);
+        if(!t)
+            return esrch;
+
+        std::lock_guard<std::mutex> guard(t->mut);
+
+        if(!t->queue)
+            return enotconn;
+
+        // a timer with nowhere to send its events stops
+        stop(*t);
+        t->queue = 0;
+
+        return 0;
+    }
+
+    void init_timers()
+    {
+        bind_syscall<sys_timer_create>(70);
+        bind_syscall<sys_timer_destroy>(71);
+        bind_syscall<sys_timer_get_information>(72);
+        bind_syscall<_sys_timer_start>(73);
+        bind_syscall<sys_timer_stop>(74);
+        bind_syscall<sys_timer_connect_event_queue>(75);
+        bind_syscall<sys_timer_disconnect_event_queue>(76);
+    }
+
+    u32 sys_timer_usleep(u64 usec)
+    {
+        sleep_for(usec);
+        return 0;
+    }
+
+    u32 sys_timer_sleep(u32 sec)
+    {
+        sleep_for(sec * 1000000ull);
+        return 0;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <types.h>
+
+namespace volts::vm
+{
+    /// called on the timer thread when a timer fires, must not add or cancel timers
+    using timer_callback_t = void(*)(void* arg);
+
+    /**
+     * @brief add a timer to the timer wheel
+     *
+     * every guest timer shares one host thread and one host timer,
+     * adding and cancelling only link and unlink from a slot list
+     *
+     * @param usec microseconds until the timer fires
+     * @param period microseconds between each firing after the first, 0 to only fire once
+     * @param callback called each time the timer fires
+     * @param arg passed to the callback
+     * @return svl::u32 the id of the timer, 0 if there are too many timers
+     */
+    svl::u32 add_timer(svl::u64 usec, svl::u64 period, timer_callback_t callback, void* arg);
+
+    /**
+     * @brief cancel a timer, its callback isnt running once this returns
+     *
+     * @param id the id of the timer
+     * @return true if the timer was pending
+     * @return false if it already fired or never existed
+     */
+    bool cancel_timer(svl::u32 id);
+
+    /**
+     * @brief block the calling thread on the timer wheel
+     *
+     * @param usec the least microseconds to sleep for
+     */
+    void sleep_for(svl::u64 usec);
+
+    /**
+     * @brief stop the timer thread, pending timers never fire
+     */
+    void stop_timers();
+
+    /**
+     * @brief bind the lv2 timer syscalls
+     *
+     * lv2 timers send an event to a queue each time they expire,
+     * they are entries on the same timer wheel as sleeps and timeouts
+     */
+    void init_timers();
+
+    /**
+     * @brief sleep the calling ppu thread
+     *
+     * @param usec microseconds to sleep for
+     * @return svl::u32 always 0
+     */
+    svl::u32 sys_timer_usleep(svl::u64 usec);
+
+    /**
+     * @brief sleep the calling ppu thread
+     *
+     * @param sec seconds to sleep for
+     * @return svl::u32 always 0
+     */
+    svl::u32 sys_timer_sleep(svl::u32 sec);
+}
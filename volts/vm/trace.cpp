@@ -0,0 +1,461 @@
+#include "trace.h"
+#include "vm.h"
+
+#include <file.h>
+#include <convert.h>
+
+#include <zlib.h>
+
+#include <spdlog/spdlog.h>
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+
+namespace volts::vm::trace
+{
+    using namespace svl;
+
+    namespace cvt = svl::convert;
+
+    /**
+     * @brief header at the start of every trace log
+     *
+     * followed by any number of chunks, each chunk is a chunk_header
+     * followed by the zlib compressed entries
+     */
+    struct log_header
+    {
+        u32 magic;
+        u32 version;
+    };
+
+    struct chunk_header
+    {
+        /// size of the chunk once uncompressed
+        u32 raw_size;
+
+        /// size of the compressed data that follows
+        u32 size;
+    };
+
+    /**
+     * @brief the fixed part of an entry
+     *
+     * followed by size bytes of payload. syscalls carry r4 to r10 and then
+     * each piece of guest memory they wrote as its address, size and bytes
+     */
+    #pragma pack(push, 1)
+    struct entry_header
+    {
+        u8 type;
+        u32 thread;
+        u64 value;
+        u32 size;
+    };
+    #pragma pack(pop)
+
+    /// registers logged with every syscall, r3 is the value and the rest are the payload
+    constexpr u32 syscall_regs = 8;
+
+    /// entries are compressed in chunks of at least this many bytes
+    constexpr u64 chunk_size = 0x200000;
+
+    constexpr u32 log_version = 2;
+
+    /// a replay waiting on another thread for this long is probably stuck
+    constexpr auto stall_warning = std::chrono::seconds(5);
+
+    /// payload bytes decoded for other threads before a thread waits for them to take their entries
+    constexpr u64 decode_ahead = chunk_size;
+
+    std::atomic<mode> active = mode::off;
+
+    static thread_local u32 self = 0;
+
+    // set once the log has no more entries for this thread, it runs live from then on
+    static thread_local bool live = false;
+
+    // outputs of the syscall the thread is running, logged with its result
+    static thread_local std::vector<u8> outputs;
+
+    static std::mutex mut;
+    static svl::file trace_file;
+
+    // uncompressed entries waiting to be written, or read back
+    static std::vector<u8> buffer;
+    static u64 cursor = 0;
+
+    // total entries seen, used to report where a replay diverged
+    static u64 entries = 0;
+
+    /**
+     * @brief an entry read back from the log
+     */
+    struct entry
+    {
+        /// position in the log across every thread
+        u64 index;
+
+        input_type type;
+        u64 value;
+        std::vector<u8> payload;
+    };
+
+    // entries decoded so far that their thread hasnt taken yet
+    static std::unordered_map<u32, std::deque<entry>> queues;
+
+    // the number of entries decoded and taken, a thread can only
+    // take its next entry once every entry before it has been taken
+    static u64 decoded = 0;
+    static u64 taken = 0;
+    static std::condition_variable turn;
+
+    // payload bytes sitting in queues, bounds how far ahead of the slowest thread the log is read
+    static u64 queued_bytes = 0;
+
+    static void flush()
+    {
+        if(buffer.empty())
+            return;
+
+        uLongf size = compressBound(buffer.size());
+        std::vector<u8> out(size);
+
+        if(compress2(out.data(), &size, buffer.data(), buffer.size(), Z_BEST_SPEED) != Z_OK)
+        {
+            spdlog::error("failed to compress trace chunk");
+            return;
+        }
+
+        trace_file.write(chunk_header{ static_cast<u32>(buffer.size()), static_cast<u32>(size) });
+        trace_file.write(out.data(), size);
+
+        buffer.clear();
+    }
+
+    static bool next_chunk()
+    {
+        buffer.clear();
+        cursor = 0;
+
+        if(trace_file.tell() + sizeof(chunk_header) > trace_file.size())
+            return false;
+
+        auto chunk = trace_file.read<chunk_header>();
+
+        if(trace_file.tell() + chunk.size > trace_file.size())
+        {
+            spdlog::error("truncated trace chunk");
+            return false;
+        }
+
+        auto data = trace_file.read<u8>(chunk.size);
+
+        buffer.resize(chunk.raw_size);
+        uLongf size = chunk.raw_size;
+
+        if(uncompress(buffer.data(), &size, data.data(), chunk.size) != Z_OK || size != chunk.raw_size)
+        {
+            spdlog::error("corrupt trace chunk");
+            buffer.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    // must be called with mut held
+    static void append(input_type type, u64 value, const u8* payload, u32 size)
+    {
+        entry_header head = { static_cast<u8>(type), self, value, size };
+
+        auto at = buffer.size();
+        buffer.resize(at + sizeof(entry_header) + size);
+
+        std::memcpy(buffer.data() + at, &head, sizeof(entry_header));
+        if(size)
+            std::memcpy(buffer.data() + at + sizeof(entry_header), payload, size);
+
+        entries++;
+
+        if(buffer.size() >= chunk_size)
+            flush();
+    }
+
+    // read the next entry into the queue of its thread, must be called with mut held
+    static bool decode()
+    {
+        if(cursor + sizeof(entry_header) > buffer.size() && !next_chunk())
+            return false;
+
+        entry_header head;
+        std::memcpy(&head, buffer.data() + cursor, sizeof(entry_header));
+
+        if(cursor + sizeof(entry_header) + head.size > buffer.size())
+        {
+            spdlog::error("corrupt trace entry {}", decoded);
+            buffer.clear();
+            return false;
+        }
+
+        auto payload = buffer.data() + cursor + sizeof(entry_header);
+        cursor += sizeof(entry_header) + head.size;
+
+        queues[head.thread].push_back({ decoded++, static_cast<input_type>(head.type), head.value, { payload, payload + head.size } });
+        queued_bytes += head.size;
+        return true;
+    }
+
+    // must be called with mut held
+    static void end_replay()
+    {
+        active = mode::off;
+        queues.clear();
+        queued_bytes = 0;
+        turn.notify_all();
+    }
+
+    /**
+     * @brief take the next entry of the calling thread once its turn comes
+     *
+     * @param out the entry taken
+     * @return false if the trace ended or diverged and the caller should continue live
+     */
+    static bool take(std::unique_lock<std::mutex>& lock, input_type type, entry& out)
+    {
+        if(live)
+            return false;
+
+        while(queues[self].empty())
+        {
+            // other threads have to take what is already decoded before more of the log is read for this one
+            if(decoded != taken && queued_bytes >= decode_ahead)
+            {
+                if(!turn.wait_for(lock, stall_warning, [&] { return active != mode::replay || !queues[self].empty() || decoded == taken || queued_bytes < decode_ahead; }))
+                    spdlog::warn("thread {:x} has waited {}s for other threads to take entries, the replay is at entry {}", self, stall_warning.count(), taken);
+
+                if(active != mode::replay)
+                    return false;
+
+                continue;
+            }
+
+            if(!decode())
+            {
+                // the other threads may still have entries, only this one stops replaying
+                spdlog::warn("trace ended for thread {:x} after {} entries, continuing live", self, taken);
+                live = true;
+                return false;
+            }
+        }
+
+        auto& queue = queues[self];
+
+        if(queue.front().type != type)
+        {
+            spdlog::error("trace diverged at entry {}, thread {:x} expected input {} got {}. continuing live",
+                queue.front().index, self, static_cast<u32>(queue.front().type), static_cast<u32>(type)
+            );
+            end_replay();
+            return false;
+        }
+
+        u64 index = queue.front().index;
+
+        // another thread has to take its earlier entries first
+        while(active == mode::replay && taken != index)
+        {
+            if(!turn.wait_for(lock, stall_warning, [&] { return active != mode::replay || taken == index; }))
+                spdlog::warn("thread {:x} has waited {}s for entry {}, the replay is at entry {}", self, stall_warning.count(), index, taken);
+        }
+
+        // another thread gave up on the trace while this one waited
+        if(active != mode::replay)
+            return false;
+
+        out = std::move(queue.front());
+        queue.pop_front();
+
+        queued_bytes -= out.payload.size();
+        taken++;
+        turn.notify_all();
+
+        return true;
+    }
+
+    bool record(const fs::path& path)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        auto file = svl::open(path, svl::mode::write);
+
+        if(!file.valid())
+        {
+            spdlog::error("failed to open {} to record a trace", path.string());
+            return false;
+        }
+
+        trace_file = std::move(file);
+        trace_file.write(log_header{ cvt::to_u32("VTRC"), log_version });
+
+        buffer.clear();
+        buffer.reserve(chunk_size * 2);
+        entries = 0;
+
+        active = mode::record;
+        spdlog::info("recording trace to {}", path.string());
+
+        return true;
+    }
+
+    bool replay(const fs::path& path)
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(!fs::exists(path))
+        {
+            spdlog::error("no trace found at {}", path.string());
+            return false;
+        }
+
+        trace_file = svl::open(path, svl::mode::read);
+        auto head = trace_file.read<log_header>();
+
+        if(head.magic != cvt::to_u32("VTRC") || head.version != log_version)
+        {
+            spdlog::error("{} is not a valid trace", path.string());
+            return false;
+        }
+
+        entries = 0;
+        decoded = 0;
+        taken = 0;
+        queued_bytes = 0;
+        queues.clear();
+        next_chunk();
+
+        active = mode::replay;
+        spdlog::info("replaying trace from {}", path.string());
+
+        return true;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(active == mode::record)
+        {
+            flush();
+            spdlog::info("recorded {} trace entries", entries);
+        }
+
+        active = mode::off;
+        trace_file = svl::file();
+        buffer.clear();
+        queues.clear();
+        queued_bytes = 0;
+        turn.notify_all();
+    }
+
+    void attach(u32 id)
+    {
+        self = id;
+        live = false;
+    }
+
+    u64 traced_input(input_type type, u64 live)
+    {
+        std::unique_lock<std::mutex> lock(mut);
+
+        switch(active.load())
+        {
+        case mode::record:
+            append(type, live, nullptr, 0);
+            return live;
+
+        case mode::replay:
+        {
+            entry e;
+            return take(lock, type, e) ? e.value : live;
+        }
+
+        default:
+            return live;
+        }
+    }
+
+    void output(u32 addr, u32 size)
+    {
+        if(!size || active != mode::record)
+            return;
+
+        auto at = outputs.size();
+        outputs.resize(at + sizeof(u32) * 2 + size);
+
+        std::memcpy(outputs.data() + at, &addr, sizeof(u32));
+        std::memcpy(outputs.data() + at + sizeof(u32), &size, sizeof(u32));
+        std::memcpy(outputs.data() + at + sizeof(u32) * 2, vm::base(addr), size);
+    }
+
+    void record_syscall(const u64* regs)
+    {
+        // the registers after r3 go in front of the outputs
+        std::vector<u8> payload((syscall_regs - 1) * sizeof(u64));
+        std::memcpy(payload.data(), regs + 1, payload.size());
+        payload.insert(payload.end(), outputs.begin(), outputs.end());
+        outputs.clear();
+
+        std::lock_guard<std::mutex> guard(mut);
+
+        if(active == mode::record)
+            append(input_type::syscall, regs[0], payload.data(), static_cast<u32>(payload.size()));
+    }
+
+    bool replay_syscall(u64* regs)
+    {
+        entry e;
+
+        {
+            std::unique_lock<std::mutex> lock(mut);
+
+            if(active != mode::replay || !take(lock, input_type::syscall, e))
+                return false;
+        }
+
+        u64 regs_size = (syscall_regs - 1) * sizeof(u64);
+
+        if(e.payload.size() < regs_size)
+        {
+            spdlog::error("trace entry {} is too small for a syscall", e.index);
+            return false;
+        }
+
+        regs[0] = e.value;
+        std::memcpy(regs + 1, e.payload.data(), regs_size);
+
+        for(u64 at = regs_size; at + sizeof(u32) * 2 <= e.payload.size();)
+        {
+            u32 addr, size;
+            std::memcpy(&addr, e.payload.data() + at, sizeof(u32));
+            std::memcpy(&size, e.payload.data() + at + sizeof(u32), sizeof(u32));
+            at += sizeof(u32) * 2;
+
+            if(at + size > e.payload.size())
+            {
+                spdlog::error("trace entry {} has a truncated output", e.index);
+                break;
+            }
+
+            std::memcpy(vm::base(addr), e.payload.data() + at, size);
+            at += size;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <types.h>
+#include <wrapfs.h>
+
+#include <atomic>
+
+namespace volts::vm::trace
+{
+    /**
+     * @brief what the tracer is currently doing
+     *
+     */
+    enum class mode : svl::u8
+    {
+        /// inputs come from the host and are not recorded
+        off,
+
+        /// inputs come from the host and are written to the log
+        record,
+
+        /// inputs come from the log
+        replay,
+    };
+
+    /**
+     * @brief the kind of non deterministic input
+     *
+     */
+    enum class input_type : svl::u8
+    {
+        /// the result of a syscall and the guest memory it wrote
+        syscall,
+
+        /// a thread entering a syscall, syscalls that wait on each other start in the recorded order
+        enter,
+
+        /// a read of the timebase register
+        timebase,
+
+        /// a choice made by a thread scheduler
+        schedule,
+    };
+
+    /// every thread is named by its kind in the top byte and an index of that kind below it
+    namespace thread_kind
+    {
+        constexpr svl::u32 ppu = 0x01000000;
+        constexpr svl::u32 spu = 0x02000000;
+
+        /// host threads that make scheduling decisions, spu slots and spurs workers
+        constexpr svl::u32 host = 0x03000000;
+    }
+
+    /// the current tracing mode, only changes before the guest starts
+    extern std::atomic<mode> active;
+
+    /**
+     * @brief start recording inputs into a log
+     *
+     * @param path the path of the log to create
+     * @return true if the log could be created
+     */
+    bool record(const fs::path& path);
+
+    /**
+     * @brief start replaying inputs from a log
+     *
+     * @param path the path of the log to read
+     * @return true if the log could be opened
+     */
+    bool replay(const fs::path& path);
+
+    /**
+     * @brief stop tracing and flush the log if recording
+     */
+    void stop();
+
+    /**
+     * @brief name the guest thread the calling host thread is running
+     *
+     * every entry is tagged with the name so a replay hands it back to the
+     * same thread. names must be the same between runs, lv2 ids are since
+     * objects are created in the same order. threads that never attach are named 0
+     *
+     * @param id the name of the thread
+     */
+    void attach(svl::u32 id);
+
+    /**
+     * @brief record or replay an input, only called when tracing is active
+     * @see input
+     */
+    svl::u64 traced_input(input_type type, svl::u64 live);
+
+    /**
+     * @brief pass a non deterministic input through the tracer
+     *
+     * when recording the live value is logged, when replaying the logged value
+     * is returned instead of the live one. when tracing is off this is a single branch.
+     *
+     * a replay hands every thread its own entries in the order they were recorded
+     * across all threads, a thread waits for the others to catch up first
+     *
+     * @param type the kind of input
+     * @param live the value the host produced
+     * @return svl::u64 the value the guest should see
+     */
+    inline svl::u64 input(input_type type, svl::u64 live)
+    {
+        if(active.load(std::memory_order_relaxed) == mode::off)
+            return live;
+
+        return traced_input(type, live);
+    }
+
+    /**
+     * @brief note guest memory the current syscall wrote
+     *
+     * the memory is logged with the result of the syscall and written back
+     * when the syscall is replayed. only called while recording
+     *
+     * @param addr the guest address written
+     * @param size the number of bytes written
+     */
+    void output(svl::u32 addr, svl::u32 size);
+
+    /**
+     * @brief log the result of a syscall with every output noted since it started
+     *
+     * @param regs r3 to r10 after the syscall, some syscalls return more than r3
+     */
+    void record_syscall(const svl::u64* regs);
+
+    /**
+     * @brief write the logged results of the next syscall back to the guest
+     *
+     * @param regs r3 to r10 of the calling thread, overwritten with the logged values
+     * @return false if the trace ended and the syscall has to run live
+     */
+    bool replay_syscall(svl::u64* regs);
+
+    /**
+     * @brief get if a syscall is recorded as it runs
+     */
+    inline bool recording()
+    {
+        return active.load(std::memory_order_relaxed) == mode::record;
+    }
+
+    /**
+     * @brief get if inputs are coming from a log
+     */
+    inline bool replaying()
+    {
+        return active.load(std::memory_order_relaxed) == mode::replay;
+    }
+}
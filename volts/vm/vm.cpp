@@ -1,6 +1,18 @@
 #include "vm.h"
 
+#include <platform.h>
+
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+#if SYS_WINDOWS
+#   include <Windows.h>
+#else
+#   include <sys/mman.h>
+#endif
 
 #include <spdlog/spdlog.h>
 
@@ -12,11 +24,35 @@ namespace volts::vm
 
 #define LOCKED(...) { std::lock_guard<std::mutex> guard(this->mut); { __VA_ARGS__ } }
 
-    static u32 align(u64 val, i64 alignment)
+    static u64 align(u64 val, i64 alignment)
     {
         return (val + alignment - 1) & -alignment;
     }
 
+    // back a range that was just allocated with host memory
+    static void commit(addr at, u64 size)
+    {
+#if SYS_WINDOWS
+        // windows only reserves the address space up front so every allocation commits its own pages
+        if(!VirtualAlloc(base_addr + at, size, MEM_COMMIT, PAGE_READWRITE))
+            spdlog::error("failed to commit {:x} bytes of guest memory at {:x}", size, at);
+#else
+        // pages of a noreserve mapping are backed the first time they are touched
+        (void)at;
+        (void)size;
+#endif
+    }
+
+    // give the host memory behind a freed range back
+    static void release_pages(addr at, u64 size)
+    {
+#if SYS_WINDOWS
+        VirtualFree(base_addr + at, size, MEM_DECOMMIT);
+#else
+        madvise(base_addr + at, size, MADV_DONTNEED);
+#endif
+    }
+
     static void free_link_chain(link* begin)
     {
         if(begin)
@@ -34,42 +70,105 @@ namespace volts::vm
     vm::addr block::alloc(u64 size, u64 alignto)
     {
         u32 s = align(size, page_size) + (offset_pages ? 0x2000 : 0);
+        alignto = std::max<u64>(alignto, page_size);
+
+        vm::addr at = 0;
 
         LOCKED({
-            link* cur = begin;
-            for(;;)
+            // first fit, the links are kept in address order
+            for(link* cur = begin; cur->next; cur = cur->next)
             {
-                // check if the chain is empty
-                if(!cur->next)
-                {
-                    return 0;
-                }
-                else if(cur->len + cur->addr + s > cur->next->addr)
-                {
-                    // if there isnt space then check the next link
-                    cur = cur->next;
-                }
-                else
+                vm::addr next = align(cur->addr + cur->len, alignto);
+
+                if(next + s <= cur->next->addr)
                 {
-                    // there is space
-                    link* in = new link{cur->next, cur->addr + cur->len, s};
-                    cur->next = in;
-                    return in->addr;
+                    cur->next = new link{cur->next, next, s};
+                    used += s;
+                    at = next;
+                    break;
                 }
             }
         });
+
+        if(at)
+            commit(at, s);
+
+        return at;
     }
 
     vm::addr block::falloc(vm::addr addr, u64 size)
     {
+        vm::addr at = addr & ~u64(page_size - 1);
+        u32 s = align(addr + size, page_size) - at;
+
+        bool placed = false;
+
+        LOCKED({
+            for(link* cur = begin; cur->next; cur = cur->next)
+            {
+                if(cur->addr + cur->len <= at && at + s <= cur->next->addr)
+                {
+                    cur->next = new link{cur->next, at, s};
+                    used += s;
+                    placed = true;
+                    break;
+                }
+            }
+        });
+
+        if(!placed)
+        {
+            spdlog::error("fixed allocation at {:x} overlaps memory already in use", addr);
+            return 0;
+        }
+
+        commit(at, s);
+
         return addr;
     }
 
-    void block::dealloc(vm::addr ptr)
+    u64 block::dealloc(vm::addr ptr)
     {
+        u64 size = 0;
+
         LOCKED({
-            // TODO
+            // the first link only marks the start of the block
+            for(link* cur = begin; cur->next; cur = cur->next)
+            {
+                link* next = cur->next;
+
+                if(next->addr == ptr && next->len && next->next)
+                {
+                    size = next->len;
+                    cur->next = next->next;
+                    delete next;
+                    used -= size;
+                    break;
+                }
+            }
         });
+
+        if(size)
+            release_pages(ptr, size);
+
+        return size;
+    }
+
+    bool block::allocated(vm::addr at, u64 size)
+    {
+        u64 pos = at;
+        u64 end = at + size;
+
+        LOCKED({
+            // the links are in address order so touching allocations carry the range along
+            for(link* cur = begin->next; cur && pos < end; cur = cur->next)
+            {
+                if(cur->addr <= pos && pos < cur->addr + cur->len)
+                    pos = cur->addr + cur->len;
+            }
+        });
+
+        return pos >= end;
     }
 
     void* base(addr of)
@@ -77,30 +176,181 @@ namespace volts::vm
         return base_addr + of;
     }
 
+    struct mmio_range
+    {
+        addr begin;
+        addr end;
+        mmio_read_t read;
+        mmio_write_t write;
+    };
+
+    constexpr u32 max_mmio = 8;
+
+    struct mmio_table
+    {
+        mmio_range ranges[max_mmio] = {};
+    };
+
+    // lookups happen on every guest load and store that passes the floor so they dont take a lock.
+    // a table is never changed once published, map and unmap publish a copy instead.
+    // replaced tables are kept since a reader may still be using one, devices are
+    // only created and destroyed a handful of times so they dont add up
+    static std::mutex mmio_mut;
+    static std::vector<std::unique_ptr<mmio_table>> mmio_tables;
+    static std::atomic<const mmio_table*> mmio = nullptr;
+
+    std::atomic<addr> mmio_floor = ~0ull;
+
+    // must be called with mmio_mut held
+    static void publish(std::unique_ptr<mmio_table> table)
+    {
+        addr floor = ~0ull;
+
+        for(auto& range : table->ranges)
+            if(range.end)
+                floor = std::min(floor, range.begin);
+
+        mmio.store(table.get());
+        mmio_floor.store(floor);
+
+        mmio_tables.push_back(std::move(table));
+    }
+
+    // must be called with mmio_mut held
+    static std::unique_ptr<mmio_table> copy_mmio()
+    {
+        auto* now = mmio.load();
+        return now ? std::make_unique<mmio_table>(*now) : std::make_unique<mmio_table>();
+    }
+
+    bool map_mmio(addr begin, u64 size, mmio_read_t read, mmio_write_t write)
+    {
+        std::lock_guard<std::mutex> guard(mmio_mut);
+
+        auto table = copy_mmio();
+
+        for(auto& range : table->ranges)
+        {
+            if(range.end)
+                continue;
+
+            range = { begin, begin + size, read, write };
+            publish(std::move(table));
+            return true;
+        }
+
+        spdlog::error("no free mmio ranges left for {:x}", begin);
+        return false;
+    }
+
+    void unmap_mmio(addr begin)
+    {
+        std::lock_guard<std::mutex> guard(mmio_mut);
+
+        auto table = copy_mmio();
+
+        for(auto& range : table->ranges)
+            if(range.end && range.begin == begin)
+                range = {};
+
+        publish(std::move(table));
+    }
+
+    static const mmio_range* find_mmio(addr at)
+    {
+        auto* table = mmio.load();
+        if(!table)
+            return nullptr;
+
+        for(auto& range : table->ranges)
+            if(at >= range.begin && at < range.end)
+                return &range;
+
+        return nullptr;
+    }
+
+    bool mmio_mapped(addr at)
+    {
+        return find_mmio(at) != nullptr;
+    }
+
+    u32 mmio_read(addr at)
+    {
+        if(auto range = find_mmio(at))
+            return range->read(at);
+
+        return 0;
+    }
+
+    void mmio_write(addr at, u32 val)
+    {
+        if(auto range = find_mmio(at))
+            range->write(at, val);
+    }
+
     block* main = nullptr;
     block* user64k = nullptr;
     block* user1m = nullptr;
     block* rsx = nullptr;
+    block* mapped = nullptr;
     block* video = nullptr;
     block* stack = nullptr;
     block* spu = nullptr;
     block* any = nullptr;
 
+    // the whole guest address space is reserved up front, on windows allocations commit their pages
+    // and elsewhere the host only backs pages once they are touched
+    static constexpr u64 address_space = 0x100000000ULL;
+
+    bool allocated(addr at, u64 size)
+    {
+        for(block* b : { main, user64k, user1m, rsx, mapped, video, stack, spu, any })
+        {
+            if(b && b->contains(at) && b->allocated(at, size))
+                return true;
+        }
+
+        return false;
+    }
+
+    void decommit(addr at, u64 size)
+    {
+#if SYS_WINDOWS
+        VirtualFree(base_addr + at, size, MEM_DECOMMIT);
+        VirtualAlloc(base_addr + at, size, MEM_COMMIT, PAGE_READWRITE);
+#else
+        madvise(base_addr + at, size, MADV_DONTNEED);
+#endif
+    }
+
     void init()
     {
         spdlog::info("initializing vm memory");
-        
-        // create base memory pointer then zero it out
-        base_addr = new byte[0x100000000ULL];
-        std::memset(base_addr, 0, 0x100000000ULL);
+
+        // fresh pages are already zeroed so nothing needs to be cleared
+#if SYS_WINDOWS
+        base_addr = static_cast<u8*>(VirtualAlloc(nullptr, address_space, MEM_RESERVE, PAGE_NOACCESS));
+#else
+        void* mem = mmap(nullptr, address_space, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        base_addr = mem == MAP_FAILED ? nullptr : static_cast<u8*>(mem);
+#endif
+
+        if(!base_addr)
+        {
+            spdlog::critical("failed to reserve guest memory");
+            std::abort();
+        }
 
         {
             main = new block(0x10000, 0x1FFF0000);
             user64k = new block(0x20000000, 0x10000000);
+            user1m = new block(0x30000000, 0x10000000, 0x100000);
 
-            user1m = nullptr;
             rsx = nullptr;
 
+            // mmapper areas are handed out in 256mb segments
+            mapped = new block(0x40000000, 0x80000000, 0x10000000);
+
             video = new block(0xC0000000, 0x10000000);
             stack = new block(0xD0000000, 0x10000000);
             spu = new block(0xE0000000, 0x20000000);
@@ -112,18 +362,19 @@ namespace volts::vm
 
     void deinit()
     {
-        delete[] base_addr;
+#if SYS_WINDOWS
+        VirtualFree(base_addr, 0, MEM_RELEASE);
+#else
+        munmap(base_addr, address_space);
+#endif
 
-        delete main;
-        delete user64k;
-        
-        delete user1m;
-        delete rsx;
+        // the blocks are nulled so anything reporting on them after a shutdown sees them as gone
+        for(block** b : { &main, &user64k, &user1m, &rsx, &mapped, &video, &stack, &spu, &any })
+        {
+            delete *b;
+            *b = nullptr;
+        }
 
-        delete video;
-        delete stack;
-        delete spu;
-        
-        delete any;
+        base_addr = nullptr;
     }
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <types.h>
+#include <endian.h>
 
 #include <mutex>
+#include <atomic>
+#include <type_traits>
 
 namespace volts::vm
 {
@@ -22,11 +25,36 @@ namespace volts::vm
         *reinterpret_cast<T*>(base(at)) = val;
     }
 
+    /**
+     * @brief a typed pointer into guest memory
+     * 
+     * stored as a big endian 32 bit address so it has the same
+     * layout as a pointer inside a guest structure
+     * 
+     * @tparam T the type being pointed to
+     */
     template<typename T>
-    T* ptr(addr at)
+    struct ptr
     {
-        return reinterpret_cast<T*>(base(at));
-    }
+        ptr() = default;
+        ptr(svl::u32 at) : val(svl::endian::byte_swap(at)) {}
+
+        /// the guest address being pointed to
+        svl::u32 addr() const { return val.get(); }
+
+        /// the host pointer to the guest memory
+        T* get() const { return reinterpret_cast<T*>(base(val.get())); }
+
+        T* operator->() const { return get(); }
+        std::add_lvalue_reference_t<T> operator*() const { return *get(); }
+
+        explicit operator bool() const { return val.get() != 0; }
+
+    private:
+        svl::endian::big<svl::u32> val;
+    };
+
+    static_assert(sizeof(ptr<void>) == sizeof(svl::u32));
 
     template<typename T>
     T& ref(addr at)
@@ -92,25 +120,124 @@ namespace volts::vm
         /**
          * @brief deallocate a peice of memory in the block
          * 
+         * the pages are given back to the host and read as zero when they are next used
+         * 
          * @param ptr the block to deallocate
+         * @return svl::u64 the size that was freed, 0 if nothing was allocated at ptr
          */
-        void dealloc(vm::addr ptr);
+        svl::u64 dealloc(vm::addr ptr);
 
+        /**
+         * @brief allocate memory at a fixed address
+         * 
+         * @param addr the address to allocate at
+         * @param size the size to allocate
+         * @return vm::addr addr, or 0 if the range overlaps memory already in use
+         */
         vm::addr falloc(vm::addr addr, svl::u64 size);
 
+        /**
+         * @brief check if a range has been allocated from the block
+         * 
+         * @param at the first address of the range
+         * @param size the size of the range
+         * @return true if every byte of the range is part of an allocation
+         */
+        bool allocated(vm::addr at, svl::u64 size);
+
+        /**
+         * @brief check if an address is inside the block
+         */
+        bool contains(vm::addr at) const
+        {
+            return at >= begin->addr && at < begin->addr + width;
+        }
+
+        /// bytes currently allocated from the block
+        std::atomic<svl::u64> used = 0;
+
     private:
         std::mutex mut;
     };
 
+    /// reads and writes of a 32 bit device register
+    using mmio_read_t = svl::u32(*)(addr at);
+    using mmio_write_t = void(*)(addr at, svl::u32 val);
+
+    /// lowest address with registers mapped, everything below it is plain memory
+    extern std::atomic<addr> mmio_floor;
+
+    /**
+     * @brief route guest accesses to a range of addresses to handlers instead of memory
+     *
+     * only 32 bit ppu loads and stores are routed, anything else still sees the memory underneath
+     *
+     * @param begin first address of the range
+     * @param size size of the range in bytes
+     * @param read called for loads
+     * @param write called for stores
+     * @return false if there are no free ranges left
+     */
+    bool map_mmio(addr begin, svl::u64 size, mmio_read_t read, mmio_write_t write);
+
+    /**
+     * @brief stop routing a range mapped by map_mmio
+     *
+     * @param begin first address of the range
+     */
+    void unmap_mmio(addr begin);
+
+    /**
+     * @brief check if an address belongs to a range mapped by map_mmio
+     *
+     * @param at the address
+     * @return true if accesses to the address go to a handler
+     */
+    bool mmio_mapped(addr at);
+
+    svl::u32 mmio_read(addr at);
+    void mmio_write(addr at, svl::u32 val);
+
+    /// the common case of plain memory costs a single compare
+    inline bool is_mmio(addr at)
+    {
+        return at >= mmio_floor.load(std::memory_order_relaxed) && mmio_mapped(at);
+    }
+
     extern block* main;
     extern block* user64k;
     extern block* user1m;
     extern block* rsx;
+
+    /// address ranges reserved by sys_mmapper for shared memory to be mapped into
+    extern block* mapped;
     extern block* video;
     extern block* stack;
     extern block* spu;
     extern block* any;
 
+    /**
+     * @brief check if a range has been allocated from any block
+     * 
+     * on windows only allocated ranges are committed so nothing else can be touched safely
+     * 
+     * @param at the first address of the range
+     * @param size the size of the range
+     * @return true if every byte of the range is part of an allocation
+     */
+    bool allocated(addr at, svl::u64 size);
+
+    /**
+     * @brief give the host memory behind a range back, it reads as zero afterwards
+     * 
+     * @param at the first address, page aligned
+     * @param size the size of the range
+     */
+    void decommit(addr at, svl::u64 size);
+
+    /**
+     * @brief reserve guest memory, pages are only backed once they are allocated or first touched
+     */
     void init();
     void deinit();
 }
\ No newline at end of file